@@ -0,0 +1,21 @@
+# - Try to find UnitTest++
+# Once done this will define
+#
+#  UNITTESTPLUSPLUS_FOUND - system has UnitTest++
+#  UNITTESTPLUSPLUS_INCLUDE_DIR - the UnitTest++ include directory
+#  UNITTESTPLUSPLUS_LIBRARIES - Link these to use UnitTest++
+#
+# Redistribution and use is allowed according to the terms of the BSD license.
+# For details see the accompanying COPYING-CMAKE-SCRIPTS file.
+
+if(UNITTESTPLUSPLUS_INCLUDE_DIR AND UNITTESTPLUSPLUS_LIBRARIES)
+	set(UnitTestPlusPlus_FIND_QUIETLY TRUE)
+endif()
+
+find_path(UNITTESTPLUSPLUS_INCLUDE_DIR NAMES UnitTest++.h PATH_SUFFIXES UnitTest++ unittest++)
+find_library(UNITTESTPLUSPLUS_LIBRARIES NAMES UnitTest++ unittest++)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(UnitTestPlusPlus DEFAULT_MSG UNITTESTPLUSPLUS_INCLUDE_DIR UNITTESTPLUSPLUS_LIBRARIES)
+
+mark_as_advanced(UNITTESTPLUSPLUS_INCLUDE_DIR UNITTESTPLUSPLUS_LIBRARIES)
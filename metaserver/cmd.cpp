@@ -511,16 +511,14 @@ static void ParseMsg(Session *session, char *buf)
 **  ParseBuffer: Handler client/server interaction.
 **
 **  @param session  Current session.
+**  @param buf      Line received from the session.
 */
-static void ParseBuffer(Session *session)
+static void ParseBuffer(Session *session, char *buf)
 {
-	char *buf;
-
-	if (!session || session->Buffer[0] == '\0') {
+	if (!session || buf[0] == '\0') {
 		return;
 	}
 
-	buf = session->Buffer;
 	if (!strncmp(buf, "PING", 4)) {
 		ParsePing(session);
 	} else {
@@ -554,43 +552,61 @@ static void ParseBuffer(Session *session)
 		} else if (!strncmp(buf, "MSG ", 4)) {
 			ParseMsg(session, buf + 4);
 		} else {
-			fprintf(stderr, "Unknown command: %s\n", session->Buffer);
+			fprintf(stderr, "Unknown command: %s\n", buf);
 			Send(session, "ERR_BADCOMMAND\n");
 		}
 	}
 }
 
 /**
-**  Parse all session buffers
+**  Parse the complete lines received by a session
+**
+**  @param session  Session with new data.
 */
-int UpdateParser(void)
+static void ParseSession(Session *session)
 {
-	Session *session;
-	int len;
-	char *next;
+	char *line = session->Buffer;
+	char *end = session->Buffer + session->BufferLength;
 
-	if (!Pool || !Pool->First) {
-		// No connections
-		return 0;
+	// Confirm full message.
+	for (char *next = line; next != end && !session->Dead; ++next) {
+		if (*next != '\r' && *next != '\n') {
+			continue;
+		}
+		*next = '\0';
+		if (next + 1 != end && (next[1] == '\r' || next[1] == '\n')) {
+			*++next = '\0';
+		}
+		ParseBuffer(session, line);
+		line = next + 1;
+	}
+	if (session->Dead) {
+		return;
 	}
+	// Remove parsed messages
+	session->BufferLength = end - line;
+	memmove(session->Buffer, line, session->BufferLength);
+	session->Buffer[session->BufferLength] = '\0';
+}
 
-	for (session = Pool->First; session; session = session->Next) {
-		// Confirm full message.
-		while ((next = strpbrk(session->Buffer, "\r\n"))) {
-			*next++ = '\0';
-			if (*next == '\r' || *next == '\n') {
-				++next;
-			}
+/**
+**  Parse the buffers of the sessions which received data
+*/
+int UpdateParser(void)
+{
+	if (!Pool) {
+		return 0;
+	}
 
-			ParseBuffer(session);
+	for (size_t i = 0; i != Pool->Ready.size(); ++i) {
+		Session *session = Pool->Ready[i];
 
-			// Remove parsed message
-			len = next - session->Buffer;
-			memmove(session->Buffer, next, sizeof(session->Buffer) - len);
-			session->Buffer[sizeof(session->Buffer) - len] = '\0';
+		session->Ready = false;
+		if (!session->Dead) {
+			ParseSession(session);
 		}
-
 	}
+	Pool->Ready.clear();
 
 	if (strlen(UDPBuffer)) {
 		// If this is a server, we'll note its external data. When clients join,
@@ -159,11 +159,12 @@ int getopt(int argc, char *const *argv, const char *opts)
 
 /**
 **  Main loop
+**
+**  UpdateSessions blocks until a socket is ready, so the requests are
+**  handled as soon as they arrive.
 */
 static void MainLoop(void)
 {
-	Uint32 ticks[2];
-	int delay;
 	int done;
 
 	//
@@ -171,30 +172,11 @@ static void MainLoop(void)
 	//
 	done = 0;
 	while (!done) {
-		ticks[0] = SDL_GetTicks();
-
 		//
 		// Update sessions and buffers.
 		//
-		UpdateSessions();
+		UpdateSessions(Server.PollingDelay);
 		UpdateParser();
-
-		ticks[1] = SDL_GetTicks();
-
-		//
-		// Idle out the remainder of this loop.
-		//
-		if ((int)(ticks[1] - ticks[0]) > Server.PollingDelay) {
-			delay = 0;
-		} else {
-			delay = Server.PollingDelay - (ticks[1] - ticks[0]);
-		}
-
-		if (delay > 2000) {
-			delay = 2000;
-		}
-
-		SDL_Delay(delay);
 	}
 
 }
@@ -257,7 +239,7 @@ int main(int argc, char **argv)
 					   "-p\tEnable debug print\n"
 					   "-m\tMax connections\n"
 					   "-i\tIdle timeout\n"
-					   "-d\tPolling delay\n");
+					   "-d\tMax wait for socket events (ms)\n");
 				exit(0);
 				break;
 			case '?':
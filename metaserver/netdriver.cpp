@@ -40,6 +40,10 @@
 #ifndef _MSC_VER
 #include <errno.h>
 #endif
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
 
 #include "stratagus.h"
 #include "games.h"
@@ -88,6 +92,9 @@
 	--count;                          \
 }
 
+#define IDLE_WHEEL_SIZE		256			// Slots (of 1 second) of the idle timer wheel
+#define MAX_EVENTS			256			// Events handled per epoll_wait
+
 /*----------------------------------------------------------------------------
 --  Variables
 ----------------------------------------------------------------------------*/
@@ -95,6 +102,14 @@
 static Socket MasterSocket;
 static Socket HolePunchSocket;
 
+#ifdef HAVE_EPOLL
+static int EpollFd = -1;                       /// epoll instance of all sockets
+static char HolePunchTag;                      /// epoll data of HolePunchSocket
+#endif
+
+static Session *IdleWheel[IDLE_WHEEL_SIZE];    /// Sessions by idle deadline
+static time_t IdleWheelTime;                   /// Last second handled by the wheel
+
 SessionPool *Pool;
 ServerStruct Server;
 char UDPBuffer[16 /* GameData->IP */ + 6 /* GameData->Port */ + 1] = {'\0'};
@@ -106,14 +121,168 @@ int UDPPort = 0;
 ----------------------------------------------------------------------------*/
 
 /**
-**  Send a message to a session
+**  Append data to the ring buffer.
 **
-**  @param session  Session to send the message to
-**  @param msg      Message to send
+**  @param buf  Data to append.
+**  @param len  Length of the data.
+**
+**  @return     false if the buffer is full.
 */
-void Send(Session *session, const char *msg)
+bool RingBuffer::Write(const char *buf, int len)
+{
+	if (Length + len > SESSION_SEND_BUFFER_SIZE) {
+		return false;
+	}
+	if (!Data) {
+		Data = new char[SESSION_SEND_BUFFER_SIZE];
+	}
+	int end = (Start + Length) % SESSION_SEND_BUFFER_SIZE;
+	int first = std::min(len, SESSION_SEND_BUFFER_SIZE - end);
+	memcpy(Data + end, buf, first);
+	memcpy(Data, buf + first, len - first);
+	Length += len;
+	return true;
+}
+
+/**
+**  Get the contiguous data at the start of the ring buffer.
+**
+**  @param buf  Set to the start of the data.
+**
+**  @return     Size of the contiguous data.
+*/
+int RingBuffer::Peek(const char **buf) const
+{
+	*buf = Data + Start;
+	return std::min(Length, SESSION_SEND_BUFFER_SIZE - Start);
+}
+
+/**
+**  Remove data from the start of the ring buffer.
+**
+**  @param len  Length of the data to remove.
+*/
+void RingBuffer::Consume(int len)
+{
+	Start = (Start + len) % SESSION_SEND_BUFFER_SIZE;
+	Length -= len;
+	if (Length == 0) {
+		// Free the memory of sessions which caught up.
+		delete[] Data;
+		Data = NULL;
+		Start = 0;
+	}
+}
+
+/**
+**  Check if the last socket operation failed because it would block.
+*/
+static bool WouldBlock()
+{
+#ifdef USE_WINSOCK
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EWOULDBLOCK || errno == EAGAIN;
+#endif
+}
+
+/**
+**  Add a socket to the watched sockets.
+**
+**  @param sock  Socket to watch.
+**  @param data  Data returned with the events of the socket.
+*/
+static int PollAdd(Socket sock, void *data)
+{
+#ifdef HAVE_EPOLL
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = data;
+	return epoll_ctl(EpollFd, EPOLL_CTL_ADD, sock, &event);
+#else
+	Pool->Sockets->AddSocket(sock);
+	return 0;
+#endif
+}
+
+/**
+**  Watch if the socket of a session accepts more output.
+**
+**  @param session  Session to update.
+**  @param enable   Also watch for output.
+*/
+static void PollWrite(Session *session, bool enable)
+{
+	if (session->WaitWrite == enable) {
+		return;
+	}
+	session->WaitWrite = enable;
+#ifdef HAVE_EPOLL
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = enable ? EPOLLIN | EPOLLOUT : EPOLLIN;
+	event.data.ptr = session;
+	epoll_ctl(EpollFd, EPOLL_CTL_MOD, session->Sock, &event);
+#endif
+}
+
+/**
+**  Stop watching a socket.
+**
+**  @param sock  Socket to remove.
+*/
+static void PollDel(Socket sock)
+{
+#ifdef HAVE_EPOLL
+	struct epoll_event event; // Needed by old kernels
+	epoll_ctl(EpollFd, EPOLL_CTL_DEL, sock, &event);
+#else
+	Pool->Sockets->DelSocket(sock);
+#endif
+}
+
+/**
+**  Put a session in the idle timer slot of its deadline.
+**
+**  @param session  Session to schedule.
+*/
+static void IdleWheelAdd(Session *session)
+{
+	session->Deadline = session->Idle + Server.IdleTimeout;
+	if (session->Deadline <= IdleWheelTime) {
+		session->Deadline = IdleWheelTime + 1;
+	}
+	Session *&slot = IdleWheel[session->Deadline % IDLE_WHEEL_SIZE];
+	session->TimerPrev = NULL;
+	session->TimerNext = slot;
+	if (slot) {
+		slot->TimerPrev = session;
+	}
+	slot = session;
+}
+
+/**
+**  Remove a session from the idle timer wheel.
+**
+**  @param session  Session to remove.
+*/
+static void IdleWheelRemove(Session *session)
 {
-	NetSendTCP(session->Sock, msg, strlen(msg));
+	if (session->Deadline == 0) { // Not scheduled
+		return;
+	}
+	if (session->TimerPrev) {
+		session->TimerPrev->TimerNext = session->TimerNext;
+	} else {
+		IdleWheel[session->Deadline % IDLE_WHEEL_SIZE] = session->TimerNext;
+	}
+	if (session->TimerNext) {
+		session->TimerNext->TimerPrev = session->TimerPrev;
+	}
+	session->TimerNext = NULL;
+	session->TimerPrev = NULL;
+	session->Deadline = 0;
 }
 
 /**
@@ -154,7 +323,7 @@ int ServerInit(int port)
 		goto error;
 	}
 
-	if (NetListenTCP(MasterSocket) == -1) {
+	if (NetListenTCP(MasterSocket, SOMAXCONN) == -1) {
 		fprintf(stderr, "NetListenTCP failed\n");
 		code = -4;
 		goto error;
@@ -166,15 +335,32 @@ int ServerInit(int port)
 		goto error;
 	}
 
+#ifdef HAVE_EPOLL
+	if ((EpollFd = epoll_create(Server.MaxConnections + 2)) == -1) {
+		fprintf(stderr, "epoll_create failed\n");
+		code = -6;
+		goto error;
+	}
+#else
 	if (!(Pool->Sockets = new SocketSet)) {
 		code = -6;
 		goto error;
 	}
+#endif
 
 	Pool->First = NULL;
 	Pool->Last = NULL;
 	Pool->Count = 0;
 
+#ifdef HAVE_EPOLL
+	PollAdd(MasterSocket, NULL);
+	PollAdd(HolePunchSocket, &HolePunchTag);
+#else
+	PollAdd(MasterSocket, NULL);
+	PollAdd(HolePunchSocket, NULL);
+#endif
+	IdleWheelTime = time(0);
+
 	return 0;
 
  error:
@@ -190,6 +376,7 @@ int ServerInit(int port)
 void ServerQuit(void)
 {
 	NetCloseTCP(MasterSocket);
+	NetCloseUDP(HolePunchSocket);
 	// begin clean up of any remaining sockets
 	if (Pool) {
 		Session *ptr;
@@ -200,40 +387,109 @@ void ServerQuit(void)
 			NetCloseTCP(ptr->Sock);
 			delete ptr;
 		}
+		for (size_t i = 0; i != Pool->Dead.size(); ++i) {
+			delete Pool->Dead[i];
+		}
 
 		delete Pool->Sockets;
 		delete Pool;
 	}
+#ifdef HAVE_EPOLL
+	if (EpollFd != -1) {
+		close(EpollFd);
+		EpollFd = -1;
+	}
+#endif
 
 	NetExit();
 }
 
-/**
-**  Returns time (in seconds) that a session has been idle.
-**
-**  @param session  This is the session we are checking.
-*/
-static int IdleSeconds(Session *session)
-{
-	return (int)(time(0) - session->Idle);
-}
-
 /**
 **  Destroys and cleans up session data.
 **
+**  The session is only deleted on the next update, so it may be killed
+**  while it is parsed.
+**
 **  @param session  Reference to the session to be killed.
 */
 static int KillSession(Session *session)
 {
+	if (session->Dead) {
+		return 0;
+	}
 	DebugPrint("Closing connection from '%s'\n" _C_ session->AddrData.IPStr);
+	PollDel(session->Sock);
 	NetCloseTCP(session->Sock);
-	Pool->Sockets->DelSocket(session->Sock);
+	IdleWheelRemove(session);
 	UNLINK(Pool->First, session, Pool->Last, Pool->Count);
+	session->Next = NULL;
+	session->Prev = NULL;
 	PartGame(session);
-	delete session;
+	session->Dead = true;
+	Pool->Dead.push_back(session);
 	return 0;
 }
 
+/**
+**  Send the pending output of a session.
+**
+**  @param session  Session to flush.
+*/
+static void FlushSession(Session *session)
+{
+	while (!session->SendBuffer.Empty()) {
+		const char *buf;
+		const int len = session->SendBuffer.Peek(&buf);
+		const int sent = NetSendTCP(session->Sock, buf, len);
+		if (sent <= 0) {
+			if (sent < 0 && !WouldBlock()) {
+				KillSession(session);
+				return;
+			}
+			break;
+		}
+		session->SendBuffer.Consume(sent);
+	}
+	PollWrite(session, !session->SendBuffer.Empty());
+}
+
+/**
+**  Send a message to a session
+**
+**  What the socket does not accept now is kept in the session send
+**  buffer and sent when the socket is writable again.
+**
+**  @param session  Session to send the message to
+**  @param msg      Message to send
+*/
+void Send(Session *session, const char *msg)
+{
+	if (session->Dead) {
+		return;
+	}
+	int len = strlen(msg);
+	if (session->SendBuffer.Empty()) {
+		const int sent = NetSendTCP(session->Sock, msg, len);
+		if (sent < 0 && !WouldBlock()) {
+			KillSession(session);
+			return;
+		}
+		if (sent > 0) {
+			msg += sent;
+			len -= sent;
+		}
+	}
+	if (len == 0) {
+		return;
+	}
+	if (!session->SendBuffer.Write(msg, len)) {
+		DebugPrint("Send buffer full for '%s'\n" _C_ session->AddrData.IPStr);
+		KillSession(session);
+		return;
+	}
+	FlushSession(session);
+}
+
 /**
 **  Accept new connections
 */
@@ -257,6 +513,7 @@ static void AcceptConnections()
 			break;
 		}
 
+		NetSetNonBlocking(new_socket);
 		new_session->Sock = new_socket;
 		new_session->Idle = time(0);
 
@@ -265,39 +522,141 @@ static void AcceptConnections()
 		new_session->AddrData.Port = port;
 		DebugPrint("New connection from '%s'\n" _C_ new_session->AddrData.IPStr);
 
+		if (PollAdd(new_socket, new_session) == -1) {
+			NetCloseTCP(new_socket);
+			delete new_session;
+			break;
+		}
 		LINK(Pool->First, new_session, Pool->Last, Pool->Count);
-		Pool->Sockets->AddSocket(new_socket);
+		IdleWheelAdd(new_session);
 	}
-	if (NetSocketReady(HolePunchSocket, 0)) {
-		NetRecvUDP(HolePunchSocket, UDPBuffer, sizeof(UDPBuffer), &UDPHost, &UDPPort);
-		DebugPrint("New UDP %s (%d %d)\n" _C_ UDPBuffer _C_ UDPHost _C_ UDPPort);
+}
+
+/**
+**  Receive the UDP message of a game server.
+*/
+static void ReadHolePunch()
+{
+	if (NetRecvUDP(HolePunchSocket, UDPBuffer, sizeof(UDPBuffer) - 1, &UDPHost, &UDPPort) > 0) {
+		UDPBuffer[sizeof(UDPBuffer) - 1] = '\0';
+		DebugPrint("New UDP %s (%d %d)\n" _C_ UDPBuffer _C_ UDPHost _C_ UDPPort);
 	}
 }
 
 /**
 **  Kick idlers
+**
+**  Only the sessions of the timer slots of the elapsed seconds are
+**  checked. Sessions which were active since they were scheduled are
+**  scheduled again.
 */
 static void KickIdlers(void)
 {
-	Session *session;
-	Session *next;
+	const time_t now = time(0);
 
-	for (session = Pool->First; session; ) {
-		next = session->Next;
-		if (IdleSeconds(session) > Server.IdleTimeout) {
-			DebugPrint("Kicking idler '%s'\n" _C_ session->AddrData.IPStr);
-			KillSession(session);
+	if (now - IdleWheelTime > IDLE_WHEEL_SIZE) {
+		IdleWheelTime = now - IDLE_WHEEL_SIZE;
+	}
+	while (IdleWheelTime < now) {
+		++IdleWheelTime;
+		Session *session = IdleWheel[IdleWheelTime % IDLE_WHEEL_SIZE];
+		IdleWheel[IdleWheelTime % IDLE_WHEEL_SIZE] = NULL;
+		while (session) {
+			Session *next = session->TimerNext;
+			session->TimerNext = NULL;
+			session->TimerPrev = NULL;
+			session->Deadline = 0;
+			if (session->Idle + Server.IdleTimeout < now) {
+				DebugPrint("Kicking idler '%s'\n" _C_ session->AddrData.IPStr);
+				KillSession(session);
+			} else {
+				IdleWheelAdd(session);
+			}
+			session = next;
 		}
-		session = next;
 	}
 }
 
 /**
-**  Read data
+**  Read data of a session
+**
+**  @param session  Session with data to read.
+*/
+static void ReadSession(Session *session)
+{
+	// Keep a byte for the '\0' of the parser.
+	const int space = sizeof(session->Buffer) - 1 - session->BufferLength;
+	if (space == 0) {
+		DebugPrint("Line too long from '%s'\n" _C_ session->AddrData.IPStr);
+		KillSession(session);
+		return;
+	}
+	session->Idle = time(0);
+	const int result = NetRecvTCP(session->Sock, session->Buffer + session->BufferLength, space);
+	if (result < 0) {
+		KillSession(session);
+		return;
+	}
+	session->BufferLength += result;
+	session->Buffer[session->BufferLength] = '\0';
+	if (result > 0 && !session->Ready) {
+		session->Ready = true;
+		Pool->Ready.push_back(session);
+	}
+}
+
+#ifdef HAVE_EPOLL
+
+/**
+**  Wait for socket events and handle them.
+**
+**  @param timeout  Maximum time to wait in ms.
 */
-static int ReadData()
+static int ReadData(int timeout)
 {
-	int result = Pool->Sockets->Select(0);
+	struct epoll_event events[MAX_EVENTS];
+	int result;
+
+	do {
+		result = epoll_wait(EpollFd, events, MAX_EVENTS, timeout);
+	} while (result == -1 && errno == EINTR);
+	if (result == -1) {
+		perror("epoll_wait");
+		return -1;
+	}
+	for (int i = 0; i != result; ++i) {
+		void *data = events[i].data.ptr;
+
+		if (data == NULL) {
+			AcceptConnections();
+		} else if (data == &HolePunchTag) {
+			ReadHolePunch();
+		} else {
+			Session *session = static_cast<Session *>(data);
+			if (session->Dead) {
+				continue;
+			}
+			if (events[i].events & EPOLLOUT) {
+				FlushSession(session);
+			}
+			if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+				ReadSession(session);
+			}
+		}
+	}
+	return 0;
+}
+
+#else
+
+/**
+**  Wait for socket events and handle them.
+**
+**  @param timeout  Maximum time to wait in ms.
+*/
+static int ReadData(int timeout)
+{
+	int result = Pool->Sockets->Select(timeout);
 
 	if (result == 0) {
 		// No sockets ready
@@ -307,21 +666,21 @@ static int ReadData()
 		// FIXME: print error message
 		return -1;
 	}
+	if (Pool->Sockets->HasDataToRead(MasterSocket)) {
+		AcceptConnections();
+	}
+	if (Pool->Sockets->HasDataToRead(HolePunchSocket)) {
+		ReadHolePunch();
+	}
 
 	// ready sockets
 	for (Session *session = Pool->First; session; ) {
 		Session *next = session->Next;
-		if (Pool->Sockets->HasDataToRead(session->Sock)) {
-			// socket ready
-			session->Idle = time(0);
-			int clen = strlen(session->Buffer);
-			result = NetRecvTCP(session->Sock, session->Buffer + clen,
-				sizeof(session->Buffer) - clen);
-			if (result < 0) {
-				KillSession(session);
-			} else {
-				session->Buffer[clen + result] = '\0';
-			}
+		if (session->WaitWrite) {
+			FlushSession(session);
+		}
+		if (!session->Dead && Pool->Sockets->HasDataToRead(session->Sock)) {
+			ReadSession(session);
 		}
 		session = next;
 	}
@@ -329,21 +688,28 @@ static int ReadData()
 	return 0;
 }
 
+#endif
+
 /**
 **  Accepts new connections, receives data, manages buffers,
+**
+**  @param timeout  Maximum time to wait for data in ms.
 */
-int UpdateSessions(void)
+int UpdateSessions(int timeout)
 {
-	AcceptConnections();
-
-	if (!Pool->First) {
-		// No connections
-		return 0;
+	// The parser is done with the sessions killed last time.
+	for (size_t i = 0; i != Pool->Dead.size(); ++i) {
+		delete Pool->Dead[i];
 	}
+	Pool->Dead.clear();
+
+	// Wake up for the next idle timer slot.
+	timeout = std::min(timeout, 1000);
+	const int result = ReadData(timeout);
 
 	KickIdlers();
 
-	return ReadData();
+	return result;
 }
 
 //@}
@@ -37,6 +37,7 @@
 ----------------------------------------------------------------------------*/
 
 #include <time.h>
+#include <vector>
 #include "net_lowlevel.h"
 
 /*----------------------------------------------------------------------------
@@ -48,6 +49,9 @@
 #define DEFAULT_SESSION_TIMEOUT		900			// 15 miniutes
 #define DEFAULT_POLLING_DELAY		250			// MS (1000 = 1s)
 
+#define SESSION_BUFFER_SIZE		1024		// Incoming line buffer
+#define SESSION_SEND_BUFFER_SIZE	16384		// Max pending output per session
+
 #define MAX_USERNAME_LENGTH 32
 #define MAX_PASSWORD_LENGTH 32
 
@@ -60,6 +64,31 @@
 
 class GameData;
 
+/**
+**  Ring buffer holding the output which could not be sent yet.
+**
+**  The storage is only allocated when a send would block, so idle
+**  sessions cost nothing.
+*/
+class RingBuffer {
+public:
+	RingBuffer() : Data(NULL), Start(0), Length(0) {}
+	~RingBuffer() { delete[] Data; }
+
+	bool Empty() const { return Length == 0; }
+	/// Append len bytes, false if they don't fit
+	bool Write(const char *buf, int len);
+	/// Size of the contiguous data at the start of the buffer
+	int Peek(const char **buf) const;
+	/// Remove len bytes from the start of the buffer
+	void Consume(int len);
+
+private:
+	char *Data;
+	int Start;
+	int Length;
+};
+
 /**
 ** Global server variables.
 */
@@ -83,7 +112,9 @@ extern ServerStruct Server;
 */
 class Session {
 public:
-	Session() : Next(NULL), Prev(NULL), Idle(0), Sock(0), Game(NULL)
+	Session() : Next(NULL), Prev(NULL), TimerNext(NULL), TimerPrev(NULL),
+		Deadline(0), BufferLength(0), Idle(0), Sock(0), Dead(false),
+		Ready(false), WaitWrite(false), Game(NULL)
 	{
 		Buffer[0] = '\0';
 		AddrData.Host = 0;
@@ -98,10 +129,19 @@ public:
 	Session *Next;
 	Session *Prev;
 
-	char Buffer[1024];
+	Session *TimerNext;       /// Next session in the same idle timer slot
+	Session *TimerPrev;       /// Previous session in the same idle timer slot
+	time_t Deadline;          /// Time of the idle timer slot
+
+	char Buffer[SESSION_BUFFER_SIZE];
+	int BufferLength;         /// Bytes received in Buffer
+	RingBuffer SendBuffer;    /// Output waiting for the socket
 	time_t Idle;
 
 	Socket Sock;
+	bool Dead;                /// Closed, deleted on next update
+	bool Ready;               /// In the list of sessions to parse
+	bool WaitWrite;           /// Waiting for the socket to accept output
 
 	struct {
 		unsigned long Host;
@@ -130,7 +170,10 @@ public:
 	Session *Last;
 	int Count;
 
-	SocketSet *Sockets;
+	std::vector<Session *> Ready; /// Sessions with new data to parse
+	std::vector<Session *> Dead;  /// Sessions to delete
+
+	SocketSet *Sockets;           /// Used when epoll is not available
 };
 
 /// external reference to session tracking.
@@ -147,7 +190,7 @@ extern void Send(Session *session, const char *msg);
 
 extern int ServerInit(int port);
 extern void ServerQuit(void);
-extern int UpdateSessions(void);
+extern int UpdateSessions(int timeout);
 
 //@}
 
@@ -84,11 +84,13 @@
 ** ::AiEachCycle(::Player)
 **
 ** Called each game cycle, to handle quick checks, which needs
-** less CPU.
+** less CPU. Continues the tasks of the turn started by AiEachSecond.
 **
 ** ::AiEachSecond(::Player)
 **
-** Called each second, to handle more CPU intensive things.
+** Called each second, to handle more CPU intensive things. Starts a
+** turn of the AI, its tasks are spread over the next cycles with a
+** budget of units to look at in each cycle, see AiRunTasks.
 **
 **
 ** @subsection aiecall Event call-backs
@@ -397,6 +399,7 @@ static void SaveAiPlayer(CFile &file, int plynr, const PlayerAi &ai)
 	}
 	file.printf("},\n");
 
+	file.printf("  \"task\", %d, \"task-cursor\", %d,\n", ai.Task, ai.TaskCursor);
 	file.printf("  \"repair-building\", %u\n", ai.LastRepairBuilding);
 
 	file.printf(")\n\n");
@@ -996,6 +999,104 @@ void AiResearchComplete(CUnit &unit, const CUpgrade *what)
 	// FIXME: upgrading knights -> paladins, must rebuild lists!
 }
 
+/**
+**  Run a task of the turn of AiPlayer.
+**
+**  @param task    Task to run.
+**  @param cursor  Where to resume the task, 0 to start it.
+**  @param budget  Units left to look at in this cycle, reduced by the
+**                 units the task looked at.
+**
+**  @return        true if the task is finished, false if it must be
+**                 resumed in the next cycle.
+*/
+static bool AiRunTask(int task, int *cursor, int *budget)
+{
+	const int units = AiPlayer->Player->GetUnitCount();
+
+	switch (task) {
+		case AiTaskScript:
+			AiPlayer->Threat.Update(*AiPlayer->Player);
+			//  Advance script
+			AiExecuteScript();
+			//  Look if everything is fine.
+			AiCheckUnits();
+			*budget -= units;
+			return true;
+		case AiTaskResources:
+			AiResourceManager();
+			*budget -= units;
+			return true;
+		case AiTaskWorkers:
+			return AiResourceManagerWorkers(cursor, budget);
+		case AiTaskRepair:
+			return AiCheckRepair(cursor, budget);
+		case AiTaskForces:
+			return AiForceManager(cursor, budget);
+		case AiTaskMagic:
+			return AiCheckMagic(cursor, budget);
+		case AiTaskExplore:
+			// At most 1 explorer each 5 seconds
+			if (GameCycle > AiPlayer->LastExplorationGameCycle + 5 * CYCLES_PER_SECOND) {
+				AiSendExplorers();
+			}
+			return true;
+		default:
+			return true;
+	}
+}
+
+/**
+**  Run the tasks of a turn until the budget is spent.
+**
+**  The budget counts units, not time, so all clients of a network
+**  game run the same tasks in the same cycles. The task and the cursor
+**  are all the state of the turn, a turn saved with them resumes where
+**  it stopped.
+**
+**  @param task    Current task of the turn, AiTaskDone when finished.
+**  @param cursor  Where to resume the current task.
+**  @param budget  Units to look at.
+**  @param run     Runs a task, see AiRunTask.
+*/
+void AiRunTasks(int *task, int *cursor, int budget, AiTaskFunc run)
+{
+	while (budget > 0 && *task < AiTaskDone) {
+		if (run(*task, cursor, &budget)) {
+			++*task;
+			*cursor = 0;
+		}
+	}
+}
+
+/**
+**  Start a new turn, the last one is finished first.
+**
+**  A late turn gets the budget of one more cycle. If it is still not
+**  finished, it goes on in the next cycles and the new turn waits for
+**  the next second, so a cycle never looks at more than a few budgets
+**  of units.
+**
+**  @param task    Current task of the turn, AiTaskDone when finished.
+**  @param cursor  Where to resume the current task.
+**  @param run     Runs a task, see AiRunTask.
+**
+**  @return        true if the new turn is started.
+*/
+bool AiStartTurn(int *task, int *cursor, AiTaskFunc run)
+{
+	if (*task < AiTaskDone) {
+		AiRunTasks(task, cursor, AiUnitsPerCycle, run);
+		if (*task < AiTaskDone) {
+			return false;
+		}
+	}
+	*task = AiTaskScript;
+	*cursor = 0;
+	AiRunTasks(task, cursor, AiUnitsPerCycle, run);
+	return true;
+}
+
 /**
 **  This is called for each player, each game cycle.
 **
@@ -1004,11 +1105,20 @@ void AiResearchComplete(CUnit &unit, const CUpgrade *what)
 void AiEachCycle(CPlayer &player)
 {
 	AiPlayer = player.Ai;
+#ifdef DEBUG
+	if (!AiPlayer) {
+		return;
+	}
+#endif
+
+	AiRunTasks(&AiPlayer->Task, &AiPlayer->TaskCursor, AiUnitsPerCycle, AiRunTask);
 }
 
 /**
 **  This is called for each player each second.
 **
+**  Starts a new turn of the AI, see AiStartTurn.
+**
 **  @param player  The player structure pointer.
 */
 void AiEachSecond(CPlayer &player)
@@ -1020,25 +1130,7 @@ void AiEachSecond(CPlayer &player)
 	}
 #endif
 
-	//  Advance script
-	AiExecuteScript();
-
-	//  Look if everything is fine.
-	AiCheckUnits();
-
-	//  Handle the resource manager.
-	AiResourceManager();
-
-	//  Handle the force manager.
-	AiForceManager();
-
-	//  Check for magic actions.
-	AiCheckMagic();
-
-	// At most 1 explorer each 5 seconds
-	if (GameCycle > AiPlayer->LastExplorationGameCycle + 5 * CYCLES_PER_SECOND) {
-		AiSendExplorers();
-	}
+	AiStartTurn(&AiPlayer->Task, &AiPlayer->TaskCursor, AiRunTask);
 }
 
 //@}
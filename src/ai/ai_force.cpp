@@ -1053,10 +1053,24 @@ void AiForce::Update()
 	}
 }
 
-void AiForceManager::Update()
+/**
+**  Update the forces, resumable.
+**
+**  @param cursor  Index of the next force to update.
+**  @param budget  Units left to look at, reduced by the units of the
+**                 forces updated.
+**
+**  @return        true if the forces are updated, false if the budget
+**                 is spent first.
+*/
+bool AiForceManager::Update(int *cursor, int *budget)
 {
-	for (unsigned int f = 0; f < forces.size(); ++f) {
-		AiForce &force = forces[f];
+	for (; *cursor < (int)forces.size(); ++*cursor) {
+		if (*budget <= 0) {
+			return false;
+		}
+		AiForce &force = forces[*cursor];
+		*budget -= 1 + force.Size();
 		//  Look if our defenders still have enemies in range.
 
 		if (force.Defending) {
@@ -1086,7 +1100,7 @@ void AiForceManager::Update()
 
 				if (force.Defending == false) {
 					// force is no longer defending
-					return;
+					return true;
 				}
 
 				// Find idle units and order them to defend
@@ -1127,15 +1141,26 @@ void AiForceManager::Update()
 			force.Update();
 		}
 	}
+	return true;
 }
 
 /**
-**  Entry point of force manager, periodic called.
+**  Entry point of force manager, periodic called, resumable.
+**
+**  @param cursor  Index of the next force to update.
+**  @param budget  Units left to look at, reduced by the units looked at.
+**
+**  @return        true if the forces are updated and the free units
+**                 assigned, false if it must be resumed.
 */
-void AiForceManager()
+bool AiForceManager(int *cursor, int *budget)
 {
-	AiPlayer->Force.Update();
+	if (!AiPlayer->Force.Update(cursor, budget)) {
+		return false;
+	}
 	AiAssignFreeUnitsToForce();
+	*budget -= AiPlayer->Player->GetUnitCount();
+	return true;
 }
 
 //@}
@@ -230,7 +230,7 @@ public:
 	int GetForce(const CUnit &unit);
 	void RemoveDeadUnit();
 	bool Assign(CUnit &unit, int force = -1);
-	void Update();
+	bool Update(int *cursor, int *budget);
 	unsigned int FindFreeForce(AiForceRole role = AiForceRoleDefault, int begin = 0);
 	void CheckUnits(int *counter);
 private:
@@ -275,13 +275,82 @@ public:
 /**
 **  AI variables.
 */
+/**
+**  Tasks of a turn of the AI, run in this order.
+*/
+enum AiTask {
+	AiTaskScript,     /// Update the threat map, run the script, check the units
+	AiTaskResources,  /// Resource manager
+	AiTaskWorkers,    /// Assign the workers to resources
+	AiTaskRepair,     /// Look for units to repair, resumes
+	AiTaskForces,     /// Force manager
+	AiTaskMagic,      /// Autocast of the spells, resumes
+	AiTaskExplore,    /// Send explorers
+	AiTaskDone        /// The turn is finished
+};
+
+/// Units the AI of a player looks at in a game cycle
+#define AiUnitsPerCycle 64
+
+/// Runs a task of a turn of the AI, see AiRunTasks
+typedef bool (*AiTaskFunc)(int task, int *cursor, int *budget);
+
+/**
+**  Enemies of an AI player on the map, counted again each second.
+**
+**  The enemies are counted as summed area tables, so the enemies in a
+**  rectangle are found with four lookups instead of a Select.
+*/
+class AiThreatMap
+{
+public:
+	AiThreatMap() : Cycle(0), Width(0), Height(0), TargetConditions(false)
+	{
+		memset(Targets, 0, sizeof(Targets));
+	}
+
+	/// Kinds of units, as targets of the enemies
+	enum {
+		ThreatAll,        /// All enemies, whatever they can attack
+		ThreatLand,       /// Land units
+		ThreatSea,        /// Naval units
+		ThreatLandOrSea,  /// Shore buildings
+		ThreatAir,        /// Flying units
+		ThreatMax
+	};
+
+	/// Count the enemies of the player again
+	void Update(const CPlayer &player);
+	/// Start counting the enemies again on a map
+	void Clear(int width, int height);
+	/// Count an enemy seen on each tile it covers
+	void Add(const Vec2i &pos, int width, int height, int canTarget);
+	/// Sum the enemies counted
+	void Sum();
+	/// Check if the map can be used instead of a search
+	bool IsValid(const CUnitType *type) const;
+	/// Count the enemies in a rectangle
+	int Count(const Vec2i &pos0, const Vec2i &pos1, const CUnitType *type) const;
+	/// Check if there is no enemy on the map a unit-type could attack
+	bool HasNoTargetFor(const CUnitType &type) const;
+
+private:
+	unsigned long Cycle;              /// Game cycle of the update + 1, 0 if never
+	int Width;                        /// Map width of the update
+	int Height;                       /// Map height of the update
+	bool TargetConditions;            /// An enemy attacks depending on flags of the target
+	std::vector<int> Seen[ThreatMax]; /// Summed enemies seen, by kind they attack
+	int Targets[ThreatMax];           /// Enemies on the map, by their kind
+};
+
 class PlayerAi
 {
 public:
 	PlayerAi() : Player(NULL), AiType(NULL),
 		SleepCycles(0), NeededMask(0), NeedSupply(false),
 		ScriptDebug(false), BuildDepots(true), LastExplorationGameCycle(0),
-		LastCanNotMoveGameCycle(0), LastRepairBuilding(0)
+		LastCanNotMoveGameCycle(0), LastRepairBuilding(0),
+		Task(AiTaskDone), TaskCursor(0)
 	{
 		memset(Reserve, 0, sizeof(Reserve));
 		memset(Used, 0, sizeof(Used));
@@ -316,6 +385,9 @@ public:
 	std::vector<CUpgrade *> ResearchRequests;     /// Upgrades requested and priority list
 	std::vector<AiBuildQueue> UnitTypeBuilt;      /// What the resource manager should build
 	int LastRepairBuilding;                       /// Last building checked for repair in this turn
+	AiThreatMap Threat;                           /// Enemies around, for AiEnemyUnitsInDistance
+	int Task;                                     /// Current task of the turn, see AiEachSecond
+	int TaskCursor;                               /// Where to resume the current task
 };
 
 /**
@@ -391,6 +463,14 @@ extern PlayerAi *AiPlayer; /// Current AI player
 --  Functions
 ----------------------------------------------------------------------------*/
 
+//
+// Turn
+//
+/// Run the tasks of a turn until the budget is spent
+extern void AiRunTasks(int *task, int *cursor, int budget, AiTaskFunc run);
+/// Start a new turn, the last one is finished first
+extern bool AiStartTurn(int *task, int *cursor, AiTaskFunc run);
+
 //
 // Resource manager
 //
@@ -402,6 +482,10 @@ extern void AiAddUpgradeToRequest(CUnitType &type);
 extern void AiAddResearchRequest(CUpgrade *upgrade);
 /// Periodic called resource manager handler
 extern void AiResourceManager();
+/// Periodic called handler assigning the workers, resumable
+extern bool AiResourceManagerWorkers(int *cursor, int *budget);
+/// Look for units to repair, resumable
+extern bool AiCheckRepair(int *cursor, int *budget);
 /// Ask the ai to explore around pos
 extern void AiExplore(const Vec2i &pos, int exploreMask);
 /// Make two unittypes be considered equals
@@ -439,8 +523,8 @@ extern void AiAttackWithForce(unsigned int force);
 /// Attack with forces in array
 extern void AiAttackWithForces(int *forces);
 
-/// Periodic called force manager handler
-extern void AiForceManager();
+/// Periodic called force manager handler, resumable
+extern bool AiForceManager(int *cursor, int *budget);
 
 //
 // Plans
@@ -457,8 +541,8 @@ extern int AiEnemyUnitsInDistance(const CPlayer &player, const CUnitType *type,
 //
 // Magic
 //
-/// Check for magic
-extern void AiCheckMagic();
+/// Check for magic, resumable
+extern bool AiCheckMagic(int *cursor, int *budget);
 
 //@}
 
@@ -47,20 +47,29 @@
 /**
 **  Check what computer units can do with magic.
 **  In fact, turn on autocast for AI.
+**
+**  @param cursor  Next unit to look at, 0 to start.
+**  @param budget  Units left to look at, reduced by the units looked at.
+**
+**  @return        true if done, false if the budget is spent.
 */
-void AiCheckMagic()
+bool AiCheckMagic(int *cursor, int *budget)
 {
 	CPlayer &player = *AiPlayer->Player;
 	const int n = player.GetUnitCount();
 
-	for (int i = 0; i < n; ++i) {
-		CUnit &unit = player.GetUnit(i);
+	for (; *cursor < n; ++*cursor) {
+		if (*budget <= 0) {
+			return false;
+		}
+		--*budget;
+		CUnit &unit = player.GetUnit(*cursor);
 
 		if (unit.Type->CanCastSpell) {
 			// Check only idle magic units
 			for (size_t i = 0; i != unit.Orders.size(); ++i) {
 				if (unit.Orders[i]->Action == UnitActionSpellCast) {
-					return;
+					return true;
 				}
 			}
 			for (unsigned int j = 0; j < SpellTypeTable.size(); ++j) {
@@ -74,6 +83,7 @@ void AiCheckMagic()
 			}
 		}
 	}
+	return true;
 }
 
 //@}
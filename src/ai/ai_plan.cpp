@@ -292,6 +292,10 @@ VisitResult EnemyFinderWithTransporter::Visit(TerrainTraversal &terrainTraversal
 
 static bool AiFindTarget(const CUnit &unit, const TerrainTraversal &terrainTransporter, Vec2i *resultPos)
 {
+	// No need to search the whole map without any target on it
+	if (unit.Player->Ai && unit.Player->Ai->Threat.HasNoTargetFor(*unit.Type)) {
+		return false;
+	}
 	TerrainTraversal terrainTraversal;
 
 	terrainTraversal.SetSize(Map.Info.MapWidth, Map.Info.MapHeight);
@@ -199,17 +199,28 @@ private:
 /**
 **  Enemy units in distance.
 **
+**  Looked up in the threat map of the AI player if it is recent,
+**  the result is then the number of tiles covered by enemies.
+**
 **  @param player  Find enemies of this player
 **  @param type    Optional unit type to check if enemy can target this
 **  @param pos     location
 **  @param range   Distance range to look.
 **
-**  @return       Number of enemy units.
+**  @return       Number of enemy units, 0 if none.
 */
 int AiEnemyUnitsInDistance(const CPlayer &player,
 						   const CUnitType *type, const Vec2i &pos, unsigned range)
 {
 	const Vec2i offset(range, range);
+
+	if (player.Ai && player.Ai->Threat.IsValid(type)) {
+		if (type == NULL) {
+			return player.Ai->Threat.Count(pos - offset, pos + offset, NULL);
+		}
+		const Vec2i typeSize(type->TileWidth - 1, type->TileHeight - 1);
+		return player.Ai->Threat.Count(pos - offset, pos + typeSize + offset, type);
+	}
 	std::vector<CUnit *> units;
 
 	if (type == NULL) {
@@ -934,20 +945,70 @@ static int AiAssignHarvesterFromTerrain(CUnit &unit, int resource)
 	return 0;
 }
 
+/**
+**  Resource units reachable from the depots, found once for all the
+**  workers assigned by a call of AiCollectResources. The units don't
+**  change while it runs, so the sites stay valid until it returns.
+*/
+class AiResourceSites
+{
+public:
+	const CResourceSites &Get(const CUnit &worker, const CUnit &depot, int resource);
+
+private:
+	struct Entry {
+		const CUnit *Depot;    /// Depot the sites are reachable from
+		int MovementMask;      /// Movement of the workers
+		int Resource;          /// Resource of the sites
+		CResourceSites Sites;  /// The resource units
+	};
+	std::vector<Entry> Entries;
+};
+
+/**
+**  Get the sites of a resource reachable by a worker from a depot,
+**  find them if they aren't known yet.
+*/
+const CResourceSites &AiResourceSites::Get(const CUnit &worker, const CUnit &depot, int resource)
+{
+	const int movemask = worker.Type->MovementMask;
+
+	for (size_t i = 0; i != Entries.size(); ++i) {
+		const Entry &entry = Entries[i];
+
+		if (entry.Depot == &depot && entry.MovementMask == movemask && entry.Resource == resource) {
+			return entry.Sites;
+		}
+	}
+	Entries.push_back(Entry());
+	Entry &entry = Entries.back();
+	entry.Depot = &depot;
+	entry.MovementMask = movemask;
+	entry.Resource = resource;
+	FindResourceSites(worker, depot, 1000, resource, entry.Sites);
+	return entry.Sites;
+}
+
 /**
 **  Assign worker to gather a certain resource from Unit.
 **
 **  @param unit      pointer to the unit.
 **  @param resource  resource identification.
+**  @param sites     resources already found from the depots.
 **
 **  @return          1 if the worker was assigned, 0 otherwise.
 */
-static int AiAssignHarvesterFromUnit(CUnit &unit, int resource)
+static int AiAssignHarvesterFromUnit(CUnit &unit, int resource, AiResourceSites &sites)
 {
 	// Try to find the nearest depot first.
 	CUnit *depot = FindDeposit(unit, 1000, resource);
 	// Find a resource to harvest from.
-	CUnit *mine = UnitFindResource(unit, depot ? *depot : unit, 1000, resource, true);
+	CUnit *mine;
+	if (depot && unit.Player->AiEnabled) {
+		mine = ChooseResourceSite(unit, sites.Get(unit, *depot, resource), resource, true);
+	} else {
+		mine = UnitFindResource(unit, depot ? *depot : unit, 1000, resource, true);
+	}
 
 	if (mine) {
 		CommandResource(unit, *mine, FlushCommands);
@@ -985,10 +1046,11 @@ static int AiAssignHarvesterFromUnit(CUnit &unit, int resource)
 **
 **  @param unit      pointer to the unit.
 **  @param resource  resource identification.
+**  @param sites     resources already found from the depots.
 **
 **  @return          1 if the worker was assigned, 0 otherwise.
 */
-static int AiAssignHarvester(CUnit &unit, int resource)
+static int AiAssignHarvester(CUnit &unit, int resource, AiResourceSites &sites)
 {
 	// It can't.
 	if (unit.Removed) {
@@ -1001,7 +1063,7 @@ static int AiAssignHarvester(CUnit &unit, int resource)
 	if (resinfo.TerrainHarvester) {
 		return AiAssignHarvesterFromTerrain(unit, resource);
 	} else {
-		return AiAssignHarvesterFromUnit(unit, resource);
+		return AiAssignHarvesterFromUnit(unit, resource, sites);
 	}
 }
 
@@ -1011,27 +1073,37 @@ static bool CmpWorkers(const CUnit *lhs, const CUnit *rhs)
 }
 
 /**
-**  Assign workers to collect resources.
+**  Harvesters of AiPlayer, counted for AiCollectResources.
+*/
+struct AiHarvesters {
+	std::vector<CUnit *> Assigned[MaxCosts]; /// Workers collecting a resource when counted
+	int Wanted[MaxCosts];                    /// Workers wanted for a resource
+	int Needed[MaxCosts];                    /// Workers still needed for a resource
+	int Total;                               /// All the harvesters
+};
+
+/**
+**  Check if a unit is an idle worker which can be assigned to a resource.
+*/
+static bool IsFreeHarvester(const CUnit &unit)
+{
+	return unit.Type->BoolFlag[HARVESTER_INDEX].value && unit.IsIdle() && !unit.ResourcesHeld;
+}
+
+/**
+**  Count the harvesters of AiPlayer and the workers wanted for each
+**  resource. Idle workers with resources are sent back home.
 **
-**  If we have a shortage of a resource, let many workers collecting this.
-**  If no shortage, split workers to all resources.
+**  @param harvesters  Filled with the harvesters.
 */
-static void AiCollectResources()
+static void AiCountHarvesters(AiHarvesters &harvesters)
 {
-	std::vector<CUnit *> units_assigned[MaxCosts]; // Worker assigned to resource
-	std::vector<CUnit *> units_unassigned[MaxCosts]; // Unassigned workers
 	int num_units_with_resource[MaxCosts];
-	int num_units_assigned[MaxCosts];
-	int num_units_unassigned[MaxCosts];
 	int percent[MaxCosts];
-	int priority_resource[MaxCosts];
-	int priority_needed[MaxCosts];
-	int wanted[MaxCosts];
-	int total_harvester = 0;
 
 	memset(num_units_with_resource, 0, sizeof(num_units_with_resource));
-	memset(num_units_unassigned, 0, sizeof(num_units_unassigned));
-	memset(num_units_assigned, 0, sizeof(num_units_assigned));
+	memset(harvesters.Wanted, 0, sizeof(harvesters.Wanted));
+	harvesters.Total = 0;
 
 	// Collect statistics about the current assignment
 	const int n = AiPlayer->Player->GetUnitCount();
@@ -1046,9 +1118,8 @@ static void AiCollectResources()
 			unit.CurrentAction() == UnitActionResource) {
 			const COrder_Resource &order = *static_cast<COrder_Resource *>(unit.CurrentOrder());
 			const int c = order.GetCurrentResource();
-			units_assigned[c].push_back(&unit);
-			num_units_assigned[c]++;
-			total_harvester++;
+			harvesters.Assigned[c].push_back(&unit);
+			harvesters.Total++;
 			continue;
 		}
 
@@ -1063,26 +1134,14 @@ static void AiCollectResources()
 
 			num_units_with_resource[c]++;
 			CommandReturnGoods(unit, 0, FlushCommands);
-			total_harvester++;
-			continue;
-		}
-
-		// Look what the unit can do
-		for (int c = 1; c < MaxCosts; ++c) {
-			if (unit.Type->ResInfo[c]) {
-				units_unassigned[c].push_back(&unit);
-				num_units_unassigned[c]++;
-			}
 		}
-		++total_harvester;
+		harvesters.Total++;
 	}
 
-	if (!total_harvester) {
+	if (!harvesters.Total) {
 		return;
 	}
 
-	memset(wanted, 0, sizeof(wanted));
-
 	int percent_total = 100;
 	for (int c = 1; c < MaxCosts; ++c) {
 		percent[c] = AiPlayer->Collect[c];
@@ -1096,125 +1155,199 @@ static void AiCollectResources()
 	for (int c = 1; c < MaxCosts; ++c) {
 		if (percent[c]) {
 			// Wanted needs to be representative.
-			if (total_harvester < 5) {
-				wanted[c] = 1 + (percent[c] * 5) / percent_total;
+			if (harvesters.Total < 5) {
+				harvesters.Wanted[c] = 1 + (percent[c] * 5) / percent_total;
 			} else {
-				wanted[c] = 1 + (percent[c] * total_harvester) / percent_total;
+				harvesters.Wanted[c] = 1 + (percent[c] * harvesters.Total) / percent_total;
 			}
 		}
 	}
 
-	// Initialise priority & mapping
 	for (int c = 0; c < MaxCosts; ++c) {
-		priority_resource[c] = c;
-		priority_needed[c] = wanted[c] - num_units_assigned[c] - num_units_with_resource[c];
+		std::vector<CUnit *> &assigned = harvesters.Assigned[c];
 
-		if (c && num_units_assigned[c] > 1) {
+		harvesters.Needed[c] = harvesters.Wanted[c] - (int)assigned.size() - num_units_with_resource[c];
+		if (c && assigned.size() > 1) {
 			//first should go workers with lower ResourcesHeld value
-			std::sort(units_assigned[c].begin(), units_assigned[c].end(), CmpWorkers);
+			std::sort(assigned.begin(), assigned.end(), CmpWorkers);
 		}
 	}
-	CUnit *unit;
-	do {
-		// sort resources by priority
-		for (int i = 0; i < MaxCosts; ++i) {
-			for (int j = i + 1; j < MaxCosts; ++j) {
-				if (priority_needed[j] > priority_needed[i]) {
-					std::swap(priority_needed[i], priority_needed[j]);
-					std::swap(priority_resource[i], priority_resource[j]);
-				}
-			}
-		}
-		unit = NULL;
-
-		// Try to complete each ressource in the priority order
-		for (int i = 0; i < MaxCosts; ++i) {
-			int c = priority_resource[i];
-
-			// If there is a free worker for c, take it.
-			if (num_units_unassigned[c]) {
-				// Take the unit.
-				while (0 < num_units_unassigned[c] && !AiAssignHarvester(*units_unassigned[c][0], c)) {
-					// can't assign to c => remove from units_unassigned !
-					units_unassigned[c][0] = units_unassigned[c][--num_units_unassigned[c]];
-					units_unassigned[c].pop_back();
-				}
+}
 
-				// unit is assigned
-				if (0 < num_units_unassigned[c]) {
-					unit = units_unassigned[c][0];
-					units_unassigned[c][0] = units_unassigned[c][--num_units_unassigned[c]];
-					units_unassigned[c].pop_back();
-
-					// remove it from other ressources
-					for (int j = 0; j < MaxCosts; ++j) {
-						if (j == c || !unit->Type->ResInfo[j]) {
-							continue;
-						}
-						for (int k = 0; k < num_units_unassigned[j]; ++k) {
-							if (units_unassigned[j][k] == unit) {
-								units_unassigned[j][k] = units_unassigned[j][--num_units_unassigned[j]];
-								units_unassigned[j].pop_back();
-								break;
-							}
-						}
-					}
-				}
+/**
+**  Sort the resources by the workers they still need.
+**
+**  @param harvesters  The harvesters of AiPlayer.
+**  @param resources   Filled with the resources, the most needed first.
+*/
+static void AiSortResourcesByNeed(const AiHarvesters &harvesters, int (&resources)[MaxCosts])
+{
+	int priority_needed[MaxCosts];
+
+	for (int c = 0; c < MaxCosts; ++c) {
+		resources[c] = c;
+		priority_needed[c] = harvesters.Needed[c];
+	}
+	for (int i = 0; i < MaxCosts; ++i) {
+		for (int j = i + 1; j < MaxCosts; ++j) {
+			if (priority_needed[j] > priority_needed[i]) {
+				std::swap(priority_needed[i], priority_needed[j]);
+				std::swap(resources[i], resources[j]);
 			}
+		}
+	}
+}
 
-			// Else : Take from already assigned worker with lower priority.
-			if (!unit) {
-				// Take from lower priority only (i+1).
-				for (int j = i + 1; j < MaxCosts && !unit; ++j) {
-					// Try to move worker from src_c to c
-					const int src_c = priority_resource[j];
-
-					// Don't complete with lower priority ones...
-					if (wanted[src_c] > wanted[c]
-						|| (wanted[src_c] == wanted[c]
-							&& num_units_assigned[src_c] <= num_units_assigned[c] + 1)) {
-						continue;
-					}
+/**
+**  Assign an idle worker to the most needed resource it can collect.
+**
+**  @param unit        The idle worker.
+**  @param harvesters  The harvesters of AiPlayer, updated.
+**  @param sites       Resources already found from the depots.
+*/
+static void AiAssignFreeHarvester(CUnit &unit, AiHarvesters &harvesters, AiResourceSites &sites)
+{
+	int resources[MaxCosts];
 
-					for (int k = num_units_assigned[src_c] - 1; k >= 0 && !unit; --k) {
-						unit = units_assigned[src_c][k];
+	AiSortResourcesByNeed(harvesters, resources);
+	for (int i = 0; i < MaxCosts; ++i) {
+		const int c = resources[i];
 
-						Assert(unit->CurrentAction() == UnitActionResource);
-						COrder_Resource &order = *static_cast<COrder_Resource *>(unit->CurrentOrder());
+		if (unit.Type->ResInfo[c] && AiAssignHarvester(unit, c, sites)) {
+			harvesters.Needed[c]--;
+			return;
+		}
+	}
+	// Unassigned units there can't be assigned ( ie : they can't move to ressource )
+	// IDEA : use transporter here.
+}
 
-						if (order.IsGatheringFinished()) {
-							//worker returning with resource
-							continue;
-						}
+/**
+**  Move a worker from a resource with less priority to a resource
+**  which needs it more.
+**
+**  @param harvesters  The harvesters of AiPlayer, updated.
+**  @param sites       Resources already found from the depots.
+**  @param tries       Workers which failed to move already, skipped.
+**                     Increased by the workers which fail to move.
+**  @param budget      Units left to look at, reduced by the workers tried.
+**
+**  @return            true if a worker moved. false if none can move or
+**                     if the budget is spent first.
+*/
+static bool AiMoveHarvester(AiHarvesters &harvesters, AiResourceSites &sites, int *tries, int *budget)
+{
+	int resources[MaxCosts];
+	int skip = *tries;
+
+	AiSortResourcesByNeed(harvesters, resources);
+	// Try to complete each ressource in the priority order
+	for (int i = 0; i < MaxCosts; ++i) {
+		const int c = resources[i];
+
+		// Take from lower priority only (i+1).
+		for (int j = i + 1; j < MaxCosts; ++j) {
+			// Try to move worker from src_c to c
+			const int src_c = resources[j];
+			std::vector<CUnit *> &src = harvesters.Assigned[src_c];
+
+			// Don't complete with lower priority ones...
+			if (harvesters.Wanted[src_c] > harvesters.Wanted[c]
+				|| (harvesters.Wanted[src_c] == harvesters.Wanted[c]
+					&& src.size() <= harvesters.Assigned[c].size() + 1)) {
+				continue;
+			}
 
-						// unit can't harvest : next one
-						if (!unit->Type->ResInfo[c] || !AiAssignHarvester(*unit, c)) {
-							unit = NULL;
-							continue;
-						}
+			for (int k = (int)src.size() - 1; k >= 0; --k) {
+				CUnit &unit = *src[k];
 
-						// Remove from src_c
-						units_assigned[src_c][k] = units_assigned[src_c][--num_units_assigned[src_c]];
-						units_assigned[src_c].pop_back();
+				Assert(unit.CurrentAction() == UnitActionResource);
+				COrder_Resource &order = *static_cast<COrder_Resource *>(unit.CurrentOrder());
 
-						// j need one more
-						priority_needed[j]++;
-					}
+				if (order.IsGatheringFinished()) {
+					//worker returning with resource
+					continue;
+				}
+				// unit can't harvest : next one
+				if (!unit.Type->ResInfo[c]) {
+					continue;
+				}
+				if (skip) {
+					--skip;
+					continue;
+				}
+				if (*budget <= 0) {
+					return false;
+				}
+				--*budget;
+				if (!AiAssignHarvester(unit, c, sites)) {
+					++*tries;
+					continue;
 				}
-			}
 
-			// We just moved an unit. Adjust priority & retry
-			if (unit) {
-				// i got a new unit.
-				priority_needed[i]--;
-				// Recompute priority now
-				break;
+				// Remove from src_c
+				src[k] = src.back();
+				src.pop_back();
+				harvesters.Needed[src_c]++;
+				harvesters.Needed[c]--;
+				*tries = 0;
+				return true;
 			}
 		}
-	} while (unit);
+	}
+	return false;
+}
 
-	// Unassigned units there can't be assigned ( ie : they can't move to ressource )
-	// IDEA : use transporter here.
+/**
+**  Assign workers to collect resources.
+**
+**  If we have a shortage of a resource, let many workers collecting this.
+**  If no shortage, split workers to all resources.
+**
+**  The idle workers are assigned first, then workers are moved from the
+**  resources with less priority. The harvesters are counted again when
+**  it resumes, the cursor only tells what is left.
+**
+**  @param cursor  0 to start, the next idle worker to assign + 1, or
+**                 -1 - the workers which failed to move.
+**  @param budget  Units left to look at, reduced by the units looked at.
+**
+**  @return        true if done, false if the budget is spent.
+*/
+static bool AiCollectResources(int *cursor, int *budget)
+{
+	AiHarvesters harvesters;
+	AiResourceSites sites;
+	const int n = AiPlayer->Player->GetUnitCount();
+
+	AiCountHarvesters(harvesters);
+	if (!harvesters.Total) {
+		return true;
+	}
+	if (*cursor == 0) {
+		*cursor = 1;
+		*budget -= n;
+	}
+
+	for (; *cursor > 0 && *cursor <= n; ++*cursor) {
+		CUnit &unit = AiPlayer->Player->GetUnit(*cursor - 1);
+
+		if (!IsFreeHarvester(unit)) {
+			continue;
+		}
+		if (*budget <= 0) {
+			return false;
+		}
+		--*budget;
+		AiAssignFreeHarvester(unit, harvesters, sites);
+	}
+
+	int tries = *cursor > 0 ? 0 : -1 - *cursor;
+	while (AiMoveHarvester(harvesters, sites, &tries, budget)) {
+	}
+	*cursor = -1 - tries;
+	// Out of budget, or no worker can move.
+	return *budget > 0;
 }
 
 /*----------------------------------------------------------------------------
@@ -1327,22 +1460,36 @@ static int AiRepairUnit(CUnit &unit)
 
 /**
 **  Check if there's a unit that should be repaired.
+**
+**  @param cursor  Next unit to look at + 1, 0 to start after the
+**                 last unit repaired.
+**  @param budget  Units left to look at, reduced by the units looked at.
+**
+**  @return        true if done, false if the budget is spent.
 */
-static void AiCheckRepair()
+bool AiCheckRepair(int *cursor, int *budget)
 {
 	const int n = AiPlayer->Player->GetUnitCount();
-	int k = 0;
 
 	// Selector for next unit
-	for (int i = n - 1; i >= 0; --i) {
-		const CUnit &unit = AiPlayer->Player->GetUnit(i);
-		if (UnitNumber(unit) == AiPlayer->LastRepairBuilding) {
-			k = i + 1;
+	if (*cursor == 0) {
+		int k = 0;
+		for (int i = n - 1; i >= 0; --i) {
+			const CUnit &unit = AiPlayer->Player->GetUnit(i);
+			if (UnitNumber(unit) == AiPlayer->LastRepairBuilding) {
+				k = i + 1;
+			}
 		}
+		*cursor = k + 1;
+		*budget -= n;
 	}
 
-	for (int i = k; i < n; ++i) {
-		CUnit &unit = AiPlayer->Player->GetUnit(i);
+	for (; *cursor <= n; ++*cursor) {
+		if (*budget <= 0) {
+			return false;
+		}
+		--*budget;
+		CUnit &unit = AiPlayer->Player->GetUnit(*cursor - 1);
 		bool repair_flag = true;
 
 		if (!unit.IsAliveOnMap()) {
@@ -1379,11 +1526,12 @@ static void AiCheckRepair()
 			if (repair_flag) {
 				AiRepairUnit(unit);
 				AiPlayer->LastRepairBuilding = UnitNumber(unit);
-				return;
+				return true;
 			}
 		}
 		// Building under construction but no worker
 		if (unit.CurrentAction() == UnitActionBuilt) {
+			*budget -= n;
 			int j;
 			for (j = 0; j < AiPlayer->Player->GetUnitCount(); ++j) {
 				COrder *order = AiPlayer->Player->GetUnit(j).CurrentOrder();
@@ -1406,12 +1554,13 @@ static void AiCheckRepair()
 				if (j == MaxCosts) {
 					AiRepairUnit(unit);
 					AiPlayer->LastRepairBuilding = UnitNumber(unit);
-					return;
+					return true;
 				}
 			}
 		}
 	}
 	AiPlayer->LastRepairBuilding = 0;
+	return true;
 }
 
 /**
@@ -1462,17 +1611,30 @@ void AiResourceManager()
 	if (!AiPlayer->NeedSupply && AiPlayer->Player->Supply == AiPlayer->Player->Demand) {
 		AiRequestSupply();
 	}
+}
 
-	// Collect resources.
-	if ((GameCycle / CYCLES_PER_SECOND) % COLLECT_RESOURCES_INTERVAL ==
+/**
+**  Assign the workers of the resource manager, periodic called after
+**  AiResourceManager.
+**
+**  @param cursor  Where to resume AiCollectResources, 0 to start.
+**  @param budget  Units left to look at, reduced by the units looked at.
+**
+**  @return        true if done, false if the budget is spent.
+*/
+bool AiResourceManagerWorkers(int *cursor, int *budget)
+{
+	// Collect resources, and go on when they were started.
+	if (*cursor != 0
+		|| (GameCycle / CYCLES_PER_SECOND) % COLLECT_RESOURCES_INTERVAL ==
 		(unsigned long)AiPlayer->Player->Index % COLLECT_RESOURCES_INTERVAL) {
-		AiCollectResources();
+		if (!AiCollectResources(cursor, budget)) {
+			return false;
+		}
 	}
 
-	// Check repair.
-	AiCheckRepair();
-
 	AiPlayer->NeededMask = 0;
+	return true;
 }
 
 //@}
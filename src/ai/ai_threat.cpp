@@ -0,0 +1,281 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name ai_threat.cpp - AI threat maps. */
+//
+//      (c) Copyright 2026 by the Stratagus Team
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+//@{
+
+/*----------------------------------------------------------------------------
+--  Includes
+----------------------------------------------------------------------------*/
+
+#include "stratagus.h"
+
+#include "ai_local.h"
+
+#include "actions.h"
+#include "map.h"
+#include "player.h"
+#include "spells.h"
+#include "unit.h"
+#include "unit_manager.h"
+#include "unittype.h"
+
+/*----------------------------------------------------------------------------
+--  Functions
+----------------------------------------------------------------------------*/
+
+/**
+**  Check if the targets of a unit-type depend on the flags of the target.
+**
+**  Such unit-types can't use the threat map, see CanTarget.
+*/
+static bool HasTargetConditions(const CUnitType &type)
+{
+	for (unsigned int i = 0; i < UnitTypeVar.GetNumberBoolFlag(); ++i) {
+		if (type.BoolFlag[i].CanTargetFlag != CONDITION_TRUE) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+**  Kind of a unit as a target, see CanTarget.
+*/
+static int TargetKind(const CUnitType &type)
+{
+	switch (type.UnitType) {
+		case UnitTypeLand:
+			return type.BoolFlag[SHOREBUILDING_INDEX].value ? AiThreatMap::ThreatLandOrSea : AiThreatMap::ThreatLand;
+		case UnitTypeFly:
+			return AiThreatMap::ThreatAir;
+		case UnitTypeNaval:
+			return AiThreatMap::ThreatSea;
+		default:
+			return -1;
+	}
+}
+
+/**
+**  Check if a unit with the CanTarget bits can attack a target kind.
+*/
+static bool CanTargetKind(int canTarget, int kind)
+{
+	switch (kind) {
+		case AiThreatMap::ThreatLand:
+			return (canTarget & CanTargetLand) != 0;
+		case AiThreatMap::ThreatSea:
+			return (canTarget & CanTargetSea) != 0;
+		case AiThreatMap::ThreatLandOrSea:
+			return (canTarget & (CanTargetLand | CanTargetSea)) != 0;
+		case AiThreatMap::ThreatAir:
+			return (canTarget & CanTargetAir) != 0;
+		default:
+			return false;
+	}
+}
+
+/**
+**  Count the enemies of a player again.
+**
+**  Seen counts the units visible as goal for the player and hostile
+**  to it on each tile they cover, once for all and once for each kind
+**  of targets they can attack, like IsAEnemyUnitOf. Targets counts the
+**  units of the enemies of the player on the map which AiFindTarget
+**  would attack, by their kind.
+**
+**  @param player  Player whose enemies are counted.
+*/
+void AiThreatMap::Update(const CPlayer &player)
+{
+	Clear(Map.Info.MapWidth, Map.Info.MapHeight);
+
+	for (CUnitManager::Iterator it = UnitManager.begin(); it != UnitManager.end(); ++it) {
+		const CUnit &unit = **it;
+
+		if (unit.Removed) {
+			continue;
+		}
+		const CUnitType &type = *unit.Type;
+
+		if (player.IsEnemy(unit) && !unit.Variable[INVISIBLE_INDEX].Value
+			&& unit.CurrentAction() != UnitActionDie
+			&& (type.UnitType != UnitTypeFly || unit.IsAgressive())) {
+			const int kind = TargetKind(type);
+			if (kind != -1) {
+				++Targets[kind];
+			}
+		}
+		if (!unit.IsEnemy(player) || !unit.IsVisibleAsGoal(player)) {
+			continue;
+		}
+		if (HasTargetConditions(type)) {
+			TargetConditions = true;
+		}
+		Add(unit.tilePos, type.TileWidth, type.TileHeight, type.CanTarget);
+	}
+	Sum();
+}
+
+/**
+**  Start counting the enemies again on a map.
+**
+**  @param width   Map width.
+**  @param height  Map height.
+*/
+void AiThreatMap::Clear(int width, int height)
+{
+	Width = width;
+	Height = height;
+	const size_t size = (Width + 1) * (Height + 1);
+	for (int i = 0; i < ThreatMax; ++i) {
+		Seen[i].assign(size, 0);
+	}
+	memset(Targets, 0, sizeof(Targets));
+	TargetConditions = false;
+	Cycle = 0;
+}
+
+/**
+**  Count an enemy seen on each tile it covers.
+**
+**  @param pos        Top left tile of the enemy.
+**  @param width      Width of the enemy in tiles.
+**  @param height     Height of the enemy in tiles.
+**  @param canTarget  CanTarget bits of the enemy.
+*/
+void AiThreatMap::Add(const Vec2i &pos, int width, int height, int canTarget)
+{
+	bool kinds[ThreatMax];
+	kinds[ThreatAll] = true;
+	for (int kind = ThreatAll + 1; kind < ThreatMax; ++kind) {
+		kinds[kind] = CanTargetKind(canTarget, kind);
+	}
+	// count in the cell after the tile, the sums are made by Sum
+	const int x1 = std::min(pos.x + width, Width);
+	const int y1 = std::min(pos.y + height, Height);
+	for (int y = pos.y; y < y1; ++y) {
+		for (int x = pos.x; x < x1; ++x) {
+			const int index = (y + 1) * (Width + 1) + x + 1;
+			for (int kind = 0; kind < ThreatMax; ++kind) {
+				Seen[kind][index] += kinds[kind];
+			}
+		}
+	}
+}
+
+/**
+**  Sum the enemies counted, the map can be used until the next second.
+*/
+void AiThreatMap::Sum()
+{
+	for (int kind = 0; kind < ThreatMax; ++kind) {
+		std::vector<int> &table = Seen[kind];
+		for (int y = 1; y <= Height; ++y) {
+			for (int x = 1; x <= Width; ++x) {
+				const int index = y * (Width + 1) + x;
+				table[index] += table[index - 1] + table[index - Width - 1] - table[index - Width - 2];
+			}
+		}
+	}
+	Cycle = GameCycle + 1;
+}
+
+/**
+**  Check if the map is recent enough to be used instead of a search.
+**
+**  @param type  Unit-type the enemies must be able to attack, or NULL.
+*/
+bool AiThreatMap::IsValid(const CUnitType *type) const
+{
+	return Cycle && GameCycle < Cycle + CYCLES_PER_SECOND
+		   && Width == Map.Info.MapWidth && Height == Map.Info.MapHeight
+		   && (type == NULL || !TargetConditions);
+}
+
+/**
+**  Count the enemies in a rectangle.
+**
+**  Enemies are counted on each tile they cover in the rectangle, the
+**  result is 0 only if no enemy is in it.
+**
+**  @param pos0  Top left tile.
+**  @param pos1  Bottom right tile.
+**  @param type  Unit-type the enemies must be able to attack, or NULL.
+**
+**  @return      The number of tiles covered by enemies.
+*/
+int AiThreatMap::Count(const Vec2i &pos0, const Vec2i &pos1, const CUnitType *type) const
+{
+	Assert(IsValid(type));
+
+	int kind = ThreatAll;
+	if (type != NULL) {
+		kind = TargetKind(*type);
+		if (kind == -1) {
+			return 0;
+		}
+	}
+	Vec2i minPos = pos0;
+	Vec2i maxPos = pos1;
+
+	Map.FixSelectionArea(minPos, maxPos);
+	if (minPos.x > maxPos.x || minPos.y > maxPos.y) {
+		return 0;
+	}
+	const std::vector<int> &table = Seen[kind];
+	const int x0 = minPos.x;
+	const int y0 = minPos.y;
+	const int x1 = maxPos.x + 1;
+	const int y1 = maxPos.y + 1;
+	const int w = Width + 1;
+
+	return table[y1 * w + x1] - table[y0 * w + x1] - table[y1 * w + x0] + table[y0 * w + x0];
+}
+
+/**
+**  Check if there is no enemy on the map a unit-type could attack.
+**
+**  @param type  Unit-type of the attacker.
+**
+**  @return      true if AiFindTarget can't find a target for it.
+*/
+bool AiThreatMap::HasNoTargetFor(const CUnitType &type) const
+{
+	if (!IsValid(NULL) || HasTargetConditions(type)) {
+		return false;
+	}
+	for (int kind = ThreatAll + 1; kind < ThreatMax; ++kind) {
+		if (Targets[kind] && CanTargetKind(type.CanTarget, kind)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//@}
@@ -1406,6 +1406,10 @@ static int CclDefineAiPlayer(lua_State *l)
 			}
 		} else if (!strcmp(value, "building")) {
 			CclParseBuildQueue(l, ai, j + 1);
+		} else if (!strcmp(value, "task")) {
+			ai->Task = LuaToNumber(l, j + 1);
+		} else if (!strcmp(value, "task-cursor")) {
+			ai->TaskCursor = LuaToNumber(l, j + 1);
 		} else if (!strcmp(value, "repair-building")) {
 			ai->LastRepairBuilding = LuaToNumber(l, j + 1);
 		} else {
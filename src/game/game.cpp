@@ -59,12 +59,14 @@
 #include "parameters.h"
 #include "pathfinder.h"
 #include "player.h"
+#include "profile.h"
 #include "replay.h"
 #include "results.h"
 #include "settings.h"
 #include "sound.h"
 #include "sound_server.h"
 #include "spells.h"
+#include "synchash.h"
 #include "tileset.h"
 #include "translate.h"
 #include "trigger.h"
@@ -298,6 +300,7 @@ static void WriteMapPreview(const char *mapname, CMap &map)
 	png_write_info(png_ptr, info_ptr);
 
 	const int rectSize = 5; // size of rectange used for player start spots
+	UI.Minimap.Sync();
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
 		unsigned char *pixels = new unsigned char[UI.Minimap.W * UI.Minimap.H * 3];
@@ -922,6 +925,7 @@ void CreateGame(const std::string &filename, CMap *map)
 	FastForwardCycle = 0;
 	SyncHash = 0;
 	InitSyncRand();
+	InitSyncHashes();
 
 	if (IsNetworkGame()) { // Prepare network play
 		NetworkOnStartGame();
@@ -1129,6 +1133,8 @@ static void CleanGame_Lua()
 void CleanGame()
 {
 	EndReplayLog();
+	CleanSyncHashes();
+	NetworkOnEndGame();
 	CleanMessages();
 
 	RestoreColorCyclingSurface();
@@ -1586,6 +1592,7 @@ void LuaRegisterModules()
 	NetworkCclRegister();
 	PathfinderCclRegister();
 	PlayerCclRegister();
+	ProfileCclRegister();
 	ReplayCclRegister();
 	ScriptRegister();
 	SelectionCclRegister();
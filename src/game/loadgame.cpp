@@ -152,6 +152,9 @@ void InitModules()
 */
 void LoadModules()
 {
+#ifndef DYNAMIC_LOAD
+	PreloadGraphics();
+#endif
 	LoadFonts();
 	LoadIcons();
 	LoadCursors(PlayerRaces.Name[ThisPlayer->Race]);
@@ -162,6 +165,7 @@ void LoadModules()
 	LoadConstructions();
 	LoadDecorations();
 	LoadUnitTypes();
+	FinishPreloadGraphics();
 
 	InitPathfinder();
 
@@ -0,0 +1,364 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name synchash.cpp - Detailed sync hashes to find desyncs. */
+//
+//      (c) Copyright 2026 by the Stratagus Team
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+//@{
+
+//----------------------------------------------------------------------------
+// Documentation
+//----------------------------------------------------------------------------
+
+/**
+** @page SyncHashModule Module - Detailed sync hashes
+**
+** The global ::SyncHash only tells that two computers are out of sync.
+** With ::EnableSyncDebug (command line option -y), a rolling hash is kept
+** for each subsystem (units, missiles, resources, random seed and map
+** fields). The hashes are sent with each network update and compared like
+** the sync message. The first time a subsystem differs, the history of
+** the last hashes and the state of this subsystem are written into
+** sync_of_stratagus_<player>.log. Comparing the logs of two players gives
+** the first cycle and the objects which differ.
+**
+** Nothing is computed when ::EnableSyncDebug is false.
+*/
+
+//----------------------------------------------------------------------------
+// Includes
+//----------------------------------------------------------------------------
+
+#include "stratagus.h"
+
+#include "synchash.h"
+
+#include "actions.h"
+#include "map.h"
+#include "missile.h"
+#include "player.h"
+#include "unit.h"
+#include "unit_manager.h"
+#include "unittype.h"
+#include "version.h"
+
+#include <time.h>
+
+//----------------------------------------------------------------------------
+// Variables
+//----------------------------------------------------------------------------
+
+bool EnableSyncDebug;       /// Compute and exchange the detailed sync hashes
+CSyncHashes SyncHashes;     /// Detailed sync hashes of the current game state
+
+static const int SyncHashHistorySize = 256; /// Number of cycles kept in history
+
+static CSyncHashes SyncHashHistory[SyncHashHistorySize]; /// Last sync hashes
+static unsigned long SyncHashHistoryCycle[SyncHashHistorySize]; /// Cycle of each history entry
+static unsigned int SyncHashMismatchMask;   /// Subsystems already reported
+static FILE *SyncHashLog;                   /// Log file, opened on first use
+
+static const char *const SyncHashNames[SyncHashTypeCount] = {
+	"units", "missiles", "resources", "random", "map"
+};
+
+//----------------------------------------------------------------------------
+// Functions
+//----------------------------------------------------------------------------
+
+/// Fold a value into a hash (FNV-1a on 32 bits)
+static inline void SyncHashFold(uint32_t &hash, uint32_t value)
+{
+	hash = (hash ^ value) * 16777619u;
+}
+
+static uint32_t HashUnits()
+{
+	uint32_t hash = 2166136261u;
+
+	for (CUnitManager::Iterator it = UnitManager.begin(); it != UnitManager.end(); ++it) {
+		const CUnit &unit = **it;
+
+		SyncHashFold(hash, UnitNumber(unit));
+		SyncHashFold(hash, unit.Type->Slot);
+		SyncHashFold(hash, unit.Player->Index);
+		SyncHashFold(hash, unit.tilePos.x | (unit.tilePos.y << 16));
+		SyncHashFold(hash, uint8_t(unit.IX) | (uint8_t(unit.IY) << 8) | (unit.Direction << 16));
+		SyncHashFold(hash, unit.Variable[HP_INDEX].Value);
+		SyncHashFold(hash, unit.Orders.empty() ? -1 : unit.CurrentAction());
+		SyncHashFold(hash, unit.Refs);
+		SyncHashFold(hash, unit.ResourcesHeld);
+		SyncHashFold(hash, unit.Removed | (unit.Destroyed << 1));
+	}
+	return hash;
+}
+
+static uint32_t HashMissiles()
+{
+	const std::vector<Missile *> &missiles = GetGlobalMissiles();
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i != missiles.size(); ++i) {
+		const Missile &missile = *missiles[i];
+
+		SyncHashFold(hash, missile.Type->Class);
+		SyncHashFold(hash, missile.position.x | (missile.position.y << 16));
+		SyncHashFold(hash, missile.destination.x | (missile.destination.y << 16));
+		SyncHashFold(hash, missile.TTL);
+		SyncHashFold(hash, missile.Damage);
+	}
+	return hash;
+}
+
+static uint32_t HashResources()
+{
+	uint32_t hash = 2166136261u;
+
+	for (int p = 0; p != NumPlayers; ++p) {
+		const CPlayer &player = Players[p];
+
+		for (int i = 0; i != MaxCosts; ++i) {
+			SyncHashFold(hash, player.Resources[i]);
+			SyncHashFold(hash, player.StoredResources[i]);
+		}
+	}
+	return hash;
+}
+
+static uint32_t HashMapRow(int y)
+{
+	uint32_t hash = 2166136261u;
+	const CMapField *mf = Map.Field(0, y);
+
+	for (int x = 0; x != Map.Info.MapWidth; ++x, ++mf) {
+		SyncHashFold(hash, mf->getGraphicTile() | (mf->Flags << 16));
+		SyncHashFold(hash, mf->Value);
+	}
+	return hash;
+}
+
+static uint32_t HashMap()
+{
+	uint32_t hash = 2166136261u;
+
+	for (int y = 0; y != Map.Info.MapHeight; ++y) {
+		SyncHashFold(hash, HashMapRow(y));
+	}
+	return hash;
+}
+
+/**
+**  Reset the detailed sync hashes for a new game.
+*/
+void InitSyncHashes()
+{
+	SyncHashes.Clear();
+	for (int i = 0; i != SyncHashHistorySize; ++i) {
+		SyncHashHistory[i].Clear();
+		SyncHashHistoryCycle[i] = 0;
+	}
+	SyncHashMismatchMask = 0;
+}
+
+/**
+**  Fold the state of each subsystem into its hash.
+**
+**  Called at the end of each game cycle.
+*/
+void SyncHashesEachCycle()
+{
+	if (!EnableSyncDebug) {
+		return;
+	}
+	const uint32_t state[SyncHashTypeCount] = {
+		HashUnits(), HashMissiles(), HashResources(), SyncRandSeed, HashMap()
+	};
+	for (int i = 0; i != SyncHashTypeCount; ++i) {
+		SyncHashes.Hash[i] = ((SyncHashes.Hash[i] << 5) | (SyncHashes.Hash[i] >> 27)) ^ state[i];
+	}
+	SyncHashHistory[GameCycle % SyncHashHistorySize] = SyncHashes;
+	SyncHashHistoryCycle[GameCycle % SyncHashHistorySize] = GameCycle;
+}
+
+static FILE *OpenSyncHashLog()
+{
+	if (SyncHashLog) {
+		return SyncHashLog;
+	}
+	char buf[256];
+	snprintf(buf, sizeof(buf), "sync_of_stratagus_%d.log", ThisPlayer ? ThisPlayer->Index : 0);
+	SyncHashLog = fopen(buf, "wb");
+	if (!SyncHashLog) {
+		return NULL;
+	}
+	time_t now;
+	time(&now);
+	fprintf(SyncHashLog, "; Log file generated by Stratagus Version " VERSION "\n");
+	fprintf(SyncHashLog, ";\tDate: %s", ctime(&now));
+	fprintf(SyncHashLog, ";\tMap: %s\n\n", Map.Info.Description.c_str());
+	return SyncHashLog;
+}
+
+static void WriteSyncHashHistory(FILE *logf)
+{
+	fprintf(logf, "; cycle:");
+	for (int i = 0; i != SyncHashTypeCount; ++i) {
+		fprintf(logf, " %s", SyncHashNames[i]);
+	}
+	fprintf(logf, "\n");
+	for (int n = 1; n <= SyncHashHistorySize; ++n) {
+		const int index = (GameCycle + n) % SyncHashHistorySize;
+		if (SyncHashHistoryCycle[index] == 0 || SyncHashHistoryCycle[index] > GameCycle) {
+			continue;
+		}
+		fprintf(logf, "%lu:", SyncHashHistoryCycle[index]);
+		for (int i = 0; i != SyncHashTypeCount; ++i) {
+			fprintf(logf, " %08X", SyncHashHistory[index].Hash[i]);
+		}
+		fprintf(logf, "\n");
+	}
+}
+
+/**
+**  Write the current state of a subsystem, one line per object,
+**  so that the dumps of two players can be compared with diff.
+*/
+static void DumpSyncState(FILE *logf, int type)
+{
+	fprintf(logf, "; %s state at cycle %lu\n", SyncHashNames[type], GameCycle);
+	switch (type) {
+		case SyncHashUnits:
+			for (CUnitManager::Iterator it = UnitManager.begin(); it != UnitManager.end(); ++it) {
+				const CUnit &unit = **it;
+				fprintf(logf, "%d %s P%d %d,%d %d,%d D%d HP%d A%d R%d Refs%d %s%s\n",
+						UnitNumber(unit), unit.Type->Ident.c_str(), unit.Player->Index,
+						unit.tilePos.x, unit.tilePos.y, unit.IX, unit.IY, unit.Direction,
+						unit.Variable[HP_INDEX].Value,
+						unit.Orders.empty() ? -1 : unit.CurrentAction(),
+						unit.ResourcesHeld, unit.Refs,
+						unit.Removed ? "removed " : "", unit.Destroyed ? "destroyed" : "");
+			}
+			break;
+		case SyncHashMissiles: {
+			const std::vector<Missile *> &missiles = GetGlobalMissiles();
+			for (size_t i = 0; i != missiles.size(); ++i) {
+				const Missile &missile = *missiles[i];
+				fprintf(logf, "%s %d,%d -> %d,%d TTL%d Damage%d\n", missile.Type->Ident.c_str(),
+						missile.position.x, missile.position.y,
+						missile.destination.x, missile.destination.y, missile.TTL, missile.Damage);
+			}
+			break;
+		}
+		case SyncHashResources:
+			for (int p = 0; p != NumPlayers; ++p) {
+				fprintf(logf, "P%d:", p);
+				for (int i = 0; i != MaxCosts; ++i) {
+					fprintf(logf, " %d/%d", Players[p].Resources[i], Players[p].StoredResources[i]);
+				}
+				fprintf(logf, "\n");
+			}
+			break;
+		case SyncHashRandom:
+			fprintf(logf, "%X\n", SyncRandSeed);
+			break;
+		case SyncHashMap:
+			// A hash per row, the differing rows can then be inspected in the savegames.
+			for (int y = 0; y != Map.Info.MapHeight; ++y) {
+				fprintf(logf, "row %d: %08X\n", y, HashMapRow(y));
+			}
+			break;
+		default:
+			break;
+	}
+	fprintf(logf, "\n");
+}
+
+/**
+**  Report the subsystems which differ from another player.
+**
+**  Only the first mismatch of each subsystem is dumped, since the rolling
+**  hashes stay different afterwards.
+**
+**  @param cycle   Network cycle of the compared hashes.
+**  @param player  Player who sent the remote hashes.
+**  @param local   Local hashes for this cycle.
+**  @param remote  Hashes received from player.
+*/
+void SyncHashesMismatch(unsigned long cycle, int player, const CSyncHashes &local, const CSyncHashes &remote)
+{
+	unsigned int mask = 0;
+	for (int i = 0; i != SyncHashTypeCount; ++i) {
+		if (local.Hash[i] != remote.Hash[i]) {
+			mask |= 1 << i;
+		}
+	}
+	if ((mask & ~SyncHashMismatchMask) == 0) {
+		return;
+	}
+	FILE *logf = OpenSyncHashLog();
+	if (!logf) {
+		return;
+	}
+	fprintf(logf, "; Out of sync with player %d at cycle %lu (now %lu):", player, cycle, GameCycle);
+	for (int i = 0; i != SyncHashTypeCount; ++i) {
+		if (mask & (1 << i)) {
+			fprintf(logf, " %s %08X!=%08X", SyncHashNames[i], local.Hash[i], remote.Hash[i]);
+		}
+	}
+	fprintf(logf, "\n");
+	WriteSyncHashHistory(logf);
+	fprintf(logf, "\n");
+	for (int i = 0; i != SyncHashTypeCount; ++i) {
+		if ((mask & ~SyncHashMismatchMask) & (1 << i)) {
+			DumpSyncState(logf, i);
+		}
+	}
+	fflush(logf);
+	SyncHashMismatchMask |= mask;
+	DebugPrint("Sync hashes differ with player %d, see sync_of_stratagus_%d.log\n" _C_
+			   player _C_ ThisPlayer->Index);
+}
+
+/**
+**  Write the hash history and close the log.
+*/
+void CleanSyncHashes()
+{
+	if (EnableSyncDebug && GameCycle != 0) {
+		FILE *logf = OpenSyncHashLog();
+		if (logf) {
+			fprintf(logf, "; Last cycles\n");
+			WriteSyncHashHistory(logf);
+		}
+	}
+	if (SyncHashLog) {
+		fclose(SyncHashLog);
+		SyncHashLog = NULL;
+	}
+	InitSyncHashes();
+}
+
+//@}
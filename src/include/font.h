@@ -59,6 +59,7 @@
 --  Includes
 ----------------------------------------------------------------------------*/
 
+#include <map>
 #include <string>
 #include "color.h"
 #include "guichan/font.h"
@@ -68,6 +69,7 @@
 ----------------------------------------------------------------------------*/
 class CGraphic;
 class CFontColor;
+struct CGlyphRun;
 
 /// Font definition
 class CFont : public gcn::Font
@@ -106,6 +108,10 @@ public:
 	template<bool CLIP>
 	unsigned int DrawChar(CGraphic &g, int utf8, int x, int y, const CFontColor &fc) const;
 
+	/// Get the glyphs of a text prepared for drawing
+	const CGlyphRun &GetGlyphRun(const char *text, size_t len,
+								 const CFontColor *fc, const CFontColor *reverse) const;
+
 	void DynamicLoad() const;
 
 private:
@@ -113,11 +119,16 @@ private:
 	void MakeFontColorTextures() const;
 #endif
 	void MeasureWidths();
+	int GlyphSource(int utf8, int *gx, int *gy) const;
+	void PrepareGlyphRun(CGlyphRun &run, const char *text, size_t len,
+						 const CFontColor *fc, const CFontColor *reverse) const;
+	void ComposeGlyphRun(CGlyphRun &run) const;
 
 private:
 	std::string Ident;    /// Ident of the font.
 	char *CharWidth;      /// Real font width (starting with ' ')
 	CGraphic *G;          /// Graphic object used to draw
+	mutable std::map<std::string, int> WidthCache; /// Width of recently measured texts
 };
 
 #define MaxFontColors 9
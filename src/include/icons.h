@@ -155,6 +155,9 @@ public:
 extern void LoadIcons();   /// Load icons
 extern void CleanIcons();  /// Cleanup icons
 
+/// Get the screen area DrawUnitIcon draws in
+extern void GetUnitIconArea(const ButtonStyle &style, const PixelPos &pos, PixelPos &areaPos, PixelSize &areaSize);
+
 //@}
 
 #endif // !__ICONS_H__
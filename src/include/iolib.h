@@ -124,7 +124,8 @@ enum {
 	CLF_TYPE_INVALID,  /// invalid file handle
 	CLF_TYPE_PLAIN,    /// plain text file handle
 	CLF_TYPE_GZIP,     /// gzip file handle
-	CLF_TYPE_BZIP2     /// bzip2 file handle
+	CLF_TYPE_BZIP2,    /// bzip2 file handle
+	CLF_TYPE_PACK      /// file of the asset pack
 };
 
 #define CL_OPEN_READ 0x1
@@ -136,6 +137,11 @@ enum {
 --  Functions
 ----------------------------------------------------------------------------*/
 
+/// Open the asset pack of a directory
+extern bool OpenAssetPack(const std::string &filename);
+/// Close the asset pack
+extern void CloseAssetPack();
+
 /// Build library path name
 extern std::string LibraryFileName(const char *file);
 
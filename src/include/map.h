@@ -379,6 +379,12 @@ extern bool UnitCanBeAt(const CUnit &unit, const Vec2i &pos);
 /// Preprocess map, for internal use.
 extern void PreprocessMap();
 
+//
+// in map_draw.cpp
+//
+/// Redraw the cached map backgrounds, the tileset or the screen changed
+extern void InvalidateMapBackgrounds();
+
 // in unit.c
 
 /// Mark on vision table the Sight of the unit.
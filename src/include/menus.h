@@ -48,6 +48,9 @@ class ButtonStyle;
 /// Draw menu button
 extern void DrawUIButton(ButtonStyle *style, unsigned flags,
 						 int x, int y, const std::string &text, int player = -1);
+/// Invalidate the area of a menu button when its drawing changed
+extern void InvalidateUIButton(const void *object, const ButtonStyle &style, unsigned flags,
+							   int x, int y, const std::string &text);
 
 /// Pre menu setup
 extern void PreMenuSetup();
@@ -60,8 +60,9 @@ public:
 		Transparent(false), UpdateCache(false) {}
 
 	void UpdateXY(const Vec2i &pos);
-	void UpdateSeenXY(const Vec2i &) {}
+	void UpdateSeenXY(const Vec2i &pos);
 	void Update();
+	void Sync();
 	void Create();
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	void FreeOpenGL();
@@ -606,6 +606,8 @@ extern int CalculateDamage(const CUnit &attacker, const CUnit &goal, const Numbe
 extern void FireMissile(CUnit &unit, CUnit *goal, const Vec2i &goalPos);
 
 extern void FindAndSortMissiles(const CViewport &vp, std::vector<Missile *> &table);
+/// Global missiles (same on all computers)
+extern const std::vector<Missile *> &GetGlobalMissiles();
 
 /// handle all missiles
 extern void MissileActions();
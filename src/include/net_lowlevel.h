@@ -136,7 +136,7 @@ extern int NetSendTCP(Socket sockfd, const void *buf, int len);
 /// Receive from a TCP socket.
 extern int NetRecvTCP(Socket sockfd, void *buf, int len);
 /// Listen for connections on a TCP socket
-extern int NetListenTCP(Socket sockfd);
+extern int NetListenTCP(Socket sockfd, int backlog = PlayerMax);
 /// Accept a connection on a TCP socket
 extern Socket NetAcceptTCP(Socket sockfd, unsigned long *clientHost, int *clientPort);
 
@@ -34,6 +34,8 @@
 #include <stdint.h>
 #include <vector>
 
+#include "synchash.h"
+
 /*----------------------------------------------------------------------------
 --  Declarations
 ----------------------------------------------------------------------------*/
@@ -46,6 +48,10 @@
 
 #define MaxNetworkCommands 9  /// Max Commands In A Packet
 
+#define MaxNetworkPacketSize 1024  /// Max size of an ingame packet
+
+#define MaxNetworkGroupUnits 64  /// Max units of a group command
+
 /**
 **  Network systems active in current game.
 */
@@ -285,6 +291,8 @@ enum _message_type_ {
 	MessageResend,                 /// Resend message
 
 	MessageChat,                   /// Chat message
+	MessageNetworkLag,             /// Change of the network lag (from server)
+	MessageSyncHashes,             /// Detailed sync hashes (sync debugging)
 
 	MessageCommandStop,            /// Unit command stop
 	MessageCommandStand,           /// Unit command stand ground
@@ -311,6 +319,7 @@ enum _message_type_ {
 	MessageCommandCancelResearch,  /// Unit command cancel research
 
 	MessageExtendedCommand,        /// Command is the next byte
+	MessageCommandGroup,           /// Same unit command for several units
 
 	// ATTN: __MUST__ be last due to spellid encoding!!!
 	MessageCommandSpellCast        /// Unit command spell cast
@@ -363,6 +372,30 @@ public:
 	uint16_t Arg4;          /// Argument 4
 };
 
+/**
+**  Network group command message.
+**
+**  The same unit command given to several units.
+**  Fields are sent as varints and the unit numbers are delta encoded,
+**  so big selections only need about one byte per unit.
+*/
+class CNetworkGroupCommand
+{
+public:
+	CNetworkGroupCommand() : Type(0), X(0), Y(0), Dest(0) {}
+
+	size_t Serialize(unsigned char *buf) const;
+	size_t Deserialize(const unsigned char *buf, size_t len);
+	size_t Size() const;
+
+public:
+	uint8_t Type;                 /// Command type (with flush flag) for each unit
+	uint16_t X;                   /// Map position X
+	uint16_t Y;                   /// Map position Y
+	uint16_t Dest;                /// Destination unit
+	std::vector<uint16_t> Units;  /// Units which receive the command
+};
+
 /**
 **  Network chat message.
 */
@@ -383,14 +416,50 @@ public:
 class CNetworkCommandSync
 {
 public:
-	CNetworkCommandSync() : syncSeed(0), syncHash(0) {}
+	CNetworkCommandSync() : syncSeed(0), syncHash(0), pingTime(0), pongTime(0), pongPlayer(255) {}
 	size_t Serialize(unsigned char *buf) const;
 	size_t Deserialize(const unsigned char *buf);
-	static size_t Size() { return 4 + 4; };
+	static size_t Size() { return 4 + 4 + 2 + 2 + 1; };
 
 public:
 	uint32_t syncSeed;
 	uint32_t syncHash;
+	uint16_t pingTime;   /// Sender clock in ms when sent
+	uint16_t pongTime;   /// Echoed pingTime of pongPlayer, plus the time it was held
+	uint8_t pongPlayer;  /// Player whose ping is echoed (255 for none)
+};
+
+/**
+**  Network lag change message.
+*/
+class CNetworkCommandLag
+{
+public:
+	CNetworkCommandLag() : networkLag(0) {}
+	size_t Serialize(unsigned char *buf) const;
+	size_t Deserialize(const unsigned char *buf);
+	static size_t Size() { return 2; };
+
+public:
+	uint16_t networkLag;  /// New network lag (# game cycles)
+};
+
+/**
+**  Network detailed sync hashes message.
+**
+**  Only sent when the sync debugging is enabled.
+*/
+class CNetworkCommandSyncHashes
+{
+public:
+	CNetworkCommandSyncHashes() : player(0) {}
+	size_t Serialize(unsigned char *buf) const;
+	size_t Deserialize(const unsigned char *buf);
+	static size_t Size() { return 1 + 4 * SyncHashTypeCount; };
+
+public:
+	uint8_t player;        /// Player who sent the hashes
+	CSyncHashes hashes;    /// Hash of each subsystem
 };
 
 /**
@@ -460,6 +529,7 @@ public:
 	size_t Serialize(unsigned char *buf, int numcommands) const;
 	void Deserialize(const unsigned char *buf, unsigned int len, int *numcommands);
 	size_t Size(int numcommands) const;
+	static size_t CommandSize(const std::vector<unsigned char> &command);
 
 	CNetworkPacketHeader Header;  /// Packet Header Info
 	std::vector<unsigned char> Command[MaxNetworkCommands];
@@ -45,15 +45,17 @@ class CHost;
 #define NetworkProtocolMinorVersion StratagusMinorVersion
 /// Network protocol patch level (maximum 99)
 #define NetworkProtocolPatchLevel   StratagusPatchLevel
-/// Network protocol version (1,2,3) -> 10203
+/// Network protocol revision, raised when the game messages change (maximum 99)
+#define NetworkProtocolRevision     1
+/// Network protocol version (1,2,3,4) -> 1020304
 #define NetworkProtocolVersion \
-	(NetworkProtocolMajorVersion * 10000 + NetworkProtocolMinorVersion * 100 + \
-	 NetworkProtocolPatchLevel)
+	(NetworkProtocolMajorVersion * 1000000 + NetworkProtocolMinorVersion * 10000 + \
+	 NetworkProtocolPatchLevel * 100 + NetworkProtocolRevision)
 
 /// Network protocol printf format string
-#define NetworkProtocolFormatString "%d.%d.%d"
+#define NetworkProtocolFormatString "%d.%d.%d.%d"
 /// Network protocol printf format arguments
-#define NetworkProtocolFormatArgs(v) (v) / 10000, ((v) / 100) % 100, (v) % 100
+#define NetworkProtocolFormatArgs(v) (v) / 1000000, ((v) / 10000) % 100, ((v) / 100) % 100, (v) % 100
 
 /*----------------------------------------------------------------------------
 --  Declarations
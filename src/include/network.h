@@ -55,9 +55,11 @@ public:
 	unsigned int gameCyclesPerUpdate;  /// Network update each # game cycles
 	unsigned int NetworkLag;      /// Network lag (# update cycles)
 	unsigned int timeoutInS;      /// Number of seconds until player times out
+	bool adaptiveLag;             /// Server adapts NetworkLag to the measured round trip times
 
 public:
 	static const int defaultPort = 6660; /// Default communication port
+	static const unsigned int maxNetworkLag = 120; /// Biggest lag the cycle numbering supports
 public:
 	static CNetworkParameter Instance;
 };
@@ -77,6 +79,9 @@ extern inline bool IsNetworkGame() { return NetworkFildes.IsValid(); }
 extern void InitNetwork1();  /// Initialise network
 extern void ExitNetwork1();  /// Cleanup network (port)
 extern void NetworkOnStartGame();  /// Initialise network data for ingame communication
+extern void NetworkOnEndGame();  /// Stop ingame communication
+extern bool NetworkHasDataToRead();  /// Is a network packet waiting?
+extern void NetworkWaitData(unsigned int timeout);  /// Wait for a network packet
 extern void NetworkEvent();  /// Handle network events
 extern void NetworkSync();   /// Hold in sync
 extern void NetworkQuitGame();  /// Quit game: warn other users
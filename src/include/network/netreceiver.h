@@ -0,0 +1,91 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name netreceiver.h - Network receive thread. */
+//
+//      (c) Copyright 2026 by the Stratagus Team
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+
+#ifndef NETRECEIVER_H
+#define NETRECEIVER_H
+
+#include <atomic>
+#include <vector>
+
+#include "SDL.h"
+
+#include "network/netsockets.h"
+
+//@{
+
+/**
+**  Thread which receives the packets of an UDP socket as soon as they
+**  arrive and queues them for the game thread.
+**
+**  The queue has a single producer (the receive thread) and a single
+**  consumer (the game thread), so it needs no lock.
+*/
+class CNetworkReceiver
+{
+public:
+	CNetworkReceiver();
+	~CNetworkReceiver();
+
+	/// Start receiving the packets of socket
+	bool Start(CUDPSocket &socket, unsigned int maxPacketSize);
+	/// Stop the thread, the queued packets are lost
+	void Stop();
+	bool IsRunning() const { return thread != NULL; }
+
+	/// Wait for a packet at most timeout ms
+	void Wait(unsigned int timeout);
+	/// Is a packet waiting in the queue?
+	bool HasPacket() const { return tail.load(std::memory_order_relaxed) != head.load(std::memory_order_acquire); }
+	/// Take the oldest packet of the queue
+	bool Pop(unsigned char *buf, int bufSize, int *len, CHost *host);
+
+private:
+	static int ThreadMain(void *data);
+	void Run();
+
+	/// A received packet
+	struct Packet {
+		std::vector<unsigned char> Data;
+		int Length;    /// Length of the packet, -1 on receive error
+		CHost Host;    /// Sender of the packet
+	};
+
+	static const unsigned int QueueSize = 128;  /// Power of 2
+
+	Packet Queue[QueueSize];          /// Received packets
+	std::atomic<unsigned int> head;   /// Next slot written by the thread
+	std::atomic<unsigned int> tail;   /// Next slot read by the game
+	std::atomic<bool> quit;           /// Ask the thread to exit
+	CUDPSocket *socket;               /// Socket to read
+	SDL_Thread *thread;               /// Receive thread
+	SDL_sem *ready;                   /// Posted for each received packet
+};
+
+//@}
+
+#endif // !NETRECEIVER_H
@@ -218,6 +218,8 @@ public:
 	void clear();
 
 	CPosition getScreenPos(const CPosition &pos) const;
+	/// Viewport being drawn, NULL outside of prepareToDraw and endDraw
+	inline const CViewport *getViewport() const { return vp; }
 
 	inline void setLowDetail(bool detail) { lowDetail = detail; }
 	inline bool getLowDetail() const { return lowDetail; }
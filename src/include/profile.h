@@ -0,0 +1,134 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name profile.h - The frame profiler header file. */
+//
+//      (c) Copyright 2026 by the Stratagus Team
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+//@{
+
+/*----------------------------------------------------------------------------
+--  Includes
+----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+#include <string>
+
+/*----------------------------------------------------------------------------
+--  Declarations
+----------------------------------------------------------------------------*/
+
+/**
+**  Phases of a frame which are timed.
+*/
+enum ProfilePhase {
+	ProfileNetwork,     /// Network commands and replay
+	ProfileTriggers,    /// Triggers
+	ProfileUnits,       /// Unit actions
+	ProfileMissiles,    /// Missile actions
+	ProfilePlayers,     /// Players each cycle
+	ProfileEachSecond,  /// Work done once per second, AI included
+	ProfileParticles,   /// Particles and messages
+	ProfileMinimap,     /// Minimap update
+	ProfileViewports,   /// Map, units and missiles of the viewports
+	ProfileFog,         /// Fog of war, part of ProfileViewports
+	ProfileInterface,   /// Whole screen update, ProfileViewports included
+	ProfileRealize,     /// Showing the frame
+	ProfileWait,        /// Waiting for events and the next frame
+	ProfilePhaseCount   /// Number of phases
+};
+
+/*----------------------------------------------------------------------------
+--  Variables
+----------------------------------------------------------------------------*/
+
+extern bool ProfileEnabled;  /// Time the phases of the frames
+
+/*----------------------------------------------------------------------------
+--  Functions
+----------------------------------------------------------------------------*/
+
+/// Current time in nanoseconds, only for differences
+extern uint64_t ProfileTicks();
+/// Record a time spent in a phase
+extern void ProfileAdd(ProfilePhase phase, uint64_t begin, uint64_t end);
+
+/**
+**  Times consecutive phases.
+**
+**  Each Lap records the time since the previous one (or the creation)
+**  for a phase. Nothing is read from the clock when ::ProfileEnabled is
+**  false at the creation.
+*/
+class CProfileTimer
+{
+public:
+	CProfileTimer() : Begin(ProfileEnabled ? ProfileTicks() : 0) {}
+
+	void Lap(ProfilePhase phase)
+	{
+		if (Begin) {
+			const uint64_t now = ProfileTicks();
+			ProfileAdd(phase, Begin, now);
+			Begin = now;
+		}
+	}
+
+private:
+	uint64_t Begin;  /// Start of the current phase, 0 if not timed
+};
+
+/**
+**  Times a phase until the end of the scope.
+*/
+class CProfileScope
+{
+public:
+	explicit CProfileScope(ProfilePhase phase) : Phase(phase) {}
+	~CProfileScope() { Timer.Lap(Phase); }
+
+private:
+	CProfileTimer Timer;        /// Timer of the scope
+	const ProfilePhase Phase;   /// Phase timed
+};
+
+/// Start a new frame
+extern void ProfileNextFrame();
+/// Show or hide the profiler overlay, timing while shown
+extern void ToggleProfileOverlay();
+/// Draw the profiler overlay if shown
+extern void DrawProfileOverlay();
+/// Write the time of each phase of the last frames as CSV
+extern bool DumpProfileCSV(const std::string &filename);
+/// Write the last timed phases as a Chrome trace
+extern bool DumpProfileTrace(const std::string &filename);
+/// Register the profiler functions with Lua
+extern void ProfileCclRegister();
+
+//@}
+
+#endif // !__PROFILE_H__
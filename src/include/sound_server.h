@@ -44,6 +44,17 @@
 ----------------------------------------------------------------------------*/
 
 #define MaxVolume 255
+
+/**
+**  Priorities of the sounds, the volume is added to them. A sound
+**  takes the channel of a sound of lower priority if none is free.
+*/
+enum SoundPriority {
+	SoundPriorityEffect = 0,    /// Sounds of unit animations and missiles
+	SoundPriorityVoice = 256,   /// Unit voices
+	SoundPriorityGame = 512,    /// Game sounds, like the messages
+	SoundPriorityFile = 768     /// Sounds played by the scripts
+};
 #define SOUND_BUFFER_SIZE 65536
 
 /**
@@ -53,7 +64,7 @@ class CSample
 {
 public:
 	CSample() : Channels(0), SampleSize(0), Frequency(0), BitsPerSample(0),
-		Buffer(NULL), Pos(0), Len(0) {}
+		Buffer(NULL), Pos(0), Len(0), Streamed(false) {}
 	virtual ~CSample() {}
 
 	virtual int Read(void *buf, int len) = 0;
@@ -66,6 +77,7 @@ public:
 	unsigned char *Buffer;        /// sample buffer
 	int Pos;                      /// buffer position
 	int Len;                      /// length of filled buffer
+	bool Streamed;                /// decoded while played, only Read gives the samples
 };
 
 /**
@@ -75,7 +87,8 @@ enum _play_audio_flags_ {
 	PlayAudioStream = 1,        /// Stream the file from medium
 	PlayAudioPreLoad = 2,       /// Load compressed in memory
 	PlayAudioLoadInMemory = 4,  /// Preload file into memory
-	PlayAudioLoadOnDemand = 8   /// Load only if needed.
+	PlayAudioLoadOnDemand = 8,  /// Load only if needed.
+	PlayAudioStreamLarge = 16   /// Stream instead of loading if too large
 };
 
 /**
@@ -98,6 +111,7 @@ extern CSample *LoadWav(const char *name, int flags);         /// Load a wav fil
 extern CSample *LoadVorbis(const char *name, int flags);      /// Load a vorbis file
 extern CSample *LoadMikMod(const char *name, int flags);      /// Load a module file
 extern CSample *LoadFluidSynth(const char *name, int flags);  /// Load a MIDI file
+extern void QuitVorbisStreams();                              /// Stop decoding vorbis streams
 
 /// Set the channel volume
 extern int SetChannelVolume(int channel, int volume);
@@ -111,6 +125,8 @@ extern CSample *GetChannelSample(int channel);
 extern void StopChannel(int channel);
 /// Stop all channels
 extern void StopAllChannels();
+/// Free the channels the mixer finished
+extern void HandleFinishedChannels();
 
 /// Check if this unit plays some sound
 extern bool UnitSoundIsPlaying(Origin *origin);
@@ -118,8 +134,13 @@ extern bool UnitSoundIsPlaying(Origin *origin);
 extern bool SampleIsPlaying(CSample *sample);
 /// Load a sample
 extern CSample *LoadSample(const std::string &name);
+/// Load a sample played once, streamed if it is large
+extern CSample *LoadSampleOnce(const std::string &name);
 /// Play a sample
 extern int PlaySample(CSample *sample, Origin *origin = NULL);
+/// Play a sample of a sound, with a limit of channels per sound and priorities
+extern int PlaySoundSample(CSample *sample, const CSound *sound, int priority,
+						   unsigned char volume, char stereo, Origin *origin = NULL);
 /// Play a sound file
 extern int PlaySoundFile(const std::string &name);
 
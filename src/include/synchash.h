@@ -0,0 +1,98 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name synchash.h - The detailed sync hashes header file. */
+//
+//      (c) Copyright 2026 by the Stratagus Team
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+
+#ifndef __SYNCHASH_H__
+#define __SYNCHASH_H__
+
+//@{
+
+/*----------------------------------------------------------------------------
+--  Includes
+----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------
+--  Declarations
+----------------------------------------------------------------------------*/
+
+/**
+**  Game subsystems which have their own sync hash.
+*/
+enum SyncHashType {
+	SyncHashUnits,      /// Units position, action and hit points
+	SyncHashMissiles,   /// Global missiles
+	SyncHashResources,  /// Resources of the players
+	SyncHashRandom,     /// Sync random seed
+	SyncHashMap,        /// Map fields
+	SyncHashTypeCount   /// Number of sync hashes
+};
+
+/**
+**  Rolling hash of each subsystem.
+**
+**  Each game cycle the state of the subsystem is folded into its hash,
+**  so once two computers differ, their hashes stay different.
+*/
+class CSyncHashes
+{
+public:
+	CSyncHashes() { Clear(); }
+	void Clear() { memset(Hash, 0, sizeof(Hash)); }
+
+	bool operator == (const CSyncHashes &rhs) const { return memcmp(Hash, rhs.Hash, sizeof(Hash)) == 0; }
+	bool operator != (const CSyncHashes &rhs) const { return !(*this == rhs); }
+
+public:
+	uint32_t Hash[SyncHashTypeCount];  /// Hash of each subsystem
+};
+
+/*----------------------------------------------------------------------------
+--  Variables
+----------------------------------------------------------------------------*/
+
+extern bool EnableSyncDebug;    /// Compute and exchange the detailed sync hashes
+extern CSyncHashes SyncHashes;  /// Detailed sync hashes of the current game state
+
+/*----------------------------------------------------------------------------
+--  Functions
+----------------------------------------------------------------------------*/
+
+/// Reset the detailed sync hashes for a new game
+extern void InitSyncHashes();
+/// Fold the state of each subsystem into its hash
+extern void SyncHashesEachCycle();
+/// Report the subsystems which differ from another player and dump their state
+extern void SyncHashesMismatch(unsigned long cycle, int player, const CSyncHashes &local, const CSyncHashes &remote);
+/// Write the hash history and close the log
+extern void CleanSyncHashes();
+
+//@}
+
+#endif // !__SYNCHASH_H__
@@ -616,6 +616,8 @@ extern void CleanDecorations();
 
 /// Draw unit's shadow
 extern void DrawShadow(const CUnitType &type, int frame, const PixelPos &screenPos);
+/// Get the screen area of a unit type's sprite and shadow
+extern void GetUnitTypeDrawArea(const CUnitType &type, const PixelPos &screenPos, PixelPos &pos, PixelSize &size);
 /// Draw all units visible on map in viewport
 extern int FindAndSortUnits(const CViewport &vp, std::vector<CUnit *> &table);
 
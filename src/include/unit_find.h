@@ -303,6 +303,25 @@ CUnit *FindUnit_If(const Vec2i &ltPos, const Vec2i &rbPos, Pred pred)
 extern CUnit *UnitFindResource(const CUnit &unit, const CUnit &startUnit, int range,
 							   int resource, bool check_usage = false, const CUnit *deposit = NULL);
 
+/**
+**  Resource units reachable from a place, nearest first.
+*/
+class CResourceSites
+{
+public:
+	CResourceSites() : Deposit(NULL) {}
+
+	const CUnit *Deposit;        /// Deposit nearest to the place
+	std::vector<CUnit *> Mines;  /// Resource units, in the order of the walk distance
+};
+
+/// Find all resources reachable from a unit
+extern void FindResourceSites(const CUnit &unit, const CUnit &startUnit, int range, int resource,
+							  CResourceSites &sites);
+/// Choose the resource UnitFindResource would find among sites
+extern CUnit *ChooseResourceSite(const CUnit &unit, const CResourceSites &sites, int resource,
+								 bool check_usage = false);
+
 /// Find nearest deposit
 extern CUnit *FindDeposit(const CUnit &unit, int range, int resource);
 /// Find the next idle worker
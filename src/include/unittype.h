@@ -240,6 +240,9 @@ public:
 
 	/// function to draw the decorations.
 	virtual void Draw(int x, int y, const CUnitType &type, const CVariable &var) const = 0;
+	/// Get the screen area Draw draws in.
+	virtual void GetArea(int x, int y, const CUnitType &type, const CVariable &var,
+						 PixelPos &pos, PixelSize &size) const = 0;
 
 	unsigned int Index;     /// Index of the variable. @see DefineVariables
 
@@ -268,6 +271,8 @@ class CDecoVarBar : public CDecoVar
 public:
 	/// function to draw the decorations.
 	virtual void Draw(int x, int y, const CUnitType &type, const CVariable &var) const;
+	virtual void GetArea(int x, int y, const CUnitType &type, const CVariable &var,
+						 PixelPos &pos, PixelSize &size) const;
 
 	bool IsVertical;            /// if true, vertical bar, else horizontal.
 	bool SEToNW;                /// (SouthEastToNorthWest), if false value 0 is on the left or up of the bar.
@@ -286,6 +291,8 @@ public:
 	CDecoVarText() : Font(NULL) {};
 	/// function to draw the decorations.
 	virtual void Draw(int x, int y, const CUnitType &type, const CVariable &var) const;
+	virtual void GetArea(int x, int y, const CUnitType &type, const CVariable &var,
+						 PixelPos &pos, PixelSize &size) const;
 
 	CFont *Font;  /// Font to use to display value.
 	// FIXME : Add Color, format
@@ -299,6 +306,8 @@ public:
 	/// function to draw the decorations.
 	virtual void Draw(int x, int y,
 					  const CUnitType &type, const CVariable &var) const;
+	virtual void GetArea(int x, int y, const CUnitType &type, const CVariable &var,
+						 PixelPos &pos, PixelSize &size) const;
 
 	char NSprite; /// Index of number. (@see DefineSprites and @see GetSpriteIndex)
 	// FIXME Sprite info. better way ?
@@ -311,6 +320,8 @@ public:
 	CDecoVarStaticSprite() : NSprite(-1), n(0), FadeValue(0) {}
 	/// function to draw the decorations.
 	virtual void Draw(int x, int y, const CUnitType &type, const CVariable &var) const;
+	virtual void GetArea(int x, int y, const CUnitType &type, const CVariable &var,
+						 PixelPos &pos, PixelSize &size) const;
 
 	// FIXME Sprite info. and Replace n with more appropriate var.
 	char NSprite;  /// Index of sprite. (@see DefineSprites and @see GetSpriteIndex)
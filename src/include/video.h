@@ -75,7 +75,7 @@ protected:
 		Refs(1), Resized(false)
 #if defined(USE_OPENGL) || defined(USE_GLES)
 		, TextureWidth(0.f), TextureHeight(0.f), Textures(NULL), NumTextures(0),
-		ColorCyclingTextures(NULL), NumColorCycles(0)
+		ColorCyclingTextures(NULL), NumColorCycles(0), TextureAtlased(false)
 #endif
 	{
 		frameFlip_map = NULL;
@@ -157,16 +157,20 @@ public:
 	int NumTextures;           /// Number of textures
 	GLuint **ColorCyclingTextures; /// Texture names
 	int NumColorCycles; /// Number of color cycled texture groups
+	bool TextureAtlased; /// Textures are {atlas page, x, y} instead of texture names
 #endif
 
 	friend class CFont;
 };
 
+struct PlayerColorSurface;
+
 class CPlayerColorGraphic : public CGraphic
 {
 protected:
 	CPlayerColorGraphic()
 	{
+		memset(PlayerColorSurfaces, 0, sizeof(PlayerColorSurfaces));
 #if defined(USE_OPENGL) || defined(USE_GLES)
 		memset(PlayerColorTextures, 0, sizeof(PlayerColorTextures));
 #endif
@@ -182,6 +186,11 @@ public:
 
 	CPlayerColorGraphic *Clone(bool grayscale = false) const;
 
+private:
+	SDL_Surface *GetPlayerColorSurface(int player, bool flip);
+
+public:
+	PlayerColorSurface *PlayerColorSurfaces[PlayerMax];/// Surfaces with player colors
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	GLuint *PlayerColorTextures[PlayerMax];/// Textures with player colors
 #endif
@@ -438,6 +447,12 @@ extern int VideoValidResolution(int w, int h);
 
 /// Load graphic from PNG file
 extern int LoadGraphicPNG(CGraphic *g);
+/// Start decoding PNG files ahead on threads
+extern void PreloadPNG(const std::vector<std::string> &files);
+/// Decode the files of the graphics not loaded yet ahead on threads
+extern void PreloadGraphics();
+/// Stop decoding ahead and free the surfaces not used
+extern void FinishPreloadGraphics();
 
 #if defined(USE_OPENGL) || defined(USE_GLES)
 
@@ -471,6 +486,24 @@ extern void Invalidate();
 /// redrawing. in so
 extern void InvalidateArea(int x, int y, int w, int h);
 
+/// Invalidates the area where something is drawn when it changed since the last frame.
+extern void InvalidateDrawnArea(const void *object, int part, uint64_t key, int x, int y, int w, int h);
+
+/// Mix a value into the key of an area given to InvalidateDrawnArea.
+inline uint64_t DrawnAreaKey(uint64_t key, uint64_t value)
+{
+	return (key ^ value) * 1099511628211ULL;
+}
+
+/// Mix a pointer into the key of an area given to InvalidateDrawnArea.
+inline uint64_t DrawnAreaKey(uint64_t key, const void *pointer)
+{
+	return DrawnAreaKey(key, uint64_t(uintptr_t(pointer)));
+}
+
+/// Mix a text into the key of an area given to InvalidateDrawnArea.
+extern uint64_t DrawnAreaKey(uint64_t key, const std::string &text);
+
 /// Set clipping for nearly all vector primitives. Functions which support
 /// clipping will be marked Clip. Set the system-wide clipping rectangle.
 extern void SetClipping(int left, int top, int right, int bottom);
@@ -534,6 +567,14 @@ extern Uint32 ColorYellow;
 #if defined(USE_OPENGL) || defined(USE_GLES)
 void DrawTexture(const CGraphic *g, GLuint *textures, int sx, int sy,
 				 int ex, int ey, int x, int y, int flip);
+/// Draw the textures queued by DrawTexture
+extern void FlushTextureBatch();
+/// Delete the OpenGL textures of a graphic, or of one of its variants
+extern void DeleteGraphicTextures(const CGraphic &g, GLuint *textures);
+/// Alpha of the textures drawn by DrawTexture
+extern GLubyte TextureBatchAlpha;
+/// Size of the texture atlas pages
+extern GLint TextureAtlasSize;
 #endif
 
 extern void FreeGraphics();
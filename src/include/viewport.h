@@ -91,6 +91,8 @@ public:
 	/// Draw the full Viewport.
 	void Draw() const;
 	void DrawBorder() const;
+	/// Invalidate the part of the viewport showing some tiles
+	void InvalidateTiles(const Vec2i &minPos, const Vec2i &maxPos) const;
 	/// Check if any part of an area is visible in viewport
 	bool AnyMapAreaVisibleInViewport(const Vec2i &boxmin, const Vec2i &boxmax) const;
 
@@ -138,6 +138,7 @@ void CMap::Reveal()
 			playerInfo.Visible[p] = std::max<unsigned short>(1, playerInfo.Visible[p]);
 		}
 		MarkSeenTile(mf);
+		UI.Minimap.UpdateSeenXY(Vec2i(i % this->Info.MapWidth, i / this->Info.MapWidth));
 	}
 	//  Global seen recount. Simple and effective.
 	for (CUnitManager::Iterator it = UnitManager.begin(); it != UnitManager.end(); ++it) {
@@ -353,6 +354,7 @@ void CMap::Clean()
 	this->TileModelsFileName.clear();
 	CGraphic::Free(this->TileGraphic);
 	this->TileGraphic = NULL;
+	InvalidateMapBackgrounds();
 
 	FlagRevealMap = 0;
 	ReplayRevealMap = 0;
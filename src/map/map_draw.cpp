@@ -39,6 +39,7 @@
 #include "particle.h"
 #include "pathfinder.h"
 #include "player.h"
+#include "profile.h"
 #include "unit.h"
 #include "unittype.h"
 #include "ui.h"
@@ -150,6 +151,26 @@ PixelPos CViewport::TilePosToScreen_Center(const Vec2i &tilePos) const
 	return topLeft + PixelTileSize / 2;
 }
 
+/**
+**  Invalidate the part of the viewport showing some tiles.
+**
+**  @param minPos  Top left tile.
+**  @param maxPos  Bottom right tile.
+*/
+void CViewport::InvalidateTiles(const Vec2i &minPos, const Vec2i &maxPos) const
+{
+	const PixelPos topLeft = TilePosToScreen_TopLeft(minPos);
+	const PixelPos bottomRight = TilePosToScreen_TopLeft(maxPos) + PixelTileSize;
+	const int x0 = std::max(topLeft.x, this->TopLeftPos.x);
+	const int y0 = std::max(topLeft.y, this->TopLeftPos.y);
+	const int x1 = std::min(bottomRight.x, this->BottomRightPos.x + 1);
+	const int y1 = std::min(bottomRight.y, this->BottomRightPos.y + 1);
+
+	if (x0 < x1 && y0 < y1) {
+		InvalidateArea(x0, y0, x1 - x0, y1 - y0);
+	}
+}
+
 /**
 **  Change viewpoint of map viewport v to tilePos.
 **
@@ -211,6 +232,297 @@ void CViewport::Center(const PixelPos &mapPixelPos)
 	this->Set(mapPixelPos - this->GetPixelSize() / 2);
 }
 
+/**
+**  Get the tile to draw for a map field.
+*/
+static inline unsigned short GetBackgroundTile(const CMapField &mf)
+{
+	return ReplayRevealMap ? mf.getGraphicTile() : mf.playerInfo.SeenTile;
+}
+
+/**
+**  Offscreen copy of the map background of a viewport (software renderer).
+**
+**  A map tile is kept in the cell (x mod Width, y mod Height), so when the
+**  viewport scrolls, only the cells of the tiles which became visible are
+**  drawn again. A cell is also redrawn when its seen tile changed, or when
+**  color cycling changed a color the tile uses. All the cache is redrawn
+**  after InvalidateMapBackgrounds. The tiles of the redrawn cells are
+**  invalidated on the screen.
+*/
+class CMapBackgroundCache
+{
+public:
+	CMapBackgroundCache() : Surface(NULL), Width(0), Height(0), TileGraphic(NULL), Generation(0) {}
+	~CMapBackgroundCache() { Clear(); }
+
+	bool IsValid() const { return Surface != NULL; }
+	void Draw(const CViewport &vp);
+
+private:
+	void Clear();
+	bool Prepare(int width, int height);
+	void CheckPalette();
+	bool TileUsesColors(unsigned short tile, const uint32_t *colors);
+	void Blit(const CViewport &vp, int cacheX, int cacheY) const;
+
+	/// Map field drawn in a cell: index of the field, -1 outside the map, -2 to redraw
+	std::vector<int> CellField;
+	std::vector<unsigned short> CellTile;  /// Tile drawn in a cell
+	SDL_Surface *Surface;                  /// Cached background
+	int Width;                             /// Width of the cache in tiles
+	int Height;                            /// Height of the cache in tiles
+	const CGraphic *TileGraphic;           /// Tileset the cache was drawn with
+	unsigned Generation;                   /// MapBackgroundGeneration the cache was drawn at
+	std::vector<SDL_Color> Palette;        /// Tileset palette the cache was drawn with
+	std::vector<uint32_t> TileColors;      /// Palette indexes used by each tile (256 bits)
+	std::vector<bool> TileColorsDone;      /// TileColors computed for the tile
+};
+
+static CMapBackgroundCache MapBackgroundCaches[MAX_NUM_VIEWPORTS]; /// Background of each viewport
+static unsigned MapBackgroundGeneration = 1;  /// Bumped when the caches must be redrawn
+
+static uint64_t ViewportKeys[MAX_NUM_VIEWPORTS];   /// What each viewport showed, see MustInvalidateViewport
+static bool ViewportOverlays[MAX_NUM_VIEWPORTS];   /// Each viewport showed overlays in the last frame
+
+/**
+**  Redraw all the cached map backgrounds.
+**
+**  Called when the tileset is loaded or freed, and when the screen is
+**  resized.
+*/
+void InvalidateMapBackgrounds()
+{
+	++MapBackgroundGeneration;
+}
+
+void CMapBackgroundCache::Clear()
+{
+	if (Surface) {
+		SDL_FreeSurface(Surface);
+		Surface = NULL;
+	}
+	Width = Height = 0;
+	TileGraphic = NULL;
+	Generation = 0;
+	CellField.clear();
+	CellTile.clear();
+	Palette.clear();
+	TileColors.clear();
+	TileColorsDone.clear();
+}
+
+/**
+**  Create the cache surface for the given size (in tiles).
+**
+**  @return false if the cache can't be used.
+*/
+bool CMapBackgroundCache::Prepare(int width, int height)
+{
+	const SDL_PixelFormat *format = TheScreen->format;
+
+	if (Surface && Width == width && Height == height && Generation == MapBackgroundGeneration
+		&& TileGraphic == Map.TileGraphic
+		&& Surface->format->BitsPerPixel == format->BitsPerPixel
+		&& Surface->format->Rmask == format->Rmask && Surface->format->Gmask == format->Gmask
+		&& Surface->format->Bmask == format->Bmask) {
+		return true;
+	}
+	Clear();
+	if (!Map.TileGraphic || !Map.TileGraphic->Surface || format->BitsPerPixel == 8) {
+		return false;
+	}
+	Surface = SDL_CreateRGBSurface(SDL_SWSURFACE, width * PixelTileSize.x, height * PixelTileSize.y,
+								   format->BitsPerPixel, format->Rmask, format->Gmask, format->Bmask, 0);
+	if (!Surface) {
+		return false;
+	}
+	Width = width;
+	Height = height;
+	TileGraphic = Map.TileGraphic;
+	Generation = MapBackgroundGeneration;
+	CellField.assign(width * height, -2);
+	CellTile.assign(width * height, 0);
+	const SDL_Palette *palette = TileGraphic->Surface->format->palette;
+	if (TileGraphic->Surface->format->BitsPerPixel == 8 && palette) {
+		Palette.assign(palette->colors, palette->colors + palette->ncolors);
+	}
+	return true;
+}
+
+/**
+**  Check if a tile uses one of the palette indexes.
+**
+**  @param tile    Tile frame.
+**  @param colors  Set of 256 palette indexes.
+*/
+bool CMapBackgroundCache::TileUsesColors(unsigned short tile, const uint32_t *colors)
+{
+	if (tile >= TileGraphic->NumFrames) {
+		return false;
+	}
+	if (TileColorsDone.size() <= tile) {
+		TileColorsDone.resize(TileGraphic->NumFrames, false);
+		TileColors.resize(TileGraphic->NumFrames * 8, 0);
+	}
+	uint32_t *used = &TileColors[tile * 8];
+	if (!TileColorsDone[tile]) {
+		SDL_Surface *surface = TileGraphic->Surface;
+		const int x = TileGraphic->frame_map[tile].x;
+		const int y = TileGraphic->frame_map[tile].y;
+
+		SDL_LockSurface(surface);
+		for (int j = 0; j < TileGraphic->Height; ++j) {
+			const Uint8 *p = static_cast<const Uint8 *>(surface->pixels) + (y + j) * surface->pitch + x;
+			for (int i = 0; i < TileGraphic->Width; ++i) {
+				used[p[i] >> 5] |= 1u << (p[i] & 31);
+			}
+		}
+		SDL_UnlockSurface(surface);
+		TileColorsDone[tile] = true;
+	}
+	for (int i = 0; i != 8; ++i) {
+		if (used[i] & colors[i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+**  Mark the cells to redraw after a color cycling of the tileset palette.
+*/
+void CMapBackgroundCache::CheckPalette()
+{
+	if (Palette.empty()) {
+		return;
+	}
+	const SDL_Palette &palette = *TileGraphic->Surface->format->palette;
+	uint32_t changed[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+	bool anyChange = false;
+
+	for (int i = 0; i != palette.ncolors && i != 256; ++i) {
+		const SDL_Color &c = palette.colors[i];
+		if (c.r != Palette[i].r || c.g != Palette[i].g || c.b != Palette[i].b) {
+			changed[i >> 5] |= 1u << (i & 31);
+			Palette[i] = c;
+			anyChange = true;
+		}
+	}
+	if (!anyChange) {
+		return;
+	}
+	for (size_t i = 0; i != CellField.size(); ++i) {
+		if (CellField[i] >= 0 && TileUsesColors(CellTile[i], changed)) {
+			CellField[i] = -2;
+		}
+	}
+}
+
+/**
+**  Draw the map background of a viewport using the cache.
+*/
+void CMapBackgroundCache::Draw(const CViewport &vp)
+{
+	const PixelSize size = vp.GetPixelSize();
+	// Enough cells for the visible tiles, whatever the offset is.
+	const int width = size.x / PixelTileSize.x + 2;
+	const int height = size.y / PixelTileSize.y + 2;
+
+	if (!Prepare(width, height)) {
+		return;
+	}
+	CheckPalette();
+
+	const Uint32 black = SDL_MapRGB(Surface->format, 0, 0, 0);
+	const int cacheX = ((vp.MapPos.x % Width) + Width) % Width;
+	const int cacheY = ((vp.MapPos.y % Height) + Height) % Height;
+
+	for (int j = 0; j != Height; ++j) {
+		const int y = vp.MapPos.y + j;
+		const int cellY = (cacheY + j) % Height;
+		for (int i = 0; i != Width; ++i) {
+			const int x = vp.MapPos.x + i;
+			const int cell = cellY * Width + (cacheX + i) % Width;
+			int field = -1;
+			unsigned short tile = 0;
+
+			if (x >= 0 && y >= 0 && x < Map.Info.MapWidth && y < Map.Info.MapHeight) {
+				field = x + y * Map.Info.MapWidth;
+				tile = GetBackgroundTile(Map.Fields[field]);
+			}
+			if (CellField[cell] == field && CellTile[cell] == tile) {
+				continue;
+			}
+			SDL_Rect drect = {Sint16((cell % Width) * PixelTileSize.x), Sint16(cellY * PixelTileSize.y),
+							  Uint16(PixelTileSize.x), Uint16(PixelTileSize.y)};
+			if (field == -1 || (TileGraphic->Surface->flags & (SDL_SRCCOLORKEY | SDL_SRCALPHA))) {
+				SDL_FillRect(Surface, &drect, black);
+			}
+			if (field != -1) {
+				SDL_Rect srect = {TileGraphic->frame_map[tile].x, TileGraphic->frame_map[tile].y,
+								  Uint16(TileGraphic->Width), Uint16(TileGraphic->Height)};
+				SDL_BlitSurface(TileGraphic->Surface, &srect, Surface, &drect);
+			}
+			CellField[cell] = field;
+			CellTile[cell] = tile;
+			vp.InvalidateTiles(Vec2i(x, y), Vec2i(x, y));
+		}
+	}
+	Blit(vp, cacheX, cacheY);
+}
+
+/**
+**  Copy the cache on the screen.
+**
+**  The cells are addressed modulo the cache size, so the visible area is
+**  made of up to 4 rectangles of the cache.
+*/
+void CMapBackgroundCache::Blit(const CViewport &vp, int cacheX, int cacheY) const
+{
+	// Screen position of the cell (cacheX, cacheY).
+	const int originX = vp.TopLeftPos.x - vp.Offset.x;
+	const int originY = vp.TopLeftPos.y - vp.Offset.y;
+	for (int j = 0; j != 2; ++j) {
+		// Cache rows [cacheY, Height) then [0, cacheY), same for the columns.
+		const int firstRow = j == 0 ? cacheY : 0;
+		const int lastRow = j == 0 ? Height : cacheY;
+		const int screenY = originY + (j == 0 ? 0 : Height - cacheY) * PixelTileSize.y;
+		for (int i = 0; i != 2; ++i) {
+			const int firstColumn = i == 0 ? cacheX : 0;
+			const int lastColumn = i == 0 ? Width : cacheX;
+			const int screenX = originX + (i == 0 ? 0 : Width - cacheX) * PixelTileSize.x;
+
+			int sx = firstColumn * PixelTileSize.x;
+			int sy = firstRow * PixelTileSize.y;
+			int w = (lastColumn - firstColumn) * PixelTileSize.x;
+			int h = (lastRow - firstRow) * PixelTileSize.y;
+			int dx = screenX;
+			int dy = screenY;
+
+			// Clip to the viewport.
+			if (dx < vp.TopLeftPos.x) {
+				sx += vp.TopLeftPos.x - dx;
+				w -= vp.TopLeftPos.x - dx;
+				dx = vp.TopLeftPos.x;
+			}
+			if (dy < vp.TopLeftPos.y) {
+				sy += vp.TopLeftPos.y - dy;
+				h -= vp.TopLeftPos.y - dy;
+				dy = vp.TopLeftPos.y;
+			}
+			w = std::min(w, vp.BottomRightPos.x + 1 - dx);
+			h = std::min(h, vp.BottomRightPos.y + 1 - dy);
+			if (w <= 0 || h <= 0) {
+				continue;
+			}
+			SDL_Rect srect = {Sint16(sx), Sint16(sy), Uint16(w), Uint16(h)};
+			SDL_Rect drect = {Sint16(dx), Sint16(dy), 0, 0};
+			SDL_BlitSurface(Surface, &srect, TheScreen, &drect);
+		}
+	}
+}
+
 /**
 **  Draw the map backgrounds.
 **
@@ -238,6 +550,18 @@ void CViewport::Center(const PixelPos &mapPixelPos)
 */
 void CViewport::DrawMapBackgroundInViewport() const
 {
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (!UseOpenGL)
+#endif
+	{
+		if (this >= UI.Viewports && this < UI.Viewports + MAX_NUM_VIEWPORTS) {
+			CMapBackgroundCache &cache = MapBackgroundCaches[this - UI.Viewports];
+			cache.Draw(*this);
+			if (cache.IsValid()) {
+				return;
+			}
+		}
+	}
 	int ex = this->BottomRightPos.x;
 	int ey = this->BottomRightPos.y;
 	int sy = this->MapPos.y;
@@ -260,13 +584,7 @@ void CViewport::DrawMapBackgroundInViewport() const
 				continue;
 			}
 			const CMapField &mf = Map.Fields[sx];
-			unsigned short int tile;
-			if (ReplayRevealMap) {
-				tile = mf.getGraphicTile();
-			} else {
-				tile = mf.playerInfo.SeenTile;
-			}
-			Map.TileGraphic->DrawFrameClip(tile, dx, dy);
+			Map.TileGraphic->DrawFrameClip(GetBackgroundTile(mf), dx, dy);
 			++sx;
 			dx += PixelTileSize.x;
 		}
@@ -309,6 +627,8 @@ static void ShowUnitName(const CViewport &vp, PixelPos pos, CUnit *unit, bool hi
 		Video.FillTransRectangle(backgroundColor, x, y, width, height, 128);
 		Video.DrawRectangle(ColorWhite, x, y, width, height);
 		label.DrawCentered(x + width / 2, y + 3, unit->Type->Name);
+		InvalidateDrawnArea(&vp, 0, DrawnAreaKey(DrawnAreaKey(0, uint64_t(backgroundColor)), unit->Type->Name),
+							x, y, width, height);
 	} else if (hidden) {
 		const std::string str("Unrevealed terrain");
 		width = font.getWidth(str) + 10;
@@ -316,11 +636,56 @@ static void ShowUnitName(const CViewport &vp, PixelPos pos, CUnit *unit, bool hi
 		Video.FillTransRectangle(ColorBlue, x, y, width, height, 128);
 		Video.DrawRectangle(ColorWhite, x, y, width, height);
 		label.DrawCentered(x + width / 2, y + 3, str);
+		InvalidateDrawnArea(&vp, 0, DrawnAreaKey(0, str), x, y, width, height);
+	}
+}
+
+/**
+**  Check if a viewport must be invalidated as a whole.
+**
+**  That is when it scrolled, moved or was resized, when it shows the map
+**  to another player or with another tileset, and when its background
+**  isn't cached, as the changes of the background are found by the cache.
+**  Overlays spanning the viewport (orders, pie menu) invalidate it while
+**  they are shown and in the frame after.
+**
+**  @param vp        Viewport drawn.
+**  @param overlays  Overlays are drawn over the viewport in this frame.
+*/
+static bool MustInvalidateViewport(const CViewport &vp, bool overlays)
+{
+	if (&vp < UI.Viewports || &vp >= UI.Viewports + MAX_NUM_VIEWPORTS) {
+		return true;
 	}
+	const int index = &vp - UI.Viewports;
+	uint64_t key = DrawnAreaKey(0, uint64_t(MapBackgroundGeneration));
+	key = DrawnAreaKey(key, uint64_t(vp.TopLeftPos.x));
+	key = DrawnAreaKey(key, uint64_t(vp.TopLeftPos.y));
+	key = DrawnAreaKey(key, uint64_t(vp.BottomRightPos.x));
+	key = DrawnAreaKey(key, uint64_t(vp.BottomRightPos.y));
+	key = DrawnAreaKey(key, uint64_t(vp.MapPos.x));
+	key = DrawnAreaKey(key, uint64_t(vp.MapPos.y));
+	key = DrawnAreaKey(key, uint64_t(vp.Offset.x));
+	key = DrawnAreaKey(key, uint64_t(vp.Offset.y));
+	key = DrawnAreaKey(key, Map.TileGraphic);
+	key = DrawnAreaKey(key, ThisPlayer);
+	key = DrawnAreaKey(key, uint64_t(ReplayRevealMap));
+	key = DrawnAreaKey(key, uint64_t(UI.NumViewports));
+	key = DrawnAreaKey(key, uint64_t(&vp == UI.SelectedViewport));
+
+	const bool overlaysShown = ViewportOverlays[index];
+	const bool changed = ViewportKeys[index] != key;
+	ViewportKeys[index] = key;
+	ViewportOverlays[index] = overlays;
+	return changed || overlays || overlaysShown || !MapBackgroundCaches[index].IsValid();
 }
 
 /**
 **  Draw a map viewport.
+**
+**  Only the parts of the viewport which changed are invalidated: the
+**  background tiles redrawn by the cache, the tiles whose fog changed, and
+**  the areas of the units, missiles and particles whose drawing changed.
 */
 void CViewport::Draw() const
 {
@@ -407,18 +772,23 @@ void CViewport::Draw() const
 		ParticleManager.endDraw();
 	}
 
-	this->DrawMapFogOfWar();
+	{
+		CProfileScope scope(ProfileFog);
+		this->DrawMapFogOfWar();
+	}
 
 	//
 	// Draw orders of selected units.
 	// Drawn here so that they are shown even when the unit is out of the screen.
 	//
+	bool overlays = CursorState == CursorStatePieMenu && this == UI.SelectedViewport;
 	if (!Preference.ShowOrders) {
 	} else if (Preference.ShowOrders < 0
 			   || (ShowOrdersCount >= GameCycle) || (KeyModifiers & ModifierShift)) {
 		for (size_t i = 0; i != Selected.size(); ++i) {
 			ShowOrder(*Selected[i]);
 		}
+		overlays = overlays || !Selected.empty();
 	}
 
 	//
@@ -438,6 +808,12 @@ void CViewport::Draw() const
 
 	DrawBorder();
 	PopClipping();
+
+	if (MustInvalidateViewport(*this, overlays)) {
+		InvalidateArea(this->TopLeftPos.x, this->TopLeftPos.y,
+					   this->BottomRightPos.x + 1 - this->TopLeftPos.x,
+					   this->BottomRightPos.y + 1 - this->TopLeftPos.y);
+	}
 }
 
 /**
@@ -47,6 +47,10 @@
 #include "video.h"
 #include "../video/intern_video.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /*----------------------------------------------------------------------------
 --  Variables
 ----------------------------------------------------------------------------*/
@@ -69,6 +73,17 @@ static std::vector<unsigned short> VisibleTable;
 static SDL_Surface *OnlyFogSurface;
 static CGraphic *AlphaFogG;
 
+/**
+**  Fog frames prepared for the masked fog pass of the software renderer.
+**  For each of the 16 frames there is one byte per pixel telling if the
+**  pixel is covered by fog and the color of that pixel in screen format.
+*/
+static std::vector<Uint8> FogFrameMask;
+static std::vector<Uint32> FogFrameColor;
+
+static std::vector<Uint8> FogRowMask;    /// Fog coverage of one row of tiles
+static std::vector<Uint32> FogRowColor;  /// Fog color of one row of tiles
+
 /*----------------------------------------------------------------------------
 --  Functions
 ----------------------------------------------------------------------------*/
@@ -225,6 +240,7 @@ void MapMarkTileSight(const CPlayer &player, const unsigned int index)
 		if (mf.playerInfo.IsTeamVisible(*ThisPlayer)) {
 			Map.MarkSeenTile(mf);
 		}
+		UI.Minimap.UpdateSeenXY(Vec2i(index % Map.Info.MapWidth, index / Map.Info.MapWidth));
 		return;
 	}
 	Assert(*v != 65535);
@@ -261,6 +277,7 @@ void MapUnmarkTileSight(const CPlayer &player, const unsigned int index)
 			if (mf.playerInfo.IsTeamVisible(*ThisPlayer)) {
 				Map.MarkSeenTile(mf);
 			}
+			UI.Minimap.UpdateSeenXY(Vec2i(index % Map.Info.MapWidth, index / Map.Info.MapWidth));
 		default:  // seen -> seen
 			--*v;
 			break;
@@ -609,13 +626,176 @@ static void DrawFogOfWarTile(int sx, int sy, int dx, int dy)
 	if (blackFogTile) {
 		Map.FogGraphic->DrawFrameClip(blackFogTile, dx, dy);
 	}
+}
+
+/**
+**  Blend the fog color into a span of 32bpp pixels.
+**
+**  Every pixel with a set mask byte becomes
+**  (pixel * (256 - alpha) + color * alpha) / 256, per channel.
+**
+**  @param dst    First pixel of the span.
+**  @param mask   Fog coverage of the span.
+**  @param color  Fog color of each pixel of the span.
+**  @param n      Number of pixels.
+**  @param alpha  Fog opacity.
+*/
+static void BlendFogSpan(Uint32 *dst, const Uint8 *mask, const Uint32 *color, int n, int alpha)
+{
+	const Uint32 ialpha = 256 - alpha;
+	int i = 0;
+
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i a = _mm_set1_epi16(alpha);
+	const __m128i ia = _mm_set1_epi16(ialpha);
+
+	for (; i + 4 <= n; i += 4) {
+		int m4;
+		memcpy(&m4, mask + i, 4);
+		if (!m4) {
+			continue;
+		}
+		const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+		const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(color + i));
+		const __m128i lo = _mm_srli_epi16(_mm_add_epi16(
+											  _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), ia),
+											  _mm_mullo_epi16(_mm_unpacklo_epi8(c, zero), a)), 8);
+		const __m128i hi = _mm_srli_epi16(_mm_add_epi16(
+											  _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), ia),
+											  _mm_mullo_epi16(_mm_unpackhi_epi8(c, zero), a)), 8);
+		const __m128i blended = _mm_packus_epi16(lo, hi);
+
+		// Widen the 4 mask bytes to one lane per pixel, keep unfogged pixels.
+		__m128i m = _mm_cvtsi32_si128(m4);
+		m = _mm_unpacklo_epi8(m, m);
+		m = _mm_unpacklo_epi16(m, m);
+		const __m128i keep = _mm_cmpeq_epi32(m, zero);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+						 _mm_or_si128(_mm_andnot_si128(keep, blended), _mm_and_si128(keep, d)));
+	}
+#endif
+
+	for (; i < n; ++i) {
+		if (mask[i]) {
+			const Uint32 d = dst[i];
+			const Uint32 c = color[i];
+			const Uint32 rb = (((d & 0xFF00FF) * ialpha + (c & 0xFF00FF) * alpha) >> 8) & 0xFF00FF;
+			const Uint32 ag = (((d >> 8) & 0xFF00FF) * ialpha + ((c >> 8) & 0xFF00FF) * alpha) & 0xFF00FF00;
+			dst[i] = rb | ag;
+		}
+	}
+}
+
+/**
+**  Draw one row of fog of war tiles on a 32bpp software screen.
+**
+**  The translucent fog of the whole row is first collected into
+**  FogRowMask/FogRowColor and then blended in a single pass, the
+**  opaque black fog and unexplored tiles are drawn afterwards.
+**
+**  @param sx  Offset into fields to the first tile of the row.
+**  @param sy  Start of the current row.
+**  @param dx  X position into video memory of the first tile.
+**  @param dy  Y position into video memory of the row.
+**  @param x0  Left border of the viewport.
+**  @param x1  Right border of the viewport (inclusive).
+**  @param y0  Top border of the viewport.
+**  @param y1  Bottom border of the viewport (inclusive).
+*/
+static void DrawFogOfWarRow(int sx, int sy, int dx, int dy, int x0, int x1, int y0, int y1)
+{
+	static std::vector<int> blackTiles;
+	static std::vector<int> unexploredTiles;
+	const int w = x1 - x0 + 1;
+	const int tw = PixelTileSize.x;
+	const int th = PixelTileSize.y;
+	bool anyFog = false;
+
+	memset(&FogRowMask[0], 0, w * th);
+	blackTiles.clear();
+	unexploredTiles.clear();
+
+	for (; dx <= x1; ++sx, dx += tw) {
+		if (!IsMapFieldExploredTable(sx)) {
+			unexploredTiles.push_back(dx);
+			continue;
+		}
+		int fogTile = 0;
+		int blackFogTile = 0;
+
+		GetFogOfWarTile(sx, sy, &fogTile, &blackFogTile);
+		if (blackFogTile) {
+			blackTiles.push_back(dx);
+			blackTiles.push_back(blackFogTile);
+		}
+		const bool visible = IsMapFieldVisibleTable(sx);
+		if (visible && (!fogTile || fogTile == blackFogTile)) {
+			continue;
+		}
+		const int left = std::max(dx, x0);
+		const int right = std::min(dx + tw, x1 + 1);
+		if (left >= right) {
+			continue;
+		}
+		anyFog = true;
+		for (int j = 0; j < th; ++j) {
+			Uint8 *mask = &FogRowMask[j * w + left - x0];
+			Uint32 *color = &FogRowColor[j * w + left - x0];
+			if (visible) {
+				const int src = (fogTile * th + j) * tw + left - dx;
+				memcpy(mask, &FogFrameMask[src], right - left);
+				memcpy(color, &FogFrameColor[src], (right - left) * sizeof(Uint32));
+			} else {
+				memset(mask, 1, right - left);
+				std::fill(color, color + right - left, FogOfWarColorSDL);
+			}
+		}
+	}
+
+	if (anyFog) {
+		const int top = std::max(dy, y0);
+		const int bottom = std::min(dy + th, y1 + 1);
+
+		Video.LockScreen();
+		for (int y = top; y < bottom; ++y) {
+			Uint32 *dst = reinterpret_cast<Uint32 *>(static_cast<Uint8 *>(TheScreen->pixels) + y * TheScreen->pitch) + x0;
+			const int j = (y - dy) * w;
+			BlendFogSpan(dst, &FogRowMask[j], &FogRowColor[j], w, FogOfWarOpacity);
+		}
+		Video.UnlockScreen();
+	}
+	for (size_t i = 0; i < blackTiles.size(); i += 2) {
+		Map.FogGraphic->DrawFrameClip(blackTiles[i + 1], blackTiles[i], dy);
+	}
+	for (size_t i = 0; i < unexploredTiles.size(); ++i) {
+		Video.FillRectangleClip(FogOfWarColorSDL, unexploredTiles[i], dy, tw, th);
+	}
+}
 
 #undef IsMapFieldExploredTable
 #undef IsMapFieldVisibleTable
+
+/**
+**  Invalidate the fog around a tile whose visibility changed.
+**
+**  The fog of a tile depends on its neighbours, and the tile may be shown
+**  by every viewport.
+*/
+static void InvalidateFogAround(const Vec2i &pos)
+{
+	const Vec2i offset(1, 1);
+
+	for (const CViewport *vp = UI.Viewports; vp < UI.Viewports + UI.NumViewports; ++vp) {
+		vp->InvalidateTiles(pos - offset, pos + offset);
+	}
 }
 
 /**
 **  Draw the map fog of war.
+**
+**  VisibleTable keeps the visibility of the tiles drawn in the last frame,
+**  so the tiles whose visibility changed are invalidated.
 */
 void CViewport::DrawMapFogOfWar() const
 {
@@ -635,7 +815,12 @@ void CViewport::DrawMapFogOfWar() const
 	unsigned int my_index = my * Map.Info.MapWidth;
 	for (; my < ey; ++my) {
 		for (int mx = sx; mx < ex; ++mx) {
-			VisibleTable[my_index + mx] = Map.Field(mx + my_index)->playerInfo.TeamVisibilityState(*ThisPlayer);
+			const unsigned short state = Map.Field(mx + my_index)->playerInfo.TeamVisibilityState(*ThisPlayer);
+
+			if (VisibleTable[my_index + mx] != state) {
+				VisibleTable[my_index + mx] = state;
+				InvalidateFogAround(Vec2i(mx, my));
+			}
 		}
 		my_index += Map.Info.MapWidth;
 	}
@@ -644,6 +829,20 @@ void CViewport::DrawMapFogOfWar() const
 	int dy = this->TopLeftPos.y - Offset.y;
 	ey = this->BottomRightPos.y;
 
+	if (!FogFrameMask.empty() && TheScreen->format->BytesPerPixel == 4) {
+		const int x0 = std::max(0, this->TopLeftPos.x);
+		const int x1 = std::min<int>(ex, TheScreen->w - 1);
+		const int y0 = std::max(0, this->TopLeftPos.y);
+		const int y1 = std::min<int>(ey, TheScreen->h - 1);
+
+		FogRowMask.resize((x1 - x0 + 1) * PixelTileSize.y);
+		FogRowColor.resize(FogRowMask.size());
+		for (; dy <= ey; dy += PixelTileSize.y, sy += Map.Info.MapWidth) {
+			DrawFogOfWarRow(MapPos.x + sy, sy, this->TopLeftPos.x - Offset.x, dy, x0, x1, y0, y1);
+		}
+		return;
+	}
+
 	while (dy <= ey) {
 		sx = MapPos.x + sy;
 		int dx = this->TopLeftPos.x - Offset.x;
@@ -661,6 +860,56 @@ void CViewport::DrawMapFogOfWar() const
 	}
 }
 
+/**
+**  Prepare the fog frames for the masked fog pass.
+**
+**  Only used on 32bpp software screens, the per tile blits are kept
+**  for every other setup.
+*/
+static void InitFogFrames()
+{
+	FogFrameMask.clear();
+	FogFrameColor.clear();
+
+	CGraphic &g = *Map.FogGraphic;
+	SDL_Surface *s = g.Surface;
+	if (TheScreen->format->BytesPerPixel != 4 || g.NumFrames < 16
+		|| g.Width != PixelTileSize.x || g.Height != PixelTileSize.y) {
+		return;
+	}
+	const int tw = PixelTileSize.x;
+	const int th = PixelTileSize.y;
+	const int bpp = s->format->BytesPerPixel;
+	const bool colorKey = (s->flags & SDL_SRCCOLORKEY) != 0;
+
+	FogFrameMask.resize(16 * tw * th);
+	FogFrameColor.resize(FogFrameMask.size());
+	SDL_LockSurface(s);
+	for (int frame = 0; frame < 16; ++frame) {
+		for (int j = 0; j < th; ++j) {
+			const Uint8 *row = static_cast<Uint8 *>(s->pixels) + (g.frame_map[frame].y + j) * s->pitch;
+			for (int i = 0; i < tw; ++i) {
+				const Uint8 *p = row + (g.frame_map[frame].x + i) * bpp;
+				Uint32 c;
+				switch (bpp) {
+					case 1: c = *p; break;
+					case 2: c = *reinterpret_cast<const Uint16 *>(p); break;
+					case 4: c = *reinterpret_cast<const Uint32 *>(p); break;
+					default: c = p[0] | (p[1] << 8) | (p[2] << 16); break;
+				}
+				Uint8 r, gr, b, a;
+				SDL_GetRGBA(c, s->format, &r, &gr, &b, &a);
+				const int index = (frame * th + j) * tw + i;
+				if (a && !(colorKey && c == s->format->colorkey)) {
+					FogFrameMask[index] = 1;
+					FogFrameColor[index] = SDL_MapRGB(TheScreen->format, r, gr, b);
+				}
+			}
+		}
+	}
+	SDL_UnlockSurface(s);
+}
+
 /**
 **  Initialize the fog of war.
 **  Build tables, setup functions.
@@ -740,6 +989,8 @@ void CMap::InitFogOfWar()
 		AlphaFogG->NumFrames = 16;//1;
 		AlphaFogG->GenFramesMap();
 		AlphaFogG->UseDisplayFormat();
+
+		InitFogFrames();
 	}
 
 	VisibleTable.clear();
@@ -768,6 +1019,10 @@ void CMap::CleanFogOfWar()
 		CGraphic::Free(AlphaFogG);
 		AlphaFogG = NULL;
 	}
+	FogFrameMask.clear();
+	FogFrameColor.clear();
+	FogRowMask.clear();
+	FogRowColor.clear();
 }
 
 //@}
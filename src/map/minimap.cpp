@@ -33,7 +33,9 @@
 --  Includes
 ----------------------------------------------------------------------------*/
 
+#include <climits>
 #include <string.h>
+#include <vector>
 
 #include "stratagus.h"
 
@@ -99,6 +101,72 @@ struct MinimapEvent {
 } MinimapEvents[MAX_MINIMAP_EVENTS];
 int NumMinimapEvents;
 
+static unsigned long MinimapGeneration;  /// Count of minimaps composed, to invalidate the shown one
+
+/**
+**  Rectangle of a unit on the minimap.
+*/
+struct MinimapUnitRect {
+	int X;         /// Left side on the minimap
+	int Y;         /// Top side on the minimap
+	int W;         /// Width in minimap pixels
+	int H;         /// Height in minimap pixels
+	Uint32 Color;  /// Color of the unit
+};
+
+/**
+**  Vision state of a tile which changed since the last update.
+*/
+struct MinimapSeenChange {
+	int Index;           /// Index of the tile
+	unsigned char Seen;  /// 0 unexplored, 1 explored, 2 visible
+};
+
+/**
+**  Work handed to the minimap thread.
+**
+**  Filled on the main thread from the game state, then composed on the
+**  minimap thread into the back buffer: the terrain layer is converted
+**  only when tiles changed, the fog layer only where the vision changed,
+**  and the units are drawn on a copy of both.
+*/
+struct MinimapJob {
+	int W;                                  /// Width of the minimap
+	int H;                                  /// Height of the minimap
+	bool WithTerrain;                       /// Draw the terrain
+	bool Terrain;                           /// Terrain changed
+	Uint32 Black;                           /// Color of unexplored pixels
+	Uint32 Background;                      /// Color without terrain
+	std::vector<MinimapSeenChange> Seen;    /// Changed vision states
+	std::vector<MinimapUnitRect> Units;     /// Units to draw
+};
+
+#if defined(USE_OPENGL) || defined(USE_GLES)
+static unsigned char *MinimapBackSurfaceGL;  /// buffer composed by the minimap thread
+#endif
+static SDL_Surface *MinimapBackSurface;      /// surface composed by the minimap thread
+static SDL_Surface *MinimapTerrainLayer;     /// terrain in the minimap format
+
+static SDL_Thread *MinimapThread;            /// thread composing the minimap
+static SDL_sem *MinimapJobReady;             /// posted when MinimapWork is filled
+static SDL_sem *MinimapJobDone;              /// posted when MinimapWork is composed
+static bool MinimapJobRunning;               /// minimap thread owns MinimapWork
+static volatile bool MinimapThreadQuit;      /// stop the minimap thread
+static MinimapJob MinimapWork;               /// the work of the minimap thread
+
+// Main thread side
+static std::vector<unsigned char> MinimapSeen;      /// vision state per tile sent to the thread
+static std::vector<unsigned char> MinimapSeenDirty; /// vision of the tile may have changed
+static std::vector<int> MinimapSeenDirtyList;       /// tiles with MinimapSeenDirty set
+static bool MinimapSeenAllDirty;                    /// vision of all tiles may have changed
+static bool MinimapTerrainChanged;                  /// terrain changed since the last update
+static int MinimapSeenKey = -1;                     /// what the vision depends on
+
+// Minimap thread side
+static std::vector<unsigned char> MinimapFog;       /// vision state per tile
+static std::vector<unsigned char> MinimapFogChanged; /// vision of the tile changed
+static std::vector<Uint32> MinimapBase;             /// terrain with fog
+
 
 /*----------------------------------------------------------------------------
 -- Functions
@@ -124,6 +192,145 @@ static void CreateMinimapTexture()
 }
 #endif
 
+/**
+**  Compose the minimap layers into the back buffer.
+**
+**  Runs on the minimap thread, or on the main thread if it couldn't be
+**  created. Only touches the minimap buffers and MinimapWork.
+*/
+static void ComposeMinimap()
+{
+	MinimapJob &job = MinimapWork;
+	Uint32 *back;
+	int pitch;
+	const Uint32 *terrain;
+	int terrainPitch;
+
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (UseOpenGL) {
+		back = (Uint32 *)MinimapBackSurfaceGL;
+		pitch = MinimapTextureWidth;
+		terrain = (const Uint32 *)MinimapTerrainSurfaceGL;
+		terrainPitch = MinimapTextureWidth;
+	} else
+#endif
+	{
+		if (job.Terrain) {
+			SDL_BlitSurface(MinimapTerrainSurface, NULL, MinimapTerrainLayer, NULL);
+		}
+		SDL_LockSurface(MinimapBackSurface);
+		SDL_LockSurface(MinimapTerrainLayer);
+		back = (Uint32 *)MinimapBackSurface->pixels;
+		pitch = MinimapBackSurface->pitch / 4;
+		terrain = (const Uint32 *)MinimapTerrainLayer->pixels;
+		terrainPitch = MinimapTerrainLayer->pitch / 4;
+	}
+
+	//
+	// Fog layer
+	//
+	bool fogChanged = job.Terrain;
+	for (size_t i = 0; i < job.Seen.size(); ++i) {
+		MinimapFog[job.Seen[i].Index] = job.Seen[i].Seen;
+		MinimapFogChanged[job.Seen[i].Index] = 1;
+		fogChanged = true;
+	}
+	if (fogChanged) {
+		for (int my = 0; my < job.H; ++my) {
+			Uint32 *base = &MinimapBase[my * job.W];
+			const Uint32 *t = terrain + my * terrainPitch;
+
+			for (int mx = 0; mx < job.W; ++mx) {
+				const int index = Minimap2MapX[mx] + Minimap2MapY[my];
+				if (!job.Terrain && !MinimapFogChanged[index]) {
+					continue;
+				}
+				const int visiontype = MinimapFog[index]; // 0 unexplored, 1 explored, >1 visible.
+
+				if (visiontype == 0 || (visiontype == 1 && ((mx & 1) != (my & 1)))) {
+					base[mx] = job.Black;
+				} else {
+					base[mx] = job.WithTerrain ? t[mx] : job.Background;
+				}
+			}
+		}
+		for (size_t i = 0; i < job.Seen.size(); ++i) {
+			MinimapFogChanged[job.Seen[i].Index] = 0;
+		}
+		if (job.Terrain) {
+			std::fill(MinimapFogChanged.begin(), MinimapFogChanged.end(), 0);
+		}
+	}
+
+	//
+	// Unit layer
+	//
+	for (int my = 0; my < job.H; ++my) {
+		memcpy(back + my * pitch, &MinimapBase[my * job.W], job.W * sizeof(Uint32));
+	}
+	for (size_t i = 0; i < job.Units.size(); ++i) {
+		const MinimapUnitRect &rect = job.Units[i];
+
+		for (int y = rect.Y; y < rect.Y + rect.H; ++y) {
+			std::fill_n(back + y * pitch + rect.X, rect.W, rect.Color);
+		}
+	}
+
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (!UseOpenGL)
+#endif
+	{
+		SDL_UnlockSurface(MinimapTerrainLayer);
+		SDL_UnlockSurface(MinimapBackSurface);
+	}
+}
+
+/**
+**  Minimap thread, composes the minimap whenever it gets work.
+*/
+static int MinimapThreadMain(void *)
+{
+	for (;;) {
+		SDL_SemWait(MinimapJobReady);
+		if (MinimapThreadQuit) {
+			break;
+		}
+		ComposeMinimap();
+		SDL_SemPost(MinimapJobDone);
+	}
+	return 0;
+}
+
+/**
+**  Take the minimap composed by the minimap thread.
+**
+**  @param wait  Wait for the minimap thread to finish.
+**
+**  @return      true if the minimap thread is idle.
+*/
+static bool FinishMinimapJob(bool wait)
+{
+	if (!MinimapJobRunning) {
+		return true;
+	}
+	if (wait) {
+		SDL_SemWait(MinimapJobDone);
+	} else if (SDL_SemTryWait(MinimapJobDone) != 0) {
+		return false;
+	}
+	MinimapJobRunning = false;
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (UseOpenGL) {
+		std::swap(MinimapSurfaceGL, MinimapBackSurfaceGL);
+	} else
+#endif
+	{
+		std::swap(MinimapSurface, MinimapBackSurface);
+	}
+	++MinimapGeneration;
+	return true;
+}
+
 /**
 **  Create a mini-map from the tiles of the map.
 **
@@ -175,6 +382,8 @@ void CMinimap::Create()
 		MinimapTerrainSurfaceGL = new unsigned char[MinimapTextureWidth * MinimapTextureHeight * 4];
 		MinimapSurfaceGL = new unsigned char[MinimapTextureWidth * MinimapTextureHeight * 4];
 		memset(MinimapSurfaceGL, 0, MinimapTextureWidth * MinimapTextureHeight * 4);
+		MinimapBackSurfaceGL = new unsigned char[MinimapTextureWidth * MinimapTextureHeight * 4];
+		memset(MinimapBackSurfaceGL, 0, MinimapTextureWidth * MinimapTextureHeight * 4);
 		CreateMinimapTexture();
 	} else
 #endif
@@ -182,10 +391,28 @@ void CMinimap::Create()
 		SDL_PixelFormat *f = Map.TileGraphic->Surface->format;
 		MinimapTerrainSurface = SDL_CreateRGBSurface(SDL_SWSURFACE, W, H, f->BitsPerPixel, f->Rmask, f->Gmask, f->Bmask, f->Amask);
 		MinimapSurface = SDL_CreateRGBSurface(SDL_SWSURFACE,  W, H, 32, TheScreen->format->Rmask, TheScreen->format->Gmask, TheScreen->format->Bmask, 0);
+		MinimapBackSurface = SDL_CreateRGBSurface(SDL_SWSURFACE,  W, H, 32, TheScreen->format->Rmask, TheScreen->format->Gmask, TheScreen->format->Bmask, 0);
+		MinimapTerrainLayer = SDL_CreateRGBSurface(SDL_SWSURFACE,  W, H, 32, TheScreen->format->Rmask, TheScreen->format->Gmask, TheScreen->format->Bmask, 0);
 	}
 
+	const size_t tiles = Map.Info.MapWidth * Map.Info.MapHeight;
+	MinimapSeen.assign(tiles, 0);
+	MinimapSeenDirty.assign(tiles, 0);
+	MinimapSeenDirtyList.clear();
+	MinimapSeenAllDirty = true;
+	MinimapFog.assign(tiles, 0);
+	MinimapFogChanged.assign(tiles, 1);
+	MinimapBase.assign(W * H, 0);
+
 	UpdateTerrain();
 
+	if (!MinimapThread) {
+		MinimapJobReady = SDL_CreateSemaphore(0);
+		MinimapJobDone = SDL_CreateSemaphore(0);
+		MinimapThreadQuit = false;
+		MinimapThread = SDL_CreateThread(MinimapThreadMain, NULL);
+	}
+
 	NumMinimapEvents = 0;
 }
 
@@ -233,6 +460,10 @@ void CMinimap::UpdateTerrain()
 	}
 	const int bpp = Map.TileGraphic->Surface->format->BytesPerPixel;
 
+	// The minimap thread reads the terrain
+	FinishMinimapJob(true);
+	MinimapTerrainChanged = true;
+
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (!UseOpenGL)
 #endif
@@ -329,6 +560,10 @@ void CMinimap::UpdateXY(const Vec2i &pos)
 		}
 	}
 
+	// The minimap thread reads the terrain
+	FinishMinimapJob(true);
+	MinimapTerrainChanged = true;
+
 	int scalex = MinimapScaleX * SCALE_PRECISION / MINIMAP_FAC;
 	if (scalex == 0) {
 		scalex = 1;
@@ -429,9 +664,75 @@ void CMinimap::UpdateXY(const Vec2i &pos)
 }
 
 /**
-**  Draw a unit on the minimap.
+**  Mark the vision of a tile as changed.
+**
+**  @param pos  The map position whose vision changed
+*/
+void CMinimap::UpdateSeenXY(const Vec2i &pos)
+{
+	if (MinimapSeenDirty.empty()) {
+		return;
+	}
+	const int index = Map.getIndex(pos);
+
+	if (!MinimapSeenDirty[index]) {
+		MinimapSeenDirty[index] = 1;
+		MinimapSeenDirtyList.push_back(index);
+	}
+}
+
+/**
+**  Find the vision changes to send to the minimap thread.
+**
+**  @param changes  Filled with the changed vision states.
 */
-static void DrawUnitOn(CUnit &unit, int red_phase)
+static void CollectSeenChanges(std::vector<MinimapSeenChange> &changes)
+{
+	// Vision of every tile changes with these.
+	int key = ThisPlayer ? ThisPlayer->Index : PlayerMax;
+	if (ThisPlayer) {
+		for (int i = 0; i < PlayerMax; ++i) {
+			key = key * 2 + (ThisPlayer->IsBothSharedVision(Players[i]) ? 1 : 0);
+		}
+	}
+	key = key * 4 + (ReplayRevealMap ? 2 : 0) + (Map.NoFogOfWar ? 1 : 0);
+	if (key != MinimapSeenKey) {
+		MinimapSeenKey = key;
+		MinimapSeenAllDirty = true;
+	}
+
+	changes.clear();
+	if (MinimapSeenAllDirty) {
+		for (size_t i = 0; i < MinimapSeen.size(); ++i) {
+			const unsigned char seen = (ReplayRevealMap || !ThisPlayer) ? 2 : Map.Field(i)->playerInfo.TeamVisibilityState(*ThisPlayer);
+			if (seen != MinimapSeen[i]) {
+				MinimapSeen[i] = seen;
+				const MinimapSeenChange change = {int(i), seen};
+				changes.push_back(change);
+			}
+		}
+	} else {
+		for (size_t i = 0; i < MinimapSeenDirtyList.size(); ++i) {
+			const int index = MinimapSeenDirtyList[i];
+			const unsigned char seen = (ReplayRevealMap || !ThisPlayer) ? 2 : Map.Field(index)->playerInfo.TeamVisibilityState(*ThisPlayer);
+			if (seen != MinimapSeen[index]) {
+				MinimapSeen[index] = seen;
+				const MinimapSeenChange change = {index, seen};
+				changes.push_back(change);
+			}
+		}
+	}
+	for (size_t i = 0; i < MinimapSeenDirtyList.size(); ++i) {
+		MinimapSeenDirty[MinimapSeenDirtyList[i]] = 0;
+	}
+	MinimapSeenDirtyList.clear();
+	MinimapSeenAllDirty = false;
+}
+
+/**
+**  Get the rectangle of a unit on the minimap.
+*/
+static void AddUnitRect(const CUnit &unit, int red_phase, std::vector<MinimapUnitRect> &rects)
 {
 	const CUnitType *type;
 
@@ -462,171 +763,115 @@ static void DrawUnitOn(CUnit &unit, int red_phase)
 		color = PlayerColors[GameSettings.Presets[unit.Player->Index].PlayerColor][0];
 	}
 
-	int mx = 1 + UI.Minimap.XOffset + Map2MinimapX[unit.tilePos.x];
-	int my = 1 + UI.Minimap.YOffset + Map2MinimapY[unit.tilePos.y];
+	const int mx = 1 + UI.Minimap.XOffset + Map2MinimapX[unit.tilePos.x];
+	const int my = 1 + UI.Minimap.YOffset + Map2MinimapY[unit.tilePos.y];
 	int w = Map2MinimapX[type->TileWidth];
 	if (mx + w >= UI.Minimap.W) { // clip right side
 		w = UI.Minimap.W - mx;
 	}
-	int h0 = Map2MinimapY[type->TileHeight];
-	if (my + h0 >= UI.Minimap.H) { // clip bottom side
-		h0 = UI.Minimap.H - my;
-	}
-	int bpp = 0;
-#if defined(USE_OPENGL) || defined(USE_GLES)
-	if (!UseOpenGL)
-#endif
-	{
-		SDL_Color c;
-		bpp = MinimapSurface->format->BytesPerPixel;
-		SDL_GetRGB(color, TheScreen->format, &c.r, &c.g, &c.b);
-	}
-	while (w-- >= 0) {
-		int h = h0;
-		while (h-- >= 0) {
-#if defined(USE_OPENGL) || defined(USE_GLES)
-			if (UseOpenGL) {
-				*(Uint32 *)&(MinimapSurfaceGL[((mx + w) + (my + h) * MinimapTextureWidth) * 4]) = color;
-			} else
-#endif
-			{
-				const unsigned int index = (mx + w) * bpp + (my + h) * MinimapSurface->pitch;
-				if (bpp == 2) {
-					*(Uint16 *)&((Uint8 *)MinimapSurface->pixels)[index] = color;
-				} else {
-					*(Uint32 *)&((Uint8 *)MinimapSurface->pixels)[index] = color;
-				}
-			}
-		}
+	int h = Map2MinimapY[type->TileHeight];
+	if (my + h >= UI.Minimap.H) { // clip bottom side
+		h = UI.Minimap.H - my;
 	}
+	// The unit covers one pixel more to the top left.
+	const MinimapUnitRect rect = {mx - 1, my - 1, std::max(w + 1, 0), std::max(h + 1, 0), color};
+	rects.push_back(rect);
 }
 
 /**
 **  Update the minimap with the current game information
+**
+**  The game state is collected here, the minimap is composed by the
+**  minimap thread and shown by Draw once it is done.
 */
 void CMinimap::Update()
 {
 	static int red_phase;
 
+	if (MinimapSeen.empty()) {
+		return;
+	}
 	int red_phase_changed = red_phase != (int)((FrameCounter / FRAMES_PER_SECOND) & 1);
 	if (red_phase_changed) {
 		red_phase = !red_phase;
 	}
 
-	// Clear Minimap background if not transparent
-	if (!Transparent) {
-#if defined(USE_OPENGL) || defined(USE_GLES)
-		if (UseOpenGL) {
-			memset(MinimapSurfaceGL, 0, MinimapTextureWidth * MinimapTextureHeight * 4);
-		} else
-#endif
-		{
-			SDL_FillRect(MinimapSurface, NULL, SDL_MapRGB(MinimapSurface->format, 0, 0, 0));
-		}
-	}
+	FinishMinimapJob(true);
 
-	int bpp;
+	MinimapJob &job = MinimapWork;
+	job.W = W;
+	job.H = H;
+	job.WithTerrain = WithTerrain;
+	job.Terrain = MinimapTerrainChanged;
+	MinimapTerrainChanged = false;
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
-		bpp = 0;
+		job.Black = Video.MapRGB(0, 0, 0, 0);
+		job.Background = 0;
 	} else
 #endif
 	{
-		bpp = MinimapSurface->format->BytesPerPixel;
+		job.Black = ColorBlack;
+		job.Background = SDL_MapRGB(MinimapSurface->format, 0, 0, 0);
 	}
+	CollectSeenChanges(job.Seen);
 
-	//
-	// Draw the terrain
-	//
-	if (WithTerrain) {
-#if defined(USE_OPENGL) || defined(USE_GLES)
-		if (UseOpenGL) {
-			memcpy(MinimapSurfaceGL, MinimapTerrainSurfaceGL, MinimapTextureWidth * MinimapTextureHeight * 4);
-		} else
-#endif
-		{
-			SDL_BlitSurface(MinimapTerrainSurface, NULL, MinimapSurface, NULL);
-		}
-	}
-
-#if defined(USE_OPENGL) || defined(USE_GLES)
-	if (!UseOpenGL)
-#endif
-	{
-		SDL_LockSurface(MinimapSurface);
-		SDL_LockSurface(MinimapTerrainSurface);
-	}
-
-	for (int my = 0; my < H; ++my) {
-		for (int mx = 0; mx < W; ++mx) {
-			int visiontype; // 0 unexplored, 1 explored, >1 visible.
-
-			if (ReplayRevealMap) {
-				visiontype = 2;
-			} else {
-				const Vec2i tilePos(Minimap2MapX[mx], Minimap2MapY[my] / Map.Info.MapWidth);
-				visiontype = Map.Field(tilePos)->playerInfo.TeamVisibilityState(*ThisPlayer);
-			}
-
-			if (visiontype == 0 || (visiontype == 1 && ((mx & 1) != (my & 1)))) {
-#if defined(USE_OPENGL) || defined(USE_GLES)
-				if (UseOpenGL) {
-					*(Uint32 *)&(MinimapSurfaceGL[(mx + my * MinimapTextureWidth) * 4]) = Video.MapRGB(0, 0, 0, 0);
-				} else
-#endif
-				{
-					const int index = mx * bpp + my * MinimapSurface->pitch;
-					if (bpp == 2) {
-						*(Uint16 *)&((Uint8 *)MinimapSurface->pixels)[index] = ColorBlack;
-					} else {
-						*(Uint32 *)&((Uint8 *)MinimapSurface->pixels)[index] = ColorBlack;
-					}
-				}
-			}
-		}
-	}
-
-#if defined(USE_OPENGL) || defined(USE_GLES)
-	if (!UseOpenGL)
-#endif
-	{
-		SDL_UnlockSurface(MinimapTerrainSurface);
-	}
-
-	//
-	// Draw units on map
-	//
+	job.Units.clear();
 	for (CUnitManager::Iterator it = UnitManager.begin(); it != UnitManager.end(); ++it) {
 		CUnit &unit = **it;
 		if (unit.IsVisibleOnMinimap()) {
-			DrawUnitOn(unit, red_phase);
+			AddUnitRect(unit, red_phase, job.Units);
 		}
 	}
-#if defined(USE_OPENGL) || defined(USE_GLES)
-	if (!UseOpenGL)
-#endif
-	{
-		SDL_UnlockSurface(MinimapSurface);
+
+	if (MinimapThread) {
+		MinimapJobRunning = true;
+		SDL_SemPost(MinimapJobReady);
+	} else {
+		ComposeMinimap();
+		MinimapJobRunning = true;
+		SDL_SemPost(MinimapJobDone);
+		FinishMinimapJob(true);
 	}
 }
 
+/**
+**  Wait for the minimap being composed, so the minimap surface is
+**  up to date with the last Update.
+*/
+void CMinimap::Sync()
+{
+	FinishMinimapJob(true);
+}
+
 /**
 **  Draw the minimap events
 */
 static void DrawEvents()
 {
 	const unsigned char alpha = 192;
+	PixelPos topLeft(INT_MAX, INT_MAX);
+	PixelPos bottomRight(INT_MIN, INT_MIN);
 
 	for (int i = 0; i < NumMinimapEvents; ++i) {
 		Video.DrawTransCircleClip(MinimapEvents[i].Color,
 								  MinimapEvents[i].pos.x, MinimapEvents[i].pos.y,
 								  MinimapEvents[i].Size, alpha);
+		topLeft.x = std::min(topLeft.x, MinimapEvents[i].pos.x - MinimapEvents[i].Size);
+		topLeft.y = std::min(topLeft.y, MinimapEvents[i].pos.y - MinimapEvents[i].Size);
+		bottomRight.x = std::max(bottomRight.x, MinimapEvents[i].pos.x + MinimapEvents[i].Size + 1);
+		bottomRight.y = std::max(bottomRight.y, MinimapEvents[i].pos.y + MinimapEvents[i].Size + 1);
 		MinimapEvents[i].Size -= 1;
 		if (MinimapEvents[i].Size < 2) {
 			MinimapEvents[i] = MinimapEvents[--NumMinimapEvents];
 			--i;
 		}
 	}
+	// The events shrink every frame.
+	if (topLeft.x != INT_MAX) {
+		InvalidateDrawnArea(MinimapEvents, 0, uint64_t(FrameCounter), topLeft.x, topLeft.y,
+							bottomRight.x - topLeft.x, bottomRight.y - topLeft.y);
+	}
 }
 
 /**
@@ -634,8 +879,10 @@ static void DrawEvents()
 */
 void CMinimap::Draw() const
 {
+	FinishMinimapJob(false);
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
+		FlushTextureBatch();
 		glBindTexture(GL_TEXTURE_2D, MinimapTexture);
 		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, MinimapTextureWidth, MinimapTextureHeight,
 						GL_RGBA, GL_UNSIGNED_BYTE, MinimapSurfaceGL);
@@ -682,6 +929,8 @@ void CMinimap::Draw() const
 	{
 		SDL_Rect drect = {Sint16(X), Sint16(Y), 0, 0};
 		SDL_BlitSurface(MinimapSurface, NULL, TheScreen, &drect);
+		InvalidateDrawnArea(this, 0, DrawnAreaKey(uint64_t(MinimapGeneration), MinimapSurface),
+							X, Y, MinimapSurface->w, MinimapSurface->h);
 	}
 
 	DrawEvents();
@@ -722,6 +971,24 @@ PixelPos CMinimap::TilePosToScreenPos(const Vec2i &tilePos) const
 */
 void CMinimap::Destroy()
 {
+	FinishMinimapJob(true);
+	if (MinimapThread) {
+		MinimapThreadQuit = true;
+		SDL_SemPost(MinimapJobReady);
+		SDL_WaitThread(MinimapThread, NULL);
+		MinimapThread = NULL;
+		SDL_DestroySemaphore(MinimapJobReady);
+		SDL_DestroySemaphore(MinimapJobDone);
+		MinimapJobReady = MinimapJobDone = NULL;
+	}
+	MinimapSeen.clear();
+	MinimapSeenDirty.clear();
+	MinimapSeenDirtyList.clear();
+	MinimapFog.clear();
+	MinimapFogChanged.clear();
+	MinimapBase.clear();
+	MinimapSeenKey = -1;
+
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
 		delete[] MinimapTerrainSurfaceGL;
@@ -731,9 +998,15 @@ void CMinimap::Destroy()
 			delete[] MinimapSurfaceGL;
 			MinimapSurfaceGL = NULL;
 		}
+		delete[] MinimapBackSurfaceGL;
+		MinimapBackSurfaceGL = NULL;
 	} else
 #endif
 	{
+		SDL_FreeSurface(MinimapBackSurface);
+		MinimapBackSurface = NULL;
+		SDL_FreeSurface(MinimapTerrainLayer);
+		MinimapTerrainLayer = NULL;
 		VideoPaletteListRemove(MinimapTerrainSurface);
 		SDL_FreeSurface(MinimapTerrainSurface);
 		MinimapTerrainSurface = NULL;
@@ -761,6 +1034,8 @@ void CMinimap::DrawViewportArea(const CViewport &viewport) const
 
 	// Draw cursor as rectangle (Note: unclipped, as it is always visible)
 	Video.DrawTransRectangle(UI.ViewportCursorColor, screenPos.x, screenPos.y, w, h, 128);
+	InvalidateDrawnArea(this, 1, uint64_t(UI.ViewportCursorColor),
+						screenPos.x, screenPos.y, w, h);
 }
 
 /**
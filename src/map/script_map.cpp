@@ -434,6 +434,7 @@ static int CclDefineTileset(lua_State *l)
 	ShowLoadProgress(_("Tileset '%s'"), Map.Tileset->ImageFile.c_str());
 	Map.TileGraphic = CGraphic::New(Map.Tileset->ImageFile, PixelTileSize.x, PixelTileSize.y);
 	Map.TileGraphic->Load();
+	InvalidateMapBackgrounds();
 	return 0;
 }
 /**
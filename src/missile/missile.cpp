@@ -526,6 +526,9 @@ void MissileType::DrawMissileType(int frame, const PixelPos &pos) const
 
 /**
 **  Draw missile.
+**
+**  The screen area of the missile is invalidated when it moved or
+**  changed frame since the last frame.
 */
 void Missile::DrawMissile(const CViewport &vp) const
 {
@@ -541,16 +544,29 @@ void Missile::DrawMissile(const CViewport &vp) const
 	}
 	const PixelPos screenPixelPos = vp.MapToScreenPixelPos(this->position);
 
+	PixelSize size(0, 0);
 	switch (this->Type->Class) {
 		case MissileClassHit:
 			CLabel(GetGameFont()).DrawClip(screenPixelPos.x, screenPixelPos.y, this->Damage);
+			size = PixelSize(GetGameFont().Width(this->Damage), GetGameFont().Height());
 			break;
 		default:
 			if (Type->G) {
 				this->Type->DrawMissileType(this->SpriteFrame, screenPixelPos);
+				size = PixelSize(this->Type->G->Width, this->Type->G->Height);
 			}
 			break;
 	}
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (!UseOpenGL)
+#endif
+	{
+		uint64_t key = DrawnAreaKey(uint64_t(screenPixelPos.x), uint64_t(screenPixelPos.y));
+		key = DrawnAreaKey(key, this->Type);
+		key = DrawnAreaKey(key, uint64_t(this->SpriteFrame));
+		key = DrawnAreaKey(key, uint64_t(this->Damage));
+		InvalidateDrawnArea(this, &vp - UI.Viewports, key, screenPixelPos.x, screenPixelPos.y, size.x, size.y);
+	}
 }
 
 static bool MissileDrawLevelCompare(const Missile *const l, const Missile *const r)
@@ -562,6 +578,16 @@ static bool MissileDrawLevelCompare(const Missile *const l, const Missile *const
 	}
 }
 
+/**
+**  Get the global missiles.
+**
+**  Contrary to local missiles, they are part of the synchronized game state.
+*/
+const std::vector<Missile *> &GetGlobalMissiles()
+{
+	return GlobalMissiles;
+}
+
 /**
 **  Sort visible missiles on map for display.
 **
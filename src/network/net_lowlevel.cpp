@@ -586,13 +586,14 @@ int NetSendTCP(Socket sockfd, const void *buf, int len)
 /**
 **  Listen for connections on a TCP socket.
 **
-**  @param sockfd  Socket
+**  @param sockfd   Socket
+**  @param backlog  Max number of connections waiting to be accepted.
 **
 **  @return 0 for success, -1 for error
 */
-int NetListenTCP(Socket sockfd)
+int NetListenTCP(Socket sockfd, int backlog)
 {
-	return listen(sockfd, PlayerMax);
+	return listen(sockfd, backlog);
 }
 
 /**
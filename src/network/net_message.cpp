@@ -133,6 +133,21 @@ size_t serialize(unsigned char *buf, const std::vector<unsigned char> &data)
 	//Wyrmgus end
 }
 
+/// Variable length encoding, 7 bits per byte, high bit set if more bytes follow
+size_t serializeVarint(unsigned char *buf, uint32_t data)
+{
+	size_t size = 1;
+	for (; data >= 0x80; data >>= 7, ++size) {
+		if (buf) {
+			*buf++ = uint8_t(data | 0x80);
+		}
+	}
+	if (buf) {
+		*buf = uint8_t(data);
+	}
+	return size;
+}
+
 size_t deserialize32(const unsigned char *buf, uint32_t *data)
 {
 	*data = ntohl(*reinterpret_cast<const uint32_t *>(buf));
@@ -192,6 +207,29 @@ size_t deserialize(const unsigned char *buf, std::vector<unsigned char> &data)
 	//Wyrmgus end
 }
 
+/**
+**  Read a varint which must end before end.
+**
+**  @return  The number of bytes read, or 0 if the varint runs past end.
+*/
+size_t deserializeVarint(const unsigned char *buf, const unsigned char *end, uint32_t *data)
+{
+	const unsigned char *p = buf;
+
+	*data = 0;
+	for (int shift = 0; shift < 32; shift += 7) {
+		if (p == end) {
+			return 0;
+		}
+		const unsigned char c = *p++;
+		*data |= uint32_t(c & 0x7F) << shift;
+		if ((c & 0x80) == 0) {
+			return p - buf;
+		}
+	}
+	return 0;
+}
+
 //
 // CNetworkHost
 //
@@ -349,7 +387,7 @@ CInitMessage_Hello::CInitMessage_Hello(const char *name) :
 	header(MessageInit_FromClient, ICMHello)
 {
 	strncpy_s(this->PlyName, sizeof(this->PlyName), name, _TRUNCATE);
-	this->Stratagus = StratagusVersion;
+	this->Stratagus = NetworkProtocolVersion;
 	this->Version = FileChecksums;
 }
 
@@ -413,7 +451,7 @@ void CInitMessage_Config::Deserialize(const unsigned char *p)
 CInitMessage_EngineMismatch::CInitMessage_EngineMismatch() :
 	header(MessageInit_FromServer, ICMEngineMismatch)
 {
-	this->Stratagus = StratagusVersion;
+	this->Stratagus = NetworkProtocolVersion;
 }
 
 const unsigned char *CInitMessage_EngineMismatch::Serialize() const
@@ -627,6 +665,101 @@ size_t CNetworkExtendedCommand::Deserialize(const unsigned char *buf)
 	return p - buf;
 }
 
+//
+// CNetworkGroupCommand
+//
+
+/// Zigzag encoding of the difference between two unit numbers
+static uint32_t EncodeUnitDelta(uint16_t previous, uint16_t unit)
+{
+	const int32_t delta = int32_t(unit) - int32_t(previous);
+	return delta >= 0 ? uint32_t(delta) << 1 : (uint32_t(-delta) << 1) - 1;
+}
+
+static uint16_t DecodeUnitDelta(uint16_t previous, uint32_t code)
+{
+	const int32_t delta = (code & 1) ? -int32_t((code + 1) >> 1) : int32_t(code >> 1);
+	return uint16_t(previous + delta);
+}
+
+size_t CNetworkGroupCommand::Serialize(unsigned char *buf) const
+{
+	unsigned char *p = buf;
+	p += serialize8(p, this->Type);
+	p += serializeVarint(p, this->X);
+	p += serializeVarint(p, this->Y);
+	// Dest is often 0xFFFF (no unit), shift it so that it uses one byte.
+	p += serializeVarint(p, uint16_t(this->Dest + 1));
+	p += serializeVarint(p, uint32_t(this->Units.size()));
+	uint16_t previous = 0;
+	for (size_t i = 0; i != this->Units.size(); ++i) {
+		p += serializeVarint(p, EncodeUnitDelta(previous, this->Units[i]));
+		previous = this->Units[i];
+	}
+	return p - buf;
+}
+
+/**
+**  Read a group command of len bytes.
+**
+**  @return  The number of bytes read, or 0 if the command is malformed.
+*/
+size_t CNetworkGroupCommand::Deserialize(const unsigned char *buf, size_t len)
+{
+	const unsigned char *p = buf;
+	const unsigned char *end = buf + len;
+	uint32_t value[4];
+
+	this->Units.clear();
+	if (len == 0) {
+		return 0;
+	}
+	p += deserialize8(p, &this->Type);
+	for (int i = 0; i != 4; ++i) {
+		const size_t r = deserializeVarint(p, end, &value[i]);
+		if (r == 0) {
+			return 0;
+		}
+		p += r;
+	}
+	this->X = uint16_t(value[0]);
+	this->Y = uint16_t(value[1]);
+	this->Dest = uint16_t(value[2] - 1);
+	// Each unit takes at least one byte.
+	if (value[3] > MaxNetworkGroupUnits || value[3] > size_t(end - p)) {
+		return 0;
+	}
+	this->Units.resize(value[3]);
+	uint16_t previous = 0;
+	for (size_t i = 0; i != this->Units.size(); ++i) {
+		uint32_t code;
+		const size_t r = deserializeVarint(p, end, &code);
+		if (r == 0) {
+			this->Units.clear();
+			return 0;
+		}
+		p += r;
+		this->Units[i] = DecodeUnitDelta(previous, code);
+		previous = this->Units[i];
+	}
+	return p - buf;
+}
+
+size_t CNetworkGroupCommand::Size() const
+{
+	size_t size = 1;
+	size += serializeVarint(NULL, this->X);
+	size += serializeVarint(NULL, this->Y);
+	size += serializeVarint(NULL, uint16_t(this->Dest + 1));
+	size += serializeVarint(NULL, uint32_t(this->Units.size()));
+	uint16_t previous = 0;
+	for (size_t i = 0; i != this->Units.size(); ++i) {
+		size += serializeVarint(NULL, EncodeUnitDelta(previous, this->Units[i]));
+		previous = this->Units[i];
+	}
+	return size;
+}
+
 //
 // CNetworkChat
 //
@@ -661,6 +794,9 @@ size_t CNetworkCommandSync::Serialize(unsigned char *buf) const
 	unsigned char *p = buf;
 	p += serialize32(p, this->syncSeed);
 	p += serialize32(p, this->syncHash);
+	p += serialize16(p, this->pingTime);
+	p += serialize16(p, this->pongTime);
+	p += serialize8(p, this->pongPlayer);
 	return p - buf;
 }
 
@@ -669,6 +805,51 @@ size_t CNetworkCommandSync::Deserialize(const unsigned char *buf)
 	const unsigned char *p = buf;
 	p += deserialize32(p, &this->syncSeed);
 	p += deserialize32(p, &this->syncHash);
+	p += deserialize16(p, &this->pingTime);
+	p += deserialize16(p, &this->pongTime);
+	p += deserialize8(p, &this->pongPlayer);
+	return p - buf;
+}
+
+//
+// CNetworkCommandLag
+//
+
+size_t CNetworkCommandLag::Serialize(unsigned char *buf) const
+{
+	unsigned char *p = buf;
+	p += serialize16(p, this->networkLag);
+	return p - buf;
+}
+
+size_t CNetworkCommandLag::Deserialize(const unsigned char *buf)
+{
+	const unsigned char *p = buf;
+	p += deserialize16(p, &this->networkLag);
+	return p - buf;
+}
+
+//
+// CNetworkCommandSyncHashes
+//
+
+size_t CNetworkCommandSyncHashes::Serialize(unsigned char *buf) const
+{
+	unsigned char *p = buf;
+	p += serialize8(p, this->player);
+	for (int i = 0; i != SyncHashTypeCount; ++i) {
+		p += serialize32(p, this->hashes.Hash[i]);
+	}
+	return p - buf;
+}
+
+size_t CNetworkCommandSyncHashes::Deserialize(const unsigned char *buf)
+{
+	const unsigned char *p = buf;
+	p += deserialize8(p, &this->player);
+	for (int i = 0; i != SyncHashTypeCount; ++i) {
+		p += deserialize32(p, &this->hashes.Hash[i]);
+	}
 	return p - buf;
 }
 
@@ -781,6 +962,11 @@ void CNetworkPacket::Deserialize(const unsigned char *p, unsigned int len, int *
 	}
 }
 
+/* static */ size_t CNetworkPacket::CommandSize(const std::vector<unsigned char> &command)
+{
+	return serialize(NULL, command);
+}
+
 size_t CNetworkPacket::Size(int numcommands) const
 {
 	size_t size = 0;
@@ -884,8 +884,10 @@ void CClient::Parse_EngineMismatch(const unsigned char *buf)
 
 	msg.Deserialize(buf);
 	const std::string serverHostStr = serverHost.toString();
-	fprintf(stderr, "Incompatible Stratagus version %d <-> %d\nfrom %s\n",
-			StratagusVersion, msg.Stratagus, serverHostStr.c_str());
+	fprintf(stderr, "Incompatible Stratagus version "
+			NetworkProtocolFormatString " <-> " NetworkProtocolFormatString "\nfrom %s\n",
+			NetworkProtocolFormatArgs(NetworkProtocolVersion),
+			NetworkProtocolFormatArgs(msg.Stratagus), serverHostStr.c_str());
 	networkState.State = ccs_incompatibleengine;
 }
 
@@ -1290,10 +1292,12 @@ void CServer::Parse_SeeYou(const int h)
 */
 static int CheckVersions(const CInitMessage_Hello &msg, CUDPSocket &socket, const CHost &host)
 {
-	if (msg.Stratagus != StratagusVersion) {
+	if (msg.Stratagus != NetworkProtocolVersion) {
 		const std::string hostStr = host.toString();
-		fprintf(stderr, "Incompatible Stratagus version %d <-> %d from %s\n",
-				StratagusVersion, msg.Stratagus, hostStr.c_str());
+		fprintf(stderr, "Incompatible Stratagus version "
+				NetworkProtocolFormatString " <-> " NetworkProtocolFormatString " from %s\n",
+				NetworkProtocolFormatArgs(NetworkProtocolVersion),
+				NetworkProtocolFormatArgs(msg.Stratagus), hostStr.c_str());
 
 		const CInitMessage_EngineMismatch message;
 		NetworkSendICMessage_Log(socket, host, message);
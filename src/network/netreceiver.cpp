@@ -0,0 +1,184 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name netreceiver.cpp - Network receive thread. */
+//
+//      (c) Copyright 2026 by the Stratagus Team
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+//@{
+
+//----------------------------------------------------------------------------
+//  Includes
+//----------------------------------------------------------------------------
+
+#include "stratagus.h"
+
+#include "network/netreceiver.h"
+
+//----------------------------------------------------------------------------
+//  Functions
+//----------------------------------------------------------------------------
+
+CNetworkReceiver::CNetworkReceiver() :
+	head(0), tail(0), quit(false), socket(NULL), thread(NULL), ready(NULL)
+{
+}
+
+CNetworkReceiver::~CNetworkReceiver()
+{
+	Stop();
+}
+
+/**
+**  Start the receive thread.
+**
+**  @param socket         Socket to read, must stay open until Stop().
+**  @param maxPacketSize  Size of the biggest packet.
+**
+**  @return true if the thread is running.
+*/
+bool CNetworkReceiver::Start(CUDPSocket &socket, unsigned int maxPacketSize)
+{
+	Stop();
+	for (unsigned int i = 0; i != QueueSize; ++i) {
+		Queue[i].Data.resize(maxPacketSize);
+	}
+	head = 0;
+	tail = 0;
+	quit = false;
+	this->socket = &socket;
+	ready = SDL_CreateSemaphore(0);
+	if (ready == NULL) {
+		return false;
+	}
+	thread = SDL_CreateThread(ThreadMain, this);
+	if (thread == NULL) {
+		DebugPrint("Can't create network thread: %s\n" _C_ SDL_GetError());
+		SDL_DestroySemaphore(ready);
+		ready = NULL;
+		return false;
+	}
+	return true;
+}
+
+/**
+**  Stop the receive thread.
+*/
+void CNetworkReceiver::Stop()
+{
+	if (thread) {
+		quit = true;
+		SDL_WaitThread(thread, NULL);
+		thread = NULL;
+	}
+	if (ready) {
+		SDL_DestroySemaphore(ready);
+		ready = NULL;
+	}
+	socket = NULL;
+}
+
+/**
+**  Wait for a packet.
+**
+**  Returns as soon as a packet is queued, so the caller can sleep until
+**  the end of its frame without delaying the packets.
+**
+**  @param timeout  Maximum time to wait in ms.
+*/
+void CNetworkReceiver::Wait(unsigned int timeout)
+{
+	const Uint32 start = SDL_GetTicks();
+
+	while (!HasPacket()) {
+		const Uint32 elapsed = SDL_GetTicks() - start;
+		// A post can be left by a packet popped before it was posted.
+		if (elapsed >= timeout || SDL_SemWaitTimeout(ready, timeout - elapsed) != 0) {
+			return;
+		}
+	}
+}
+
+/**
+**  Take the oldest received packet.
+**
+**  @param buf      Buffer for the packet.
+**  @param bufSize  Size of buf.
+**  @param len      Set to the length of the packet (-1 on receive error).
+**  @param host     Set to the sender of the packet.
+**
+**  @return false if no packet is waiting.
+*/
+bool CNetworkReceiver::Pop(unsigned char *buf, int bufSize, int *len, CHost *host)
+{
+	const unsigned int index = tail.load(std::memory_order_relaxed);
+	if (index == head.load(std::memory_order_acquire)) {
+		return false;
+	}
+	const Packet &packet = Queue[index % QueueSize];
+	*len = std::min(packet.Length, bufSize);
+	if (*len > 0) {
+		memcpy(buf, &packet.Data[0], *len);
+	}
+	*host = packet.Host;
+	tail.store(index + 1, std::memory_order_release);
+	// Consume the post of the packet, unless a Wait already did, so
+	// ready never counts more than the queued packets.
+	SDL_SemTryWait(ready);
+	return true;
+}
+
+int CNetworkReceiver::ThreadMain(void *data)
+{
+	static_cast<CNetworkReceiver *>(data)->Run();
+	return 0;
+}
+
+/**
+**  Receive loop of the thread.
+*/
+void CNetworkReceiver::Run()
+{
+	// The timeout only bounds the time needed to see quit.
+	const int timeout = 100;
+
+	while (!quit.load(std::memory_order_relaxed)) {
+		const unsigned int index = head.load(std::memory_order_relaxed);
+		if (index - tail.load(std::memory_order_acquire) == QueueSize) {
+			// Game thread is late: let the packets wait in the socket.
+			SDL_Delay(1);
+			continue;
+		}
+		if (socket->HasDataToRead(timeout) <= 0) {
+			continue;
+		}
+		Packet &packet = Queue[index % QueueSize];
+		packet.Length = socket->Recv(&packet.Data[0], packet.Data.size(), &packet.Host);
+		head.store(index + 1, std::memory_order_release);
+		SDL_SemPost(ready);
+	}
+}
+
+//@}
@@ -40,6 +40,12 @@
 
 #include <stdio.h>
 
+#ifdef HAVE_EPOLL
+#include <errno.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
 //
 // CHost
 //
@@ -69,10 +75,10 @@ bool CHost::isValid() const
 class CUDPSocket_Impl
 {
 public:
-	CUDPSocket_Impl() : socket(Socket(-1)) {}
+	CUDPSocket_Impl() : socket(Socket(-1)), epollfd(-1) {}
 	~CUDPSocket_Impl() { if (IsValid()) { Close(); } }
-	bool Open(const CHost &host) { socket = NetOpenUDP(host.getIp(), host.getPort()); return socket != INVALID_SOCKET; }
-	void Close() { NetCloseUDP(socket); socket = Socket(-1); }
+	bool Open(const CHost &host);
+	void Close();
 	void Send(const CHost &host, const void *buf, unsigned int len) { NetSendUDP(socket, host.getIp(), host.getPort(), buf, len); }
 	int Recv(void *buf, int len, CHost *hostFrom)
 	{
@@ -83,13 +89,64 @@ public:
 		return res;
 	}
 	void SetNonBlocking() { NetSetNonBlocking(socket); }
-	int HasDataToRead(int timeout) { return NetSocketReady(socket, timeout); }
+	int HasDataToRead(int timeout);
 	bool IsValid() const { return socket != Socket(-1); }
 	int GetSocketAddresses(unsigned long *ips, int maxAddr) { return NetSocketAddr(socket, ips, maxAddr); }
 private:
 	Socket socket;
+	int epollfd; /// epoll instance watching socket (-1 without epoll)
 };
 
+bool CUDPSocket_Impl::Open(const CHost &host)
+{
+	socket = NetOpenUDP(host.getIp(), host.getPort());
+	if (socket == INVALID_SOCKET) {
+		return false;
+	}
+#ifdef HAVE_EPOLL
+	// The socket is waited on every frame, so register it once.
+	epollfd = epoll_create(1);
+	if (epollfd != -1) {
+		struct epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.fd = socket;
+		if (epoll_ctl(epollfd, EPOLL_CTL_ADD, socket, &event) == -1) {
+			close(epollfd);
+			epollfd = -1;
+		}
+	}
+#endif
+	return true;
+}
+
+void CUDPSocket_Impl::Close()
+{
+#ifdef HAVE_EPOLL
+	if (epollfd != -1) {
+		close(epollfd);
+		epollfd = -1;
+	}
+#endif
+	NetCloseUDP(socket);
+	socket = Socket(-1);
+}
+
+int CUDPSocket_Impl::HasDataToRead(int timeout)
+{
+#ifdef HAVE_EPOLL
+	if (epollfd != -1) {
+		struct epoll_event event;
+		int retval;
+		do {
+			retval = epoll_wait(epollfd, &event, 1, timeout);
+		} while (retval == -1 && errno == EINTR);
+		return retval;
+	}
+#endif
+	return NetSocketReady(socket, timeout);
+}
+
 //
 // CUDPSocket
 //
@@ -117,6 +117,10 @@
 ** per packet. Sending it to 7 other players, gives 840 bytes per update.
 ** This means we could do 6 updates (each 166ms) per second (6*840=5040 bytes/s).
 **
+** The same order given to a selection is sent as one group command:
+** the target is sent once and the unit numbers are delta encoded as
+** varints, which is about one byte per unit.
+**
 ** @subsection a_packet Network packet
 **
 ** @li [IP  Header - 20 bytes]
@@ -146,6 +150,30 @@
 ** If there are missing packages, the game is paused and old commands
 ** are resend to all clients.
 **
+** @subsection lag Adaptive lag
+**
+** The sync packages carry the clock of the sender and echo the clock
+** received from one other player, which gives the round trip time and its
+** jitter to each player. The server computes the lag needed from the worst
+** of them (and from its own stalls) and sends the new lag as a command.
+** So all computers change the lag in the same game cycle: when it grows,
+** the cycles in between are filled with syncs, when it shrinks, the cycles
+** already sent are not sent again.
+**
+** @subsection receiver Receive thread
+**
+** During the game a thread waits on the socket (with epoll on Linux) and
+** queues each packet as soon as it arrives. The queue has one producer and
+** one consumer, so it is lock free. WaitEventsOneFrame() sleeps until a
+** packet is queued or the frame is over, instead of polling the socket.
+**
+** @subsection synchashes Detailed sync hashes
+**
+** With sync debugging enabled (-y), each update also carries a hash per
+** subsystem (see synchash.cpp). The first subsystem which differs is
+** dumped into a log file, so the desync can be found by comparing the
+** logs of two players.
+**
 ** @section missing What features are missing
 **
 ** @li The recover from lost packets can be improved, as the player knows
@@ -156,8 +184,7 @@
 **
 ** @li Add a server/client protocol, which allows more players per game.
 **
-** @li Lag (latency) and bandwidth should be automatic detected during game setup
-** and later during game automatic adapted.
+** @li Bandwidth should be automatic detected during game setup.
 **
 ** @li Also it would be nice, if we support viewing clients. This means
 ** other people can view the game in progress.
@@ -233,10 +260,12 @@
 #include "net_lowlevel.h"
 #include "net_message.h"
 #include "netconnect.h"
+#include "network/netreceiver.h"
 #include "parameters.h"
 #include "player.h"
 #include "replay.h"
 #include "sound.h"
+#include "synchash.h"
 #include "translate.h"
 #include "unit.h"
 #include "unit_manager.h"
@@ -269,6 +298,51 @@ public:
 	std::vector<unsigned char> Data;  /// command content (network format)
 };
 
+/**
+**  Round trip time measurement of a remote player.
+**
+**  Each sync message carries the clock of its sender and echoes the
+**  clock of one other player, so every player measures the round trip
+**  time to the others without extra packets.
+*/
+class CNetworkRoundTrip
+{
+public:
+	CNetworkRoundTrip() { Clear(); }
+	void Clear()
+	{
+		srtt = rttvar = 0;
+		samples = 0;
+		lastPingTime = 0;
+		lastPingTicks = 0;
+		lastPingCycle = 0;
+	}
+
+	/// Add a round trip time sample (smoothed as for TCP, RFC 6298)
+	void AddSample(unsigned int rtt)
+	{
+		if (samples == 0) {
+			srtt = rtt;
+			rttvar = rtt / 2;
+		} else {
+			const unsigned int delta = srtt > rtt ? srtt - rtt : rtt - srtt;
+			rttvar = (3 * rttvar + delta) / 4;
+			srtt = (7 * srtt + rtt) / 8;
+		}
+		++samples;
+	}
+	/// Time needed to safely deliver a packet, in ms
+	unsigned int GetDelay() const { return srtt + 4 * rttvar; }
+
+public:
+	unsigned int srtt;           /// Smoothed round trip time in ms
+	unsigned int rttvar;         /// Round trip time variation (jitter) in ms
+	unsigned int samples;        /// Number of samples
+	uint16_t lastPingTime;       /// Last clock received from this player
+	uint32_t lastPingTicks;      /// Local time when lastPingTime was received
+	unsigned long lastPingCycle; /// Cycle of the packet with lastPingTime
+};
+
 //----------------------------------------------------------------------------
 //  Variables
 //----------------------------------------------------------------------------
@@ -282,23 +356,27 @@ CNetworkParameter::CNetworkParameter()
 	gameCyclesPerUpdate = 1;
 	NetworkLag = 10;
 	timeoutInS = 45;
+	adaptiveLag = true;
 }
 
 void CNetworkParameter::FixValues()
 {
 	gameCyclesPerUpdate = std::max(gameCyclesPerUpdate, 1u);
 	NetworkLag = std::max(NetworkLag, 2u * gameCyclesPerUpdate);
+	NetworkLag = std::min(NetworkLag, maxNetworkLag);
 }
 
 bool NetworkInSync = true;                 /// Network is in sync
 
 CUDPSocket NetworkFildes;                  /// Network file descriptor
+static CNetworkReceiver NetworkReceiver;   /// Receive thread during the game
 
 static unsigned long NetworkLastFrame[PlayerMax]; /// Last frame received packet
 static unsigned long NetworkLastCycle[PlayerMax]; /// Last cycle received packet
 
 static int NetworkSyncSeeds[256];          /// Network sync seeds.
 static int NetworkSyncHashs[256];          /// Network sync hashs.
+static CSyncHashes NetworkSyncDetails[256]; /// Network detailed sync hashes.
 static CNetworkCommandQueue NetworkIn[256][PlayerMax][MaxNetworkCommands]; /// Per-player network packet input queue
 static std::deque<CNetworkCommandQueue> CommandsIn;    /// Network command input queue
 static std::deque<CNetworkCommandQueue> MsgCommandsIn; /// Network message input queue
@@ -337,6 +415,15 @@ static CNetworkStat NetworkStat;
 
 static int PlayerQuit[PlayerMax];          /// Player quit
 
+static CNetworkRoundTrip NetworkRoundTrip[PlayerMax]; /// Round trip time to each player
+static unsigned long NetworkLastSentCycle;  /// Last gameNetCycle sent to the others
+static int NetworkPongIndex;                /// Host index of the next echoed ping
+
+static bool NetworkLagChangePending;        /// Server: lag change sent but not executed
+static unsigned long NetworkLagCheckCycle;  /// Server: last cycle the lag was checked
+static int NetworkLagLowerVotes;            /// Server: checks in a row which allow a lower lag
+static unsigned int NetworkStallCount;      /// Server: number of recovers since last check
+
 //----------------------------------------------------------------------------
 //  Mid-Level api functions
 //----------------------------------------------------------------------------
@@ -349,8 +436,13 @@ static int PlayerQuit[PlayerMax];          /// Player quit
 */
 static void NetworkBroadcast(const CNetworkPacket &packet, int numcommands, int player = 255)
 {
+	static std::vector<unsigned char> sendBuffer(MaxNetworkPacketSize);
+
 	const unsigned int size = packet.Size(numcommands);
-	unsigned char *buf = new unsigned char[size];
+	if (sendBuffer.size() < size) {
+		sendBuffer.resize(size);
+	}
+	unsigned char *buf = &sendBuffer[0];
 	packet.Serialize(buf, numcommands);
 
 	// Send to all clients.
@@ -366,7 +458,6 @@ static void NetworkBroadcast(const CNetworkPacket &packet, int numcommands, int
 		const CHost host(Hosts[HostsCount - 1].Host, Hosts[HostsCount - 1].Port);
 		NetworkFildes.Send(host, buf, size);
 	}
-	delete[] buf;
 }
 
 /**
@@ -376,7 +467,8 @@ static void NetworkBroadcast(const CNetworkPacket &packet, int numcommands, int
 */
 static void NetworkSendPacket(const CNetworkCommandQueue(&ncq)[MaxNetworkCommands])
 {
-	CNetworkPacket packet;
+	// Kept between calls so that the command buffers are reused.
+	static CNetworkPacket packet;
 
 	// Build packet of up to MaxNetworkCommands messages.
 	int numcommands = 0;
@@ -390,6 +482,7 @@ static void NetworkSendPacket(const CNetworkCommandQueue(&ncq)[MaxNetworkCommand
 	}
 	for (; i < MaxNetworkCommands; ++i) {
 		packet.Header.Type[i] = MessageNone;
+		packet.Command[i].clear();
 	}
 	NetworkBroadcast(packet, numcommands);
 }
@@ -444,6 +537,8 @@ void ExitNetwork1()
 		return;
 	}
 
+	NetworkReceiver.Stop();
+
 #ifdef DEBUG
 	printStatistic(NetworkFildes.getStatistic());
 	NetworkFildes.clearStatistic();
@@ -474,6 +569,10 @@ void NetworkOnStartGame()
 	NetworkInSync = true;
 	CommandsIn.clear();
 	MsgCommandsIn.clear();
+	// The setup messages are read synchronously, the game ones by the thread.
+	if (!NetworkReceiver.Start(NetworkFildes, MaxNetworkPacketSize)) {
+		DebugPrint("Network receive thread not started, polling the socket\n");
+	}
 	// Prepare first time without syncs.
 	for (int i = 0; i != 256; ++i) {
 		for (int p = 0; p != PlayerMax; ++p) {
@@ -500,9 +599,21 @@ void NetworkOnStartGame()
 	}
 	memset(NetworkSyncSeeds, 0, sizeof(NetworkSyncSeeds));
 	memset(NetworkSyncHashs, 0, sizeof(NetworkSyncHashs));
+	for (int i = 0; i != 256; ++i) {
+		NetworkSyncDetails[i].Clear();
+	}
 	memset(PlayerQuit, 0, sizeof(PlayerQuit));
 	memset(NetworkLastFrame, 0, sizeof(NetworkLastFrame));
 	memset(NetworkLastCycle, 0, sizeof(NetworkLastCycle));
+	for (int i = 0; i != PlayerMax; ++i) {
+		NetworkRoundTrip[i].Clear();
+	}
+	NetworkLastSentCycle = 0;
+	NetworkPongIndex = 0;
+	NetworkLagChangePending = false;
+	NetworkLagCheckCycle = 0;
+	NetworkLagLowerVotes = 0;
+	NetworkStallCount = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -721,11 +832,8 @@ static void ParseResendCommand(const CNetworkPacket &packet)
 	}
 }
 
-static bool IsAValidCommand_Command(const CNetworkPacket &packet, int index, const int player)
+static bool IsAValidCommand_Unit(unsigned int slot, const int player)
 {
-	CNetworkCommand nc;
-	nc.Deserialize(&packet.Command[index][0]);
-	const unsigned int slot = nc.Unit;
 	const CUnit *unit = slot < UnitManager.GetUsedSlotCount() ? &UnitManager.GetSlotUnit(slot) : NULL;
 
 	if (unit && (unit->Player->Index == player
@@ -736,17 +844,51 @@ static bool IsAValidCommand_Command(const CNetworkPacket &packet, int index, con
 	}
 }
 
-static bool IsAValidCommand_Dismiss(const CNetworkPacket &packet, int index, const int player)
+static bool IsAValidCommand_DismissUnit(unsigned int slot, const int player)
 {
-	CNetworkCommand nc;
-	nc.Deserialize(&packet.Command[index][0]);
-	const unsigned int slot = nc.Unit;
 	const CUnit *unit = slot < UnitManager.GetUsedSlotCount() ? &UnitManager.GetSlotUnit(slot) : NULL;
 
 	if (unit && unit->Type->ClicksToExplode) {
 		return true;
 	}
-	return IsAValidCommand_Command(packet, index, player);
+	return IsAValidCommand_Unit(slot, player);
+}
+
+static bool IsAValidCommand_Command(const CNetworkPacket &packet, int index, const int player)
+{
+	CNetworkCommand nc;
+	nc.Deserialize(&packet.Command[index][0]);
+	return IsAValidCommand_Unit(nc.Unit, player);
+}
+
+static bool IsAValidCommand_Dismiss(const CNetworkPacket &packet, int index, const int player)
+{
+	CNetworkCommand nc;
+	nc.Deserialize(&packet.Command[index][0]);
+	return IsAValidCommand_DismissUnit(nc.Unit, player);
+}
+
+static bool IsAValidCommand_Group(const CNetworkPacket &packet, int index, const int player)
+{
+	const std::vector<unsigned char> &command = packet.Command[index];
+	CNetworkGroupCommand ngc;
+	if (command.empty() || ngc.Deserialize(&command[0], command.size()) == 0) {
+		return false;
+	}
+	const unsigned char type = ngc.Type & 0x7F;
+
+	if (type < MessageCommandStop || type == MessageExtendedCommand || type == MessageCommandGroup) {
+		return false;
+	}
+	for (size_t i = 0; i != ngc.Units.size(); ++i) {
+		const bool valid = type == MessageCommandDismiss
+						   ? IsAValidCommand_DismissUnit(ngc.Units[i], player)
+						   : IsAValidCommand_Unit(ngc.Units[i], player);
+		if (!valid) {
+			return false;
+		}
+	}
+	return true;
 }
 
 static bool IsAValidCommand(const CNetworkPacket &packet, int index, const int player)
@@ -754,17 +896,70 @@ static bool IsAValidCommand(const CNetworkPacket &packet, int index, const int p
 	switch (packet.Header.Type[index] & 0x7F) {
 		case MessageExtendedCommand: // FIXME: ensure the sender is part of the command
 		case MessageSync: // Sync does not matter
+		case MessageSyncHashes: // Sync does not matter
 		case MessageSelection: // FIXME: ensure it's from the right player
 		case MessageQuit:      // FIXME: ensure it's from the right player
 		case MessageResend:    // FIXME: ensure it's from the right player
 		case MessageChat:      // FIXME: ensure it's from the right player
 			return true;
+		case MessageNetworkLag: // Only the server decides the lag
+			return NetConnectType == 2 && HostsCount > 0 && Hosts[HostsCount - 1].PlyNr == player;
 		case MessageCommandDismiss: return IsAValidCommand_Dismiss(packet, index, player);
+		case MessageCommandGroup: return IsAValidCommand_Group(packet, index, player);
 		default: return IsAValidCommand_Command(packet, index, player);
 	}
 	// FIXME: not all values in nc have been validated
 }
 
+/**
+**  Take the ping information of a received sync message.
+**
+**  @param player  Player who sent the message.
+**  @param cycle   Destination cycle of the packet.
+**  @param nc      Sync message.
+*/
+static void NetworkReceivePing(int player, unsigned long cycle, const CNetworkCommandSync &nc)
+{
+	CNetworkRoundTrip &roundTrip = NetworkRoundTrip[player];
+
+	// Resent packets carry an old clock.
+	if (cycle <= roundTrip.lastPingCycle) {
+		return;
+	}
+	const uint32_t ticks = SDL_GetTicks();
+	roundTrip.lastPingCycle = cycle;
+	roundTrip.lastPingTime = nc.pingTime;
+	roundTrip.lastPingTicks = ticks;
+	if (nc.pongPlayer == ThisPlayer->Index) {
+		roundTrip.AddSample(uint16_t(ticks - nc.pongTime));
+	}
+}
+
+/**
+**  Fill the ping information of a sync message to send.
+**
+**  @param nc  Sync message.
+*/
+static void NetworkSendPing(CNetworkCommandSync &nc)
+{
+	const uint32_t ticks = SDL_GetTicks();
+
+	nc.pingTime = uint16_t(ticks);
+	nc.pongPlayer = 255;
+	// Echo the players in turn.
+	for (int i = 0; i != HostsCount; ++i) {
+		NetworkPongIndex = (NetworkPongIndex + 1) % HostsCount;
+		const int player = Hosts[NetworkPongIndex].PlyNr;
+		const CNetworkRoundTrip &roundTrip = NetworkRoundTrip[player];
+
+		if (player != ThisPlayer->Index && roundTrip.lastPingTicks != 0) {
+			nc.pongPlayer = player;
+			nc.pongTime = uint16_t(roundTrip.lastPingTime + (ticks - roundTrip.lastPingTicks));
+			break;
+		}
+	}
+}
+
 static void NetworkParseInGameEvent(const unsigned char *buf, int len, const CHost &host)
 {
 	CNetworkPacket packet;
@@ -820,6 +1015,11 @@ static void NetworkParseInGameEvent(const unsigned char *buf, int len, const CHo
 			if (n > GameCycle + 128) {
 				n -= 0x100;
 			}
+			if (packet.Header.Type[i] == MessageSync) {
+				CNetworkCommandSync nc;
+				nc.Deserialize(&packet.Command[i][0]);
+				NetworkReceivePing(player, n, nc);
+			}
 			NetworkIn[packet.Header.Cycle][player][i].Time = n;
 			NetworkIn[packet.Header.Cycle][player][i].Type = packet.Header.Type[i];
 			NetworkIn[packet.Header.Cycle][player][i].Data = packet.Command[i];
@@ -842,6 +1042,39 @@ static void NetworkParseInGameEvent(const unsigned char *buf, int len, const CHo
 	}
 }
 
+/**
+**  Game ended: stop the receive thread.
+*/
+void NetworkOnEndGame()
+{
+	NetworkReceiver.Stop();
+}
+
+/**
+**  Check if a network packet is waiting.
+*/
+bool NetworkHasDataToRead()
+{
+	if (NetworkReceiver.IsRunning()) {
+		return NetworkReceiver.HasPacket();
+	}
+	return NetworkFildes.HasDataToRead(0) > 0;
+}
+
+/**
+**  Wait for a network packet.
+**
+**  @param timeout  Maximum time to wait in ms.
+*/
+void NetworkWaitData(unsigned int timeout)
+{
+	if (NetworkReceiver.IsRunning()) {
+		NetworkReceiver.Wait(timeout);
+	} else {
+		NetworkFildes.HasDataToRead(timeout);
+	}
+}
+
 /**
 **  Called if message for the network is ready.
 **  (by WaitEventsOneFrame)
@@ -853,9 +1086,16 @@ void NetworkEvent()
 		return;
 	}
 	// Read the packet.
-	unsigned char buf[1024];
+	unsigned char buf[MaxNetworkPacketSize];
 	CHost host;
-	int len = NetworkFildes.Recv(&buf, sizeof(buf), &host);
+	int len;
+	if (NetworkReceiver.IsRunning()) {
+		if (!NetworkReceiver.Pop(buf, sizeof(buf), &len, &host)) {
+			return;
+		}
+	} else {
+		len = NetworkFildes.Recv(&buf, sizeof(buf), &host);
+	}
 	if (len < 0) {
 		DebugPrint("Server/Client gone?\n");
 		// just hope for an automatic recover right now..
@@ -920,6 +1160,59 @@ static void NetworkExecCommand_Sync(const CNetworkCommandQueue &ncq)
 	}
 }
 
+/**
+**  Compare the detailed sync hashes of another player with ours.
+*/
+static void NetworkExecCommand_SyncHashes(const CNetworkCommandQueue &ncq)
+{
+	Assert((ncq.Type & 0x7F) == MessageSyncHashes);
+
+	if (!EnableSyncDebug) {
+		return;
+	}
+	CNetworkCommandSyncHashes nc;
+	nc.Deserialize(&ncq.Data[0]);
+	const unsigned long gameNetCycle = GameCycle;
+	const CSyncHashes &local = NetworkSyncDetails[gameNetCycle & 0xFF];
+
+	if (nc.hashes != local) {
+		SyncHashesMismatch(gameNetCycle, nc.player, local, nc.hashes);
+	}
+}
+
+static void NetworkSendCommands(unsigned long gameNetCycle);
+
+/**
+**  Execute a network lag change.
+**
+**  All players execute it in the same game cycle, so the same syncs are
+**  sent everywhere when the lag grows.
+*/
+static void NetworkExecCommand_Lag(const CNetworkCommandQueue &ncq)
+{
+	Assert((ncq.Type & 0x7F) == MessageNetworkLag);
+
+	CNetworkCommandLag nc;
+	nc.Deserialize(&ncq.Data[0]);
+	const unsigned int gameCyclesPerUpdate = CNetworkParameter::Instance.gameCyclesPerUpdate;
+	const unsigned int networkLag = std::min<unsigned int>(nc.networkLag, CNetworkParameter::maxNetworkLag);
+
+	if (networkLag < 2 * gameCyclesPerUpdate || networkLag % gameCyclesPerUpdate) {
+		DebugPrint("Bad network lag %d\n" _C_ networkLag);
+		return;
+	}
+	DebugPrint("Network lag %d -> %d (cycle %lu)\n" _C_
+			   CNetworkParameter::Instance.NetworkLag _C_ networkLag _C_ GameCycle);
+	CNetworkParameter::Instance.NetworkLag = networkLag;
+	NetworkLagChangePending = false;
+	// Cycles between the old and the new lag are never sent otherwise.
+	// When the lag is lowered, the already sent cycles are skipped.
+	for (unsigned long cycle = NetworkLastSentCycle + gameCyclesPerUpdate;
+		 cycle <= GameCycle + networkLag; cycle += gameCyclesPerUpdate) {
+		NetworkSendCommands(cycle);
+	}
+}
+
 static void NetworkExecCommand_Selection(const CNetworkCommandQueue &ncq)
 {
 	Assert((ncq.Type & 0x7F) == MessageSelection);
@@ -979,6 +1272,19 @@ static void NetworkExecCommand_Command(const CNetworkCommandQueue &ncq)
 	ExecCommand(ncq.Type, nc.Unit, nc.X, nc.Y, nc.Dest);
 }
 
+static void NetworkExecCommand_Group(const CNetworkCommandQueue &ncq)
+{
+	Assert((ncq.Type & 0x7F) == MessageCommandGroup);
+	CNetworkGroupCommand ngc;
+
+	if (ncq.Data.empty() || ngc.Deserialize(&ncq.Data[0], ncq.Data.size()) == 0) {
+		return;
+	}
+	for (size_t i = 0; i != ngc.Units.size(); ++i) {
+		ExecCommand(ngc.Type, ngc.Units[i], ngc.X, ngc.Y, ngc.Dest);
+	}
+}
+
 /**
 **  Execute a network command.
 **
@@ -988,10 +1294,13 @@ static void NetworkExecCommand(const CNetworkCommandQueue &ncq)
 {
 	switch (ncq.Type & 0x7F) {
 		case MessageSync: NetworkExecCommand_Sync(ncq); break;
+		case MessageSyncHashes: NetworkExecCommand_SyncHashes(ncq); break;
 		case MessageSelection: NetworkExecCommand_Selection(ncq); break;
 		case MessageChat: NetworkExecCommand_Chat(ncq); break;
 		case MessageQuit: NetworkExecCommand_Quit(ncq); break;
+		case MessageNetworkLag: NetworkExecCommand_Lag(ncq); break;
 		case MessageExtendedCommand: NetworkExecCommand_ExtendedCommand(ncq); break;
+		case MessageCommandGroup: NetworkExecCommand_Group(ncq); break;
 		case MessageNone:
 			// Nothing to Do, This Message Should Never be Executed
 			Assert(0);
@@ -1000,6 +1309,55 @@ static void NetworkExecCommand(const CNetworkCommandQueue &ncq)
 	}
 }
 
+/**
+**  Build the next command to send from the command input queue.
+**
+**  Consecutive unit commands which only differ by the unit are merged
+**  into one group command, so big selections are sent in one update.
+**
+**  @param ncq  Filled with the command to send.
+**
+**  @return number of commands of the input queue used by ncq.
+*/
+static size_t NetworkPeekCommand(CNetworkCommandQueue &ncq)
+{
+	const CNetworkCommandQueue &first = CommandsIn.front();
+	const unsigned char type = first.Type & 0x7F;
+
+	ncq = first;
+	if (type < MessageCommandStop || type == MessageExtendedCommand) {
+		return 1;
+	}
+	CNetworkCommand nc;
+	nc.Deserialize(&first.Data[0]);
+
+	CNetworkGroupCommand ngc;
+	ngc.Type = first.Type;
+	ngc.X = nc.X;
+	ngc.Y = nc.Y;
+	ngc.Dest = nc.Dest;
+	ngc.Units.push_back(nc.Unit);
+	for (size_t i = 1; i < CommandsIn.size() && ngc.Units.size() < MaxNetworkGroupUnits; ++i) {
+		const CNetworkCommandQueue &next = CommandsIn[i];
+		if (next.Type != first.Type) {
+			break;
+		}
+		CNetworkCommand nextnc;
+		nextnc.Deserialize(&next.Data[0]);
+		if (nextnc.X != nc.X || nextnc.Y != nc.Y || nextnc.Dest != nc.Dest) {
+			break;
+		}
+		ngc.Units.push_back(nextnc.Unit);
+	}
+	if (ngc.Units.size() == 1) {
+		return 1;
+	}
+	ncq.Type = MessageCommandGroup;
+	ncq.Data.resize(ngc.Size());
+	ngc.Serialize(&ncq.Data[0]);
+	return ngc.Units.size();
+}
+
 /**
 **  Network send commands.
 */
@@ -1007,6 +1365,8 @@ static void NetworkSendCommands(unsigned long gameNetCycle)
 {
 	// No command available, send sync.
 	int numcommands = 0;
+	// Keep one command for the detailed sync hashes.
+	const int maxcommands = EnableSyncDebug ? MaxNetworkCommands - 1 : MaxNetworkCommands;
 	CNetworkCommandQueue(&ncq)[MaxNetworkCommands] = NetworkIn[gameNetCycle & 0xFF][ThisPlayer->Index];
 	ncq[0].Clear();
 	if (CommandsIn.empty() && MsgCommandsIn.empty()) {
@@ -1014,15 +1374,22 @@ static void NetworkSendCommands(unsigned long gameNetCycle)
 		ncq[0].Type = MessageSync;
 		nc.syncHash = SyncHash;
 		nc.syncSeed = SyncRandSeed;
+		NetworkSendPing(nc);
 		ncq[0].Data.resize(nc.Size());
 		nc.Serialize(&ncq[0].Data[0]);
 		ncq[0].Time = gameNetCycle;
 		numcommands = 1;
 	} else {
-		while (!CommandsIn.empty() && numcommands < MaxNetworkCommands) {
-			const CNetworkCommandQueue &incommand = CommandsIn.front();
+		size_t packetSize = CNetworkPacketHeader::Size();
+		if (EnableSyncDebug) {
+			packetSize += CNetworkCommandSyncHashes::Size() + 5;
+		}
+
+		while (!CommandsIn.empty() && numcommands < maxcommands) {
 #ifdef DEBUG
-			if (incommand.Type != MessageExtendedCommand) {
+			const CNetworkCommandQueue &incommand = CommandsIn.front();
+			if (incommand.Type >= MessageCommandStop
+				&& incommand.Type != MessageExtendedCommand && incommand.Type != MessageCommandGroup) {
 				CNetworkCommand nc;
 				nc.Deserialize(&incommand.Data[0]);
 
@@ -1033,27 +1400,118 @@ static void NetworkSendCommands(unsigned long gameNetCycle)
 				}
 			}
 #endif
-			ncq[numcommands] = incommand;
+			const size_t used = NetworkPeekCommand(ncq[numcommands]);
+			const size_t commandSize = CNetworkPacket::CommandSize(ncq[numcommands].Data);
+			if (numcommands != 0 && packetSize + commandSize > MaxNetworkPacketSize) {
+				break;
+			}
+			packetSize += commandSize;
 			ncq[numcommands].Time = gameNetCycle;
 			++numcommands;
-			CommandsIn.pop_front();
+			CommandsIn.erase(CommandsIn.begin(), CommandsIn.begin() + used);
 		}
-		while (!MsgCommandsIn.empty() && numcommands < MaxNetworkCommands) {
+		while (!MsgCommandsIn.empty() && numcommands < maxcommands) {
 			const CNetworkCommandQueue &incommand = MsgCommandsIn.front();
+			const size_t commandSize = CNetworkPacket::CommandSize(incommand.Data);
+			if (numcommands != 0 && packetSize + commandSize > MaxNetworkPacketSize) {
+				break;
+			}
+			packetSize += commandSize;
 			ncq[numcommands] = incommand;
 			ncq[numcommands].Time = gameNetCycle;
 			++numcommands;
 			MsgCommandsIn.pop_front();
 		}
 	}
+	if (EnableSyncDebug) {
+		CNetworkCommandSyncHashes nc;
+		nc.player = ThisPlayer->Index;
+		nc.hashes = SyncHashes;
+		ncq[numcommands].Type = MessageSyncHashes;
+		ncq[numcommands].Data.resize(nc.Size());
+		nc.Serialize(&ncq[numcommands].Data[0]);
+		ncq[numcommands].Time = gameNetCycle;
+		++numcommands;
+	}
 	if (numcommands != MaxNetworkCommands) {
 		ncq[numcommands].Type = MessageNone;
 	}
 	NetworkSyncSeeds[gameNetCycle & 0xFF] = SyncRandSeed;
 	NetworkSyncHashs[gameNetCycle & 0xFF] = SyncHash;
+	NetworkSyncDetails[gameNetCycle & 0xFF] = SyncHashes;
+	NetworkLastSentCycle = gameNetCycle;
 	NetworkSendPacket(ncq);
 }
 
+/**
+**  Server: adapt the network lag to the measured round trip times.
+**
+**  The new lag is sent as a command, so all players change it in the same
+**  game cycle. The lag grows as soon as needed, but is lowered step by
+**  step only when the connection has been good for some time.
+**
+**  @param gameNetCycle  Current game cycle.
+*/
+static void NetworkAdaptLag(unsigned long gameNetCycle)
+{
+	if (!CNetworkParameter::Instance.adaptiveLag || NetConnectType != 1 || NetworkLagChangePending) {
+		return;
+	}
+	if (gameNetCycle < NetworkLagCheckCycle + 2 * CYCLES_PER_SECOND) {
+		return;
+	}
+	NetworkLagCheckCycle = gameNetCycle;
+
+	unsigned int delay = 0;
+	bool measured = false;
+	for (int i = 0; i != HostsCount; ++i) {
+		const CNetworkRoundTrip &roundTrip = NetworkRoundTrip[Hosts[i].PlyNr];
+		if (Hosts[i].PlyNr == ThisPlayer->Index || roundTrip.samples == 0) {
+			continue;
+		}
+		// Clients talk to each other through the server,
+		// so the worst path is about one round trip.
+		delay = std::max(delay, roundTrip.GetDelay());
+		measured = true;
+	}
+	if (!measured) {
+		return;
+	}
+	const unsigned int gameCyclesPerUpdate = CNetworkParameter::Instance.gameCyclesPerUpdate;
+	const unsigned int currentLag = CNetworkParameter::Instance.NetworkLag;
+	const unsigned int cyclesPerSecond = std::max(CYCLES_PER_SECOND * VideoSyncSpeed / 100, 1);
+	// One more update for the time between reception and execution.
+	unsigned int lag = (delay * cyclesPerSecond + 999) / 1000 + gameCyclesPerUpdate;
+
+	if (NetworkStallCount != 0) {
+		lag = std::max(lag, currentLag + gameCyclesPerUpdate);
+	}
+	NetworkStallCount = 0;
+	lag = (lag + gameCyclesPerUpdate - 1) / gameCyclesPerUpdate * gameCyclesPerUpdate;
+	lag = std::max(lag, 2 * gameCyclesPerUpdate);
+	lag = std::min(lag, CNetworkParameter::maxNetworkLag / gameCyclesPerUpdate * gameCyclesPerUpdate);
+
+	if (lag < currentLag) {
+		if (++NetworkLagLowerVotes < 3) {
+			return;
+		}
+		lag = currentLag - gameCyclesPerUpdate;
+	} else if (lag == currentLag) {
+		NetworkLagLowerVotes = 0;
+		return;
+	}
+	NetworkLagLowerVotes = 0;
+
+	CNetworkCommandLag nc;
+	nc.networkLag = lag;
+	CNetworkCommandQueue ncq;
+	ncq.Type = MessageNetworkLag;
+	ncq.Data.resize(nc.Size());
+	nc.Serialize(&ncq.Data[0]);
+	CommandsIn.push_front(ncq);
+	NetworkLagChangePending = true;
+}
+
 /**
 **  Network execute commands.
 */
@@ -1086,8 +1544,13 @@ void NetworkCommands()
 		return;
 	}
 	const unsigned long gameNetCycle = GameCycle;
+	NetworkAdaptLag(gameNetCycle);
 	// Send messages to all clients (other players)
-	NetworkSendCommands(gameNetCycle + CNetworkParameter::Instance.NetworkLag);
+	// After the lag was lowered, the next cycles are already sent.
+	const unsigned long sendCycle = gameNetCycle + CNetworkParameter::Instance.NetworkLag;
+	if (sendCycle > NetworkLastSentCycle) {
+		NetworkSendCommands(sendCycle);
+	}
 	NetworkExecCommands(gameNetCycle);
 	NetworkInSync = IsNetworkCommandReady(gameNetCycle + CNetworkParameter::Instance.gameCyclesPerUpdate);
 }
@@ -1164,6 +1627,7 @@ void NetworkRecover()
 	if (FrameCounter % CNetworkParameter::Instance.gameCyclesPerUpdate != 0) {
 		return;
 	}
+	++NetworkStallCount;
 	for (int i = 0; i != HostsCount; ++i) {
 		CheckPlayerThatTimeOut(i);
 	}
@@ -49,6 +49,17 @@ void GraphicAnimation::draw(int x, int y)
 {
 	if (!isFinished()) {
 		g->DrawFrameClip(currentFrame, x - g->Width / 2, y - g->Height / 2);
+#if defined(USE_OPENGL) || defined(USE_GLES)
+		if (!UseOpenGL)
+#endif
+		{
+			const CViewport *vp = ParticleManager.getViewport();
+			uint64_t key = DrawnAreaKey(uint64_t(x), uint64_t(y));
+			key = DrawnAreaKey(key, uint64_t(currentFrame));
+			key = DrawnAreaKey(key, g);
+			InvalidateDrawnArea(this, vp ? vp - UI.Viewports : 0, key,
+								x - g->Width / 2, y - g->Height / 2, g->Width, g->Height);
+		}
 	}
 }
 
@@ -78,6 +78,8 @@ void CheckMusicFinished(bool force)
 {
 	bool proceed;
 
+	HandleFinishedChannels();
+
 	SDL_LockMutex(MusicFinishedMutex);
 	proceed = MusicFinished;
 	MusicFinished = false;
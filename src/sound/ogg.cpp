@@ -48,6 +48,10 @@
 #include "SDL.h"
 #include "SDL_endian.h"
 
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
 #include "iolib.h"
 #include "movie.h"
 #include "sound_server.h"
@@ -65,15 +69,43 @@ public:
 	OggData Data;
 };
 
+/**
+**  A vorbis file decoded while it plays.
+**
+**  The decoder thread decodes ahead into Buffer, a ring of
+**  VorbisRingSize bytes, and Read only copies from it, so the mixer
+**  never waits for the decoder.
+*/
 class CSampleVorbisStream : public CSample
 {
 public:
+	CSampleVorbisStream() : RingRead(0), RingWrite(0), Decoded(false) { Streamed = true; }
 	~CSampleVorbisStream();
 	int Read(void *buf, int len);
+	void Decode();
 
 	OggData Data;
+	std::vector<char> Packet;          /// Samples of a decoded packet
+	std::atomic<unsigned> RingRead;    /// Bytes read from the ring
+	std::atomic<unsigned> RingWrite;   /// Bytes decoded into the ring
+	std::atomic<bool> Decoded;         /// The whole file is in the ring
 };
 
+/*----------------------------------------------------------------------------
+--  Variables
+----------------------------------------------------------------------------*/
+
+/// Size of the ring of a stream, about 1.5 seconds of 44100 hz stereo
+#define VorbisRingSize (256 * 1024)
+/// Decoded size above which a sound played once is streamed
+#define VorbisPreloadBudget (2 * 1024 * 1024)
+
+static std::vector<CSampleVorbisStream *> VorbisStreams;  /// Streams to decode
+static SDL_mutex *VorbisStreamsLock;      /// Protects VorbisStreams
+static SDL_sem *VorbisDecoderWake;        /// Posted when a ring needs data
+static SDL_Thread *VorbisDecoderThread;   /// Decodes the streams
+static bool VorbisDecoderQuit;            /// Ask the decoder thread to quit
+
 /*----------------------------------------------------------------------------
 --  Functions
 ----------------------------------------------------------------------------*/
@@ -309,42 +341,154 @@ void OggFree(OggData *data)
 }
 
 
-int VorbisStreamRead(CSample *sample, OggData *data, void *buf, int len)
+/**
+**  Decode the streams ahead of the mixer.
+**
+**  Wakes up when a ring was read below half of its size, or at least
+**  every 50ms.
+*/
+static int VorbisDecoder(void *)
 {
-	int bytes;
+	SDL_LockMutex(VorbisStreamsLock);
+	while (!VorbisDecoderQuit) {
+		for (size_t i = 0; i < VorbisStreams.size(); ++i) {
+			VorbisStreams[i]->Decode();
+		}
+		SDL_UnlockMutex(VorbisStreamsLock);
+		SDL_SemWaitTimeout(VorbisDecoderWake, 50);
+		SDL_LockMutex(VorbisStreamsLock);
+	}
+	SDL_UnlockMutex(VorbisStreamsLock);
+	return 0;
+}
 
-	if (sample->Pos > SOUND_BUFFER_SIZE / 2) {
-		memcpy(sample->Buffer, sample->Buffer + sample->Pos, sample->Len);
-		sample->Pos = 0;
+/**
+**  Let the decoder thread decode a stream, start the thread if needed.
+**
+**  @param stream  Stream to decode.
+*/
+static void AddVorbisStream(CSampleVorbisStream *stream)
+{
+	if (!VorbisStreamsLock) {
+		VorbisStreamsLock = SDL_CreateMutex();
+		VorbisDecoderWake = SDL_CreateSemaphore(0);
+	}
+	SDL_LockMutex(VorbisStreamsLock);
+	VorbisStreams.push_back(stream);
+	if (!VorbisDecoderThread) {
+		VorbisDecoderQuit = false;
+		VorbisDecoderThread = SDL_CreateThread(VorbisDecoder, NULL);
 	}
+	SDL_UnlockMutex(VorbisStreamsLock);
+}
 
-	while (sample->Len < SOUND_BUFFER_SIZE / 4) {
-		bytes = VorbisProcessData(data, (char *)sample->Buffer + sample->Pos + sample->Len);
-		if (bytes > 0) {
-			sample->Len += bytes;
-		} else {
-			break;
-		}
+/**
+**  Remove a stream from the decoder thread.
+**
+**  @param stream  Stream to remove.
+*/
+static void RemoveVorbisStream(CSampleVorbisStream *stream)
+{
+	if (!VorbisStreamsLock) {
+		return;
 	}
+	SDL_LockMutex(VorbisStreamsLock);
+	std::vector<CSampleVorbisStream *>::iterator it =
+		std::find(VorbisStreams.begin(), VorbisStreams.end(), stream);
+	if (it != VorbisStreams.end()) {
+		VorbisStreams.erase(it);
+	}
+	SDL_UnlockMutex(VorbisStreamsLock);
+}
 
-	if (sample->Len < len) {
-		len = sample->Len;
+/**
+**  Stop the decoder thread.
+*/
+void QuitVorbisStreams()
+{
+	if (!VorbisStreamsLock) {
+		return;
 	}
+	SDL_LockMutex(VorbisStreamsLock);
+	VorbisDecoderQuit = true;
+	SDL_UnlockMutex(VorbisStreamsLock);
+	if (VorbisDecoderThread) {
+		SDL_SemPost(VorbisDecoderWake);
+		SDL_WaitThread(VorbisDecoderThread, NULL);
+		VorbisDecoderThread = NULL;
+	}
+	SDL_DestroySemaphore(VorbisDecoderWake);
+	VorbisDecoderWake = NULL;
+	SDL_DestroyMutex(VorbisStreamsLock);
+	VorbisStreamsLock = NULL;
+}
+
+/**
+**  Decode packets into the ring while a whole packet fits.
+**
+**  Called by the decoder thread with VorbisStreamsLock held, and once
+**  by LoadVorbis to fill the ring before the stream is played.
+*/
+void CSampleVorbisStream::Decode()
+{
+	while (!this->Decoded.load(std::memory_order_relaxed)) {
+		const unsigned write = this->RingWrite.load(std::memory_order_relaxed);
+		const unsigned read = this->RingRead.load(std::memory_order_acquire);
 
-	memcpy(buf, sample->Buffer + sample->Pos, len);
-	sample->Pos += len;
-	sample->Len -= len;
+		if (VorbisRingSize - (write - read) < this->Packet.size()) {
+			break;
+		}
+		const int bytes = VorbisProcessData(&this->Data, &this->Packet[0]);
+		if (bytes <= 0) {
+			this->Decoded.store(true, std::memory_order_release);
+			break;
+		}
+		const unsigned offset = write % VorbisRingSize;
+		const unsigned first = std::min<unsigned>(bytes, VorbisRingSize - offset);
 
-	return len;
+		memcpy(this->Buffer + offset, &this->Packet[0], first);
+		memcpy(this->Buffer, &this->Packet[first], bytes - first);
+		this->RingWrite.store(write + bytes, std::memory_order_release);
+	}
 }
 
+/**
+**  Read the decoded samples from the ring.
+**
+**  If the decoder is late the rest of the buffer is silence, a short
+**  read means the end of the file.
+*/
 int CSampleVorbisStream::Read(void *buf, int len)
 {
-	return VorbisStreamRead(this, &this->Data, buf, len);
+	const bool decoded = this->Decoded.load(std::memory_order_acquire);
+	const unsigned read = this->RingRead.load(std::memory_order_relaxed);
+	const unsigned available = this->RingWrite.load(std::memory_order_acquire) - read;
+	unsigned n = std::min<unsigned>(len, available);
+
+	if (!decoded && n < (unsigned)len) {
+		// keep the channels in place after the silence
+		n -= n % (2 * this->Channels);
+	}
+	const unsigned offset = read % VorbisRingSize;
+	const unsigned first = std::min<unsigned>(n, VorbisRingSize - offset);
+
+	memcpy(buf, this->Buffer + offset, first);
+	memcpy((char *)buf + first, this->Buffer, n - first);
+	this->RingRead.store(read + n, std::memory_order_release);
+
+	if (!decoded && available - n < VorbisRingSize / 2) {
+		SDL_SemPost(VorbisDecoderWake);
+	}
+	if (!decoded && n < (unsigned)len) {
+		memset((char *)buf + n, 0, len - n);
+		return len;
+	}
+	return n;
 }
 
 CSampleVorbisStream::~CSampleVorbisStream()
 {
+	RemoveVorbisStream(this);
 	if (this->Data.File) {
 		this->Data.File->close();
 		delete this->Data.File;
@@ -372,10 +516,61 @@ CSampleVorbis::~CSampleVorbis()
 	delete[] this->Buffer;
 }
 
+/**
+**  Find the length of an ogg file from the granule position of its
+**  last page.
+**
+**  @param f  File to look at, its position is kept.
+**
+**  @return   Samples per channel, -1 if unknown.
+*/
+static ogg_int64_t OggLength(CFile *f)
+{
+	const long pos = f->tell();
+	ogg_int64_t length = -1;
+
+	if (f->seek(0, SEEK_END) || f->tell() <= 0) {
+		f->seek(pos, SEEK_SET);
+		return -1;
+	}
+	const long size = f->tell();
+	ogg_sync_state sync;
+	ogg_page page;
+
+	ogg_sync_init(&sync);
+	// pages are at most 64KB, look at growing tails of the file
+	for (long tail = 16384; length < 0; tail *= 2) {
+		const long start = std::max(0L, size - tail);
+
+		ogg_sync_reset(&sync);
+		f->seek(start, SEEK_SET);
+		int bytes;
+		do {
+			char *buf = ogg_sync_buffer(&sync, 4096);
+			bytes = f->read(buf, 4096);
+			ogg_sync_wrote(&sync, std::max(bytes, 0));
+		} while (bytes > 0);
+
+		while (ogg_sync_pageout(&sync, &page) != 0) {
+			if (ogg_page_eos(&page)) {
+				length = ogg_page_granulepos(&page);
+			}
+		}
+		if (start == 0) {
+			break;
+		}
+	}
+	ogg_sync_clear(&sync);
+	f->seek(pos, SEEK_SET);
+	return length;
+}
 
 /**
 **  Load vorbis.
 **
+**  With PlayAudioStreamLarge files which would take more than
+**  VorbisPreloadBudget bytes once decoded are streamed instead.
+**
 **  @param name   File name.
 **  @param flags  Load flags.
 **
@@ -395,8 +590,17 @@ CSample *LoadVorbis(const char *name, int flags)
 		return NULL;
 	}
 
-	if (flags & PlayAudioStream) {
-		CSampleVorbisStream *sampleVorbisStream = new CSampleVorbisStream;
+	bool stream = (flags & PlayAudioStream) != 0;
+	ogg_int64_t length = -1;
+	if (!stream) {
+		length = OggLength(f);
+		// assume stereo, the channels aren't known yet
+		stream = (flags & PlayAudioStreamLarge) && length * 2 * 2 > VorbisPreloadBudget;
+	}
+
+	CSampleVorbisStream *sampleVorbisStream = NULL;
+	if (stream) {
+		sampleVorbisStream = new CSampleVorbisStream;
 		sample = sampleVorbisStream;
 		data = &sampleVorbisStream->Data;
 	} else {
@@ -423,43 +627,35 @@ CSample *LoadVorbis(const char *name, int flags)
 	sample->Pos = 0;
 	data->File = f;
 
-	if (flags & PlayAudioStream) {
-		sample->Buffer = new unsigned char[SOUND_BUFFER_SIZE];
-	} else {
-		unsigned char *buf;
-		int total;
-		ogg_page pg;
-		ogg_sync_state sync;
-
-		// find total size
-		int pos = f->tell();
-		ogg_sync_init(&sync);
-		for (int i = 0; ; ++i) {
-			f->seek(-1 * i * 4096, SEEK_END);
-			buf = (unsigned char *)ogg_sync_buffer(&sync, 4096);
-			f->read(buf, 8192);
-			ogg_sync_wrote(&sync, 8192);
-			if (ogg_sync_pageout(&sync, &pg) == 1 && ogg_page_eos(&pg)) {
-				total = ogg_page_granulepos(&pg) * 2 * sample->Channels;
-				break;
-			}
-		}
-		f->seek(pos, SEEK_SET);
+	// a packet decodes to at most a long block of samples
+	std::vector<char> packet(vorbis_info_blocksize(info, 1) * info->channels * 2);
 
-		sample->Buffer = new unsigned char[total];
-		pos = 0;
+	if (stream) {
+		sampleVorbisStream->Packet.swap(packet);
+		sample->Buffer = new unsigned char[VorbisRingSize];
+		sampleVorbisStream->Decode();
+		AddVorbisStream(sampleVorbisStream);
+	} else {
+		std::vector<unsigned char> pcm;
+		int bytes;
 
-		int ret;
-		while ((ret = VorbisStreamRead(sample, &(static_cast<CSampleVorbis *>(sample))->Data,
-									   sample->Buffer + pos, 8192))) {
-			pos += ret;
+		if (length > 0) {
+			pcm.reserve(length * 2 * sample->Channels);
+		}
+		while ((bytes = VorbisProcessData(data, &packet[0])) > 0) {
+			pcm.insert(pcm.end(), packet.begin(), packet.begin() + bytes);
 		}
 
-		sample->Len = total;
+		sample->Buffer = new unsigned char[std::max<size_t>(pcm.size(), 1)];
+		if (!pcm.empty()) {
+			memcpy(sample->Buffer, &pcm[0], pcm.size());
+		}
+		sample->Len = pcm.size();
 		sample->Pos = 0;
 
 		f->close();
 		delete f;
+		data->File = NULL;
 		OggFree(data);
 	}
 
@@ -285,13 +285,14 @@ void PlayUnitSound(const CUnit &unit, UnitVoiceGroup voice)
 	if (UnitSoundIsPlaying(&source)) {
 		return;
 	}
-
-	int channel = PlaySample(ChooseSample(sound, selection, source), &source);
-	if (channel == -1) {
+	// Not heard from the view point, don't take a channel.
+	const unsigned char volume = CalculateVolume(false, ViewPointDistanceToUnit(unit), sound->Range);
+	if (volume == 0) {
 		return;
 	}
-	SetChannelVolume(channel, CalculateVolume(false, ViewPointDistanceToUnit(unit), sound->Range));
-	SetChannelStereo(channel, CalculateStereo(unit));
+
+	PlaySoundSample(ChooseSample(sound, selection, source), sound, SoundPriorityVoice + volume,
+					volume, CalculateStereo(unit), &source);
 }
 
 /**
@@ -313,12 +314,8 @@ void PlayUnitSound(const CUnit &unit, CSound *sound)
 		return;
 	}
 
-	int channel = PlaySample(ChooseSample(sound, false, source));
-	if (channel == -1) {
-		return;
-	}
-	SetChannelVolume(channel, volume);
-	SetChannelStereo(channel, CalculateStereo(unit));
+	PlaySoundSample(ChooseSample(sound, false, source), sound, SoundPriorityEffect + volume,
+					volume, CalculateStereo(unit));
 }
 
 /**
@@ -343,12 +340,8 @@ void PlayMissileSound(const Missile &missile, CSound *sound)
 		return;
 	}
 
-	int channel = PlaySample(ChooseSample(sound, false, source));
-	if (channel == -1) {
-		return;
-	}
-	SetChannelVolume(channel, volume);
-	SetChannelStereo(channel, stereo);
+	PlaySoundSample(ChooseSample(sound, false, source), sound, SoundPriorityEffect + volume,
+					volume, stereo);
 }
 
 /**
@@ -370,11 +363,8 @@ void PlayGameSound(CSound *sound, unsigned char volume, bool always)
 		return;
 	}
 
-	int channel = PlaySample(sample);
-	if (channel == -1) {
-		return;
-	}
-	SetChannelVolume(channel, CalculateVolume(true, volume, sound->Range));
+	volume = CalculateVolume(true, volume, sound->Range);
+	PlaySoundSample(sample, sound, SoundPriorityGame + volume, volume, 0);
 }
 
 static std::map<int, LuaActionListener *> ChannelMap;
@@ -403,7 +393,7 @@ static void PlaySoundFileCallback(int channel)
 int PlayFile(const std::string &name, LuaActionListener *listener)
 {
 	int channel = -1;
-	CSample *sample = LoadSample(name);
+	CSample *sample = LoadSampleOnce(name);
 
 	if (sample) {
 		channel = PlaySample(sample);
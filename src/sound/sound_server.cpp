@@ -49,6 +49,12 @@
 
 #include "SDL.h"
 
+#include <atomic>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /*----------------------------------------------------------------------------
 --  Variables
 ----------------------------------------------------------------------------*/
@@ -62,30 +68,117 @@ static int MusicVolume = 128;    /// music volume
 static bool MusicEnabled = true;
 static bool EffectsEnabled = true;
 
-/// Channels for sound effects and unit speech
+/**
+**  Single producer, single consumer queue without locks.
+**
+**  One thread pushes, another pops. N must be a power of 2.
+*/
+template <typename T, unsigned N>
+class SoundQueue
+{
+public:
+	SoundQueue() : ReadIndex(0), WriteIndex(0) {}
+
+	/// Push an item, false if the queue is full
+	bool Push(const T &item)
+	{
+		const unsigned write = WriteIndex.load(std::memory_order_relaxed);
+		if (write - ReadIndex.load(std::memory_order_acquire) == N) {
+			return false;
+		}
+		Items[write % N] = item;
+		WriteIndex.store(write + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// Pop an item, false if the queue is empty
+	bool Pop(T &item)
+	{
+		const unsigned read = ReadIndex.load(std::memory_order_relaxed);
+		if (read == WriteIndex.load(std::memory_order_acquire)) {
+			return false;
+		}
+		item = Items[read % N];
+		ReadIndex.store(read + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	T Items[N];                        /// The items
+	std::atomic<unsigned> ReadIndex;   /// Items popped
+	std::atomic<unsigned> WriteIndex;  /// Items pushed
+};
+
+/// Channels for sound effects and unit speech, owned by the game thread
 struct SoundChannel {
 	CSample *Sample;       /// sample to play
-	Origin *Unit;          /// pointer to unit, who plays the sound, if any
+	Origin Unit;           /// unit who plays the sound, Base is NULL if none
 	unsigned char Volume;  /// Volume of this channel
 	signed char Stereo;    /// stereo location of sound (-128 left, 0 center, 127 right)
 
 	bool Playing;          /// channel is currently playing
-	int Point;             /// point in sample if playing or next free channel
+	bool Used;             /// channel is not free, until the mixer finished it
+	unsigned Serial;       /// number of the sound played on the channel
+	int NextFree;          /// next free channel if free
+
+	const CSound *Sound;   /// sound the sample belongs to, if any
+	int Priority;          /// priority of the sound, see PlaySoundSample
+	unsigned Start;        /// when the sound started, to find the oldest
 
 	void (*FinishedCallback)(int channel); /// Callback for when a sample finishes playing
 };
 
+/// Channels as mixed, owned by the mixer thread
+struct MixerChannel {
+	CSample *Sample;       /// sample to play
+	unsigned char Volume;  /// Volume of this channel
+	signed char Stereo;    /// stereo location of sound
+	bool Playing;          /// channel is currently playing
+	unsigned Serial;       /// number of the sound played on the channel
+	int Point;             /// point in sample
+	std::vector<char> Scratch; /// conversion buffer of a streamed sample
+};
+
+/// What a command does to a channel
+enum SoundCommandType {
+	SoundCommandPlay,    /// Start the sample
+	SoundCommandVolume,  /// Change the volume
+	SoundCommandStereo,  /// Change the stereo
+	SoundCommandStop     /// Stop the channel
+};
+
+/// Change of a channel sent to the mixer
+struct SoundCommand {
+	unsigned char Type;    /// What to do, a SoundCommandType
+	unsigned char Channel; /// Channel to change
+	unsigned char Volume;  /// New volume
+	signed char Stereo;    /// New stereo
+	unsigned Serial;       /// Sound played on the channel
+	CSample *Sample;       /// Sample to play
+};
+
+/// A channel the mixer finished, sent back to the game thread
+struct SoundFinished {
+	int Channel;           /// The channel
+	unsigned Serial;       /// Sound which was played on the channel
+};
+
 #define MaxChannels 64     /// How many channels are supported
+#define MaxVoicesPerSound 4 /// How many channels may play the same sound
 
 static SoundChannel Channels[MaxChannels];
 static int NextFreeChannel;
+static unsigned ChannelStarts;  /// Sounds started, orders the channels
+static MixerChannel MixerChannels[MaxChannels];
+
+static SoundQueue<SoundCommand, 1024> SoundCommands;             /// Game thread to mixer
+static SoundQueue<SoundFinished, 2 * MaxChannels> SoundFinishes; /// Mixer to game thread
 
 static struct {
 	CSample *Sample;       /// Music sample
 	void (*FinishedCallback)(); /// Callback for when music finishes playing
 } MusicChannel;
-
-static void ChannelFinished(int channel);
+static std::vector<char> MusicScratch; /// conversion buffer of the music
 
 static struct {
 	SDL_AudioSpec Format;
@@ -104,37 +197,83 @@ static struct {
 ----------------------------------------------------------------------------*/
 
 /**
-**  Convert RAW sound data to 44100 hz, Stereo, 16 bits per channel
+**  Prepare the conversion of a streamed sample to 44100 hz, Stereo,
+**  16 bits per channel.
+**
+**  @param sample  Sample to convert
+**  @param size    Number of samples of the mixer to fill
+**  @param acvt    Set to the conversion
 **
-**  @param src        Source buffer
-**  @param dest       Destination buffer
-**  @param frequency  Frequency of source
-**  @param chansize   Bitrate in bytes per channel of source
-**  @param channels   Number of channels of source
-**  @param bytes      Number of compressed bytes to read
+**  @return        Number of bytes to read from the sample, 0 if its
+**                 format can't be converted. The conversion needs
+**                 acvt->len_mult times as many bytes.
+*/
+static int PrepareStreamConversion(const CSample &sample, int size, SDL_AudioCVT *acvt)
+{
+	const int frameSize = (sample.SampleSize / 8) * sample.Channels;
+
+	if (frameSize <= 0 || sample.Frequency <= 0) {
+		return 0;
+	}
+	const Uint16 format = sample.SampleSize == 8 ? AUDIO_U8 : AUDIO_S16SYS;
+	if (SDL_BuildAudioCVT(acvt, format, sample.Channels, sample.Frequency, AUDIO_S16SYS, 2, 44100) < 0) {
+		return 0;
+	}
+	// size counts the samples of both channels
+	const long long frames = (long long)(size / 2) * sample.Frequency / 44100;
+	return std::max(static_cast<int>(frames), 1) * frameSize;
+}
+
+/**
+**  Allocate the conversion buffer of a streamed sample when it starts,
+**  so that the mixer doesn't allocate memory.
 **
-**  @return           Number of bytes written in 'dest'
+**  @param sample   Sample which starts
+**  @param scratch  Conversion buffer
 */
-static int ConvertToStereo32(const char *src, char *dest, int frequency,
-							 int chansize, int channels, int bytes)
+static void ReserveStreamScratch(const CSample &sample, std::vector<char> &scratch)
 {
 	SDL_AudioCVT acvt;
-	Uint16 format;
+	const size_t len = PrepareStreamConversion(sample, Audio.Format.samples * Audio.Format.channels, &acvt);
 
-	if (chansize == 1) {
-		format = AUDIO_U8;
-	} else {
-		format = AUDIO_S16SYS;
+	if (len && scratch.size() < len * acvt.len_mult) {
+		scratch.resize(len * acvt.len_mult);
 	}
-	SDL_BuildAudioCVT(&acvt, format, channels, frequency, AUDIO_S16SYS, 2, 44100);
+}
 
-	acvt.buf = (Uint8 *)dest;
-	memcpy(dest, src, bytes);
-	acvt.len = bytes;
+/**
+**  Read and convert the next part of a streamed sample.
+**
+**  @param sample   Sample to read
+**  @param size     Number of samples of the mixer to fill
+**  @param scratch  Conversion buffer, grown if needed
+**  @param samples  Set to the converted samples
+**  @param n        Set to the number of converted samples, at most size
+**
+**  @return         true if the end of the sample is reached.
+*/
+static bool ReadStream(CSample &sample, int size, std::vector<char> &scratch,
+					   const short **samples, int *n)
+{
+	SDL_AudioCVT acvt;
+	const int len = PrepareStreamConversion(sample, size, &acvt);
 
+	*n = 0;
+	if (len == 0) {
+		return true;
+	}
+	if (scratch.size() < (size_t)len * acvt.len_mult) {
+		// Only when a stream with another format starts
+		scratch.resize((size_t)len * acvt.len_mult);
+	}
+	const int read = sample.Read(&scratch[0], len);
+	acvt.buf = reinterpret_cast<Uint8 *>(&scratch[0]);
+	acvt.len = read;
 	SDL_ConvertAudio(&acvt);
 
-	return acvt.len_mult * bytes;
+	*samples = reinterpret_cast<const short *>(acvt.buf);
+	*n = std::min(acvt.len_cvt / (int)sizeof(short), size);
+	return read < len;
 }
 
 /**
@@ -151,27 +290,17 @@ static void MixMusicToStereo32(int *buffer, int size)
 	if (MusicPlaying) {
 		Assert(MusicChannel.Sample);
 
-		short *buf = new short[size];
-		int len = size * sizeof(short);
-		char *tmp = new char[len];
-
-		int div = 176400 / (MusicChannel.Sample->Frequency * (MusicChannel.Sample->SampleSize / 8) * MusicChannel.Sample->Channels);
-
-		size = MusicChannel.Sample->Read(tmp, len / div);
+		const short *buf;
+		int n;
+		const bool finished = ReadStream(*MusicChannel.Sample, size, MusicScratch, &buf, &n);
 
-		int n = ConvertToStereo32(tmp, (char *)buf, MusicChannel.Sample->Frequency,
-								  MusicChannel.Sample->SampleSize / 8, MusicChannel.Sample->Channels, size);
-
-		for (int i = 0; i < n / (int)sizeof(*buf); ++i) {
+		for (int i = 0; i < n; ++i) {
 			// Add to our samples
 			// FIXME: why taking out '/ 2' leads to distortion
 			buffer[i] += buf[i] * MusicVolume / MaxVolume / 2;
 		}
 
-		delete[] tmp;
-		delete[] buf;
-
-		if (n < len) { // End reached
+		if (finished) { // End reached
 			MusicPlaying = false;
 			delete MusicChannel.Sample;
 			MusicChannel.Sample = NULL;
@@ -183,57 +312,129 @@ static void MixMusicToStereo32(int *buffer, int size)
 	}
 }
 
+/**
+**  Convert a sample loaded in memory to the format of the mixer,
+**  44100 hz, stereo, 16 bits per channel.
+**
+**  Done once at load, so the mixer only applies the volume.
+**
+**  @param sample  Sample to convert.
+**
+**  @return        false if the sample can't be converted.
+*/
+static bool ConvertSampleToStereo16(CSample &sample)
+{
+	if (sample.Frequency == 44100 && sample.Channels == 2 && sample.SampleSize == 16) {
+		return true;
+	}
+	SDL_AudioCVT acvt;
+	const Uint16 format = sample.SampleSize == 8 ? AUDIO_U8 : AUDIO_S16SYS;
+
+	if (SDL_BuildAudioCVT(&acvt, format, sample.Channels, sample.Frequency, AUDIO_S16SYS, 2, 44100) < 0) {
+		return false;
+	}
+	unsigned char *buf = new unsigned char[sample.Len * acvt.len_mult];
+	memcpy(buf, sample.Buffer + sample.Pos, sample.Len);
+	acvt.buf = buf;
+	acvt.len = sample.Len;
+	if (SDL_ConvertAudio(&acvt) < 0) {
+		delete[] buf;
+		return false;
+	}
+	delete[] sample.Buffer;
+	sample.Buffer = buf;
+	sample.Pos = 0;
+	sample.Len = acvt.len_cvt & ~3;
+	sample.Frequency = 44100;
+	sample.Channels = 2;
+	sample.SampleSize = 16;
+	sample.BitsPerSample = 16;
+	return true;
+}
+
 /**
 **  Mix sample to buffer.
 **
-**  The input samples are adjusted by the local volume and resampled
-**  to the output frequence.
+**  The input samples are adjusted by the local volume. The sample is
+**  already in the output format, see ConvertSampleToStereo16.
 **
 **  @param sample  Input sample
 **  @param index   Position into input sample
 **  @param volume  Volume of the input sample
 **  @param stereo  Stereo (left/right) position of sample
 **  @param buffer  Output buffer
-**  @param size    Size of output buffer (in samples per channel)
+**  @param size    Size of output buffer (in samples)
 **
 **  @return        The number of bytes used to fill buffer
-**
-**  @todo          Can mix faster if signed 8 bit buffers are used.
 */
 static int MixSampleToStereo32(CSample *sample, int index, unsigned char volume,
 							   char stereo, int *buffer, int size)
 {
-	static int buf[SOUND_BUFFER_SIZE / 2];
-	unsigned char left;
-	unsigned char right;
-
-	int div = 176400 / (sample->Frequency * (sample->SampleSize / 8) * sample->Channels);
-	int local_volume = (int)volume * EffectsVolume / MaxVolume;
-
-	if (stereo < 0) {
-		left = 128;
-		right = 128 + stereo;
-	} else {
-		left = 128 - stereo;
-		right = 128;
+	Assert(sample->Frequency == 44100 && sample->Channels == 2 && sample->SampleSize == 16);
+	Assert(!(index & 3));
+
+	const int local_volume = (int)volume * EffectsVolume / MaxVolume;
+	const int left = stereo < 0 ? 128 : 128 - stereo;
+	const int right = stereo < 0 ? 128 + stereo : 128;
+	// Gains in 1/65536th, the old '/ 128 / MaxVolume / 2' of the volume,
+	// kept below 32768 to fit in 16 bits.
+	const int gainLeft = std::min(local_volume * left * 256 / MaxVolume, 32767);
+	const int gainRight = std::min(local_volume * right * 256 / MaxVolume, 32767);
+
+	const short *src = reinterpret_cast<const short *>(sample->Buffer + index);
+	size = std::min((sample->Len - index) / 2, size) & ~1;
+
+	int i = 0;
+#ifdef __SSE2__
+	const __m128i gain = _mm_set_epi32(gainRight, gainLeft, gainRight, gainLeft);
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; i + 8 <= size; i += 8) {
+		const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		// Each 32 bit lane holds a sample and a 0, so madd is sample * gain.
+		const __m128i lo = _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(s, zero), gain), 16);
+		const __m128i hi = _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(s, zero), gain), 16);
+		__m128i *dst = reinterpret_cast<__m128i *>(buffer + i);
+
+		_mm_storeu_si128(dst, _mm_add_epi32(_mm_loadu_si128(dst), lo));
+		_mm_storeu_si128(dst + 1, _mm_add_epi32(_mm_loadu_si128(dst + 1), hi));
 	}
-
-	Assert(!(index & 1));
-
-	size = std::min((sample->Len - index) * div / 2, size);
-
-	size = ConvertToStereo32((char *)(sample->Buffer + index), (char *)buf, sample->Frequency,
-							 sample->SampleSize / 8, sample->Channels,
-							 size * 2 / div);
-
-	size /= 2;
-	for (int i = 0; i < size; i += 2) {
-		// FIXME: why taking out '/ 2' leads to distortion
-		buffer[i] += ((short *)buf)[i] * local_volume * left / 128 / MaxVolume / 2;
-		buffer[i + 1] += ((short *)buf)[i + 1] * local_volume * right / 128 / MaxVolume / 2;
+#endif
+	for (; i < size; i += 2) {
+		buffer[i] += (src[i] * gainLeft) >> 16;
+		buffer[i + 1] += (src[i + 1] * gainRight) >> 16;
 	}
+	return size * 2;
+}
 
-	return 2 * size / div;
+/**
+**  Mix a streamed sample to buffer.
+**
+**  Streamed samples are converted while they are mixed, like the music.
+**
+**  @param mc      Channel playing the sample
+**  @param buffer  Output buffer
+**  @param size    Size of output buffer (in samples)
+**
+**  @return        true if the end of the sample is reached
+*/
+static bool MixStreamToStereo32(MixerChannel &mc, int *buffer, int size)
+{
+	const int local_volume = (int)mc.Volume * EffectsVolume / MaxVolume;
+	const int left = mc.Stereo < 0 ? 128 : 128 - mc.Stereo;
+	const int right = mc.Stereo < 0 ? 128 + mc.Stereo : 128;
+	const int gainLeft = std::min(local_volume * left * 256 / MaxVolume, 32767);
+	const int gainRight = std::min(local_volume * right * 256 / MaxVolume, 32767);
+
+	const short *buf;
+	int n;
+	const bool finished = ReadStream(*mc.Sample, size, mc.Scratch, &buf, &n);
+
+	for (int i = 0; i + 1 < n; i += 2) {
+		buffer[i] += (buf[i] * gainLeft) >> 16;
+		buffer[i + 1] += (buf[i + 1] * gainRight) >> 16;
+	}
+	return finished;
 }
 
 /**
@@ -249,15 +450,23 @@ static int MixChannelsToStereo32(int *buffer, int size)
 	int new_free_channels = 0;
 
 	for (int channel = 0; channel < MaxChannels; ++channel) {
-		if (Channels[channel].Playing && Channels[channel].Sample) {
-			int i = MixSampleToStereo32(Channels[channel].Sample,
-										Channels[channel].Point, Channels[channel].Volume,
-										Channels[channel].Stereo, buffer, size);
-			Channels[channel].Point += i;
-			Assert(Channels[channel].Point <= Channels[channel].Sample->Len);
-
-			if (Channels[channel].Point == Channels[channel].Sample->Len) {
-				ChannelFinished(channel);
+		MixerChannel &mc = MixerChannels[channel];
+
+		if (mc.Playing && mc.Sample) {
+			bool finished;
+
+			if (mc.Sample->Streamed) {
+				finished = MixStreamToStereo32(mc, buffer, size);
+			} else {
+				int i = MixSampleToStereo32(mc.Sample, mc.Point, mc.Volume, mc.Stereo, buffer, size);
+				mc.Point += i;
+				Assert(mc.Point <= mc.Sample->Len);
+				finished = mc.Point == mc.Sample->Len;
+			}
+			if (finished) {
+				mc.Playing = false;
+				const SoundFinished finished = {channel, mc.Serial};
+				SoundFinishes.Push(finished);
 				++new_free_channels;
 			}
 		}
@@ -265,6 +474,51 @@ static int MixChannelsToStereo32(int *buffer, int size)
 	return new_free_channels;
 }
 
+/**
+**  Apply the changes of the channels sent by the game thread.
+**
+**  Stopped channels are sent back as finished.
+*/
+static void ApplySoundCommands()
+{
+	SoundCommand command;
+
+	while (SoundCommands.Pop(command)) {
+		MixerChannel &mc = MixerChannels[command.Channel];
+
+		switch (command.Type) {
+			case SoundCommandPlay:
+				mc.Sample = command.Sample;
+				mc.Volume = command.Volume;
+				mc.Stereo = command.Stereo;
+				mc.Serial = command.Serial;
+				mc.Point = 0;
+				mc.Playing = true;
+				if (mc.Sample->Streamed) {
+					ReserveStreamScratch(*mc.Sample, mc.Scratch);
+				}
+				break;
+			case SoundCommandVolume:
+				if (mc.Serial == command.Serial) {
+					mc.Volume = command.Volume;
+				}
+				break;
+			case SoundCommandStereo:
+				if (mc.Serial == command.Serial) {
+					mc.Stereo = command.Stereo;
+				}
+				break;
+			case SoundCommandStop:
+				if (mc.Serial == command.Serial && mc.Playing) {
+					mc.Playing = false;
+					const SoundFinished finished = {command.Channel, mc.Serial};
+					SoundFinishes.Push(finished);
+				}
+				break;
+		}
+	}
+}
+
 /**
 **  Clip mix to output stereo 16 signed bit.
 **
@@ -276,6 +530,14 @@ static void ClipMixToStereo16(const int *mix, int size, short *output)
 {
 	const int *end = mix + size;
 
+#ifdef __SSE2__
+	for (; end - mix >= 8; mix += 8, output += 8) {
+		const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mix));
+		const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mix + 4));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(output), _mm_packs_epi32(lo, hi));
+	}
+#endif
 	while (mix < end) {
 		int s = (*mix++);
 		clamp(&s, SHRT_MIN, SHRT_MAX);
@@ -294,6 +556,8 @@ static void MixIntoBuffer(void *buffer, int samples)
 	// FIXME: can save the memset here, if first channel sets the values
 	memset(Audio.MixerBuffer, 0, samples * sizeof(*Audio.MixerBuffer));
 
+	ApplySoundCommands();
+
 	if (EffectsEnabled) {
 		// Add channels to mixer buffer
 		MixChannelsToStereo32(Audio.MixerBuffer, samples);
@@ -357,6 +621,42 @@ static int FillThread(void *)
 --  Effects
 ----------------------------------------------------------------------------*/
 
+/**
+**  Send a change of a channel to the mixer.
+**
+**  When the queue is full, changes of the volume or the stereo are
+**  dropped, a stop waits for the mixer.
+**
+**  @return  false if the command is not sent.
+*/
+static bool SendSoundCommand(const SoundCommand &command)
+{
+	while (!SoundCommands.Push(command)) {
+		if (command.Type != SoundCommandStop || !Audio.Running) {
+			return false;
+		}
+		SDL_Delay(1);
+	}
+	return true;
+}
+
+/**
+**  Send a change of a channel to the mixer.
+*/
+static bool SendSoundCommand(int type, int channel)
+{
+	const SoundChannel &c = Channels[channel];
+	SoundCommand command;
+
+	command.Type = type;
+	command.Channel = channel;
+	command.Volume = c.Volume;
+	command.Stereo = c.Stereo;
+	command.Serial = c.Serial;
+	command.Sample = c.Sample;
+	return SendSoundCommand(command);
+}
+
 /**
 **  Check if this sound is already playing
 */
@@ -373,8 +673,8 @@ bool SampleIsPlaying(CSample *sample)
 bool UnitSoundIsPlaying(Origin *origin)
 {
 	for (int i = 0; i < MaxChannels; ++i) {
-		if (origin && Channels[i].Unit && origin->Id && Channels[i].Unit->Id
-			&& origin->Id == Channels[i].Unit->Id && Channels[i].Playing) {
+		if (origin && Channels[i].Unit.Base && origin->Id && Channels[i].Unit.Id
+			&& origin->Id == Channels[i].Unit.Id && Channels[i].Playing) {
 			return true;
 		}
 	}
@@ -390,39 +690,115 @@ static void ChannelFinished(int channel)
 		Channels[channel].FinishedCallback(channel);
 	}
 
-	delete Channels[channel].Unit;
-	Channels[channel].Unit = NULL;
+	Channels[channel].Unit.Base = NULL;
+	Channels[channel].Unit.Id = 0;
 
 	Channels[channel].Playing = false;
-	Channels[channel].Point = NextFreeChannel;
+	Channels[channel].Used = false;
+	Channels[channel].NextFree = NextFreeChannel;
 	NextFreeChannel = channel;
 }
 
+/**
+**  Free the channels the mixer finished, and call their callbacks.
+**
+**  Called by the game thread, the callbacks may run lua.
+*/
+void HandleFinishedChannels()
+{
+	SoundFinished finished;
+
+	while (SoundFinishes.Pop(finished)) {
+		const SoundChannel &c = Channels[finished.Channel];
+
+		if (c.Used && c.Serial == finished.Serial) {
+			ChannelFinished(finished.Channel);
+		}
+	}
+}
+
+/**
+**  Start a sample on a channel.
+**
+**  The channel is free, or plays a sound which is replaced.
+**
+**  @return  The channel, -1 if the mixer can't be told.
+*/
+static int StartChannel(int channel, CSample *sample, unsigned char volume, char stereo,
+						const CSound *sound, int priority, Origin *origin)
+{
+	SoundChannel &c = Channels[channel];
+	SoundCommand command;
+
+	command.Type = SoundCommandPlay;
+	command.Channel = channel;
+	command.Volume = volume;
+	command.Stereo = stereo;
+	command.Serial = c.Serial + 1;
+	command.Sample = sample;
+	if (!SendSoundCommand(command)) {
+		return -1;
+	}
+	c.Serial = command.Serial;
+	c.Volume = volume;
+	c.Playing = true;
+	c.Used = true;
+	c.Sample = sample;
+	c.Stereo = stereo;
+	c.FinishedCallback = NULL;
+	c.Unit.Base = origin ? origin->Base : NULL;
+	c.Unit.Id = origin && origin->Base ? origin->Id : 0;
+	c.Sound = sound;
+	c.Priority = priority;
+	c.Start = ++ChannelStarts;
+	return channel;
+}
+
 /**
 **  Put a sound request in the next free channel.
 */
-static int FillChannel(CSample *sample, unsigned char volume, char stereo, Origin *origin)
+static int FillChannel(CSample *sample, unsigned char volume, char stereo,
+					   const CSound *sound, int priority, Origin *origin)
 {
 	Assert(NextFreeChannel < MaxChannels);
 
-	int old_free = NextFreeChannel;
-	int next_free = Channels[NextFreeChannel].Point;
-
-	Channels[NextFreeChannel].Volume = volume;
-	Channels[NextFreeChannel].Point = 0;
-	Channels[NextFreeChannel].Playing = true;
-	Channels[NextFreeChannel].Sample = sample;
-	Channels[NextFreeChannel].Stereo = stereo;
-	Channels[NextFreeChannel].FinishedCallback = NULL;
-	if (origin && origin->Base) {
-		Origin *source = new Origin;
-		source->Base = origin->Base;
-		source->Id = origin->Id;
-		Channels[NextFreeChannel].Unit = source;
+	const int channel = StartChannel(NextFreeChannel, sample, volume, stereo, sound, priority, origin);
+	if (channel != -1) {
+		NextFreeChannel = Channels[channel].NextFree;
 	}
-	NextFreeChannel = next_free;
+	return channel;
+}
+
+/**
+**  Find the playing channel a new sound may take: the lowest priority,
+**  the oldest first. Channels with a finished callback are never taken.
+**
+**  @param sound  Only look at the channels of this sound, if not NULL.
+**  @param count  Set to the number of channels looked at.
+**
+**  @return       The channel, -1 if none.
+*/
+static int LowestPriorityChannel(const CSound *sound, int *count)
+{
+	int best = -1;
+
+	*count = 0;
+	for (int i = 0; i < MaxChannels; ++i) {
+		const SoundChannel &c = Channels[i];
 
-	return old_free;
+		if (!c.Playing || (sound && c.Sound != sound)) {
+			continue;
+		}
+		++*count;
+		if (c.FinishedCallback) {
+			continue;
+		}
+		if (best == -1 || c.Priority < Channels[best].Priority
+			|| (c.Priority == Channels[best].Priority && int(c.Start - Channels[best].Start) < 0)) {
+			best = i;
+		}
+	}
+	return best;
 }
 
 /**
@@ -442,12 +818,11 @@ int SetChannelVolume(int channel, int volume)
 	if (volume < 0) {
 		volume = Channels[channel].Volume;
 	} else {
-		SDL_LockMutex(Audio.Lock);
-
 		volume = std::min(MaxVolume, volume);
 		Channels[channel].Volume = volume;
-
-		SDL_UnlockMutex(Audio.Lock);
+		if (Channels[channel].Playing) {
+			SendSoundCommand(SoundCommandVolume, channel);
+		}
 	}
 	return volume;
 }
@@ -472,9 +847,10 @@ int SetChannelStereo(int channel, int stereo)
 	if (stereo < -128 || stereo > 127) {
 		stereo = Channels[channel].Stereo;
 	} else {
-		SDL_LockMutex(Audio.Lock);
 		Channels[channel].Stereo = stereo;
-		SDL_UnlockMutex(Audio.Lock);
+		if (Channels[channel].Playing) {
+			SendSoundCommand(SoundCommandStereo, channel);
+		}
 	}
 	return stereo;
 }
@@ -507,17 +883,19 @@ CSample *GetChannelSample(int channel)
 /**
 **  Stop a channel
 **
+**  The channel is freed and its callback called once the mixer stopped
+**  it, see HandleFinishedChannels.
+**
 **  @param channel  Channel to stop
 */
 void StopChannel(int channel)
 {
-	SDL_LockMutex(Audio.Lock);
 	if (channel >= 0 && channel < MaxChannels) {
 		if (Channels[channel].Playing) {
-			ChannelFinished(channel);
+			Channels[channel].Playing = false;
+			SendSoundCommand(SoundCommandStop, channel);
 		}
 	}
-	SDL_UnlockMutex(Audio.Lock);
 }
 
 /**
@@ -525,16 +903,12 @@ void StopChannel(int channel)
 */
 void StopAllChannels()
 {
-	SDL_LockMutex(Audio.Lock);
 	for (int i = 0; i < MaxChannels; ++i) {
-		if (Channels[i].Playing) {
-			ChannelFinished(i);
-		}
+		StopChannel(i);
 	}
-	SDL_UnlockMutex(Audio.Lock);
 }
 
-static CSample *LoadSample(const char *name, enum _play_audio_flags_ flag)
+static CSample *LoadSample(const char *name, int flag)
 {
 	CSample *sampleWav = LoadWav(name, flag);
 
@@ -577,12 +951,92 @@ CSample *LoadSample(const std::string &name)
 	const std::string filename = LibraryFileName(name.c_str());
 	CSample *sample = LoadSample(filename.c_str(), PlayAudioLoadInMemory);
 
+	if (sample && !ConvertSampleToStereo16(*sample)) {
+		fprintf(stderr, "Can't convert the sound '%s'\n", name.c_str());
+		delete sample;
+		sample = NULL;
+	} else if (sample == NULL) {
+		fprintf(stderr, "Can't load the sound '%s'\n", name.c_str());
+	}
+	return sample;
+}
+
+/**
+**  Load a sample played once, like a speech.
+**
+**  Unlike LoadSample the sample is streamed if it would take too much
+**  memory, it can be played on one channel only.
+**
+**  @param name  File name of sample (short version).
+**
+**  @return      General sample loaded from file.
+*/
+CSample *LoadSampleOnce(const std::string &name)
+{
+	const std::string filename = LibraryFileName(name.c_str());
+	CSample *sample = LoadSample(filename.c_str(), PlayAudioLoadInMemory | PlayAudioStreamLarge);
+
 	if (sample == NULL) {
 		fprintf(stderr, "Can't load the sound '%s'\n", name.c_str());
+	} else if (!sample->Streamed && !ConvertSampleToStereo16(*sample)) {
+		fprintf(stderr, "Can't convert the sound '%s'\n", name.c_str());
+		delete sample;
+		sample = NULL;
 	}
 	return sample;
 }
 
+/**
+**  Play a sample of a sound.
+**
+**  A sound plays on at most MaxVoicesPerSound channels, a new one
+**  replaces the oldest of its lowest priority ones if it doesn't have
+**  a lower priority. When all channels are used the new sound replaces
+**  the oldest of the lowest priority channels if it has a higher
+**  priority.
+**
+**  @param sample    Sample to play
+**  @param sound     Sound the sample belongs to, NULL for no limit
+**  @param priority  Priority of the sound, a SoundPriority plus the volume
+**  @param volume    Volume of the channel
+**  @param stereo    Stereo of the channel
+**  @param origin    Unit playing the sound, if any
+**
+**  @return          Channel number, -1 if not played
+*/
+int PlaySoundSample(CSample *sample, const CSound *sound, int priority,
+					unsigned char volume, char stereo, Origin *origin)
+{
+	HandleFinishedChannels();
+	if (!SoundEnabled() || !EffectsEnabled || !sample) {
+		return -1;
+	}
+	if (Preference.StereoSound == false) {
+		stereo = 0;
+	}
+	if (sound) {
+		int count;
+		const int channel = LowestPriorityChannel(sound, &count);
+
+		if (count >= MaxVoicesPerSound) {
+			if (channel == -1 || Channels[channel].Priority > priority) {
+				return -1;
+			}
+			return StartChannel(channel, sample, volume, stereo, sound, priority, origin);
+		}
+	}
+	if (NextFreeChannel == MaxChannels) {
+		int count;
+		const int channel = LowestPriorityChannel(NULL, &count);
+
+		if (channel == -1 || Channels[channel].Priority >= priority) {
+			return -1;
+		}
+		return StartChannel(channel, sample, volume, stereo, sound, priority, origin);
+	}
+	return FillChannel(sample, volume, stereo, sound, priority, origin);
+}
+
 /**
 **  Play a sound sample
 **
@@ -592,14 +1046,7 @@ CSample *LoadSample(const std::string &name)
 */
 int PlaySample(CSample *sample, Origin *origin)
 {
-	int channel = -1;
-
-	SDL_LockMutex(Audio.Lock);
-	if (SoundEnabled() && EffectsEnabled && sample && NextFreeChannel != MaxChannels) {
-		channel = FillChannel(sample, EffectsVolume, 0, origin);
-	}
-	SDL_UnlockMutex(Audio.Lock);
-	return channel;
+	return PlaySoundSample(sample, NULL, SoundPriorityFile + EffectsVolume, EffectsVolume, 0, origin);
 }
 
 /**
@@ -611,7 +1058,7 @@ int PlaySample(CSample *sample, Origin *origin)
 */
 int PlaySoundFile(const std::string &name)
 {
-	CSample *sample = LoadSample(name);
+	CSample *sample = LoadSampleOnce(name);
 	if (sample) {
 		return PlaySample(sample);
 	}
@@ -676,6 +1123,7 @@ int PlayMusic(CSample *sample)
 {
 	if (sample) {
 		StopMusic();
+		ReserveStreamScratch(*sample, MusicScratch);
 		MusicChannel.Sample = sample;
 		MusicPlaying = true;
 		return 0;
@@ -703,6 +1151,7 @@ int PlayMusic(const std::string &file)
 
 	if (sample) {
 		StopMusic();
+		ReserveStreamScratch(*sample, MusicScratch);
 		MusicChannel.Sample = sample;
 		MusicPlaying = true;
 		return 0;
@@ -843,7 +1292,7 @@ int InitSound()
 	// pre-start menus!
 	// initialize channels
 	for (int i = 0; i < MaxChannels; ++i) {
-		Channels[i].Point = i + 1;
+		Channels[i].NextFree = i + 1;
 	}
 
 	// Create mutex and cond for FillThread
@@ -868,6 +1317,9 @@ void QuitSound()
 	Audio.Running = false;
 	// Join with the FillThread
 	SDL_WaitThread(Audio.Thread, NULL);
+#ifdef USE_VORBIS
+	QuitVorbisStreams();
+#endif
 
 	SoundInitialized = false;
 	delete[] Audio.MixerBuffer;
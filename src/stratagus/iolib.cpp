@@ -47,6 +47,13 @@
 #include <stdarg.h>
 #include <stdio.h>
 
+#ifdef USE_WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
 #ifdef USE_ZLIB
 #include <zlib.h>
 #endif
@@ -55,6 +62,276 @@
 #include <bzlib.h>
 #endif
 
+/*----------------------------------------------------------------------------
+--  Asset pack
+----------------------------------------------------------------------------*/
+
+/**
+**  The asset pack holds the files of the data directory in one file,
+**  mapped in memory once. A file of the pack is found with a binary
+**  search of its index instead of probing the disk.
+**
+**  Layout, integers in little endian:
+**  - header: "STRAPAK1", number of files (32 bits), size of the names (32 bits)
+**  - index, sorted by name: offset, stored size and size (64 bits each),
+**    offset and length of the name in the names (32 bits each), method
+**    (32 bits, 0 stored, 1 zlib) and 32 unused bits
+**  - names, then the data of the files
+**
+**  tools/mkpack.cpp writes it.
+*/
+
+static const char AssetPackMagic[8] = {'S', 'T', 'R', 'A', 'P', 'A', 'K', '1'};
+static const size_t AssetPackHeaderSize = 16;  /// Size of the header
+static const size_t AssetPackEntrySize = 40;   /// Size of an index entry
+static const uint64_t AssetPackMaxInflated = 256 << 20;  /// Max size of a compressed file
+
+enum {
+	AssetPackStored,  /// File stored as is
+	AssetPackZlib     /// File compressed with zlib
+};
+
+/**
+**  A file of the asset pack.
+*/
+struct AssetPackEntry {
+	const unsigned char *Data;  /// Stored data
+	size_t StoredSize;          /// Size of the stored data
+	size_t Size;                /// Size of the file
+	int Method;                 /// How the data is stored
+};
+
+static const unsigned char *AssetPackData;  /// The mapped pack, NULL if none
+static size_t AssetPackSize;                 /// Size of the pack
+static unsigned AssetPackCount;              /// Number of files of the pack
+static std::string AssetPackRoot;            /// Directory the pack holds
+#ifdef USE_WIN32
+static HANDLE AssetPackFile = INVALID_HANDLE_VALUE;  /// File of the pack
+static HANDLE AssetPackMapping;                      /// Mapping of the pack
+#endif
+
+static unsigned AssetPackRead32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+static uint64_t AssetPackRead64(const unsigned char *p)
+{
+	return AssetPackRead32(p) | ((uint64_t)AssetPackRead32(p + 4) << 32);
+}
+
+/**
+**  Get the name of an index entry of the asset pack.
+*/
+static const char *AssetPackEntryName(unsigned index, size_t *length)
+{
+	const unsigned char *entry = AssetPackData + AssetPackHeaderSize + index * AssetPackEntrySize;
+	const size_t names = AssetPackHeaderSize + AssetPackCount * AssetPackEntrySize;
+
+	*length = AssetPackRead32(entry + 28);
+	return reinterpret_cast<const char *>(AssetPackData + names + AssetPackRead32(entry + 24));
+}
+
+/**
+**  Compare two names like memcmp, the shorter first if one is the start
+**  of the other.
+*/
+static int AssetPackCompare(const char *a, size_t alen, const char *b, size_t blen)
+{
+	const int res = memcmp(a, b, std::min(alen, blen));
+	if (res) {
+		return res;
+	}
+	return alen < blen ? -1 : (alen > blen ? 1 : 0);
+}
+
+/**
+**  Close the asset pack.
+*/
+void CloseAssetPack()
+{
+	if (!AssetPackData) {
+		return;
+	}
+#ifdef USE_WIN32
+	UnmapViewOfFile(AssetPackData);
+	CloseHandle(AssetPackMapping);
+	CloseHandle(AssetPackFile);
+	AssetPackFile = INVALID_HANDLE_VALUE;
+#else
+	munmap(const_cast<unsigned char *>(AssetPackData), AssetPackSize);
+#endif
+	AssetPackData = NULL;
+	AssetPackSize = 0;
+	AssetPackCount = 0;
+}
+
+/**
+**  Check the header and the index of the asset pack.
+*/
+static bool CheckAssetPack()
+{
+	if (AssetPackSize < AssetPackHeaderSize || memcmp(AssetPackData, AssetPackMagic, sizeof(AssetPackMagic))) {
+		return false;
+	}
+	AssetPackCount = AssetPackRead32(AssetPackData + 8);
+	const uint64_t names = AssetPackHeaderSize + (uint64_t)AssetPackCount * AssetPackEntrySize;
+	const uint64_t namesSize = AssetPackRead32(AssetPackData + 12);
+	if (names + namesSize > AssetPackSize) {
+		return false;
+	}
+	const char *previous = NULL;
+	size_t previousLength = 0;
+	for (unsigned i = 0; i < AssetPackCount; ++i) {
+		const unsigned char *entry = AssetPackData + AssetPackHeaderSize + i * AssetPackEntrySize;
+		const uint64_t offset = AssetPackRead64(entry);
+		const uint64_t stored = AssetPackRead64(entry + 8);
+		const uint64_t size = AssetPackRead64(entry + 16);
+		const unsigned method = AssetPackRead32(entry + 32);
+
+		if (offset > AssetPackSize || stored > AssetPackSize - offset
+			|| (uint64_t)AssetPackRead32(entry + 24) + AssetPackRead32(entry + 28) > namesSize) {
+			return false;
+		}
+		// Stored files are used in place, compressed ones are inflated
+		// in one buffer, which uncompress sizes with uLongf.
+		if (method == AssetPackStored) {
+			if (size != stored) {
+				return false;
+			}
+		} else if (method == AssetPackZlib) {
+			if (size > AssetPackMaxInflated || stored > AssetPackMaxInflated) {
+				return false;
+			}
+		} else {
+			return false;
+		}
+		size_t length;
+		const char *name = AssetPackEntryName(i, &length);
+		if (previous && AssetPackCompare(previous, previousLength, name, length) >= 0) {
+			return false;
+		}
+		previous = name;
+		previousLength = length;
+	}
+	return true;
+}
+
+/**
+**  Open the asset pack of a directory.
+**
+**  The files of the pack then stand for the files of the directory of
+**  the pack, and are found before the files on the disk.
+**
+**  @param filename  File name of the pack.
+**
+**  @return          true if the pack is open.
+*/
+bool OpenAssetPack(const std::string &filename)
+{
+	CloseAssetPack();
+
+#ifdef USE_WIN32
+	AssetPackFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (AssetPackFile == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(AssetPackFile, &size) || !size.QuadPart
+		|| !(AssetPackMapping = CreateFileMapping(AssetPackFile, NULL, PAGE_READONLY, 0, 0, NULL))) {
+		CloseHandle(AssetPackFile);
+		AssetPackFile = INVALID_HANDLE_VALUE;
+		return false;
+	}
+	AssetPackData = static_cast<const unsigned char *>(MapViewOfFile(AssetPackMapping, FILE_MAP_READ, 0, 0, 0));
+	if (!AssetPackData) {
+		CloseHandle(AssetPackMapping);
+		CloseHandle(AssetPackFile);
+		AssetPackFile = INVALID_HANDLE_VALUE;
+		return false;
+	}
+	AssetPackSize = size.QuadPart;
+#else
+	const int fd = ::open(filename.c_str(), O_RDONLY | O_BINARY);
+	if (fd == -1) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) || !st.st_size) {
+		::close(fd);
+		return false;
+	}
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+	AssetPackData = static_cast<const unsigned char *>(data);
+	AssetPackSize = st.st_size;
+#endif
+
+	if (!CheckAssetPack()) {
+		fprintf(stderr, "Invalid asset pack '%s'\n", filename.c_str());
+		CloseAssetPack();
+		return false;
+	}
+	const size_t slash = filename.rfind('/');
+	AssetPackRoot = slash == std::string::npos ? "." : filename.substr(0, slash);
+	DebugPrint("Asset pack '%s' with %u files\n" _C_ filename.c_str() _C_ AssetPackCount);
+	return true;
+}
+
+/**
+**  Find a file in the asset pack.
+**
+**  @param file   File name, in the directory of the pack.
+**  @param entry  Set to the file found.
+**
+**  @return       true if found.
+*/
+static bool FindAssetPackFile(const char *file, AssetPackEntry *entry)
+{
+	if (!AssetPackData) {
+		return false;
+	}
+	const size_t rootLength = AssetPackRoot.size();
+	if (!strncmp(file, AssetPackRoot.c_str(), rootLength) && file[rootLength] == '/') {
+		file += rootLength + 1;
+	} else if (AssetPackRoot != "." || *file == '/') {
+		return false;
+	}
+	while (file[0] == '.' && file[1] == '/') {
+		file += 2;
+	}
+	const size_t length = strlen(file);
+	unsigned low = 0;
+	unsigned high = AssetPackCount;
+
+	while (low < high) {
+		const unsigned middle = low + (high - low) / 2;
+		size_t nameLength;
+		const char *name = AssetPackEntryName(middle, &nameLength);
+		const int res = AssetPackCompare(name, nameLength, file, length);
+
+		if (res < 0) {
+			low = middle + 1;
+		} else if (res > 0) {
+			high = middle;
+		} else {
+			if (entry) {
+				const unsigned char *p = AssetPackData + AssetPackHeaderSize + middle * AssetPackEntrySize;
+
+				entry->Data = AssetPackData + AssetPackRead64(p);
+				entry->StoredSize = AssetPackRead64(p + 8);
+				entry->Size = AssetPackRead64(p + 16);
+				entry->Method = AssetPackRead32(p + 32);
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
 class CFile::PImpl
 {
 public:
@@ -73,9 +350,15 @@ private:
 	PImpl(const PImpl &rhs); // No implementation
 	const PImpl &operator = (const PImpl &rhs); // No implementation
 
+	bool openPack(const char *name);
+
 private:
 	int   cl_type;   /// type of CFile
 	FILE *cl_plain;  /// standard file pointer
+	const unsigned char *cl_pack;              /// data of a file of the asset pack
+	size_t cl_pack_size;                       /// size of the data
+	size_t cl_pack_pos;                        /// read position in the data
+	std::vector<unsigned char> cl_pack_buffer; /// inflated data of a compressed file
 #ifdef USE_ZLIB
 	gzFile cl_gz;    /// gzip file pointer
 #endif // !USE_ZLIB
@@ -198,6 +481,9 @@ int CFile::printf(const char *format, ...)
 CFile::PImpl::PImpl()
 {
 	cl_type = CLF_TYPE_INVALID;
+	cl_pack = NULL;
+	cl_pack_size = 0;
+	cl_pack_pos = 0;
 }
 
 CFile::PImpl::~PImpl()
@@ -256,6 +542,44 @@ static void bzseek(BZFILE *file, unsigned offset, int)
 
 #endif // USE_BZ2LIB
 
+/**
+**  Open a file of the asset pack.
+**
+**  Stored files are read from the mapped pack, compressed files are
+**  inflated once.
+**
+**  @param name  File name.
+**
+**  @return      true if the file is in the pack.
+*/
+bool CFile::PImpl::openPack(const char *name)
+{
+	AssetPackEntry entry;
+
+	if (!FindAssetPackFile(name, &entry)) {
+		return false;
+	}
+	if (entry.Method == AssetPackStored || !entry.Size) {
+		cl_pack = entry.Data;
+#ifdef USE_ZLIB
+	} else if (entry.Method == AssetPackZlib) {
+		cl_pack_buffer.resize(entry.Size);
+		uLongf size = entry.Size;
+		if (uncompress(&cl_pack_buffer[0], &size, entry.Data, entry.StoredSize) != Z_OK || size != entry.Size) {
+			fprintf(stderr, "Can't inflate '%s' from the asset pack\n", name);
+			std::vector<unsigned char>().swap(cl_pack_buffer);
+			return false;
+		}
+		cl_pack = &cl_pack_buffer[0];
+#endif
+	} else {
+		return false;
+	}
+	cl_pack_size = entry.Size;
+	cl_pack_pos = 0;
+	return true;
+}
+
 int CFile::PImpl::open(const char *name, long openflags)
 {
 	char buf[512];
@@ -291,6 +615,8 @@ int CFile::PImpl::open(const char *name, long openflags)
 				if ((cl_plain = fopen(name, openstring))) {
 					cl_type = CLF_TYPE_PLAIN;
 				}
+	} else if (openPack(name)) {
+		cl_type = CLF_TYPE_PACK;
 	} else {
 		if (!(cl_plain = fopen(name, openstring))) { // try plain first
 #ifdef USE_ZLIB
@@ -356,6 +682,11 @@ int CFile::PImpl::close()
 		if (tp == CLF_TYPE_PLAIN) {
 			ret = fclose(cl_plain);
 		}
+		if (tp == CLF_TYPE_PACK) {
+			cl_pack = NULL;
+			std::vector<unsigned char>().swap(cl_pack_buffer);
+			ret = 0;
+		}
 #ifdef USE_ZLIB
 		if (tp == CLF_TYPE_GZIP) {
 			ret = gzclose(cl_gz);
@@ -382,6 +713,11 @@ int CFile::PImpl::read(void *buf, size_t len)
 		if (cl_type == CLF_TYPE_PLAIN) {
 			ret = fread(buf, 1, len, cl_plain);
 		}
+		if (cl_type == CLF_TYPE_PACK) {
+			ret = std::min(len, cl_pack_size - cl_pack_pos);
+			memcpy(buf, cl_pack + cl_pack_pos, ret);
+			cl_pack_pos += ret;
+		}
 #ifdef USE_ZLIB
 		if (cl_type == CLF_TYPE_GZIP) {
 			ret = gzread(cl_gz, buf, len);
@@ -453,6 +789,18 @@ int CFile::PImpl::seek(long offset, int whence)
 		if (tp == CLF_TYPE_PLAIN) {
 			ret = fseek(cl_plain, offset, whence);
 		}
+		if (tp == CLF_TYPE_PACK) {
+			long pos = offset;
+			if (whence == SEEK_CUR) {
+				pos += cl_pack_pos;
+			} else if (whence == SEEK_END) {
+				pos += cl_pack_size;
+			}
+			if (pos >= 0 && (size_t)pos <= cl_pack_size) {
+				cl_pack_pos = pos;
+				ret = 0;
+			}
+		}
 #ifdef USE_ZLIB
 		if (tp == CLF_TYPE_GZIP) {
 			ret = gzseek(cl_gz, offset, whence);
@@ -479,6 +827,9 @@ long CFile::PImpl::tell()
 		if (tp == CLF_TYPE_PLAIN) {
 			ret = ftell(cl_plain);
 		}
+		if (tp == CLF_TYPE_PACK) {
+			ret = cl_pack_pos;
+		}
 #ifdef USE_ZLIB
 		if (tp == CLF_TYPE_GZIP) {
 			ret = gztell(cl_gz);
@@ -508,6 +859,9 @@ long CFile::PImpl::tell()
 */
 static bool FindFileWithExtension(char(&file)[PATH_MAX])
 {
+	if (FindAssetPackFile(file, NULL)) {
+		return true;
+	}
 	if (!access(file, R_OK)) {
 		return true;
 	}
@@ -642,7 +996,7 @@ bool CanAccessFile(const char *filename)
 		char name[PATH_MAX];
 		name[0] = '\0';
 		LibraryFileName(filename, name);
-		return (name[0] != '\0' && 0 == access(name, R_OK));
+		return (name[0] != '\0' && (FindAssetPackFile(name, NULL) || 0 == access(name, R_OK)));
 	}
 	return false;
 }
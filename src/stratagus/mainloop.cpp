@@ -42,9 +42,11 @@
 #include "missile.h"
 #include "network.h"
 #include "particle.h"
+#include "profile.h"
 #include "replay.h"
 #include "results.h"
 #include "sound.h"
+#include "synchash.h"
 #include "translate.h"
 #include "trigger.h"
 #include "ui.h"
@@ -165,6 +167,10 @@ void DrawMapArea()
 **
 **  This functions updates everything on screen. The map, the gui, the
 **  cursors.
+**
+**  Everything is drawn again, but only the areas which changed since the
+**  last frame are invalidated: each drawing function marks what it drew
+**  with InvalidateDrawnArea or InvalidateArea.
 */
 void UpdateDisplay()
 {
@@ -175,7 +181,10 @@ void UpdateDisplay()
 #else
 		Video.FillRectangleClip(ColorBlack, 0, 0, Video.Width, Video.Height);
 #endif
-		DrawMapArea();
+		{
+			CProfileScope scope(ProfileViewports);
+			DrawMapArea();
+		}
 		DrawMessages();
 
 		if (CursorState == CursorStateRectangle) {
@@ -192,6 +201,9 @@ void UpdateDisplay()
 											 UI.Fillers[i].G->Width,
 											 UI.Fillers[i].G->Height,
 											 UI.Fillers[i].X, UI.Fillers[i].Y);
+				InvalidateDrawnArea(&UI.Fillers[i], 0, DrawnAreaKey(0, UI.Fillers[i].G),
+									UI.Fillers[i].X, UI.Fillers[i].Y,
+									UI.Fillers[i].G->Width, UI.Fillers[i].G->Height);
 			}
 			DrawMenuButtonArea();
 			DrawUserDefinedButtons();
@@ -213,14 +225,11 @@ void UpdateDisplay()
 
 	DrawGuichanWidgets();
 
+	DrawProfileOverlay();
+
 	if (CursorState != CursorStateRectangle) {
 		DrawCursor();
 	}
-
-	//
-	// Update changes to display.
-	//
-	Invalidate();
 }
 
 static void InitGameCallbacks()
@@ -241,6 +250,8 @@ static void GameLogicLoop()
 	// FIXME: We need find better place!
 	SaveGameLoading = false;
 
+	CProfileTimer timer;
+
 	//
 	// Game logic part
 	//
@@ -249,11 +260,17 @@ static void GameLogicLoop()
 		++GameCycle;
 		MultiPlayerReplayEachCycle();
 		NetworkCommands(); // Get network commands
+		timer.Lap(ProfileNetwork);
 		TriggersEachCycle();// handle triggers
+		timer.Lap(ProfileTriggers);
 		UnitActions();      // handle units
+		timer.Lap(ProfileUnits);
 		MissileActions();   // handle missiles
+		timer.Lap(ProfileMissiles);
 		PlayersEachCycle(); // handle players
+		SyncHashesEachCycle(); // detailed sync hashes, if enabled
 		UpdateTimer();      // update game timer
+		timer.Lap(ProfilePlayers);
 
 
 		//
@@ -304,19 +321,23 @@ static void GameLogicLoop()
 			UI.StatusLine.Set(_("Autosave"));
 			SaveGame("autosave.sav");
 		}
+		timer.Lap(ProfileEachSecond);
 	}
 
 	UpdateMessages();     // update messages
 	ParticleManager.update(); // handle particles
 	CheckMusicFinished(); // Check for next song
+	timer.Lap(ProfileParticles);
 
 	if (FastForwardCycle <= GameCycle || !(GameCycle & 0x3f)) {
 		WaitEventsOneFrame();
 	}
+	timer.Lap(ProfileWait);
 
 	if (!NetworkInSync) {
 		NetworkRecover(); // recover network
 	}
+	timer.Lap(ProfileNetwork);
 }
 
 //#define REALVIDEO
@@ -342,6 +363,7 @@ static void DisplayLoop()
 	 *	FIXME: still not secure
 	 */
 	if (UI.Minimap.UpdateCache) {
+		CProfileScope scope(ProfileMinimap);
 		UI.Minimap.Update();
 		UI.Minimap.UpdateCache = false;
 	}
@@ -363,14 +385,20 @@ static void DisplayLoop()
 		//FIXME: this might be better placed somewhere at front of the
 		// program, as we now still have a game on the background and
 		// need to go through the game-menu or supply a map file
-		UpdateDisplay();
+		{
+			CProfileScope scope(ProfileInterface);
+			UpdateDisplay();
+		}
 
 		//
 		// If double-buffered mode, we will display the contains of
 		// VideoMemory. If direct mode this does nothing. In X11 it does
 		// XFlush
 		//
-		RealizeVideoMemory();
+		{
+			CProfileScope scope(ProfileRealize);
+			RealizeVideoMemory();
+		}
 	}
 #ifdef REALVIDEO
 	if (FastForwardCycle == GameCycle) {
@@ -382,6 +410,7 @@ static void DisplayLoop()
 static void SingleGameLoop()
 {
 	while (GameRunning) {
+		ProfileNextFrame();
 		DisplayLoop();
 		GameLogicLoop();
 	}
@@ -0,0 +1,377 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name profile.cpp - The frame profiler. */
+//
+//      (c) Copyright 2026 by the Stratagus Team
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+//@{
+
+//----------------------------------------------------------------------------
+// Documentation
+//----------------------------------------------------------------------------
+
+/**
+** @page ProfileModule Module - Frame profiler
+**
+** The main loop times the phases of each frame (see ::ProfilePhase) with
+** ::CProfileTimer and ::CProfileScope. For each phase the time of the last
+** frames is kept in a ring buffer, and the last timed phases are kept
+** with their start for a trace.
+**
+** ALT+R or CTRL+R shows an overlay with the mean and worst time of each
+** phase and a graph of the last frame times. From Lua, SetProfiling(true)
+** records without the overlay, DumpProfile(file) writes the frames as CSV
+** and DumpProfileTrace(file) writes a trace for chrome://tracing.
+**
+** Nothing is timed when ::ProfileEnabled is false.
+*/
+
+//----------------------------------------------------------------------------
+// Includes
+//----------------------------------------------------------------------------
+
+#include "stratagus.h"
+
+#include "profile.h"
+
+#include "font.h"
+#include "script.h"
+#include "ui.h"
+#include "video.h"
+
+#ifdef USE_WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+//----------------------------------------------------------------------------
+// Variables
+//----------------------------------------------------------------------------
+
+bool ProfileEnabled;               /// Time the phases of the frames
+
+static bool ProfileOverlay;        /// Show the profiler overlay
+static bool ProfileRecording;      /// Time the phases without the overlay
+
+static const char *const ProfilePhaseNames[ProfilePhaseCount] = {
+	"Network", "Triggers", "Units", "Missiles", "Players", "EachSecond", "Particles",
+	"Minimap", "Viewports", "Fog", "Interface", "Realize", "Wait"
+};
+
+/**
+**  A timed phase kept for the trace.
+*/
+struct ProfileEvent {
+	uint64_t Begin;     /// Start in nanoseconds
+	uint32_t Duration;  /// Duration in nanoseconds
+	int Phase;          /// The phase
+};
+
+static const int ProfileFrameCount = 256;    /// Frames kept in the ring buffers
+static const int ProfileEventCount = 16384;  /// Timed phases kept for the trace
+static const int ProfileOverlayFrames = 64;  /// Frames summed up by the overlay
+
+static uint32_t ProfileFrameTime[ProfileFrameCount];                    /// Frame time in microseconds
+static uint32_t ProfilePhaseTime[ProfileFrameCount][ProfilePhaseCount]; /// Phase time in microseconds
+static unsigned long ProfileFrames;                                     /// Frames finished
+static uint64_t ProfileFrameBegin;                                      /// Start of the current frame
+static uint64_t ProfilePhaseSum[ProfilePhaseCount];                     /// Phase time of the current frame
+
+static ProfileEvent ProfileEvents[ProfileEventCount];  /// Last timed phases
+static unsigned long ProfileEventTotal;                /// Phases timed
+
+//----------------------------------------------------------------------------
+// Functions
+//----------------------------------------------------------------------------
+
+/**
+**  Current time in nanoseconds.
+**
+**  Only differences are meaningful. Never returns 0.
+*/
+uint64_t ProfileTicks()
+{
+#ifdef USE_WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+
+	if (!frequency.QuadPart) {
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&counter);
+	const uint64_t c = counter.QuadPart;
+	const uint64_t f = frequency.QuadPart;
+	return (c / f) * 1000000000ULL + (c % f) * 1000000000ULL / f + 1;
+#else
+	timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec + 1;
+#endif
+}
+
+/**
+**  Record a time spent in a phase.
+**
+**  @param phase  The phase.
+**  @param begin  Start of the phase.
+**  @param end    End of the phase.
+*/
+void ProfileAdd(ProfilePhase phase, uint64_t begin, uint64_t end)
+{
+	ProfilePhaseSum[phase] += end - begin;
+
+	ProfileEvent &event = ProfileEvents[ProfileEventTotal % ProfileEventCount];
+	event.Begin = begin;
+	event.Duration = uint32_t(std::min<uint64_t>(end - begin, 0xffffffff));
+	event.Phase = phase;
+	++ProfileEventTotal;
+}
+
+/**
+**  Start a new frame.
+**
+**  The times of the phases of the finished frame go into the ring
+**  buffers.
+*/
+void ProfileNextFrame()
+{
+	ProfileEnabled = ProfileOverlay || ProfileRecording;
+	if (!ProfileEnabled) {
+		ProfileFrameBegin = 0;
+		return;
+	}
+	const uint64_t now = ProfileTicks();
+
+	if (ProfileFrameBegin) {
+		const int index = ProfileFrames % ProfileFrameCount;
+
+		ProfileFrameTime[index] = uint32_t((now - ProfileFrameBegin) / 1000);
+		for (int i = 0; i < ProfilePhaseCount; ++i) {
+			ProfilePhaseTime[index][i] = uint32_t(ProfilePhaseSum[i] / 1000);
+		}
+		++ProfileFrames;
+	}
+	memset(ProfilePhaseSum, 0, sizeof(ProfilePhaseSum));
+	ProfileFrameBegin = now;
+}
+
+/**
+**  Show or hide the profiler overlay.
+*/
+void ToggleProfileOverlay()
+{
+	ProfileOverlay = !ProfileOverlay;
+}
+
+/**
+**  Draw the profiler overlay.
+**
+**  Shows the mean and worst time of the frames and of each phase over
+**  the last frames, and a graph of the frame times.
+*/
+void DrawProfileOverlay()
+{
+	if (!ProfileOverlay) {
+		return;
+	}
+	const int frames = std::min<unsigned long>(ProfileFrames, ProfileOverlayFrames);
+	uint64_t frameSum = 0;
+	uint32_t frameMax = 0;
+	uint64_t phaseSum[ProfilePhaseCount] = {};
+	uint32_t phaseMax[ProfilePhaseCount] = {};
+
+	for (int i = 0; i < frames; ++i) {
+		const int index = (ProfileFrames - 1 - i) % ProfileFrameCount;
+
+		frameSum += ProfileFrameTime[index];
+		frameMax = std::max(frameMax, ProfileFrameTime[index]);
+		for (int j = 0; j < ProfilePhaseCount; ++j) {
+			phaseSum[j] += ProfilePhaseTime[index][j];
+			phaseMax[j] = std::max(phaseMax[j], ProfilePhaseTime[index][j]);
+		}
+	}
+
+	CLabel label(GetSmallFont());
+	const int lineHeight = GetSmallFont().Height() + 1;
+	const int graphFrames = 128;
+	const int graphHeight = 40;
+	const int x = UI.MapArea.X + 8;
+	const int y = UI.MapArea.Y + 8;
+	const int w = std::max(graphFrames, 160) + 8;
+	const int h = (ProfilePhaseCount + 1) * lineHeight + graphHeight + 12;
+	char buf[128];
+
+	Video.FillTransRectangleClip(ColorBlack, x, y, w, h, 160);
+	// The figures change every frame.
+	InvalidateDrawnArea(ProfileFrameTime, 0, uint64_t(FrameCounter), x, y, w, h);
+
+	snprintf(buf, sizeof(buf), "Frame %.2f ms, max %.2f",
+			 frames ? frameSum / 1000.0 / frames : 0.0, frameMax / 1000.0);
+	label.DrawClip(x + 4, y + 4, buf);
+	for (int i = 0; i < ProfilePhaseCount; ++i) {
+		snprintf(buf, sizeof(buf), "%s %.2f, max %.2f", ProfilePhaseNames[i],
+				 frames ? phaseSum[i] / 1000.0 / frames : 0.0, phaseMax[i] / 1000.0);
+		label.DrawClip(x + 4, y + 4 + (i + 1) * lineHeight, buf);
+	}
+
+	// Frame times, 2 pixels per millisecond, red above the frame budget.
+	const int graphY = y + h - 4;
+	const uint32_t budget = 1000000 / FRAMES_PER_SECOND;
+	const int shown = std::min<unsigned long>(ProfileFrames, graphFrames);
+	for (int i = 0; i < shown; ++i) {
+		const uint32_t time = ProfileFrameTime[(ProfileFrames - shown + i) % ProfileFrameCount];
+		const int height = std::min<int>(time / 500, graphHeight);
+
+		Video.DrawVLineClip(time > budget ? ColorRed : ColorGreen, x + 4 + i, graphY - height, height);
+	}
+}
+
+/**
+**  Write the time of each phase of the last frames as CSV.
+**
+**  @param filename  File to write.
+**
+**  @return          true if written.
+*/
+bool DumpProfileCSV(const std::string &filename)
+{
+	FILE *fd = fopen(filename.c_str(), "wb");
+	if (!fd) {
+		fprintf(stderr, "Can't save to '%s'\n", filename.c_str());
+		return false;
+	}
+	fprintf(fd, "frame,total");
+	for (int i = 0; i < ProfilePhaseCount; ++i) {
+		fprintf(fd, ",%s", ProfilePhaseNames[i]);
+	}
+	fprintf(fd, "\n");
+
+	const unsigned long first = ProfileFrames - std::min<unsigned long>(ProfileFrames, ProfileFrameCount);
+	for (unsigned long frame = first; frame < ProfileFrames; ++frame) {
+		const int index = frame % ProfileFrameCount;
+
+		fprintf(fd, "%lu,%.3f", frame, ProfileFrameTime[index] / 1000.0);
+		for (int i = 0; i < ProfilePhaseCount; ++i) {
+			fprintf(fd, ",%.3f", ProfilePhaseTime[index][i] / 1000.0);
+		}
+		fprintf(fd, "\n");
+	}
+	fclose(fd);
+	return true;
+}
+
+/**
+**  Write the last timed phases as a trace for chrome://tracing.
+**
+**  @param filename  File to write.
+**
+**  @return          true if written.
+*/
+bool DumpProfileTrace(const std::string &filename)
+{
+	FILE *fd = fopen(filename.c_str(), "wb");
+	if (!fd) {
+		fprintf(stderr, "Can't save to '%s'\n", filename.c_str());
+		return false;
+	}
+	const unsigned long first = ProfileEventTotal - std::min<unsigned long>(ProfileEventTotal, ProfileEventCount);
+	const uint64_t origin = first < ProfileEventTotal ? ProfileEvents[first % ProfileEventCount].Begin : 0;
+
+	fprintf(fd, "{\"traceEvents\":[\n");
+	for (unsigned long i = first; i < ProfileEventTotal; ++i) {
+		const ProfileEvent &event = ProfileEvents[i % ProfileEventCount];
+
+		fprintf(fd, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}%s\n",
+				ProfilePhaseNames[event.Phase], (event.Begin - origin) / 1000.0, event.Duration / 1000.0,
+				i + 1 < ProfileEventTotal ? "," : "");
+	}
+	fprintf(fd, "]}\n");
+	fclose(fd);
+	return true;
+}
+
+/**
+**  Time the frames without showing the overlay.
+**
+**  @param l  Lua state.
+*/
+static int CclSetProfiling(lua_State *l)
+{
+	LuaCheckArgs(l, 1);
+	ProfileRecording = LuaToBoolean(l, 1);
+	return 0;
+}
+
+/**
+**  Show or hide the profiler overlay.
+**
+**  @param l  Lua state.
+*/
+static int CclSetShowProfile(lua_State *l)
+{
+	LuaCheckArgs(l, 1);
+	ProfileOverlay = LuaToBoolean(l, 1);
+	return 0;
+}
+
+/**
+**  Write the time of each phase of the last frames as CSV.
+**
+**  @param l  Lua state.
+*/
+static int CclDumpProfile(lua_State *l)
+{
+	LuaCheckArgs(l, 1);
+	lua_pushboolean(l, DumpProfileCSV(LuaToString(l, 1)));
+	return 1;
+}
+
+/**
+**  Write the last timed phases as a trace for chrome://tracing.
+**
+**  @param l  Lua state.
+*/
+static int CclDumpProfileTrace(lua_State *l)
+{
+	LuaCheckArgs(l, 1);
+	lua_pushboolean(l, DumpProfileTrace(LuaToString(l, 1)));
+	return 1;
+}
+
+/**
+**  Register the profiler functions with Lua.
+*/
+void ProfileCclRegister()
+{
+	lua_register(Lua, "SetProfiling", CclSetProfiling);
+	lua_register(Lua, "SetShowProfile", CclSetShowProfile);
+	lua_register(Lua, "DumpProfile", CclDumpProfile);
+	lua_register(Lua, "DumpProfileTrace", CclDumpProfileTrace);
+}
+
+//@}
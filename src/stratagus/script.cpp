@@ -183,24 +183,143 @@ static bool GetFileContent(const std::string &file, std::string &content)
 		return false;
 	}
 
-	const int size = 10000;
-	std::vector<char> buf;
-	buf.resize(size);
-	int location = 0;
+	// Size the buffer up front when the file can tell its size,
+	// compressed files grow it instead.
+	size_t size = 0;
+	if (fp.seek(0, SEEK_END) == 0) {
+		const long end = fp.tell();
+		if (end >= 0 && fp.seek(0, SEEK_SET) == 0) {
+			size = end;
+		}
+	}
+	content.resize(std::max<size_t>(size + 1, 4096));
+	size_t location = 0;
 	for (;;) {
-		int read = fp.read(&buf[location], size);
-		if (read != size) {
-			location += read;
+		const int read = fp.read(&content[location], content.size() - location);
+		if (read <= 0) {
 			break;
 		}
 		location += read;
-		buf.resize(buf.size() + size);
+		if (location == content.size()) {
+			content.resize(content.size() * 2);
+		}
 	}
 	fp.close();
-	content.assign(&buf[0], location);
+	content.resize(location);
 	return true;
 }
 
+/**
+**  Hash of a script for the bytecode cache, FNV-1a.
+*/
+static uint64_t LuaCacheHash(const std::string &s, uint64_t hash = 14695981039346656037ULL)
+{
+	for (size_t i = 0; i < s.size(); ++i) {
+		hash = (hash ^ (unsigned char)s[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+**  Get the file of the bytecode cache of a script.
+**
+**  Files of the user directory, like save games, are not cached.
+**
+**  @param file  Script file.
+**
+**  @return      Cache file, empty if not cached.
+*/
+static std::string LuaCacheFileName(const std::string &file)
+{
+	const std::string &userDirectory = Parameters::Instance.GetUserDirectory();
+
+	if (userDirectory.empty() || !file.compare(0, userDirectory.size(), userDirectory)) {
+		return "";
+	}
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.luac", (unsigned long long)LuaCacheHash(file));
+	return userDirectory + "/cache/lua/" + name;
+}
+
+/// Writer of lua_dump
+static int LuaCacheWriter(lua_State *, const void *p, size_t size, void *data)
+{
+	static_cast<std::string *>(data)->append(static_cast<const char *>(p), size);
+	return 0;
+}
+
+/**
+**  Load a script as a chunk, using the bytecode cache.
+**
+**  The cache file of a script holds the hash of the source it was
+**  compiled from, the chunk is compiled and the cache file rewritten when
+**  the source changes. Lua rejects bytecode of another version or
+**  platform, the source is compiled then.
+**
+**  @param content  Source of the script.
+**  @param file     Script file.
+**
+**  @return         Status of luaL_loadbuffer.
+*/
+static int LuaLoadChunk(const std::string &content, const std::string &file)
+{
+	const std::string cacheFile = LuaCacheFileName(file);
+	if (cacheFile.empty()) {
+		return luaL_loadbuffer(Lua, content.c_str(), content.size(), file.c_str());
+	}
+	char header[32];
+	snprintf(header, sizeof(header), "%s %016llx\n", LUA_VERSION, (unsigned long long)LuaCacheHash(content));
+
+	std::string cache;
+	FILE *fd = fopen(cacheFile.c_str(), "rb");
+	if (fd) {
+		char buf[4096];
+		size_t read;
+		while ((read = fread(buf, 1, sizeof(buf), fd)) > 0) {
+			cache.append(buf, read);
+		}
+		fclose(fd);
+	}
+	const size_t headerSize = strlen(header);
+	if (cache.size() > headerSize && !cache.compare(0, headerSize, header)) {
+		if (!luaL_loadbuffer(Lua, cache.data() + headerSize, cache.size() - headerSize, file.c_str())) {
+			return 0;
+		}
+		lua_pop(Lua, 1); // error message
+	}
+
+	const int status = luaL_loadbuffer(Lua, content.c_str(), content.size(), file.c_str());
+	if (status) {
+		return status;
+	}
+	cache = header;
+#if LUA_VERSION_NUM >= 503
+	const int dumped = lua_dump(Lua, LuaCacheWriter, &cache, 0);
+#else
+	const int dumped = lua_dump(Lua, LuaCacheWriter, &cache);
+#endif
+	if (dumped == 0) {
+		const std::string directory = Parameters::Instance.GetUserDirectory() + "/cache";
+		makedir(directory.c_str(), 0777);
+		makedir((directory + "/lua").c_str(), 0777);
+
+		// Write to another file first, a script loaded twice at the same
+		// time must not read half a cache file.
+		const std::string tmpFile = cacheFile + ".tmp";
+		fd = fopen(tmpFile.c_str(), "wb");
+		if (fd) {
+			const bool written = fwrite(cache.data(), 1, cache.size(), fd) == cache.size();
+			if (fclose(fd) == 0 && written) {
+				remove(cacheFile.c_str());
+				rename(tmpFile.c_str(), cacheFile.c_str());
+			} else {
+				remove(tmpFile.c_str());
+			}
+		}
+	}
+	return 0;
+}
+
 /**
 **  Load a file and execute it
 **
@@ -225,7 +344,7 @@ int LuaLoadFile(const std::string &file, const std::string &strArg)
 		// https://github.com/Wargus/stratagus/issues/196, disable for now.
 		FileChecksums = 0;
 	}
-	const int status = luaL_loadbuffer(Lua, content.c_str(), content.size(), file.c_str());
+	const int status = LuaLoadChunk(content, file);
 
 	if (!status) {
 		if (!strArg.empty()) {
@@ -2404,7 +2523,7 @@ void LoadCcl(const std::string &filename, const std::string &luaArgStr)
 	//  Load and evaluate configuration file
 	CclInConfigFile = 1;
 	const std::string name = LibraryFileName(filename.c_str());
-	if (access(name.c_str(), R_OK)) {
+	if (!CanAccessFile(filename.c_str())) {
 		fprintf(stderr, "Maybe you need to specify another gamepath with '-d /path/to/datadir'?\n");
 		ExitFatal(-1);
 	}
@@ -195,6 +195,7 @@ extern void beos_init(int argc, char **argv);
 #include "results.h"
 #include "settings.h"
 #include "sound_server.h"
+#include "synchash.h"
 #include "title.h"
 #include "translate.h"
 #include "ui.h"
@@ -418,6 +419,7 @@ void Exit(int err)
 			   (SlowFrameCounter * 100) / (FrameCounter ? FrameCounter : 1));
 	lua_settop(Lua, 0);
 	lua_close(Lua);
+	CloseAssetPack();
 	DeInitVideo();
 
 	fprintf(stdout, "%s", _("Thanks for playing Stratagus.\n"));
@@ -470,6 +472,7 @@ static void Usage()
 		"\t-u userpath\tPath where stratagus saves preferences, log and savegame\n"
 		"\t-v mode\t\tVideo mode resolution in format <xres>x<yres>\n"
 		"\t-W\t\tWindowed video mode\n"
+		"\t-y\t\tEnables detailed sync hashes and desync dumps (for debugging)\n"
 #if defined(USE_OPENGL) || defined(USE_GLES)
 		"\t-x idx\t\tControls fullscreen scaling if your graphics card supports shaders.\n"\
 		"\t  \t\tPass a number to select a shader in your shaders directory by index (starting at 0).\n"\
@@ -523,7 +526,7 @@ void ParseCommandLine(int argc, char **argv, Parameters &parameters)
 {
 	char *sep;
 	for (;;) {
-		switch (getopt(argc, argv, "ac:d:D:eE:FG:hiI:lN:oOP:ps:S:u:v:Wx:Z:?-")) {
+		switch (getopt(argc, argv, "ac:d:D:eE:FG:hiI:lN:oOP:ps:S:u:v:Wx:yZ:?-")) {
 			case 'a':
 				EnableAssert = true;
 				continue;
@@ -632,6 +635,9 @@ void ParseCommandLine(int argc, char **argv, Parameters &parameters)
 				VideoForceFullScreen = 1;
 				Video.FullScreen = 0;
 				continue;
+			case 'y':
+				EnableSyncDebug = true;
+				continue;
 #if defined(USE_OPENGL) || defined(USE_GLES)
 			case 'x':
 				Video.ShaderIndex = atoi(optarg);
@@ -753,6 +759,8 @@ int stratagusMain(int argc, char **argv)
 
 	makedir(parameters.GetUserDirectory().c_str(), 0777);
 
+	OpenAssetPack(StratagusLibPath + "/data.pak");
+
 	// Init Lua and register lua functions!
 	InitLua();
 	LuaRegisterModules();
@@ -607,6 +607,8 @@ void DrawPopup(const ButtonAction &button, const CUIButton &uibutton, int x, int
 			content.Draw(x + content.pos.x, y + content.pos.y, *popup, popupWidth, button, Costs);
 		}
 	}
+	// The contents follow the player state: redraw the popup every frame.
+	InvalidateDrawnArea(popup, 0, uint64_t(FrameCounter), x, y, popupWidth + 1, popupHeight + 1);
 
 #if 0 // Fixme: need to remove soon
 	switch (button.Action) {
@@ -724,6 +726,40 @@ void DrawPopup(const ButtonAction &button, const CUIButton &uibutton, int x, int
 #endif
 }
 
+/**
+**  Invalidate the area of the button panel.
+**
+**  The buttons follow the selected units, the cooldowns and the resources
+**  of the player: the background and all the buttons are invalidated every
+**  frame.
+*/
+static void InvalidateButtonPanel()
+{
+	PixelPos topLeft(UI.ButtonPanel.X, UI.ButtonPanel.Y);
+	PixelPos bottomRight(topLeft);
+
+	if (UI.ButtonPanel.G) {
+		bottomRight.x += UI.ButtonPanel.G->Width;
+		bottomRight.y += UI.ButtonPanel.G->Height;
+	}
+	for (size_t i = 0; i != UI.ButtonPanel.Buttons.size(); ++i) {
+		const CUIButton &button = UI.ButtonPanel.Buttons[i];
+
+		if (button.Style == NULL) {
+			continue;
+		}
+		PixelPos pos;
+		PixelSize size;
+
+		GetUnitIconArea(*button.Style, PixelPos(button.X, button.Y), pos, size);
+		topLeft.x = std::min(topLeft.x, pos.x);
+		topLeft.y = std::min(topLeft.y, pos.y);
+		bottomRight.x = std::max(bottomRight.x, pos.x + size.x);
+		bottomRight.y = std::max(bottomRight.y, pos.y + size.y);
+	}
+	InvalidateArea(topLeft.x, topLeft.y, bottomRight.x - topLeft.x, bottomRight.y - topLeft.y);
+}
+
 /**
 **  Draw button panel.
 **
@@ -737,6 +773,7 @@ void CButtonPanel::Draw()
 									  UI.ButtonPanel.G->Width, UI.ButtonPanel.G->Height,
 									  UI.ButtonPanel.X, UI.ButtonPanel.Y);
 	}
+	InvalidateButtonPanel();
 
 	// No buttons
 	if (CurrentButtons.empty()) {
@@ -250,6 +250,43 @@ void CIcon::DrawUnitIcon(const ButtonStyle &style, unsigned flags,
 	}
 }
 
+/**
+**  Get the screen area where DrawUnitIcon draws, with its border and
+**  icon frame.
+**
+**  @param style     Button style
+**  @param pos       display pixel position
+**  @param areaPos   Returns the top left corner of the area.
+**  @param areaSize  Returns the size of the area.
+*/
+void GetUnitIconArea(const ButtonStyle &style, const PixelPos &pos, PixelPos &areaPos, PixelSize &areaSize)
+{
+	// Auto cast icons get a border of 2 pixels, shifted icons 4 pixels.
+	int margin = std::max(std::max(style.Default.BorderSize, style.Hover.BorderSize),
+						  std::max(style.Clicked.BorderSize, 2));
+	if (Preference.IconsShift) {
+		margin = std::max(margin, 4);
+	}
+	PixelPos topLeft(pos.x - margin, pos.y - margin);
+	PixelPos bottomRight(pos.x + style.Width + margin, pos.y + style.Height + margin);
+
+	if (Preference.IconsShift && Preference.IconFrameG && Preference.PressedIconFrameG) {
+		const CGraphic *frames[] = {Preference.IconFrameG, Preference.PressedIconFrameG};
+
+		for (int i = 0; i < 2; ++i) {
+			const int xoffset = (style.Width - frames[i]->Width) / 2;
+			const int yoffset = (style.Height - frames[i]->Height) / 2;
+
+			topLeft.x = std::min(topLeft.x, pos.x + xoffset);
+			topLeft.y = std::min(topLeft.y, pos.y + yoffset);
+			bottomRight.x = std::max(bottomRight.x, pos.x + xoffset + frames[i]->Width + 1);
+			bottomRight.y = std::max(bottomRight.y, pos.y + yoffset + frames[i]->Height + 1);
+		}
+	}
+	areaPos = topLeft;
+	areaSize = bottomRight - topLeft;
+}
+
 /**
 **  Load the Icon
 */
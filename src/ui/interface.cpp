@@ -44,6 +44,7 @@
 #include "iolib.h"
 #include "network.h"
 #include "player.h"
+#include "profile.h"
 #include "replay.h"
 #include "sound.h"
 #include "sound_server.h"
@@ -670,6 +671,13 @@ static bool CommandKey(int key)
 			UiTogglePause();
 			break;
 
+		case 'r': // ALT+R, CTRL+R Toggle profiler overlay
+			if (!(KeyModifiers & (ModifierAlt | ModifierControl))) {
+				break;
+			}
+			ToggleProfileOverlay();
+			break;
+
 		case 's': // CTRL+S - Turn sound on / off
 			if (KeyModifiers & ModifierControl) {
 				UiToggleSound();
@@ -70,38 +70,44 @@
 --  UI BUTTONS
 ----------------------------------------------------------------------------*/
 
+/**
+**  Draw a button of the user interface and invalidate it when it changed.
+**
+**  @param button  Button to draw.
+**  @param flags   State of Button (clicked, mouse over...)
+*/
+static void DrawUIButtonArea(CUIButton &button, unsigned flags)
+{
+	DrawUIButton(button.Style, flags, button.X, button.Y, button.Text);
+	InvalidateUIButton(&button, *button.Style, flags, button.X, button.Y, button.Text);
+}
+
 static void DrawMenuButtonArea_noNetwork()
 {
 	if (UI.MenuButton.X != -1) {
-		DrawUIButton(UI.MenuButton.Style,
-					 (ButtonAreaUnderCursor == ButtonAreaMenu
-					  && ButtonUnderCursor == ButtonUnderMenu ? MI_FLAGS_ACTIVE : 0) |
-					 (GameMenuButtonClicked ? MI_FLAGS_CLICKED : 0),
-					 // (UI.MenuButton.Clicked ? MI_FLAGS_CLICKED : 0),
-					 UI.MenuButton.X, UI.MenuButton.Y,
-					 UI.MenuButton.Text);
+		DrawUIButtonArea(UI.MenuButton,
+						 (ButtonAreaUnderCursor == ButtonAreaMenu
+						  && ButtonUnderCursor == ButtonUnderMenu ? MI_FLAGS_ACTIVE : 0) |
+						 (GameMenuButtonClicked ? MI_FLAGS_CLICKED : 0));
+		// (UI.MenuButton.Clicked ? MI_FLAGS_CLICKED : 0),
 	}
 }
 
 static void DrawMenuButtonArea_Network()
 {
 	if (UI.NetworkMenuButton.X != -1) {
-		DrawUIButton(UI.NetworkMenuButton.Style,
-					 (ButtonAreaUnderCursor == ButtonAreaMenu
-					  && ButtonUnderCursor == ButtonUnderNetworkMenu ? MI_FLAGS_ACTIVE : 0) |
-					 (GameMenuButtonClicked ? MI_FLAGS_CLICKED : 0),
-					 // (UI.NetworkMenuButton.Clicked ? MI_FLAGS_CLICKED : 0),
-					 UI.NetworkMenuButton.X, UI.NetworkMenuButton.Y,
-					 UI.NetworkMenuButton.Text);
+		DrawUIButtonArea(UI.NetworkMenuButton,
+						 (ButtonAreaUnderCursor == ButtonAreaMenu
+						  && ButtonUnderCursor == ButtonUnderNetworkMenu ? MI_FLAGS_ACTIVE : 0) |
+						 (GameMenuButtonClicked ? MI_FLAGS_CLICKED : 0));
+		// (UI.NetworkMenuButton.Clicked ? MI_FLAGS_CLICKED : 0),
 	}
 	if (UI.NetworkDiplomacyButton.X != -1) {
-		DrawUIButton(UI.NetworkDiplomacyButton.Style,
-					 (ButtonAreaUnderCursor == ButtonAreaMenu
-					  && ButtonUnderCursor == ButtonUnderNetworkDiplomacy ? MI_FLAGS_ACTIVE : 0) |
-					 (GameDiplomacyButtonClicked ? MI_FLAGS_CLICKED : 0),
-					 // (UI.NetworkDiplomacyButton.Clicked ? MI_FLAGS_CLICKED : 0),
-					 UI.NetworkDiplomacyButton.X, UI.NetworkDiplomacyButton.Y,
-					 UI.NetworkDiplomacyButton.Text);
+		DrawUIButtonArea(UI.NetworkDiplomacyButton,
+						 (ButtonAreaUnderCursor == ButtonAreaMenu
+						  && ButtonUnderCursor == ButtonUnderNetworkDiplomacy ? MI_FLAGS_ACTIVE : 0) |
+						 (GameDiplomacyButtonClicked ? MI_FLAGS_CLICKED : 0));
+		// (UI.NetworkDiplomacyButton.Clicked ? MI_FLAGS_CLICKED : 0),
 	}
 }
 
@@ -120,15 +126,13 @@ void DrawMenuButtonArea()
 void DrawUserDefinedButtons()
 {
 	for (size_t i = 0; i < UI.UserButtons.size(); ++i) {
-		const CUIUserButton &button = UI.UserButtons[i];
+		CUIUserButton &button = UI.UserButtons[i];
 
 		if (button.Button.X != -1) {
-			DrawUIButton(button.Button.Style,
-						 (ButtonAreaUnderCursor == ButtonAreaUser
-						  && size_t(ButtonUnderCursor) == i ? MI_FLAGS_ACTIVE : 0) |
-						 (button.Clicked ? MI_FLAGS_CLICKED : 0),
-						 button.Button.X, button.Button.Y,
-						 button.Button.Text);
+			DrawUIButtonArea(button.Button,
+							 (ButtonAreaUnderCursor == ButtonAreaUser
+							  && size_t(ButtonUnderCursor) == i ? MI_FLAGS_ACTIVE : 0) |
+							 (button.Clicked ? MI_FLAGS_CLICKED : 0));
 		}
 	}
 }
@@ -568,6 +572,22 @@ static void DrawUnitInfo(CUnit &unit)
 --  RESOURCES
 ----------------------------------------------------------------------------*/
 
+/**
+**  Invalidate the text of a resource when it changed since the last frame.
+**
+**  @param res    Resource whose text is drawn.
+**  @param key    Key of what the text shows.
+**  @param y      Screen Y position of the text.
+**  @param width  Width of the drawn text.
+**  @param font   Font of the text.
+*/
+static void InvalidateResourceText(const CResourceInfo &res, uint64_t key, int y, int width, const CFont &font)
+{
+	key = DrawnAreaKey(key, &font);
+	key = DrawnAreaKey(key, uint64_t(y));
+	InvalidateDrawnArea(&res, 1, key, res.TextX, y, width, font.Height());
+}
+
 /**
 **  Draw the player resource in top line.
 **
@@ -579,13 +599,21 @@ void DrawResources()
 
 	// Draw all icons of resource.
 	for (int i = 0; i <= FreeWorkersCount; ++i) {
-		if (UI.Resources[i].G) {
-			UI.Resources[i].G->DrawFrameClip(UI.Resources[i].IconFrame,
-											 UI.Resources[i].IconX, UI.Resources[i].IconY);
+		const CResourceInfo &res = UI.Resources[i];
+
+		if (res.G) {
+			res.G->DrawFrameClip(res.IconFrame, res.IconX, res.IconY);
+
+			uint64_t key = DrawnAreaKey(uint64_t(res.IconX), uint64_t(res.IconY));
+			key = DrawnAreaKey(key, res.G);
+			key = DrawnAreaKey(key, uint64_t(res.IconFrame));
+			InvalidateDrawnArea(&res, 0, key, res.IconX, res.IconY, res.G->Width, res.G->Height);
 		}
 	}
 	for (int i = 0; i < MaxCosts; ++i) {
-		if (UI.Resources[i].TextX != -1) {
+		const CResourceInfo &res = UI.Resources[i];
+
+		if (res.TextX != -1) {
 			const int resourceAmount = ThisPlayer->Resources[i];
 
 			if (ThisPlayer->MaxResources[i] != -1) {
@@ -594,35 +622,49 @@ void DrawResources()
 				snprintf(tmp, sizeof(tmp), "%d (%d)", resAmount, ThisPlayer->MaxResources[i] - ThisPlayer->StoredResources[i]);
 				label.SetFont(GetSmallFont());
 
-				label.Draw(UI.Resources[i].TextX, UI.Resources[i].TextY + 3, tmp);
+				const int width = label.Draw(res.TextX, res.TextY + 3, tmp);
+				InvalidateResourceText(res, DrawnAreaKey(0, std::string(tmp)), res.TextY + 3, width, GetSmallFont());
 			} else {
-				label.SetFont(resourceAmount > 99999 ? GetSmallFont() : GetGameFont());
+				CFont &font = resourceAmount > 99999 ? GetSmallFont() : GetGameFont();
+				label.SetFont(font);
 
-				label.Draw(UI.Resources[i].TextX, UI.Resources[i].TextY + (resourceAmount > 99999) * 3, resourceAmount);
+				const int y = res.TextY + (resourceAmount > 99999) * 3;
+				const int width = label.Draw(res.TextX, y, resourceAmount);
+				InvalidateResourceText(res, uint64_t(resourceAmount), y, width, font);
 			}
 		}
 	}
 	if (UI.Resources[FoodCost].TextX != -1) {
+		const CResourceInfo &res = UI.Resources[FoodCost];
+		const bool reverse = ThisPlayer->Supply < ThisPlayer->Demand;
 		char tmp[256];
 		snprintf(tmp, sizeof(tmp), "%d/%d", ThisPlayer->Demand, ThisPlayer->Supply);
 		label.SetFont(GetGameFont());
-		if (ThisPlayer->Supply < ThisPlayer->Demand) {
-			label.DrawReverse(UI.Resources[FoodCost].TextX, UI.Resources[FoodCost].TextY, tmp);
+		int width;
+		if (reverse) {
+			width = label.DrawReverse(res.TextX, res.TextY, tmp);
 		} else {
-			label.Draw(UI.Resources[FoodCost].TextX, UI.Resources[FoodCost].TextY, tmp);
+			width = label.Draw(res.TextX, res.TextY, tmp);
 		}
+		InvalidateResourceText(res, DrawnAreaKey(uint64_t(reverse), std::string(tmp)), res.TextY, width, GetGameFont());
 	}
 	if (UI.Resources[ScoreCost].TextX != -1) {
+		const CResourceInfo &res = UI.Resources[ScoreCost];
 		const int score = ThisPlayer->Score;
+		CFont &font = score > 99999 ? GetSmallFont() : GetGameFont();
 
-		label.SetFont(score > 99999 ? GetSmallFont() : GetGameFont());
-		label.Draw(UI.Resources[ScoreCost].TextX, UI.Resources[ScoreCost].TextY + (score > 99999) * 3, score);
+		label.SetFont(font);
+		const int y = res.TextY + (score > 99999) * 3;
+		const int width = label.Draw(res.TextX, y, score);
+		InvalidateResourceText(res, uint64_t(score), y, width, font);
 	}
 	if (UI.Resources[FreeWorkersCount].TextX != -1) {
+		const CResourceInfo &res = UI.Resources[FreeWorkersCount];
 		const int workers = ThisPlayer->FreeWorkers.size();
 
 		label.SetFont(GetGameFont());
-		label.Draw(UI.Resources[FreeWorkersCount].TextX, UI.Resources[FreeWorkersCount].TextY, workers);
+		const int width = label.Draw(res.TextX, res.TextY, workers);
+		InvalidateResourceText(res, uint64_t(workers), res.TextY, width, GetGameFont());
 	}
 }
 
@@ -747,6 +789,8 @@ void MessagesDisplay::DrawMessages()
 					PopClipping();
 				}
 			}
+			InvalidateDrawnArea(this, 0, uint64_t(FrameCounter), UI.MapArea.X + 8, UI.MapArea.Y + 8,
+								Video.Width - UI.MapArea.X - 8, count * (UI.MessageFont->Height() + 1));
 		} else {
 #endif
 			// background so the text is easier to read
@@ -787,6 +831,12 @@ void MessagesDisplay::DrawMessages()
 			if (MessagesCount < 1) {
 				MessagesSameCount = 0;
 			}
+			uint64_t key = DrawnAreaKey(uint64_t(MessagesCount), uint64_t(MessagesScrollY));
+			for (int z = 0; z < MessagesCount; ++z) {
+				key = DrawnAreaKey(key, std::string(Messages[z]));
+			}
+			InvalidateDrawnArea(this, 0, key, UI.MapArea.X + 8, UI.MapArea.Y + 8,
+								Video.Width - UI.MapArea.X - 8, MessagesCount * (UI.MessageFont->Height() + 1));
 #ifdef DEBUG
 		}
 #endif
@@ -1156,6 +1206,66 @@ static void InfoPanel_draw_multiple_selection()
 	}
 }
 
+/**
+**  Extend an area with the icon of a button and the bars drawn under it.
+**
+**  @param button       Button of the icon, may be NULL.
+**  @param topLeft      Top left corner of the area.
+**  @param bottomRight  Bottom right corner of the area, excluded.
+*/
+static void AddInfoPanelButtonArea(const CUIButton *button, PixelPos &topLeft, PixelPos &bottomRight)
+{
+	if (button == NULL || button->Style == NULL) {
+		return;
+	}
+	PixelPos pos;
+	PixelSize size;
+
+	GetUnitIconArea(*button->Style, PixelPos(button->X, button->Y), pos, size);
+	// Life and mana bars are drawn up to 14 pixels under the icon.
+	topLeft.x = std::min(topLeft.x, pos.x);
+	topLeft.y = std::min(topLeft.y, pos.y);
+	bottomRight.x = std::max(bottomRight.x, pos.x + size.x);
+	bottomRight.y = std::max(bottomRight.y, pos.y + size.y + 14);
+}
+
+/**
+**  Invalidate the area of the info panel.
+**
+**  What the info panel shows changes with too many things to track, so
+**  its background and all its buttons are invalidated every frame.
+*/
+static void InvalidateInfoPanel()
+{
+	PixelPos topLeft(UI.InfoPanel.X, UI.InfoPanel.Y);
+	PixelPos bottomRight(topLeft);
+
+	if (UI.InfoPanel.G) {
+		bottomRight.x += UI.InfoPanel.G->Width;
+		bottomRight.y += UI.InfoPanel.G->Height;
+	}
+	AddInfoPanelButtonArea(UI.SingleSelectedButton, topLeft, bottomRight);
+	AddInfoPanelButtonArea(UI.SingleTrainingButton, topLeft, bottomRight);
+	AddInfoPanelButtonArea(UI.UpgradingButton, topLeft, bottomRight);
+	AddInfoPanelButtonArea(UI.ResearchingButton, topLeft, bottomRight);
+	for (size_t i = 0; i != UI.SelectedButtons.size(); ++i) {
+		AddInfoPanelButtonArea(&UI.SelectedButtons[i], topLeft, bottomRight);
+	}
+	for (size_t i = 0; i != UI.TrainingButtons.size(); ++i) {
+		AddInfoPanelButtonArea(&UI.TrainingButtons[i], topLeft, bottomRight);
+	}
+	for (size_t i = 0; i != UI.TransportingButtons.size(); ++i) {
+		AddInfoPanelButtonArea(&UI.TransportingButtons[i], topLeft, bottomRight);
+	}
+	if (UI.MaxSelectedFont) {
+		topLeft.x = std::min(topLeft.x, UI.MaxSelectedTextX);
+		topLeft.y = std::min(topLeft.y, UI.MaxSelectedTextY);
+		bottomRight.x = std::max(bottomRight.x, UI.MaxSelectedTextX + UI.MaxSelectedFont->Width("+9999"));
+		bottomRight.y = std::max(bottomRight.y, UI.MaxSelectedTextY + UI.MaxSelectedFont->Height());
+	}
+	InvalidateArea(topLeft.x, topLeft.y, bottomRight.x - topLeft.x, bottomRight.y - topLeft.y);
+}
+
 /**
 **  Draw info panel.
 **
@@ -1167,6 +1277,7 @@ static void InfoPanel_draw_multiple_selection()
 */
 void CInfoPanel::Draw()
 {
+	InvalidateInfoPanel();
 	if (UnitUnderCursor && Selected.empty() && !UnitUnderCursor->Type->BoolFlag[ISNOTSELECTABLE_INDEX].value
 		&& (ReplayRevealMap || UnitUnderCursor->IsVisible(*ThisPlayer))) {
 			InfoPanel_draw_single_selection(UnitUnderCursor);
@@ -53,6 +53,8 @@ void CStatusLine::Draw()
 					this->TextX + this->Width - 1, Video.Height - 1);
 		CLabel(*this->Font).DrawClip(this->TextX, this->TextY, this->StatusLine);
 		PopClipping();
+		InvalidateDrawnArea(this, 0, DrawnAreaKey(uint64_t(this->TextX), this->StatusLine),
+							this->TextX, this->TextY, this->Width, this->Font->Height());
 	}
 }
 
@@ -104,10 +106,13 @@ void CStatusLine::ClearCosts()
 */
 void CStatusLine::DrawCosts()
 {
-	int x = UI.StatusLine.TextX + 268;
+	const int startX = UI.StatusLine.TextX + 268;
+	int x = startX;
+	int height = GetGameFont().Height();
 	CLabel label(GetGameFont());
 	if (this->Costs[ManaResCost]) {
 		UI.Resources[ManaResCost].G->DrawFrameClip(UI.Resources[ManaResCost].IconFrame, x, UI.StatusLine.TextY);
+		height = std::max(height, UI.Resources[ManaResCost].G->Height);
 
 		x += 20;
 		x += label.Draw(x, UI.StatusLine.TextY, this->Costs[ManaResCost]);
@@ -119,6 +124,7 @@ void CStatusLine::DrawCosts()
 			if (UI.Resources[i].G) {
 				UI.Resources[i].G->DrawFrameClip(UI.Resources[i].IconFrame,
 					x, UI.StatusLine.TextY);
+				height = std::max(height, UI.Resources[i].G->Height);
 				x += 20;
 			}
 			x += label.Draw(x, UI.StatusLine.TextY, this->Costs[i]);
@@ -127,6 +133,11 @@ void CStatusLine::DrawCosts()
 			}
 		}
 	}
+	uint64_t key = uint64_t(UI.StatusLine.TextY);
+	for (int i = 0; i <= ManaResCost; ++i) {
+		key = DrawnAreaKey(key, uint64_t(this->Costs[i]));
+	}
+	InvalidateDrawnArea(this, 1, key, startX, UI.StatusLine.TextY, x - startX, height);
 }
 
 /**
@@ -145,4 +145,35 @@ void DrawUIButton(ButtonStyle *style, unsigned flags, int x, int y,
 	}
 }
 
+/**
+**  Invalidate the area of a button drawn by DrawUIButton when its drawing
+**  changed since the last frame.
+**
+**  @param object  Identifies the button drawn.
+**  @param style   Button style
+**  @param flags   State of Button (clicked, mouse over...)
+**  @param x       X display position
+**  @param y       Y display position
+**  @param text    text printed on button
+*/
+void InvalidateUIButton(const void *object, const ButtonStyle &style, unsigned flags, int x, int y,
+						const std::string &text)
+{
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (UseOpenGL) {
+		return;
+	}
+#endif
+	const int border = std::max(style.Default.BorderSize, std::max(style.Hover.BorderSize, style.Clicked.BorderSize));
+	uint64_t key = DrawnAreaKey(uint64_t(x), uint64_t(y));
+	key = DrawnAreaKey(key, &style);
+	key = DrawnAreaKey(key, uint64_t(flags));
+	key = DrawnAreaKey(key, text);
+	if (border) {
+		// The border color pulses with the game cycle.
+		key = DrawnAreaKey(key, uint64_t(GameCycle % 0x20));
+	}
+	InvalidateDrawnArea(object, 0, key, x - border, y - border, style.Width + 2 * border, style.Height + 2 * border);
+}
+
 //@}
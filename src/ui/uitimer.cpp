@@ -33,6 +33,7 @@
 
 #include "ui/uitimer.h"
 #include "font.h"
+#include "video.h"
 
 #include <cstdio>
 
@@ -48,7 +49,9 @@ void CUITimer::Draw(int second) const
 	} else {
 		snprintf(buf, sizeof(buf), "%d:%02d", min, sec);
 	}
-	CLabel(*this->Font).Draw(this->X, this->Y, buf);
+	const int width = CLabel(*this->Font).Draw(this->X, this->Y, buf);
+	InvalidateDrawnArea(this, 0, DrawnAreaKey(uint64_t(this->X), std::string(buf)),
+						this->X, this->Y, width, this->Font->Height());
 }
 
 //@}
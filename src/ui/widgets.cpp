@@ -168,14 +168,32 @@ void handleInput(const SDL_Event *event)
 	}
 }
 
+/**
+**  Draw the guichan widgets.
+**
+**  Widgets mark themselves dirty when they change: the area of the top
+**  widget is only invalidated then, or when the top widget changed.
+*/
 void DrawGuichanWidgets()
 {
+	static gcn::Widget *lastTop = NULL;
+
 	if (Gui) {
 #if defined(USE_OPENGL) || defined(USE_GLES)
 		Gui->setUseDirtyDrawing(!UseOpenGL && !GameRunning && !Editor.Running);
 #else
 		Gui->setUseDirtyDrawing(!GameRunning && !Editor.Running);
 #endif
+		gcn::Widget *top = Gui->getTop();
+		if (top != lastTop) {
+			lastTop = top;
+			Invalidate();
+		} else if (top && top->getDirty()) {
+			const gcn::Rectangle &rect = top->getDimension();
+			const int border = top->getBorderSize();
+
+			InvalidateArea(rect.x - border, rect.y - border, rect.width + 2 * border, rect.height + 2 * border);
+		}
 		Gui->draw();
 	}
 }
@@ -34,6 +34,7 @@
 --  Includes
 ----------------------------------------------------------------------------*/
 
+#include <climits>
 #include <vector>
 
 #include "stratagus.h"
@@ -94,6 +95,30 @@ public:
 
 static DecoSpriteType DecoSprite; /// All sprite's infos.
 
+/**
+**  Screen area covering what is drawn for a unit.
+*/
+class CUnitDrawArea
+{
+public:
+	CUnitDrawArea() : TopLeft(INT_MAX, INT_MAX), BottomRight(INT_MIN, INT_MIN) {}
+
+	/// Extend the area with a rectangle
+	void Add(int x, int y, int w, int h)
+	{
+		TopLeft.x = std::min(TopLeft.x, x);
+		TopLeft.y = std::min(TopLeft.y, y);
+		BottomRight.x = std::max(BottomRight.x, x + w);
+		BottomRight.y = std::max(BottomRight.y, y + h);
+	}
+
+	/// Extend the area with a rectangle
+	void Add(const PixelPos &pos, const PixelSize &size) { Add(pos.x, pos.y, size.x, size.y); }
+
+	PixelPos TopLeft;      /// Top left corner
+	PixelPos BottomRight;  /// Bottom right corner, excluded
+};
+
 unsigned long ShowOrdersCount;    /// Show orders for some time
 
 unsigned long ShowNameDelay;                 /// Delay to show unit's name
@@ -426,6 +451,26 @@ void CDecoVarBar::Draw(int x, int y,
 	}
 }
 
+/**
+**  Get the area a bar is drawn in: the full bar and its border.
+*/
+void CDecoVarBar::GetArea(int x, int y, const CUnitType &type, const CVariable &var,
+						  PixelPos &pos, PixelSize &size) const
+{
+	const int height = this->Height ? this->Height : type.BoxHeight;
+	const int width = this->Width ? this->Width : type.BoxWidth;
+	const int b = this->BorderSize;
+
+	if (this->IsCenteredInX) {
+		x -= (this->IsVertical ? width : var.Value * width / var.Max) / 2;
+	}
+	if (this->IsCenteredInY) {
+		y -= (this->IsVertical ? var.Value * height / var.Max : height) / 2;
+	}
+	pos = PixelPos(x - b, y - b);
+	size = PixelSize(width + 2 * b, height + 2 * b);
+}
+
 /**
 **  Print variable values (and max....).
 **
@@ -445,6 +490,19 @@ void CDecoVarText::Draw(int x, int y, const CUnitType &/*type*/, const CVariable
 	CLabel(*this->Font).DrawClip(x, y, var.Value);
 }
 
+void CDecoVarText::GetArea(int x, int y, const CUnitType &/*type*/, const CVariable &var,
+						   PixelPos &pos, PixelSize &size) const
+{
+	if (this->IsCenteredInX) {
+		x -= 2;
+	}
+	if (this->IsCenteredInY) {
+		y -= this->Font->Height() / 2;
+	}
+	pos = PixelPos(x, y);
+	size = PixelSize(this->Font->Width(var.Value), this->Font->Height());
+}
+
 /**
 **  Draw a sprite with is like a bar (several stages)
 **
@@ -475,6 +533,17 @@ void CDecoVarSpriteBar::Draw(int x, int y, const CUnitType &/*type*/, const CVar
 	sprite.DrawFrameClip(n, x, y);
 }
 
+void CDecoVarSpriteBar::GetArea(int x, int y, const CUnitType &/*type*/, const CVariable &/*var*/,
+								PixelPos &pos, PixelSize &size) const
+{
+	const Decoration &decosprite = DecoSprite.SpriteArray[(int)this->NSprite];
+	const CGraphic &sprite = *decosprite.Sprite;
+
+	pos = PixelPos(x + decosprite.HotPos.x - (this->IsCenteredInX ? sprite.Width / 2 : 0),
+				   y + decosprite.HotPos.y - (this->IsCenteredInY ? sprite.Height / 2 : 0));
+	size = PixelSize(sprite.Width, sprite.Height);
+}
+
 /**
 **  Draw a static sprite.
 **
@@ -505,20 +574,34 @@ void CDecoVarStaticSprite::Draw(int x, int y, const CUnitType &/*type*/, const C
 	}
 }
 
+void CDecoVarStaticSprite::GetArea(int x, int y, const CUnitType &/*type*/, const CVariable &/*var*/,
+								   PixelPos &pos, PixelSize &size) const
+{
+	const Decoration &decosprite = DecoSprite.SpriteArray[(int)this->NSprite];
+	const CGraphic &sprite = *decosprite.Sprite;
+
+	pos = PixelPos(x + decosprite.HotPos.x - (this->IsCenteredInX ? sprite.Width / 2 : 0),
+				   y + decosprite.HotPos.y - (this->IsCenteredInY ? sprite.Height / 2 : 0));
+	size = PixelSize(sprite.Width, sprite.Height);
+}
+
 /**
 **  Draw decoration (invis, for the unit.)
 **
 **  @param unit       Pointer to the unit.
 **  @param type       Type of the unit.
 **  @param screenPos  Screen position of the unit.
+**  @param area       Extended with the area of the decorations.
 */
-static void DrawDecoration(const CUnit &unit, const CUnitType &type, const PixelPos &screenPos)
+static void DrawDecoration(const CUnit &unit, const CUnitType &type, const PixelPos &screenPos,
+						   CUnitDrawArea &area)
 {
 	int x = screenPos.x;
 	int y = screenPos.y;
 #ifdef DEBUG
 	// Show the number of references.
 	CLabel(GetGameFont()).DrawClip(x + 1, y + 1, unit.Refs);
+	area.Add(x + 1, y + 1, GetGameFont().Width(unit.Refs), GetGameFont().Height());
 #endif
 
 	UpdateUnitVariables(const_cast<CUnit &>(unit));
@@ -538,10 +621,14 @@ static void DrawDecoration(const CUnit &unit, const CUnitType &type, const Pixel
 			  || (ThisPlayer->IsEnemy(unit) && !var.ShowOpponent)
 			  || (ThisPlayer->IsAllied(unit) && (unit.Player != ThisPlayer) && var.HideAllied)
 			  || max == 0)) {
-			var.Draw(
-				x + var.OffsetX + var.OffsetXPercent * unit.Type->TileWidth * PixelTileSize.x / 100,
-				y + var.OffsetY + var.OffsetYPercent * unit.Type->TileHeight * PixelTileSize.y / 100,
-				type, unit.Variable[var.Index]);
+			const int decoX = x + var.OffsetX + var.OffsetXPercent * unit.Type->TileWidth * PixelTileSize.x / 100;
+			const int decoY = y + var.OffsetY + var.OffsetYPercent * unit.Type->TileHeight * PixelTileSize.y / 100;
+			PixelPos pos;
+			PixelSize size;
+
+			var.Draw(decoX, decoY, type, unit.Variable[var.Index]);
+			var.GetArea(decoX, decoY, type, unit.Variable[var.Index], pos, size);
+			area.Add(pos, size);
 		}
 	}
 
@@ -564,6 +651,7 @@ static void DrawDecoration(const CUnit &unit, const CUnitType &type, const Pixel
 		const int height = GetGameFont().Height();
 		y += (unit.Type->TileHeight * PixelTileSize.y + unit.Type->BoxHeight) / 2 - height;
 		CLabel(GetGameFont()).DrawClip(x, y, groupId);
+		area.Add(x, y, width, height);
 	}
 }
 
@@ -605,6 +693,30 @@ void DrawShadow(const CUnitType &type, int frame, const PixelPos &screenPos)
 	}
 }
 
+/**
+**  Get the screen area where a unit type is drawn with DrawUnitType
+**  and DrawShadow.
+**
+**  @param type       Unit type.
+**  @param screenPos  Screen (top left) position of the unit.
+**  @param pos        Returns the top left corner of the area.
+**  @param size       Returns the size of the area.
+*/
+void GetUnitTypeDrawArea(const CUnitType &type, const PixelPos &screenPos, PixelPos &pos, PixelSize &size)
+{
+	CUnitDrawArea area;
+
+	area.Add(screenPos.x - (type.Width - type.TileWidth * PixelTileSize.x) / 2 + type.OffsetX,
+			 screenPos.y - (type.Height - type.TileHeight * PixelTileSize.y) / 2 + type.OffsetY,
+			 type.Width, type.Height);
+	if (type.ShadowSprite) {
+		area.Add(screenPos.x - (type.ShadowWidth - type.TileWidth * PixelTileSize.x) / 2 + type.OffsetX + type.ShadowOffsetX,
+				 screenPos.y - (type.ShadowHeight - type.TileHeight * PixelTileSize.y) / 2 + type.OffsetY + type.ShadowOffsetY,
+				 type.ShadowWidth, type.ShadowHeight);
+	}
+	pos = area.TopLeft;
+	size = area.BottomRight - area.TopLeft;
+}
 
 /**
 **  Show the current order of a unit.
@@ -651,10 +763,12 @@ void ShowOrder(const CUnit &unit)
 **  @param unit  Unit pointer of drawn unit.
 **  @param type  Unit-type pointer.
 **  @param screenPos  screen pixel (top left) position of unit.
+**  @param area  Extended with the area of the informations.
 **
 **  @todo FIXME: The different styles should become a function call.
 */
-static void DrawInformations(const CUnit &unit, const CUnitType &type, const PixelPos &screenPos)
+static void DrawInformations(const CUnit &unit, const CUnitType &type, const PixelPos &screenPos,
+							 CUnitDrawArea &area)
 {
 #if 0 && DEBUG // This is for showing vis counts and refs.
 	char buf[10];
@@ -678,6 +792,7 @@ static void DrawInformations(const CUnit &unit, const CUnitType &type, const Pix
 			if (value) {
 				// Radius -1 so you can see all ranges
 				Video.DrawCircleClip(ColorGreen, center.x, center.y, radius - 1);
+				area.Add(center.x - radius, center.y - radius, 2 * radius + 1, 2 * radius + 1);
 			}
 		}
 		if (type.CanAttack) {
@@ -687,6 +802,7 @@ static void DrawInformations(const CUnit &unit, const CUnitType &type, const Pix
 
 				if (value) {
 					Video.DrawCircleClip(ColorBlue, center.x, center.y, radius);
+					area.Add(center.x - radius, center.y - radius, 2 * radius + 1, 2 * radius + 1);
 				}
 			}
 			if (Preference.ShowAttackRange) {
@@ -696,6 +812,7 @@ static void DrawInformations(const CUnit &unit, const CUnitType &type, const Pix
 				if (value) {
 					// Radius +1 so you can see all ranges
 					Video.DrawCircleClip(ColorGreen, center.x, center.y, radius - 1);
+					area.Add(center.x - radius, center.y - radius, 2 * radius + 1, 2 * radius + 1);
 				}
 			}
 		}
@@ -703,7 +820,7 @@ static void DrawInformations(const CUnit &unit, const CUnitType &type, const Pix
 
 	// FIXME: johns: ugly check here, should be removed!
 	if (unit.CurrentAction() != UnitActionDie && (unit.IsVisible(*ThisPlayer) || ReplayRevealMap)) {
-		DrawDecoration(unit, type, screenPos);
+		DrawDecoration(unit, type, screenPos, area);
 	}
 }
 
@@ -778,12 +895,50 @@ static void DrawConstruction(const int player, const CConstructionFrame *cframe,
 	}
 }
 
+/**
+**  Get the screen area of a construction drawn by DrawConstruction and
+**  DrawConstructionShadow.
+**
+**  @param type       Unit type.
+**  @param cframe     Construction frame.
+**  @param screenPos  Screen (top left) position of the unit.
+**  @param area       Extended with the area of the construction.
+*/
+static void AddConstructionArea(const CUnitType &type, const CConstructionFrame *cframe,
+								const PixelPos &screenPos, CUnitDrawArea &area)
+{
+	const PixelPos center(screenPos + type.GetPixelSize() / 2);
+
+	if (cframe->File == ConstructionFileConstruction) {
+		const CConstruction &construction = *type.Construction;
+
+		area.Add(center.x - construction.Width / 2, center.y - construction.Height / 2,
+				 construction.Width, construction.Height);
+		if (construction.ShadowSprite) {
+			area.Add(screenPos.x - (construction.Width - type.TileWidth * PixelTileSize.x) / 2 + type.OffsetX,
+					 screenPos.y - (construction.Height - type.TileHeight * PixelTileSize.y) / 2 + type.OffsetY,
+					 construction.Width, construction.Height);
+		}
+	} else {
+		PixelPos pos;
+		PixelSize size;
+
+		area.Add(center.x + type.OffsetX - type.Width / 2, center.y + type.OffsetY - type.Height / 2,
+				 type.Width, type.Height);
+		GetUnitTypeDrawArea(type, screenPos, pos, size);
+		area.Add(pos, size);
+	}
+}
+
 /**
 **  Units on map:
 */
 
 /**
 **  Draw unit on map.
+**
+**  The screen area covered by the unit is invalidated when anything that
+**  changes its drawing changed since the last frame.
 */
 void CUnit::Draw(const CViewport &vp) const
 {
@@ -899,7 +1054,55 @@ void CUnit::Draw(const CViewport &vp) const
 	}
 
 	// Unit's extras not fully supported.. need to be decorations themselves.
-	DrawInformations(*this, *type, screenPos);
+	CUnitDrawArea area;
+	DrawInformations(*this, *type, screenPos, area);
+
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (!UseOpenGL)
+#endif
+	{
+		if (state == 1 && constructed && cframe) {
+			AddConstructionArea(*type, cframe, screenPos, area);
+		} else {
+			PixelPos pos;
+			PixelSize size;
+
+			GetUnitTypeDrawArea(*type, screenPos, pos, size);
+			area.Add(pos, size);
+		}
+		// Selection marks are drawn up to 3 pixels around the box.
+		const PixelPos center = vp.MapToScreenPixelPos(this->GetMapPixelPosCenter());
+		const int boxX = center.x - type->BoxWidth / 2 - (type->Width - (type->Sprite ? type->Sprite->Width : 0)) / 2 + type->BoxOffsetX;
+		const int boxY = center.y - type->BoxHeight / 2 - (type->Height - (type->Sprite ? type->Sprite->Height : 0)) / 2 + type->BoxOffsetY;
+		area.Add(boxX - 3, boxY - 3, type->BoxWidth + 7, type->BoxHeight + 7);
+
+		uint64_t key = DrawnAreaKey(uint64_t(screenPos.x), uint64_t(screenPos.y));
+		key = DrawnAreaKey(key, type);
+		key = DrawnAreaKey(key, sprite);
+		key = DrawnAreaKey(key, uint64_t(frame));
+		key = DrawnAreaKey(key, uint64_t(GameSettings.Presets[player].PlayerColor));
+		key = DrawnAreaKey(key, uint64_t(state | (action == UnitActionDie) << 2 | IsVisible << 3));
+		key = DrawnAreaKey(key, uint64_t(constructed));
+		key = DrawnAreaKey(key, cframe);
+		key = DrawnAreaKey(key, uint64_t(this->Selected | (CursorBuilding != NULL) << 1 | (UnitUnderCursor == this) << 2
+										 | IsOnlySelected(*this) << 3 | Preference.ShowSightRange << 4
+										 | Preference.ShowReactionRange << 5 | Preference.ShowAttackRange << 6));
+		key = DrawnAreaKey(key, uint64_t(this->TeamSelected));
+		key = DrawnAreaKey(key, uint64_t(this->Blink));
+		key = DrawnAreaKey(key, this->Player);
+		key = DrawnAreaKey(key, uint64_t(this->GroupId));
+		for (std::vector<CDecoVar *>::const_iterator i = UnitTypeVar.DecoVar.begin();
+			 i < UnitTypeVar.DecoVar.end(); ++i) {
+			const CVariable &var = this->Variable[(*i)->Index];
+
+			key = DrawnAreaKey(key, uint64_t(var.Value) << 32 | uint32_t(var.Max) << 1 | var.Enable);
+		}
+#ifdef DEBUG
+		key = DrawnAreaKey(key, uint64_t(this->Refs));
+#endif
+		InvalidateDrawnArea(this, &vp - UI.Viewports, key, area.TopLeft.x, area.TopLeft.y,
+							area.BottomRight.x - area.TopLeft.x, area.BottomRight.y - area.TopLeft.y);
+	}
 }
 
 /**
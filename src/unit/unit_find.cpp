@@ -326,6 +326,7 @@ public:
 		*resultMine = NULL;
 	}
 	VisitResult Visit(TerrainTraversal &terrainTraversal, const Vec2i &pos, const Vec2i &from);
+	bool Consider(CUnit &mine);
 private:
 	bool MineIsUsable(const CUnit &mine) const;
 
@@ -392,19 +393,75 @@ VisitResult ResourceUnitFinder::Visit(TerrainTraversal &terrainTraversal, const
 
 	CUnit *mine = Map.Field(pos)->UnitCache.find(res_finder);
 
-	if (mine && mine != *resultMine && MineIsUsable(*mine)) {
+	if (mine && Consider(*mine)) {
+		return VisitResult_Finished;
+	}
+	if (CanMoveToMask(pos, movemask)) { // reachable
+		if (terrainTraversal.Get(pos) < maxRange) {
+			return VisitResult_Ok;
+		} else {
+			return VisitResult_DeadEnd;
+		}
+	} else { // unreachable
+		return VisitResult_DeadEnd;
+	}
+}
+
+/**
+**  Take the mine if it is better than the best one found yet.
+**
+**  @param mine  Resource unit found.
+**
+**  @return      true if no mine can be better.
+*/
+bool ResourceUnitFinder::Consider(CUnit &mine)
+{
+	if (&mine != *resultMine && MineIsUsable(mine)) {
 		ResourceUnitFinder::ResourceUnitFinder_Cost cost;
 
-		cost.SetFrom(*mine, deposit, check_usage);
+		cost.SetFrom(mine, deposit, check_usage);
 		if (cost < bestCost) {
-			*resultMine = mine;
+			*resultMine = &mine;
 
 			if (cost.IsMin()) {
-				return VisitResult_Finished;
+				return true;
 			}
 			bestCost = cost;
 		}
 	}
+	return false;
+}
+
+class ResourceSitesFinder
+{
+public:
+	ResourceSitesFinder(const CUnit &worker, int resource, int maxRange, std::vector<CUnit *> *mines) :
+		worker(worker),
+		movemask(worker.Type->MovementMask & ~(MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit)),
+		maxRange(maxRange),
+		res_finder(resource, 1),
+		mines(mines)
+	{}
+	VisitResult Visit(TerrainTraversal &terrainTraversal, const Vec2i &pos, const Vec2i &from);
+private:
+	const CUnit &worker;
+	unsigned int movemask;
+	int maxRange;
+	CResourceFinder res_finder;
+	std::vector<CUnit *> *mines;
+};
+
+VisitResult ResourceSitesFinder::Visit(TerrainTraversal &terrainTraversal, const Vec2i &pos, const Vec2i &from)
+{
+	if (!worker.Player->AiEnabled && !Map.Field(pos)->playerInfo.IsExplored(*worker.Player)) {
+		return VisitResult_DeadEnd;
+	}
+
+	CUnit *mine = Map.Field(pos)->UnitCache.find(res_finder);
+
+	if (mine && std::find(mines->begin(), mines->end(), mine) == mines->end()) {
+		mines->push_back(mine);
+	}
 	if (CanMoveToMask(pos, movemask)) { // reachable
 		if (terrainTraversal.Get(pos) < maxRange) {
 			return VisitResult_Ok;
@@ -416,6 +473,65 @@ VisitResult ResourceUnitFinder::Visit(TerrainTraversal &terrainTraversal, const
 	}
 }
 
+/**
+**  Find all the resource units UnitFindResource could choose from.
+**
+**  The units are found once for the workers of a place, then
+**  ChooseResourceSite chooses among them for each worker like
+**  UnitFindResource without searching the map again. The sites are
+**  only valid until the units change.
+**
+**  @param unit        A worker, its player and movement are used.
+**  @param startUnit   Find resources reachable from this unit.
+**  @param range       Maximum distance to the resource.
+**  @param resource    The resource id.
+**  @param sites       Filled with the resource units, nearest first.
+*/
+void FindResourceSites(const CUnit &unit, const CUnit &startUnit, int range, int resource,
+					   CResourceSites &sites)
+{
+	sites.Deposit = FindDepositNearLoc(*unit.Player, startUnit.tilePos, range, resource);
+	sites.Mines.clear();
+
+	TerrainTraversal terrainTraversal;
+
+	terrainTraversal.SetSize(Map.Info.MapWidth, Map.Info.MapHeight);
+	terrainTraversal.Init();
+
+	terrainTraversal.PushUnitPosAndNeighboor(startUnit);
+
+	ResourceSitesFinder resourceSitesFinder(unit, resource, range, &sites.Mines);
+
+	terrainTraversal.Run(resourceSitesFinder);
+}
+
+/**
+**  Choose a resource unit of the sites for a worker.
+**
+**  @param unit         The unit that wants to find a resource, it must
+**                      move like the worker of FindResourceSites.
+**  @param sites        Resource units found by FindResourceSites.
+**  @param resource     The resource id.
+**  @param check_usage  Check if mine is in use.
+**
+**  @return             The unit UnitFindResource would find, or NULL.
+*/
+CUnit *ChooseResourceSite(const CUnit &unit, const CResourceSites &sites, int resource, bool check_usage)
+{
+	CUnit *resultMine = NULL;
+	ResourceUnitFinder resourceUnitFinder(unit, sites.Deposit, resource, 0, check_usage, &resultMine);
+	const CResourceFinder res_finder(resource, 1);
+
+	for (size_t i = 0; i != sites.Mines.size(); ++i) {
+		CUnit &mine = *sites.Mines[i];
+
+		if (res_finder(&mine) && resourceUnitFinder.Consider(mine)) {
+			break;
+		}
+	}
+	return resultMine;
+}
+
 /**
 **  Find Resource.
 **
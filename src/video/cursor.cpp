@@ -158,6 +158,14 @@ static void DrawVisibleRectangleCursor(PixelPos corner1, PixelPos corner2)
 	const int h = corner2.y - corner1.y + 1;
 
 	Video.DrawRectangleClip(ColorGreen, corner1.x, corner1.y, w, h);
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (!UseOpenGL)
+#endif
+	{
+		uint64_t key = DrawnAreaKey(uint64_t(corner1.x), uint64_t(corner1.y));
+		key = DrawnAreaKey(key, uint64_t(w) << 32 | uint32_t(h));
+		InvalidateDrawnArea(&CursorStartScreenPos, 0, key, corner1.x, corner1.y, w, h);
+	}
 }
 
 /**
@@ -185,10 +193,18 @@ static void DrawBuildingCursor()
 	DrawShadow(*CursorBuilding, CursorBuilding->StillFrame, screenPos);
 	DrawUnitType(*CursorBuilding, CursorBuilding->Sprite, GameSettings.Presets[ThisPlayer->Index].PlayerColor,
 				 CursorBuilding->StillFrame, screenPos);
+	PixelPos areaPos;
+	PixelSize areaSize;
+	GetUnitTypeDrawArea(*CursorBuilding, screenPos, areaPos, areaSize);
+	PixelPos areaEnd = areaPos + areaSize;
 	if (CursorBuilding->CanAttack && CursorBuilding->Stats->Variables[ATTACKRANGE_INDEX].Value > 0) {
 		const PixelPos center(screenPos + CursorBuilding->GetPixelSize() / 2);
 		const int radius = (CursorBuilding->Stats->Variables[ATTACKRANGE_INDEX].Max + (CursorBuilding->TileWidth - 1)) * PixelTileSize.x + 1;
 		Video.DrawCircleClip(ColorRed, center.x, center.y, radius);
+		areaPos.x = std::min(areaPos.x, center.x - radius);
+		areaPos.y = std::min(areaPos.y, center.y - radius);
+		areaEnd.x = std::max(areaEnd.x, center.x + radius + 1);
+		areaEnd.y = std::max(areaEnd.y, center.y + radius + 1);
 	}
 
 	//
@@ -236,6 +252,19 @@ static void DrawBuildingCursor()
 		}
 	}
 	PopClipping();
+
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (!UseOpenGL)
+#endif
+	{
+		// The overlay depends on the map under the cursor, redraw it every frame.
+		areaPos.x = std::min(areaPos.x, screenPos.x);
+		areaPos.y = std::min(areaPos.y, screenPos.y);
+		areaEnd.x = std::max(areaEnd.x, screenPos.x + w0 * PixelTileSize.x);
+		areaEnd.y = std::max(areaEnd.y, screenPos.y + CursorBuilding->TileHeight * PixelTileSize.y);
+		InvalidateDrawnArea(&CursorBuilding, 0, uint64_t(FrameCounter),
+							areaPos.x, areaPos.y, areaEnd.x - areaPos.x, areaEnd.y - areaPos.y);
+	}
 }
 
 
@@ -294,6 +323,15 @@ void DrawCursor()
 		GameCursor->G->Load();
 	}
 	GameCursor->G->DrawFrameClip(GameCursor->SpriteFrame, pos.x, pos.y);
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (!UseOpenGL)
+#endif
+	{
+		uint64_t key = DrawnAreaKey(uint64_t(pos.x), uint64_t(pos.y));
+		key = DrawnAreaKey(key, GameCursor);
+		key = DrawnAreaKey(key, uint64_t(GameCursor->SpriteFrame));
+		InvalidateDrawnArea(&GameCursor, 0, key, pos.x, pos.y, GameCursor->G->Width, GameCursor->G->Height);
+	}
 }
 
 /**
@@ -68,6 +68,48 @@ static std::string DefaultReverseColorIndex; /// Default reverse color index
 typedef std::map<const CFontColor *, CGraphic *> FontColorGraphicMap;
 static std::map<const CFont *, FontColorGraphicMap> FontColorGraphics;
 
+/**
+**  A text prepared for drawing.
+**
+**  Holds the glyphs of the text with their colors and positions, so
+**  the text is parsed only once. On the software renderer a text drawn
+**  again and again is also composed into one surface drawn with a
+**  single blit.
+*/
+struct CGlyphRun {
+	struct Glyph {
+		CGraphic *G;               /// Graphic of the glyph color
+		const CFontColor *Color;   /// Color of the glyph
+		short GX;                  /// X position in the font graphic
+		short GY;                  /// Y position in the font graphic
+		short W;                   /// Width of the glyph
+		short X;                   /// X position in the run
+	};
+
+	CGlyphRun() : Font(NULL), Normal(NULL), Reverse(NULL), Initial(NULL), Width(0),
+		Cacheable(false), SetsLastColor(false), LastColor(NULL), Uses(0), LastUse(0), Surface(NULL) {}
+
+	const CFont *Font;             /// Font of the run
+	const CFontColor *Normal;      /// Color the text starts with
+	const CFontColor *Reverse;     /// Reverse color of the text
+	const CFontColor *Initial;     /// Current font color when prepared
+	std::string Text;              /// The text
+	std::vector<Glyph> Glyphs;     /// Glyphs to draw
+	int Width;                     /// Width of the run in pixels
+	bool Cacheable;                /// Run doesn't depend on the last text color
+	bool SetsLastColor;            /// Drawing the run changes the last text color
+	const CFontColor *LastColor;   /// Last text color after the run
+	unsigned int Uses;             /// Number of times the run was drawn
+	unsigned int LastUse;          /// GlyphRunClock of the last use
+	SDL_Surface *Surface;          /// Composed run, software renderer only
+};
+
+static const unsigned int MaxGlyphRuns = 256;  /// Glyph runs kept in the cache
+static const size_t MaxWidthCache = 256;       /// Widths kept per font
+
+static std::map<Uint64, CGlyphRun> GlyphRuns;  /// Cache of glyph runs by hash
+static unsigned int GlyphRunClock;             /// Counts glyph run lookups
+
 // FIXME: remove these
 static CFont *SmallFont;  /// Small font used in stats
 static CFont *GameFont;   /// Normal font used in game
@@ -357,6 +399,13 @@ int CFont::Width(const std::string &text) const
 	size_t pos = 0;
 
 	DynamicLoad();
+	std::map<std::string, int>::const_iterator it = WidthCache.find(text);
+	if (it != WidthCache.end()) {
+		return it->second;
+	}
+	if (WidthCache.size() >= MaxWidthCache) {
+		WidthCache.clear();
+	}
 	while (GetUTF8(text, pos, utf8)) {
 		if (utf8 == '~') {
 			if (text[pos] == '|') {
@@ -384,6 +433,7 @@ int CFont::Width(const std::string &text) const
 			width += this->CharWidth[utf8 - 32] + 1;
 		}
 	}
+	WidthCache[text] = width;
 	return width;
 }
 
@@ -437,8 +487,16 @@ static void VideoDrawCharClip(const CGraphic &g, int gx, int gy, int w, int h,
 }
 
 
-template<bool CLIP>
-unsigned int CFont::DrawChar(CGraphic &g, int utf8, int x, int y, const CFontColor &fc) const
+/**
+**  Find a character in the font graphic.
+**
+**  @param utf8  The character.
+**  @param gx    Set to the X position of the character in the graphic.
+**  @param gy    Set to the Y position of the character in the graphic.
+**
+**  @return      The width of the character.
+*/
+int CFont::GlyphSource(int utf8, int *gx, int *gy) const
 {
 	int c = utf8 - 32;
 	Assert(c >= 0);
@@ -447,9 +505,17 @@ unsigned int CFont::DrawChar(CGraphic &g, int utf8, int x, int y, const CFontCol
 	if (c < 0 || ipr * this->G->GraphicHeight / this->G->Height <= c) {
 		c = 0;
 	}
-	const int w = this->CharWidth[c];
-	const int gx = (c % ipr) * this->G->Width;
-	const int gy = (c / ipr) * this->G->Height;
+	*gx = (c % ipr) * this->G->Width;
+	*gy = (c / ipr) * this->G->Height;
+	return this->CharWidth[c];
+}
+
+template<bool CLIP>
+unsigned int CFont::DrawChar(CGraphic &g, int utf8, int x, int y, const CFontColor &fc) const
+{
+	int gx;
+	int gy;
+	const int w = GlyphSource(utf8, &gx, &gy);
 
 	if (CLIP) {
 		VideoDrawCharClip(g, gx, gy, w, this->G->Height, x , y, fc);
@@ -479,7 +545,20 @@ CGraphic *CFont::GetFontColorGraphic(const CFontColor &fontColor) const
 }
 
 /**
-**  Draw text with font at x,y clipped/unclipped.
+**  Free all cached glyph runs.
+*/
+static void ClearGlyphRuns()
+{
+	for (std::map<Uint64, CGlyphRun>::iterator it = GlyphRuns.begin(); it != GlyphRuns.end(); ++it) {
+		if (it->second.Surface) {
+			SDL_FreeSurface(it->second.Surface);
+		}
+	}
+	GlyphRuns.clear();
+}
+
+/**
+**  Parse a text into glyphs.
 **
 **  ~    is special prefix.
 **  ~~   is the ~ character self.
@@ -487,37 +566,39 @@ CGraphic *CFont::GetFontColorGraphic(const CFontColor &fontColor) const
 **  ~<   start reverse.
 **  ~>   switch back to last used color.
 **
-**  @param x     X screen position
-**  @param y     Y screen position
-**  @param font  Font number
-**  @param text  Text to be displayed.
-**  @param clip  Flag if TRUE clip, otherwise not.
-**
-**  @return      The length of the printed text.
+**  @param run      Filled with the glyphs of the text.
+**  @param text     Text to be displayed.
+**  @param len      Length of the text.
+**  @param fc       Color of the text.
+**  @param reverse  Reverse color of the text.
 */
-template <const bool CLIP>
-int CLabel::DoDrawText(int x, int y,
-					   const char *const text, const size_t len, const CFontColor *fc) const
+void CFont::PrepareGlyphRun(CGlyphRun &run, const char *text, size_t len,
+							const CFontColor *fc, const CFontColor *reverse) const
 {
-	int widths = 0;
 	int utf8;
-	bool tab;
 	const int tabSize = 4; // FIXME: will be removed when text system will be rewritten
 	size_t pos = 0;
 	const CFontColor *backup = fc;
+	const CFontColor *lastTextColor = LastTextColor;
 	bool isColor = false;
-	font->DynamicLoad();
-	CGraphic *g = font->GetFontColorGraphic(*FontColor);
+	CGraphic *g = GetFontColorGraphic(*FontColor);
+
+	run.Glyphs.clear();
+	run.Width = 0;
+	run.Cacheable = true;
+	run.SetsLastColor = false;
 
 	while (GetUTF8(text, len, pos, utf8)) {
-		tab = false;
+		int count = 1;
 		if (utf8 == '\t') {
-			tab = true;
+			utf8 = ' ';
+			count = tabSize;
 		} else if (utf8 == '~') {
 			switch (text[pos]) {
 				case '\0':  // wrong formatted string.
 					DebugPrint("oops, format your ~\n");
-					return widths;
+					pos = len;
+					continue;
 				case '~':
 					++pos;
 					break;
@@ -527,24 +608,30 @@ int CLabel::DoDrawText(int x, int y,
 				case '!':
 					if (fc != reverse) {
 						fc = reverse;
-						g = font->GetFontColorGraphic(*fc);
+						g = GetFontColorGraphic(*fc);
 					}
 					++pos;
 					continue;
 				case '<':
-					LastTextColor = fc;
+					lastTextColor = fc;
+					run.SetsLastColor = true;
 					if (fc != reverse) {
 						isColor = true;
 						fc = reverse;
-						g = font->GetFontColorGraphic(*fc);
+						g = GetFontColorGraphic(*fc);
 					}
 					++pos;
 					continue;
 				case '>':
-					if (fc != LastTextColor) {
-						std::swap(fc, LastTextColor);
+					// Uses the last color of a previous text.
+					if (!run.SetsLastColor) {
+						run.Cacheable = false;
+					}
+					if (fc != lastTextColor) {
+						std::swap(fc, lastTextColor);
+						run.SetsLastColor = true;
 						isColor = false;
-						g = font->GetFontColorGraphic(*fc);
+						g = GetFontColorGraphic(*fc);
 					}
 					++pos;
 					continue;
@@ -556,39 +643,220 @@ int CLabel::DoDrawText(int x, int y,
 					}
 					if (!*p) {
 						DebugPrint("oops, format your ~\n");
-						return widths;
+						pos = len;
+						continue;
 					}
 					std::string color;
 
 					color.insert(0, text + pos, p - (text + pos));
 					pos = p - text + 1;
-					LastTextColor = fc;
+					lastTextColor = fc;
+					run.SetsLastColor = true;
 					const CFontColor *fc_tmp = CFontColor::Get(color);
 					if (fc_tmp) {
 						isColor = true;
 						fc = fc_tmp;
-						g = font->GetFontColorGraphic(*fc);
+						g = GetFontColorGraphic(*fc);
 					}
 					continue;
 				}
 			}
 		}
-		if (tab) {
-			for (int tabs = 0; tabs < tabSize; ++tabs) {
-				widths += font->DrawChar<CLIP>(*g, ' ', x + widths, y, *fc);
-			}
-		} else {
-			widths += font->DrawChar<CLIP>(*g, utf8, x + widths, y, *fc);
+		while (count--) {
+			int gx;
+			int gy;
+			const int w = GlyphSource(utf8, &gx, &gy);
+			const CGlyphRun::Glyph glyph = {g, fc, short(gx), short(gy), short(w), short(run.Width)};
+
+			run.Glyphs.push_back(glyph);
+			run.Width += w + 1;
 		}
 
 		if (isColor == false && fc != backup) {
 			fc = backup;
-			g = font->GetFontColorGraphic(*fc);
+			g = GetFontColorGraphic(*fc);
+		}
+	}
+	run.LastColor = lastTextColor;
+}
+
+/**
+**  Compose the glyphs of a run into one surface in the screen format.
+**
+**  @param run  The glyph run.
+*/
+void CFont::ComposeGlyphRun(CGlyphRun &run) const
+{
+	const SDL_PixelFormat *f = TheScreen->format;
+	SDL_Surface *s = SDL_CreateRGBSurface(SDL_SWSURFACE, run.Width, G->Height, f->BitsPerPixel,
+										  f->Rmask, f->Gmask, f->Bmask, 0);
+	if (!s) {
+		return;
+	}
+
+	// Find a transparent color which isn't used by the text.
+	Uint32 ckey = Video.MapRGB(s->format, 255, 0, 255);
+	for (bool used = true; used;) {
+		used = false;
+		for (size_t i = 0; i < run.Glyphs.size() && !used; ++i) {
+			for (int j = 0; j < MaxFontColors; ++j) {
+				if (Video.MapRGB(s->format, run.Glyphs[i].Color->Colors[j]) == ckey) {
+					used = true;
+					--ckey;
+					break;
+				}
+			}
 		}
 	}
-	return widths;
+	SDL_FillRect(s, NULL, ckey);
+	SDL_SetColorKey(s, SDL_SRCCOLORKEY | SDL_RLEACCEL, ckey);
+
+	for (size_t i = 0; i < run.Glyphs.size(); ++i) {
+		const CGlyphRun::Glyph &glyph = run.Glyphs[i];
+		SDL_Rect srect = {glyph.GX, glyph.GY, Uint16(glyph.W), Uint16(G->Height)};
+		SDL_Rect drect = {glyph.X, 0, 0, 0};
+		std::vector<SDL_Color> sdlColors(glyph.Color->Colors, glyph.Color->Colors + MaxFontColors);
+
+		SDL_SetColors(glyph.G->Surface, &sdlColors[0], 0, MaxFontColors);
+		SDL_BlitSurface(glyph.G->Surface, &srect, s, &drect);
+	}
+	run.Surface = s;
 }
 
+/**
+**  Get the glyphs of a text prepared for drawing.
+**
+**  Runs are cached by font, colors and text, so a text drawn every
+**  frame is parsed once. Once a run is drawn a few times it is also
+**  composed into a surface on the software renderer.
+**
+**  @param text     Text to be displayed.
+**  @param len      Length of the text.
+**  @param fc       Color of the text.
+**  @param reverse  Reverse color of the text.
+**
+**  @return         The glyph run, valid until the next call.
+*/
+const CGlyphRun &CFont::GetGlyphRun(const char *text, size_t len,
+									const CFontColor *fc, const CFontColor *reverse) const
+{
+	// FNV-1a over the key
+	Uint64 hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < len; ++i) {
+		hash = (hash ^ (unsigned char)text[i]) * 1099511628211ULL;
+	}
+	const void *const ptrs[] = {this, fc, reverse, FontColor};
+	for (size_t i = 0; i < sizeof(ptrs) / sizeof(*ptrs); ++i) {
+		hash = (hash ^ (Uint64)(size_t)ptrs[i]) * 1099511628211ULL;
+	}
+
+	if (GlyphRuns.size() > MaxGlyphRuns) {
+		// Drop the runs not used recently.
+		for (std::map<Uint64, CGlyphRun>::iterator it = GlyphRuns.begin(); it != GlyphRuns.end();) {
+			if (GlyphRunClock - it->second.LastUse >= MaxGlyphRuns) {
+				if (it->second.Surface) {
+					SDL_FreeSurface(it->second.Surface);
+				}
+				GlyphRuns.erase(it++);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	CGlyphRun &run = GlyphRuns[hash];
+	if (run.Font != this || run.Normal != fc || run.Reverse != reverse || run.Initial != FontColor
+		|| run.Text.compare(0, std::string::npos, text, len) != 0) {
+		if (run.Surface) {
+			SDL_FreeSurface(run.Surface);
+			run.Surface = NULL;
+		}
+		run.Font = this;
+		run.Normal = fc;
+		run.Reverse = reverse;
+		run.Initial = FontColor;
+		run.Text.assign(text, len);
+		run.Uses = 0;
+		PrepareGlyphRun(run, text, len, fc, reverse);
+	} else if (!run.Cacheable) {
+		PrepareGlyphRun(run, text, len, fc, reverse);
+	}
+	run.LastUse = GlyphRunClock++;
+	++run.Uses;
+
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (!UseOpenGL)
+#endif
+	{
+		if (run.Uses == 3 && run.Cacheable && run.Width > 0) {
+			ComposeGlyphRun(run);
+		}
+	}
+	return run;
+}
+
+/**
+**  Draw a composed glyph run clipped/unclipped.
+**
+**  @param run  The glyph run.
+**  @param x    X screen position
+**  @param y    Y screen position
+**  @param h    Height of the font.
+*/
+template <const bool CLIP>
+static void DrawGlyphRunSurface(const CGlyphRun &run, int x, int y, int h)
+{
+	int w = run.Width;
+	int ox = 0;
+	int oy = 0;
+	int ex = 0;
+
+	if (CLIP) {
+		CLIP_RECTANGLE_OFS(x, y, w, h, ox, oy, ex);
+	}
+	SDL_Rect srect = {Sint16(ox), Sint16(oy), Uint16(w), Uint16(h)};
+	SDL_Rect drect = {Sint16(x), Sint16(y), 0, 0};
+
+	SDL_BlitSurface(run.Surface, &srect, TheScreen, &drect);
+}
+
+/**
+**  Draw text with font at x,y clipped/unclipped.
+**
+**  @param x     X screen position
+**  @param y     Y screen position
+**  @param text  Text to be displayed.
+**  @param len   Length of the text.
+**  @param fc    Color of the text.
+**
+**  @return      The length of the printed text.
+*/
+template <const bool CLIP>
+int CLabel::DoDrawText(int x, int y,
+					   const char *const text, const size_t len, const CFontColor *fc) const
+{
+	font->DynamicLoad();
+	const CGlyphRun &run = font->GetGlyphRun(text, len, fc, reverse);
+	const int height = font->Height();
+
+	if (run.SetsLastColor) {
+		LastTextColor = run.LastColor;
+	}
+	if (run.Surface) {
+		DrawGlyphRunSurface<CLIP>(run, x, y, height);
+		return run.Width;
+	}
+	for (size_t i = 0; i < run.Glyphs.size(); ++i) {
+		const CGlyphRun::Glyph &glyph = run.Glyphs[i];
+
+		if (CLIP) {
+			VideoDrawCharClip(*glyph.G, glyph.GX, glyph.GY, glyph.W, height, x + glyph.X, y, *glyph.Color);
+		} else {
+			VideoDrawChar(*glyph.G, glyph.GX, glyph.GY, glyph.W, height, x + glyph.X, y, *glyph.Color);
+		}
+	}
+	return run.Width;
+}
 
 CLabel::CLabel(const CFont &f) :
 	normal(DefaultTextColor),
@@ -798,6 +1066,8 @@ void CFont::MeasureWidths()
 {
 	const int maxy = G->GraphicWidth / G->Width * G->GraphicHeight / G->Height;
 
+	ClearGlyphRuns();
+	WidthCache.clear();
 	delete[] CharWidth;
 	CharWidth = new char[maxy];
 	memset(CharWidth, 0, maxy);
@@ -910,11 +1180,12 @@ void LoadFonts()
 #if defined(USE_OPENGL) || defined(USE_GLES)
 void CFont::FreeOpenGL()
 {
+	ClearGlyphRuns();
 	if (this->G) {
 		for (FontColorGraphicMap::iterator it = FontColorGraphics[this].begin();
 			 it != FontColorGraphics[this].end(); ++it) {
 			CGraphic &g = *it->second;
-			glDeleteTextures(g.NumTextures, g.Textures);
+			DeleteGraphicTextures(g, g.Textures);
 		}
 	}
 }
@@ -934,6 +1205,7 @@ void FreeOpenGLFonts()
 
 void CFont::Reload() const
 {
+	ClearGlyphRuns();
 	if (this->G) {
 		FontColorGraphicMap &fontColorGraphicMap = FontColorGraphics[this];
 		for (FontColorGraphicMap::iterator it = fontColorGraphicMap.begin();
@@ -977,6 +1249,7 @@ void ReloadFonts()
 /* static */ CFont *CFont::New(const std::string &ident, CGraphic *g)
 {
 	CFont *&font = Fonts[ident];
+	ClearGlyphRuns();
 	if (font) {
 		if (font->G != g) {
 			CGraphic::Free(font->G);
@@ -1030,6 +1303,7 @@ CFontColor::~CFontColor()
 {
 	CFontColor *&fc = FontColors[ident];
 
+	ClearGlyphRuns();
 	if (fc == NULL) {
 		fc = new CFontColor(ident);
 	}
@@ -1054,6 +1328,7 @@ CFontColor::~CFontColor()
 
 void CFont::Clean()
 {
+	ClearGlyphRuns();
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	CFont *font = this;
 
@@ -1063,7 +1338,7 @@ void CFont::Clean()
 			for (FontColorGraphicMap::iterator it = fontColorGraphicMap.begin();
 				 it != fontColorGraphicMap.end(); ++it) {
 				CGraphic *g = it->second;
-				glDeleteTextures(g->NumTextures, g->Textures);
+				DeleteGraphicTextures(*g, g->Textures);
 				delete[] g->Textures;
 				delete g;
 			}
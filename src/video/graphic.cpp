@@ -39,6 +39,8 @@
 #include <string>
 #include <map>
 #include <list>
+#include <thread>
+#include <vector>
 
 #include "video.h"
 #include "player.h"
@@ -47,6 +49,10 @@
 #include "iolib.h"
 #include "ui.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /*----------------------------------------------------------------------------
 --  Variables
 ----------------------------------------------------------------------------*/
@@ -55,6 +61,51 @@ static int HashCount;
 static std::map<std::string, CGraphic *> GraphicHash;
 static std::list<CGraphic *> Graphics;
 
+/**
+**  A graphic recolored for a player, in the display format.
+**
+**  Only used by the software renderer for paletted graphics, so that
+**  drawing a unit doesn't have to change the palette of the shared
+**  surface and blit through a new color map. The cached surfaces are
+**  kept within PlayerColorSurfaceBudget, least recently used first out.
+*/
+struct PlayerColorSurface {
+	CPlayerColorGraphic *G;    /// Graphic which was recolored
+	int Player;                /// Player whose colors are used
+	SDL_Surface *Surface;      /// Recolored surface
+	SDL_Surface *SurfaceFlip;  /// Recolored flipped surface
+	int NumColors;             /// Number of colors in the palette
+	SDL_Color Palette[256];    /// Palette the surfaces were made from
+	unsigned int LastUse;      /// PlayerColorSurfaceClock of the last draw
+};
+
+/// Bytes of recolored surfaces to keep
+static const size_t PlayerColorSurfaceBudget = 32 * 1024 * 1024;
+
+static std::list<PlayerColorSurface> PlayerColorSurfaceCache;
+static size_t PlayerColorSurfaceBytes;       /// Bytes used by PlayerColorSurfaceCache
+static unsigned int PlayerColorSurfaceClock; /// Counts draws with recolored surfaces
+
+#if defined(USE_OPENGL) || defined(USE_GLES)
+/**
+**  A page of the texture atlas.
+**
+**  Small graphics share these textures so that consecutive draws of
+**  different graphics end up in the same texture batch. A page is
+**  filled shelf by shelf and starts over once all its users are freed.
+*/
+struct TextureAtlasPage {
+	GLuint Texture;   /// Texture name of the page
+	int ShelfX;       /// Next free column of the current shelf
+	int ShelfY;       /// Top of the current shelf
+	int ShelfHeight;  /// Height of the current shelf
+	int Users;        /// Number of graphics placed in the page
+};
+
+static std::vector<TextureAtlasPage> TextureAtlasPages;
+GLint TextureAtlasSize;  /// Size of the texture atlas pages
+#endif
+
 /*----------------------------------------------------------------------------
 --  Functions
 ----------------------------------------------------------------------------*/
@@ -133,10 +184,9 @@ void CGraphic::DrawSubTrans(int gx, int gy, int w, int h, int x, int y,
 {
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
-		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-		glColor4ub(255, 255, 255, alpha);
+		TextureBatchAlpha = alpha;
 		DrawSub(gx, gy, w, h, x, y);
-		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+		TextureBatchAlpha = 0xff;
 	} else
 #endif
 	{
@@ -231,10 +281,9 @@ void CGraphic::DrawFrameTrans(unsigned frame, int x, int y, int alpha) const
 {
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
-		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-		glColor4ub(255, 255, 255, alpha);
+		TextureBatchAlpha = alpha;
 		DrawFrame(frame, x, y);
-		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+		TextureBatchAlpha = 0xff;
 	} else
 #endif
 	{
@@ -247,10 +296,9 @@ void CGraphic::DrawFrameClipTrans(unsigned frame, int x, int y, int alpha) const
 {
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
-		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-		glColor4ub(255, 255, 255, alpha);
+		TextureBatchAlpha = alpha;
 		DrawFrameClip(frame, x, y);
-		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+		TextureBatchAlpha = 0xff;
 	} else
 #endif
 	{
@@ -259,6 +307,183 @@ void CGraphic::DrawFrameClipTrans(unsigned frame, int x, int y, int alpha) const
 	}
 }
 
+/**
+**  Draw a part of a surface clipped.
+**
+**  @param s   surface to draw
+**  @param gx  X offset into the surface
+**  @param gy  Y offset into the surface
+**  @param w   width to display
+**  @param h   height to display
+**  @param x   X screen position
+**  @param y   Y screen position
+*/
+static void DrawSurfaceClip(SDL_Surface *s, int gx, int gy, int w, int h, int x, int y)
+{
+	const int oldx = x;
+	const int oldy = y;
+	CLIP_RECTANGLE(x, y, w, h);
+
+	SDL_Rect srect = {Sint16(gx + x - oldx), Sint16(gy + y - oldy), Uint16(w), Uint16(h)};
+	SDL_Rect drect = {Sint16(x), Sint16(y), 0, 0};
+
+	SDL_BlitSurface(s, &srect, TheScreen, &drect);
+}
+
+/**
+**  Free a recolored surface.
+**
+**  @param it  The recolored surface.
+*/
+static void FreePlayerColorSurface(std::list<PlayerColorSurface>::iterator it)
+{
+	SDL_Surface *surfaces[] = {it->Surface, it->SurfaceFlip};
+
+	for (int i = 0; i < 2; ++i) {
+		if (surfaces[i]) {
+			PlayerColorSurfaceBytes -= surfaces[i]->pitch * surfaces[i]->h;
+			SDL_FreeSurface(surfaces[i]);
+		}
+	}
+	it->G->PlayerColorSurfaces[it->Player] = NULL;
+	PlayerColorSurfaceCache.erase(it);
+}
+
+/**
+**  Free the recolored surfaces of a graphic.
+**
+**  @param g  The graphic.
+*/
+static void FreePlayerColorSurfaces(const CGraphic &g)
+{
+	for (std::list<PlayerColorSurface>::iterator it = PlayerColorSurfaceCache.begin(); it != PlayerColorSurfaceCache.end();) {
+		if (it->G == &g) {
+			FreePlayerColorSurface(it++);
+		} else {
+			++it;
+		}
+	}
+}
+
+/**
+**  Free the least recently used recolored surfaces until there is room.
+**
+**  @param bytes  Bytes needed.
+**  @param keep   Recolored surface which must not be freed.
+*/
+static void EvictPlayerColorSurfaces(size_t bytes, const PlayerColorSurface *keep)
+{
+	while (PlayerColorSurfaceBytes + bytes > PlayerColorSurfaceBudget) {
+		std::list<PlayerColorSurface>::iterator oldest = PlayerColorSurfaceCache.end();
+
+		for (std::list<PlayerColorSurface>::iterator it = PlayerColorSurfaceCache.begin(); it != PlayerColorSurfaceCache.end(); ++it) {
+			if (&*it != keep && (oldest == PlayerColorSurfaceCache.end()
+								 || PlayerColorSurfaceClock - it->LastUse > PlayerColorSurfaceClock - oldest->LastUse)) {
+				oldest = it;
+			}
+		}
+		if (oldest == PlayerColorSurfaceCache.end()) {
+			break;
+		}
+		FreePlayerColorSurface(oldest);
+	}
+}
+
+/**
+**  Check if a recolored surface still matches the graphic.
+**
+**  The palette may have been cycled or the player colors changed since
+**  the surface was made. The player color range of the shared palette
+**  is not compared, it holds the colors of the last player drawn.
+**
+**  @param pcs     The recolored surface.
+**  @param pal     Current palette of the graphic.
+**  @param player  Player whose colors are used.
+**
+**  @return        true if the surface can be drawn.
+*/
+static bool PlayerColorSurfaceValid(const PlayerColorSurface &pcs, const SDL_Palette &pal, const CPlayer &player)
+{
+	if (pal.ncolors != pcs.NumColors) {
+		return false;
+	}
+	const int start = std::min(PlayerColorIndexStart, pal.ncolors);
+	const int end = std::min(PlayerColorIndexStart + PlayerColorIndexCount, pal.ncolors);
+
+	if (memcmp(pal.colors, pcs.Palette, start * sizeof(SDL_Color))
+		|| memcmp(pal.colors + end, pcs.Palette + end, (pal.ncolors - end) * sizeof(SDL_Color))) {
+		return false;
+	}
+	const std::vector<CColor> &colors = player.UnitColors.Colors;
+	for (int i = start; i < end; ++i) {
+		if (i - start >= (int)colors.size()) {
+			return false;
+		}
+		const CColor &c = colors[i - start];
+		if (c.R != pcs.Palette[i].r || c.G != pcs.Palette[i].g || c.B != pcs.Palette[i].b) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+**  Get the graphic recolored for a player in the display format.
+**
+**  @param player  player number
+**  @param flip    get the flipped surface
+**
+**  @return        The recolored surface, NULL if it can't be cached.
+*/
+SDL_Surface *CPlayerColorGraphic::GetPlayerColorSurface(int player, bool flip)
+{
+	if (Surface->format->BytesPerPixel != 1 || !PlayerColorIndexCount || (flip && !SurfaceFlip)) {
+		return NULL;
+	}
+	PlayerColorSurface *pcs = PlayerColorSurfaces[player];
+
+	if (pcs && !PlayerColorSurfaceValid(*pcs, *Surface->format->palette, Players[player])) {
+		for (std::list<PlayerColorSurface>::iterator it = PlayerColorSurfaceCache.begin(); it != PlayerColorSurfaceCache.end(); ++it) {
+			if (&*it == pcs) {
+				FreePlayerColorSurface(it);
+				break;
+			}
+		}
+		pcs = NULL;
+	}
+	SDL_Surface *src = flip ? SurfaceFlip : Surface;
+	if (!pcs || !(flip ? pcs->SurfaceFlip : pcs->Surface)) {
+		const size_t bytes = src->w * src->h * TheScreen->format->BytesPerPixel;
+		if (bytes > PlayerColorSurfaceBudget) {
+			return NULL;
+		}
+		EvictPlayerColorSurfaces(bytes, pcs);
+	}
+	if (!pcs) {
+		PlayerColorSurfaceCache.push_front(PlayerColorSurface());
+		pcs = PlayerColorSurfaces[player] = &PlayerColorSurfaceCache.front();
+		pcs->G = this;
+		pcs->Player = player;
+		pcs->Surface = NULL;
+		pcs->SurfaceFlip = NULL;
+		GraphicPlayerPixels(Players[player], *this);
+		pcs->NumColors = Surface->format->palette->ncolors;
+		memcpy(pcs->Palette, Surface->format->palette->colors, pcs->NumColors * sizeof(SDL_Color));
+	}
+
+	SDL_Surface *&s = flip ? pcs->SurfaceFlip : pcs->Surface;
+	if (!s) {
+		SDL_SetColors(src, pcs->Palette, 0, pcs->NumColors);
+		s = SDL_DisplayFormat(src);
+		if (!s) {
+			return NULL;
+		}
+		PlayerColorSurfaceBytes += s->pitch * s->h;
+	}
+	pcs->LastUse = PlayerColorSurfaceClock++;
+	return s;
+}
+
 /**
 **  Draw graphic object clipped and with player colors.
 **
@@ -279,8 +504,14 @@ void CPlayerColorGraphic::DrawPlayerColorFrameClip(int player, unsigned frame,
 	} else
 #endif
 	{
-		GraphicPlayerPixels(Players[player], *this);
-		DrawFrameClip(frame, x, y);
+		SDL_Surface *s = GetPlayerColorSurface(player, false);
+
+		if (s) {
+			DrawSurfaceClip(s, frame_map[frame].x, frame_map[frame].y, Width, Height, x, y);
+		} else {
+			GraphicPlayerPixels(Players[player], *this);
+			DrawFrameClip(frame, x, y);
+		}
 	}
 }
 
@@ -367,10 +598,9 @@ void CGraphic::DrawFrameTransX(unsigned frame, int x, int y, int alpha) const
 {
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
-		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-		glColor4ub(255, 255, 255, alpha);
+		TextureBatchAlpha = alpha;
 		DrawFrameX(frame, x, y);
-		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+		TextureBatchAlpha = 0xff;
 	} else
 #endif
 	{
@@ -388,10 +618,9 @@ void CGraphic::DrawFrameClipTransX(unsigned frame, int x, int y, int alpha) cons
 {
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
-		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-		glColor4ub(255, 255, 255, alpha);
+		TextureBatchAlpha = alpha;
 		DrawFrameClipX(frame, x, y);
-		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+		TextureBatchAlpha = 0xff;
 	} else
 #endif
 	{
@@ -432,8 +661,14 @@ void CPlayerColorGraphic::DrawPlayerColorFrameClipX(int player, unsigned frame,
 	} else
 #endif
 	{
-		GraphicPlayerPixels(Players[player], *this);
-		DrawFrameClipX(frame, x, y);
+		SDL_Surface *s = GetPlayerColorSurface(player, true);
+
+		if (s) {
+			DrawSurfaceClip(s, frameFlip_map[frame].x, frameFlip_map[frame].y, Width, Height, x, y);
+		} else {
+			GraphicPlayerPixels(Players[player], *this);
+			DrawFrameClipX(frame, x, y);
+		}
 	}
 }
 
@@ -659,42 +894,262 @@ void CGraphic::GenFramesMap()
 	}
 }
 
-static void ApplyGrayScale(SDL_Surface *Surface, int Width, int Height)
+/**
+**  Kernel processing the rows [begin, end) of an image.
+*/
+typedef void ImageRowsFunc(void *data, int begin, int end);
+
+/**
+**  A part of an image processed by one thread.
+*/
+struct ImageRowsJob {
+	ImageRowsFunc *Func;  /// The kernel
+	void *Data;           /// Data of the kernel
+	int Begin;            /// First row
+	int End;              /// Last row + 1
+};
+
+static int ImageRowsThread(void *data)
 {
-	SDL_LockSurface(Surface);
-	const SDL_PixelFormat *f = Surface->format;
-	const int bpp = Surface->format->BytesPerPixel;
-	const double redGray = 0.21;
-	const double greenGray = 0.72;
-	const double blueGray = 0.07;
+	ImageRowsJob &job = *static_cast<ImageRowsJob *>(data);
 
-	switch (bpp) {
-		case 1: {
-			SDL_Color colors[256];
-			SDL_Palette &pal = *Surface->format->palette;
-			for (int i = 0; i < 256; ++i) {
-				const int gray = redGray * pal.colors[i].r + greenGray * pal.colors[i].g + blueGray * pal.colors[i].b;
-				colors[i].r = colors[i].g = colors[i].b = gray;
-			}
-			SDL_SetColors(Surface, &colors[0], 0, 256);
-			break;
+	job.Func(job.Data, job.Begin, job.End);
+	return 0;
+}
+
+/**
+**  Run an image kernel over all rows of an image.
+**
+**  Big images are split over a few threads, the kernels only touch the
+**  pixels of their rows.
+**
+**  @param func   The kernel.
+**  @param data   Data of the kernel.
+**  @param rows   Number of rows of the image.
+**  @param bytes  Bytes processed by the kernel.
+*/
+static void ForEachImageRows(ImageRowsFunc *func, void *data, int rows, size_t bytes)
+{
+	static const size_t MinBytesPerThread = 256 * 1024;
+	static const int MaxImageThreads = 8;
+	int threads = std::min<int>(std::thread::hardware_concurrency(), MaxImageThreads);
+
+	threads = std::min<int>(threads, bytes / MinBytesPerThread);
+	threads = std::min(threads, rows);
+	if (threads <= 1) {
+		func(data, 0, rows);
+		return;
+	}
+	ImageRowsJob jobs[MaxImageThreads];
+	SDL_Thread *thread[MaxImageThreads];
+
+	for (int i = 0; i < threads; ++i) {
+		jobs[i].Func = func;
+		jobs[i].Data = data;
+		jobs[i].Begin = rows * i / threads;
+		jobs[i].End = rows * (i + 1) / threads;
+		// The first part is done by this thread.
+		thread[i] = i ? SDL_CreateThread(ImageRowsThread, &jobs[i]) : NULL;
+	}
+	for (int i = 0; i < threads; ++i) {
+		if (!thread[i]) {
+			ImageRowsThread(&jobs[i]);
 		}
-		case 4: {
-			Uint32 *p;
-			for (int i = 0; i < Height; ++i) {
-				for (int j = 0; j < Width; ++j) {
-					p = (Uint32 *)(Surface->pixels) + i * Width + j * bpp;
-					const Uint32 gray = ((Uint8)((*p) * redGray) >> f->Rshift) +
-										((Uint8)(*(p + 1) * greenGray) >> f->Gshift) +
-										((Uint8)(*(p + 2) * blueGray) >> f->Bshift) +
-										((Uint8)(*(p + 3)) >> f->Ashift);
-					*p = gray;
-				}
+	}
+	for (int i = 1; i < threads; ++i) {
+		if (thread[i]) {
+			SDL_WaitThread(thread[i], NULL);
+		}
+	}
+}
+
+/// Gray level of a color, weights 0.21, 0.72 and 0.07 in 1/256th
+static inline int GrayLevel(int r, int g, int b)
+{
+	return (r * 54 + g * 184 + b * 18) >> 8;
+}
+
+/**
+**  Make the rows of a 32bpp surface gray, 8 bits per color.
+*/
+static void GrayScaleRows32(void *data, int begin, int end)
+{
+	SDL_Surface &s = *static_cast<SDL_Surface *>(data);
+	const SDL_PixelFormat &f = *s.format;
+
+	for (int y = begin; y < end; ++y) {
+		Uint32 *p = reinterpret_cast<Uint32 *>(static_cast<Uint8 *>(s.pixels) + y * s.pitch);
+		int x = 0;
+#ifdef __SSE2__
+		const __m128i mask = _mm_set1_epi32(0xff);
+		const __m128i alpha = _mm_set1_epi32(f.Amask);
+		const __m128i weightR = _mm_set1_epi32(54);
+		const __m128i weightG = _mm_set1_epi32(184);
+		const __m128i weightB = _mm_set1_epi32(18);
+		const __m128i shiftR = _mm_cvtsi32_si128(f.Rshift);
+		const __m128i shiftG = _mm_cvtsi32_si128(f.Gshift);
+		const __m128i shiftB = _mm_cvtsi32_si128(f.Bshift);
+
+		for (; x + 4 <= s.w; x += 4) {
+			const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + x));
+			// Products fit in the low 16 bits of each lane.
+			__m128i gray = _mm_mullo_epi16(_mm_and_si128(_mm_srl_epi32(c, shiftR), mask), weightR);
+			gray = _mm_add_epi32(gray, _mm_mullo_epi16(_mm_and_si128(_mm_srl_epi32(c, shiftG), mask), weightG));
+			gray = _mm_add_epi32(gray, _mm_mullo_epi16(_mm_and_si128(_mm_srl_epi32(c, shiftB), mask), weightB));
+			gray = _mm_srli_epi32(gray, 8);
+
+			__m128i res = _mm_and_si128(c, alpha);
+			res = _mm_or_si128(res, _mm_sll_epi32(gray, shiftR));
+			res = _mm_or_si128(res, _mm_sll_epi32(gray, shiftG));
+			res = _mm_or_si128(res, _mm_sll_epi32(gray, shiftB));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(p + x), res);
+		}
+#endif
+		for (; x < s.w; ++x) {
+			const Uint32 c = p[x];
+			const Uint32 gray = GrayLevel((c >> f.Rshift) & 0xff, (c >> f.Gshift) & 0xff, (c >> f.Bshift) & 0xff);
+
+			p[x] = (c & f.Amask) | (gray << f.Rshift) | (gray << f.Gshift) | (gray << f.Bshift);
+		}
+	}
+}
+
+/**
+**  Make the rows of a 16, 24 or 32bpp surface gray, any pixel format.
+*/
+static void GrayScaleRows(void *data, int begin, int end)
+{
+	SDL_Surface &s = *static_cast<SDL_Surface *>(data);
+	const int bpp = s.format->BytesPerPixel;
+
+	for (int y = begin; y < end; ++y) {
+		Uint8 *p = static_cast<Uint8 *>(s.pixels) + y * s.pitch;
+
+		for (int x = 0; x < s.w; ++x, p += bpp) {
+			Uint32 c = 0;
+			memcpy(&c, p, bpp);
+			Uint8 r, g, b, a;
+			SDL_GetRGBA(c, s.format, &r, &g, &b, &a);
+			const Uint8 gray = GrayLevel(r, g, b);
+			c = SDL_MapRGBA(s.format, gray, gray, gray, a);
+			memcpy(p, &c, bpp);
+		}
+	}
+}
+
+/**
+**  Make a surface gray.
+**
+**  @param surface  Surface to change.
+*/
+static void ApplyGrayScale(SDL_Surface *surface)
+{
+	SDL_LockSurface(surface);
+	const SDL_PixelFormat &f = *surface->format;
+
+	if (f.BytesPerPixel == 1) {
+		SDL_Color colors[256];
+		const SDL_Palette &pal = *f.palette;
+		for (int i = 0; i < pal.ncolors; ++i) {
+			const Uint8 gray = GrayLevel(pal.colors[i].r, pal.colors[i].g, pal.colors[i].b);
+			colors[i].r = colors[i].g = colors[i].b = gray;
+		}
+		SDL_SetColors(surface, &colors[0], 0, pal.ncolors);
+	} else {
+		const size_t bytes = surface->h * surface->pitch;
+		if (f.BytesPerPixel == 4 && !f.Rloss && !f.Gloss && !f.Bloss) {
+			ForEachImageRows(GrayScaleRows32, surface, surface->h, bytes);
+		} else {
+			ForEachImageRows(GrayScaleRows, surface, surface->h, bytes);
+		}
+	}
+	SDL_UnlockSurface(surface);
+}
+
+/**
+**  Source of a resize: for each destination row and column the source
+**  row and column, the next ones, and the weight of the next ones in
+**  1/256th.
+*/
+struct ResizeData {
+	const Uint8 *Src;        /// Source pixels
+	int SrcPitch;            /// Source pitch
+	Uint8 *Dst;              /// Destination pixels
+	int W;                   /// Destination width
+	int Bpp;                 /// Bytes per pixel
+	std::vector<int> X;      /// Source column of each destination column
+	std::vector<int> X1;     /// Next source column, same at the border
+	std::vector<int> WX;     /// Weight of the next column
+	std::vector<int> Y;      /// Source row of each destination row
+	std::vector<int> Y1;     /// Next source row, same at the border
+	std::vector<int> WY;     /// Weight of the next row
+};
+
+/**
+**  Resize rows of an 8bpp surface, nearest pixel.
+*/
+static void ResizeRows8(void *data, int begin, int end)
+{
+	const ResizeData &rd = *static_cast<ResizeData *>(data);
+
+	for (int i = begin; i < end; ++i) {
+		const Uint8 *src = rd.Src + rd.Y[i] * rd.SrcPitch;
+		Uint8 *dst = rd.Dst + i * rd.W;
+
+		for (int j = 0; j < rd.W; ++j) {
+			dst[j] = src[rd.X[j]];
+		}
+	}
+}
+
+/**
+**  Resize rows of a 24 or 32bpp surface.
+**
+**  Each pixel is the mean of the interpolations with the next row, the
+**  next column and the next diagonal pixel, in fixed point.
+*/
+static void ResizeRows(void *data, int begin, int end)
+{
+	const ResizeData &rd = *static_cast<ResizeData *>(data);
+	const int bpp = rd.Bpp;
+
+	for (int i = begin; i < end; ++i) {
+		const Uint8 *row = rd.Src + rd.Y[i] * rd.SrcPitch;
+		const Uint8 *row1 = rd.Src + rd.Y1[i] * rd.SrcPitch;
+		Uint8 *dst = rd.Dst + i * rd.W * bpp;
+
+		for (int j = 0; j < rd.W; ++j, dst += bpp) {
+			const Uint8 *p1 = row + rd.X[j] * bpp;
+			const Uint8 *p2 = row1 + rd.X[j] * bpp;
+			const Uint8 *p3 = row + rd.X1[j] * bpp;
+			const Uint8 *p4 = (rd.Y1[i] != rd.Y[i] && rd.X1[j] != rd.X[j]) ? row1 + rd.X1[j] * bpp : p1;
+			const int w2 = (rd.WY[i] + 1) / 3;
+			const int w3 = (rd.WX[j] + 1) / 3;
+			const int w4 = (rd.WX[j] + rd.WY[i] + 3) / 6;
+			const int w1 = 256 - w2 - w3 - w4;
+#ifdef __SSE2__
+			if (bpp == 4) {
+				const __m128i zero = _mm_setzero_si128();
+				Uint32 c1, c2, c3, c4;
+				memcpy(&c1, p1, 4);
+				memcpy(&c2, p2, 4);
+				memcpy(&c3, p3, 4);
+				memcpy(&c4, p4, 4);
+				__m128i sum = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(c1), zero), _mm_set1_epi16(w1));
+				sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(c2), zero), _mm_set1_epi16(w2)));
+				sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(c3), zero), _mm_set1_epi16(w3)));
+				sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(c4), zero), _mm_set1_epi16(w4)));
+				sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8);
+				const Uint32 c = _mm_cvtsi128_si32(_mm_packus_epi16(sum, zero));
+				memcpy(dst, &c, 4);
+				continue;
+			}
+#endif
+			for (int k = 0; k < bpp; ++k) {
+				dst[k] = (p1[k] * w1 + p2[k] * w2 + p3[k] * w3 + p4[k] * w4 + 128) >> 8;
 			}
-			break;
 		}
 	}
-	SDL_UnlockSurface(Surface);
 }
 
 /**
@@ -738,7 +1193,7 @@ void CGraphic::Load(bool grayscale)
 	NumFrames = GraphicWidth / Width * GraphicHeight / Height;
 
 	if (grayscale) {
-		ApplyGrayScale(Surface, Width, Height);
+		ApplyGrayScale(Surface);
 	}
 
 #if defined(USE_OPENGL) || defined(USE_GLES)
@@ -773,6 +1228,104 @@ static void FreeSurface(SDL_Surface **surface)
 	*surface = NULL;
 }
 
+#if defined(USE_OPENGL) || defined(USE_GLES)
+
+/**
+**  Check if the textures of a graphic should go into the texture atlas.
+*/
+static bool UseTextureAtlas(const CGraphic &g)
+{
+#ifdef USE_OPENGL
+	if (GLTextureCompressionSupported && UseGLTextureCompression) {
+		return false;
+	}
+#endif
+	const int size = std::min<int>(GLMaxTextureSize, 2048);
+
+	return size >= 1024 && !g.NumColorCycles
+		   && g.GraphicWidth <= size / 4 && g.GraphicHeight <= size / 4;
+}
+
+/**
+**  Find room for a graphic in the texture atlas.
+**
+**  @param w         Width of the graphic.
+**  @param h         Height of the graphic.
+**  @param textures  Filled with the page texture and the position in it.
+*/
+static void AllocTextureAtlasRegion(int w, int h, GLuint *textures)
+{
+	// Keep one transparent pixel between graphics.
+	++w;
+	++h;
+	for (size_t i = 0;; ++i) {
+		if (i == TextureAtlasPages.size()) {
+			TextureAtlasPage page = {0, 0, 0, 0, 0};
+
+			TextureAtlasSize = std::min<int>(GLMaxTextureSize, 2048);
+			glGenTextures(1, &page.Texture);
+			glBindTexture(GL_TEXTURE_2D, page.Texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, TextureAtlasSize, TextureAtlasSize, 0,
+						 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			TextureAtlasPages.push_back(page);
+		}
+		TextureAtlasPage &page = TextureAtlasPages[i];
+		int x = page.ShelfX;
+		int y = page.ShelfY;
+		int shelfHeight = page.ShelfHeight;
+
+		if (x + w > TextureAtlasSize) {
+			x = 0;
+			y += shelfHeight;
+			shelfHeight = 0;
+		}
+		if (y + h > TextureAtlasSize) {
+			continue;
+		}
+		page.ShelfX = x + w;
+		page.ShelfY = y;
+		page.ShelfHeight = std::max(shelfHeight, h);
+		++page.Users;
+
+		textures[0] = page.Texture;
+		textures[1] = x;
+		textures[2] = y;
+		return;
+	}
+}
+
+/**
+**  Delete the OpenGL textures of a graphic.
+**
+**  @param g         The graphic object.
+**  @param textures  Textures of the graphic, or of one of its variants.
+*/
+void DeleteGraphicTextures(const CGraphic &g, GLuint *textures)
+{
+	// Pending draws may still use the textures.
+	FlushTextureBatch();
+
+	if (!g.TextureAtlased) {
+		glDeleteTextures(g.NumTextures, textures);
+		return;
+	}
+	for (size_t i = 0; i < TextureAtlasPages.size(); ++i) {
+		TextureAtlasPage &page = TextureAtlasPages[i];
+		if (page.Texture == textures[0]) {
+			if (--page.Users == 0) {
+				page.ShelfX = page.ShelfY = page.ShelfHeight = 0;
+			}
+			break;
+		}
+	}
+}
+
+#endif
+
 /**
 **  Free a graphic
 **
@@ -792,7 +1345,7 @@ void CGraphic::Free(CGraphic *g)
 		// No more uses of this graphic
 		if (UseOpenGL) {
 			if (g->Textures) {
-				glDeleteTextures(g->NumTextures, g->Textures);
+				DeleteGraphicTextures(*g, g->Textures);
 				delete[] g->Textures;
 				g->DeleteColorCyclingTextures();
 			}
@@ -800,7 +1353,7 @@ void CGraphic::Free(CGraphic *g)
 			if (cg) {
 				for (int i = 0; i < PlayerMax; ++i) {
 					if (cg->PlayerColorTextures[i]) {
-						glDeleteTextures(cg->NumTextures, cg->PlayerColorTextures[i]);
+						DeleteGraphicTextures(*cg, cg->PlayerColorTextures[i]);
 						delete[] cg->PlayerColorTextures[i];
 					}
 				}
@@ -809,6 +1362,7 @@ void CGraphic::Free(CGraphic *g)
 		}
 #endif
 
+		FreePlayerColorSurfaces(*g);
 		FreeSurface(&g->Surface);
 		delete[] g->frame_map;
 		g->frame_map = NULL;
@@ -839,17 +1393,21 @@ void FreeOpenGLGraphics()
 	std::list<CGraphic *>::iterator i;
 	for (i = Graphics.begin(); i != Graphics.end(); ++i) {
 		if ((*i)->Textures) {
-			glDeleteTextures((*i)->NumTextures, (*i)->Textures);
+			DeleteGraphicTextures(**i, (*i)->Textures);
 		}
 		CPlayerColorGraphic *cg = dynamic_cast<CPlayerColorGraphic *>(*i);
 		if (cg) {
 			for (int j = 0; j < PlayerMax; ++j) {
 				if (cg->PlayerColorTextures[j]) {
-					glDeleteTextures(cg->NumTextures, cg->PlayerColorTextures[j]);
+					DeleteGraphicTextures(*cg, cg->PlayerColorTextures[j]);
 				}
 			}
 		}
 	}
+	for (size_t i = 0; i < TextureAtlasPages.size(); ++i) {
+		glDeleteTextures(1, &TextureAtlasPages[i].Texture);
+	}
+	TextureAtlasPages.clear();
 }
 
 /**
@@ -895,6 +1453,7 @@ void CGraphic::Flip()
 	if (SurfaceFlip) {
 		return;
 	}
+	FreePlayerColorSurfaces(*this);
 
 	SDL_Surface *s = SurfaceFlip = SDL_ConvertSurface(Surface, Surface->format, SDL_SWSURFACE);
 	if (Surface->flags & SDL_SRCCOLORKEY) {
@@ -1000,6 +1559,7 @@ void CGraphic::UseDisplayFormat()
 	if (UseOpenGL) { return; }
 #endif
 
+	FreePlayerColorSurfaces(*this);
 	SDL_Surface *s = Surface;
 
 	if (s->format->Amask != 0) {
@@ -1042,9 +1602,10 @@ static int PowerOf2(int x)
 **  @param colors   Unit colors.
 **  @param ow       Offset width.
 **  @param oh       Offset height.
+**  @param atlas    Atlas page and position to fill instead of a texture.
 */
 static void MakeTextures2(CGraphic *g, GLuint texture, CUnitColors *colors,
-						  int ow, int oh)
+						  int ow, int oh, const GLuint *atlas = NULL)
 {
 	int useckey = g->Surface->flags & SDL_SRCCOLORKEY;
 	SDL_PixelFormat *f = g->Surface->format;
@@ -1054,8 +1615,8 @@ static void MakeTextures2(CGraphic *g, GLuint texture, CUnitColors *colors,
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	int maxw = std::min<int>(g->GraphicWidth - ow, GLMaxTextureSize);
 	int maxh = std::min<int>(g->GraphicHeight - oh, GLMaxTextureSize);
-	int w = PowerOf2(maxw);
-	int h = PowerOf2(maxh);
+	int w = atlas ? maxw : PowerOf2(maxw);
+	int h = atlas ? maxh : PowerOf2(maxh);
 	unsigned char *tex = new unsigned char[w * h * 4];
 	memset(tex, 0, w * h * 4);
 	unsigned char alpha;
@@ -1067,10 +1628,12 @@ static void MakeTextures2(CGraphic *g, GLuint texture, CUnitColors *colors,
 
 	SDL_LockSurface(g->Surface);
 	glBindTexture(GL_TEXTURE_2D, texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	if (!atlas) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	}
 
 	unsigned char *tp;
 	const unsigned char *sp;
@@ -1145,7 +1708,11 @@ static void MakeTextures2(CGraphic *g, GLuint texture, CUnitColors *colors,
 	}
 #endif
 
-	glTexImage2D(GL_TEXTURE_2D, 0, internalformat, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, tex);
+	if (atlas) {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, atlas[1], atlas[2], w, h, GL_RGBA, GL_UNSIGNED_BYTE, tex);
+	} else {
+		glTexImage2D(GL_TEXTURE_2D, 0, internalformat, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, tex);
+	}
 
 #ifdef DEBUG
 	int x;
@@ -1185,6 +1752,20 @@ static void MakeTextures(CGraphic *g, int player, CUnitColors *colors)
 
 	CPlayerColorGraphic *cg = dynamic_cast<CPlayerColorGraphic *>(g);
 	GLuint *textures;
+
+	g->TextureAtlased = UseTextureAtlas(*g);
+	if (g->TextureAtlased) {
+		textures = new GLuint[3];
+		if (!colors || !cg) {
+			g->Textures = textures;
+		} else {
+			cg->PlayerColorTextures[player] = textures;
+		}
+		g->NumTextures = 1;
+		AllocTextureAtlasRegion(g->GraphicWidth, g->GraphicHeight, textures);
+		MakeTextures2(g, textures[0], colors, 0, 0, textures);
+		return;
+	}
 	if (!colors || !cg) {
 		textures = g->Textures = new GLuint[g->NumTextures];
 		glGenTextures(g->NumTextures, g->Textures);
@@ -1237,13 +1818,19 @@ void MakeColorCyclingTextures(CGraphic *g, int count)
 	if (g->ColorCyclingTextures) {
 		return;
 	}
+	g->NumColorCycles = count;
+	// Color cycling swaps the texture arrays, which the atlas can't follow.
+	if (g->TextureAtlased && g->Textures) {
+		DeleteGraphicTextures(*g, g->Textures);
+		delete[] g->Textures;
+		g->Textures = NULL;
+	}
 	MakeTexture(g); // ensure that we are initialized
 
 	int tw = (g->GraphicWidth - 1) / GLMaxTextureSize + 1;
 	const int th = (g->GraphicHeight - 1) / GLMaxTextureSize + 1;
 
 	GLuint **textures;
-	g->NumColorCycles = count;
 	textures = g->ColorCyclingTextures = new GLuint*[count];
 
 	for (int c = 0; c < count; c++) {
@@ -1288,6 +1875,7 @@ void CGraphic::Resize(int w, int h)
 	if (GraphicWidth == w && GraphicHeight == h) {
 		return;
 	}
+	FreePlayerColorSurfaces(*this);
 
 	// Resizing the same image multiple times looks horrible
 	// If the image has already been resized then get a clean copy first
@@ -1302,94 +1890,58 @@ void CGraphic::Resize(int w, int h)
 	Uint32 ckey = Surface->format->colorkey;
 	int useckey = Surface->flags & SDL_SRCCOLORKEY;
 
-	int bpp = Surface->format->BytesPerPixel;
-	if (bpp == 1) {
-		SDL_Color pal[256];
-
-		SDL_LockSurface(Surface);
-
-		unsigned char *pixels = (unsigned char *)Surface->pixels;
-		unsigned char *data = new unsigned char[w * h];
-		int x = 0;
+	const int bpp = Surface->format->BytesPerPixel;
+	ResizeData rd;
+
+	rd.Src = (const Uint8 *)Surface->pixels;
+	rd.SrcPitch = Surface->pitch;
+	rd.Dst = new Uint8[w * h * bpp];
+	rd.W = w;
+	rd.Bpp = bpp;
+	rd.X.resize(w);
+	rd.X1.resize(w);
+	rd.WX.resize(w);
+	rd.Y.resize(h);
+	rd.Y1.resize(h);
+	rd.WY.resize(h);
+	for (int j = 0; j < w; ++j) {
+		const int fx = (long long)j * Width * 256 / w;
+		rd.X[j] = fx >> 8;
+		rd.X1[j] = rd.X[j] != Surface->w - 1 ? rd.X[j] + 1 : rd.X[j];
+		rd.WX[j] = fx & 0xff;
+	}
+	for (int i = 0; i < h; ++i) {
+		const int fy = (long long)i * Height * 256 / h;
+		rd.Y[i] = fy >> 8;
+		rd.Y1[i] = rd.Y[i] != Surface->h - 1 ? rd.Y[i] + 1 : rd.Y[i];
+		rd.WY[i] = fy & 0xff;
+	}
 
-		for (int i = 0; i < h; ++i) {
-			for (int j = 0; j < w; ++j) {
-				data[x] = pixels[(i * Height / h) * Surface->pitch + j * Width / w];
-				++x;
-			}
-		}
+	SDL_LockSurface(Surface);
+	ForEachImageRows(bpp == 1 ? ResizeRows8 : ResizeRows, &rd, h, w * h * bpp);
+	SDL_UnlockSurface(Surface);
+	VideoPaletteListRemove(Surface);
 
-		SDL_UnlockSurface(Surface);
-		VideoPaletteListRemove(Surface);
+	if (bpp == 1) {
+		SDL_Color pal[256];
 
 		memcpy(pal, Surface->format->palette->colors, sizeof(SDL_Color) * 256);
 		SDL_FreeSurface(Surface);
 
-		Surface = SDL_CreateRGBSurfaceFrom(data, w, h, 8, w, 0, 0, 0, 0);
+		Surface = SDL_CreateRGBSurfaceFrom(rd.Dst, w, h, 8, w, 0, 0, 0, 0);
 		if (Surface->format->BytesPerPixel == 1) {
 			VideoPaletteListAdd(Surface);
 		}
 		SDL_SetPalette(Surface, SDL_LOGPAL | SDL_PHYSPAL, pal, 0, 256);
 	} else {
-		SDL_LockSurface(Surface);
-
-		unsigned char *pixels = (unsigned char *)Surface->pixels;
-		unsigned char *data = new unsigned char[w * h * bpp];
-		int x = 0;
-
-		for (int i = 0; i < h; ++i) {
-			float fy = (float)i * Height / h;
-			int iy = (int)fy;
-			fy -= iy;
-			for (int j = 0; j < w; ++j) {
-				float fx = (float)j * Width / w;
-				int ix = (int)fx;
-				fx -= ix;
-				float fz = (fx + fy) / 2;
-
-				unsigned char *p1 = &pixels[iy * Surface->pitch + ix * bpp];
-				unsigned char *p2 = (iy != Surface->h - 1) ?
-									&pixels[(iy + 1) * Surface->pitch + ix * bpp] :
-									p1;
-				unsigned char *p3 = (ix != Surface->w - 1) ?
-									&pixels[iy * Surface->pitch + (ix + 1) * bpp] :
-									p1;
-				unsigned char *p4 = (iy != Surface->h - 1 && ix != Surface->w - 1) ?
-									&pixels[(iy + 1) * Surface->pitch + (ix + 1) * bpp] :
-									p1;
-
-				data[x * bpp + 0] = static_cast<unsigned char>(
-										(p1[0] * (1 - fy) + p2[0] * fy +
-										 p1[0] * (1 - fx) + p3[0] * fx +
-										 p1[0] * (1 - fz) + p4[0] * fz) / 3.0 + .5);
-				data[x * bpp + 1] = static_cast<unsigned char>(
-										(p1[1] * (1 - fy) + p2[1] * fy +
-										 p1[1] * (1 - fx) + p3[1] * fx +
-										 p1[1] * (1 - fz) + p4[1] * fz) / 3.0 + .5);
-				data[x * bpp + 2] = static_cast<unsigned char>(
-										(p1[2] * (1 - fy) + p2[2] * fy +
-										 p1[2] * (1 - fx) + p3[2] * fx +
-										 p1[2] * (1 - fz) + p4[2] * fz) / 3.0 + .5);
-				if (bpp == 4) {
-					data[x * bpp + 3] = static_cast<unsigned char>(
-											(p1[3] * (1 - fy) + p2[3] * fy +
-											 p1[3] * (1 - fx) + p3[3] * fx +
-											 p1[3] * (1 - fz) + p4[3] * fz) / 3.0 + .5);
-				}
-				++x;
-			}
-		}
-
 		int Rmask = Surface->format->Rmask;
 		int Gmask = Surface->format->Gmask;
 		int Bmask = Surface->format->Bmask;
 		int Amask = Surface->format->Amask;
 
-		SDL_UnlockSurface(Surface);
-		VideoPaletteListRemove(Surface);
 		SDL_FreeSurface(Surface);
 
-		Surface = SDL_CreateRGBSurfaceFrom(data, w, h, 8 * bpp, w * bpp,
+		Surface = SDL_CreateRGBSurfaceFrom(rd.Dst, w, h, 8 * bpp, w * bpp,
 										   Rmask, Gmask, Bmask, Amask);
 	}
 	if (useckey) {
@@ -1400,7 +1952,7 @@ void CGraphic::Resize(int w, int h)
 
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL && Textures) {
-		glDeleteTextures(NumTextures, Textures);
+		DeleteGraphicTextures(*this, Textures);
 		delete[] Textures;
 		Textures = NULL;
 		MakeTexture(this);
@@ -1423,6 +1975,7 @@ void CGraphic::SetOriginalSize()
 	if (!Resized) {
 		return;
 	}
+	FreePlayerColorSurfaces(*this);
 
 	
 	if (Surface) {
@@ -1445,7 +1998,7 @@ void CGraphic::SetOriginalSize()
 
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL && Textures) {
-		glDeleteTextures(NumTextures, Textures);
+		DeleteGraphicTextures(*this, Textures);
 		delete[] Textures;
 		Textures = NULL;
 		DeleteColorCyclingTextures();
@@ -1494,13 +2047,72 @@ bool CGraphic::TransparentPixel(int x, int y)
 	return ret;
 }
 
+/**
+**  Make the rows of a 32bpp surface a shadow: black, and half as
+**  opaque if the surface has an alpha channel.
+*/
+static void ShadowRows32(void *data, int begin, int end)
+{
+	SDL_Surface &s = *static_cast<SDL_Surface *>(data);
+	const Uint32 amask = s.format->Amask;
+	const Uint32 ashift = s.format->Ashift;
+	const bool useckey = (s.flags & SDL_SRCCOLORKEY) != 0;
+	const Uint32 ckey = s.format->colorkey;
+
+	for (int y = begin; y < end; ++y) {
+		Uint32 *p = reinterpret_cast<Uint32 *>(static_cast<Uint8 *>(s.pixels) + y * s.pitch);
+		int x = 0;
+#ifdef __SSE2__
+		if (!useckey) {
+			const __m128i mask = _mm_set1_epi32(amask);
+			const __m128i lsb = _mm_set1_epi32(1u << ashift);
+			for (; x + 4 <= s.w; x += 4) {
+				__m128i c = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + x)), mask);
+				// Half the alpha: drop its lowest bit, then shift it down.
+				c = _mm_srli_epi32(_mm_andnot_si128(lsb, c), 1);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(p + x), _mm_and_si128(c, mask));
+			}
+		}
+#endif
+		for (; x < s.w; ++x) {
+			if (useckey && p[x] == ckey) {
+				continue;
+			}
+			p[x] = (((p[x] & amask) >> ashift) / 2 << ashift) & amask;
+		}
+	}
+}
+
 /**
 **  Make shadow sprite
-**
-**  @todo FIXME: 32bpp
 */
 void CGraphic::MakeShadow()
 {
+	FreePlayerColorSurfaces(*this);
+
+	if (Surface->format->BytesPerPixel == 4 && Surface->format->Amask) {
+		// Set all pixels to black with half their alpha
+		SDL_Surface *surfaces[] = {Surface, SurfaceFlip};
+		for (int i = 0; i < 2; ++i) {
+			if (surfaces[i]) {
+				SDL_LockSurface(surfaces[i]);
+				ForEachImageRows(ShadowRows32, surfaces[i], surfaces[i]->h, surfaces[i]->h * surfaces[i]->pitch);
+				SDL_UnlockSurface(surfaces[i]);
+			}
+		}
+#if defined(USE_OPENGL) || defined(USE_GLES)
+		if (UseOpenGL) {
+			if (Textures) {
+				DeleteGraphicTextures(*this, Textures);
+				delete[] Textures;
+				Textures = NULL;
+				DeleteColorCyclingTextures();
+			}
+			MakeTexture(this);
+		}
+#endif
+		return;
+	}
 	SDL_Color colors[256];
 
 	// Set all colors in the palette to black and use 50% alpha
@@ -1512,7 +2124,7 @@ void CGraphic::MakeShadow()
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
 		if (Textures) {
-			glDeleteTextures(NumTextures, Textures);
+			DeleteGraphicTextures(*this, Textures);
 			delete[] Textures;
 			Textures = NULL;
 			DeleteColorCyclingTextures();
@@ -1528,6 +2140,26 @@ void CGraphic::MakeShadow()
 	}
 }
 
+/**
+**  Decode the files of the graphics not loaded yet ahead on threads.
+**
+**  Graphics which are not loaded afterwards only cost their decoding,
+**  FinishPreloadGraphics frees them.
+*/
+void PreloadGraphics()
+{
+	std::vector<std::string> files;
+
+	for (std::map<std::string, CGraphic *>::const_iterator it = GraphicHash.begin(); it != GraphicHash.end(); ++it) {
+		const CGraphic &g = *it->second;
+
+		if (!g.Surface && !g.File.empty()) {
+			files.push_back(LibraryFileName(g.File.c_str()));
+		}
+	}
+	PreloadPNG(files);
+}
+
 void FreeGraphics()
 {
 	std::map<std::string, CGraphic *>::iterator i;
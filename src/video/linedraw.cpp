@@ -39,6 +39,11 @@
 
 #include "intern_video.h"
 
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 /*----------------------------------------------------------------------------
 -- Declarations
@@ -62,6 +67,9 @@ void (*VideoDrawPixel)(Uint32 color, int x, int y);
 static void (*VideoDoDrawPixel)(Uint32 color, int x, int y);
 void (*VideoDrawTransPixel)(Uint32 color, int x, int y, unsigned char alpha);
 static void (*VideoDoDrawTransPixel)(Uint32 color, int x, int y, unsigned char alpha);
+static void (*VideoDoDrawHSpan)(Uint32 color, int x, int y, int width);
+static void (*VideoDoDrawVSpan)(Uint32 color, int x, int y, int height);
+static void (*VideoDoDrawTransHSpan)(Uint32 color, int x, int y, int width, unsigned char alpha);
 
 /**
 **  Draw a 16-bit pixel
@@ -156,6 +164,83 @@ void VideoDrawTransPixel32(Uint32 color, int x, int y, unsigned char alpha)
 	Video.UnlockScreen();
 }
 
+/**
+**  Draw a horizontal span of pixels, T is the pixel type of the screen.
+*/
+template <typename T>
+static void VideoFillHSpan(Uint32 color, int x, int y, int width)
+{
+	T *p = &((T *)TheScreen->pixels)[x + y * Video.Width];
+	std::fill_n(p, std::max(width, 0), T(color));
+}
+
+/**
+**  Draw a vertical span of pixels, T is the pixel type of the screen.
+*/
+template <typename T>
+static void VideoFillVSpan(Uint32 color, int x, int y, int height)
+{
+	T *p = &((T *)TheScreen->pixels)[x + y * Video.Width];
+	for (int i = 0; i < height; ++i, p += Video.Width) {
+		*p = T(color);
+	}
+}
+
+/**
+**  Draw a transparent horizontal span of 16-bit pixels
+*/
+static void VideoDoDrawTransHSpan16(Uint32 color, int x, int y, int width, unsigned char alpha)
+{
+	// Loses precision for speed
+	alpha = (255 - alpha) >> 3;
+
+	Uint16 *p = &((Uint16 *)TheScreen->pixels)[x + y * Video.Width];
+	color = (((color << 16) | color) & 0x07E0F81F);
+	for (int i = 0; i < width; ++i) {
+		unsigned long dp = p[i];
+		dp = ((dp << 16) | dp) & 0x07E0F81F;
+		dp = ((((dp - color) * alpha) >> 5) + color) & 0x07E0F81F;
+		p[i] = (Uint16)((dp >> 16) | dp);
+	}
+}
+
+/**
+**  Draw a transparent horizontal span of 32-bit pixels
+**
+**  Each channel becomes (dst * (255 - alpha) + color * (alpha + 1)) / 256,
+**  four pixels at a time with SSE2.
+*/
+static void VideoDoDrawTransHSpan32(Uint32 color, int x, int y, int width, unsigned char alpha)
+{
+	const Uint32 a = 255 - alpha;
+	const Uint32 ia = 256 - a;
+	Uint32 *p = &((Uint32 *)TheScreen->pixels)[x + y * Video.Width];
+	int i = 0;
+
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i va = _mm_set1_epi16(a);
+	// The color part is the same for every pixel.
+	const __m128i vc = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_set1_epi32(color), zero), _mm_set1_epi16(ia));
+
+	for (; i + 4 <= width; i += 4) {
+		const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+		const __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), va), vc), 8);
+		const __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), va), vc), 8);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), _mm_packus_epi16(lo, hi));
+	}
+#endif
+
+	const Uint32 c1 = (color & 0x00FF00FF) * ia;
+	const Uint32 c2 = ((color >> 8) & 0x00FF00FF) * ia;
+	for (; i < width; ++i) {
+		const Uint32 d = p[i];
+		const Uint32 dp1 = (((d & 0x00FF00FF) * a + c1) >> 8) & 0x00FF00FF;
+		const Uint32 dp2 = (((d >> 8) & 0x00FF00FF) * a + c2) & 0xFF00FF00;
+		p[i] = dp1 | dp2;
+	}
+}
+
 /**
 **  Draw a clipped pixel
 */
@@ -202,9 +287,7 @@ void DrawTransPixelClip(Uint32 color, int x, int y, unsigned char alpha)
 void DrawVLine(Uint32 color, int x, int y, int height)
 {
 	Video.LockScreen();
-	for (int i = 0; i < height; ++i) {
-		VideoDoDrawPixel(color, x, y + i);
-	}
+	VideoDoDrawVSpan(color, x, y, height);
 	Video.UnlockScreen();
 }
 
@@ -237,11 +320,9 @@ void DrawVLineClip(Uint32 color, int x, int y, int height)
 void DrawTransVLineClip(Uint32 color, int x, int y,
 						int height, unsigned char alpha)
 {
-	Video.LockScreen();
-	for (int i = 0; i < height; ++i) {
-		VideoDoDrawTransPixelClip(color, x, y + i, alpha);
-	}
-	Video.UnlockScreen();
+	int w = 1;
+	CLIP_RECTANGLE(x, y, w, height);
+	DrawTransVLine(color, x, y, height, alpha);
 }
 
 /**
@@ -250,9 +331,7 @@ void DrawTransVLineClip(Uint32 color, int x, int y,
 void DrawHLine(Uint32 color, int x, int y, int width)
 {
 	Video.LockScreen();
-	for (int i = 0; i < width; ++i) {
-		VideoDoDrawPixel(color, x + i, y);
-	}
+	VideoDoDrawHSpan(color, x, y, width);
 	Video.UnlockScreen();
 }
 
@@ -273,9 +352,7 @@ void DrawTransHLine(Uint32 color, int x, int y,
 					int width, unsigned char alpha)
 {
 	Video.LockScreen();
-	for (int i = 0; i < width; ++i) {
-		VideoDoDrawTransPixel(color, x + i, y, alpha);
-	}
+	VideoDoDrawTransHSpan(color, x, y, width, alpha);
 	Video.UnlockScreen();
 }
 
@@ -285,11 +362,9 @@ void DrawTransHLine(Uint32 color, int x, int y,
 void DrawTransHLineClip(Uint32 color, int x, int y,
 						int width, unsigned char alpha)
 {
-	Video.LockScreen();
-	for (int i = 0; i < width; ++i) {
-		VideoDoDrawTransPixelClip(color, x + i, y, alpha);
-	}
-	Video.UnlockScreen();
+	int h = 1;
+	CLIP_RECTANGLE(x, y, width, h);
+	DrawTransHLine(color, x, y, width, alpha);
 }
 
 /**
@@ -595,15 +670,11 @@ void FillRectangleClip(Uint32 color, int x, int y,
 void FillTransRectangle(Uint32 color, int x, int y,
 						int w, int h, unsigned char alpha)
 {
-	int ex = x + w;
-	int ey = y + h;
-	int sx = x;
+	const int ey = y + h;
 
 	Video.LockScreen();
 	for (; y < ey; ++y) {
-		for (x = sx; x < ex; ++x) {
-			VideoDoDrawTransPixel(color, x, y, alpha);
-		}
+		VideoDoDrawTransHSpan(color, x, y, w, alpha);
 	}
 	Video.UnlockScreen();
 }
@@ -889,12 +960,18 @@ void InitLineDraw()
 			VideoDoDrawPixel = VideoDoDrawPixel16;
 			VideoDrawTransPixel = VideoDrawTransPixel16;
 			VideoDoDrawTransPixel = VideoDoDrawTransPixel16;
+			VideoDoDrawHSpan = VideoFillHSpan<Uint16>;
+			VideoDoDrawVSpan = VideoFillVSpan<Uint16>;
+			VideoDoDrawTransHSpan = VideoDoDrawTransHSpan16;
 			break;
 		case 32:
 			VideoDrawPixel = VideoDrawPixel32;
 			VideoDoDrawPixel = VideoDoDrawPixel32;
 			VideoDrawTransPixel = VideoDrawTransPixel32;
 			VideoDoDrawTransPixel = VideoDoDrawTransPixel32;
+			VideoDoDrawHSpan = VideoFillHSpan<Uint32>;
+			VideoDoDrawVSpan = VideoFillVSpan<Uint32>;
+			VideoDoDrawTransHSpan = VideoDoDrawTransHSpan32;
 	}
 }
 
@@ -917,6 +994,7 @@ void DrawPixel(Uint32 color, int x, int y)
 	GLubyte r, g, b, a;
 
 	Video.GetRGBA(color, NULL, &r, &g, &b, &a);
+	FlushTextureBatch();
 	glDisable(GL_TEXTURE_2D);
 	glColor4ub(r, g, b, a);
 #ifdef USE_GLES
@@ -1001,6 +1079,7 @@ void DrawHLine(Uint32 color, int x, int y, int width)
 	GLubyte r, g, b, a;
 
 	Video.GetRGBA(color, NULL, &r, &g, &b, &a);
+	FlushTextureBatch();
 	glDisable(GL_TEXTURE_2D);
 	glColor4ub(r, g, b, a);
 #ifdef USE_GLES
@@ -1104,6 +1183,7 @@ void DrawVLine(Uint32 color, int x, int y, int height)
 	GLubyte r, g, b, a;
 
 	Video.GetRGBA(color, NULL, &r, &g, &b, &a);
+	FlushTextureBatch();
 	glDisable(GL_TEXTURE_2D);
 	glColor4ub(r, g, b, a);
 #ifdef USE_GLES
@@ -1224,6 +1304,7 @@ void DrawLine(Uint32 color, int x1, int y1, int x2, int y2)
 	}
 
 	Video.GetRGBA(color, NULL, &r, &g, &b, &a);
+	FlushTextureBatch();
 	glDisable(GL_TEXTURE_2D);
 	glColor4ub(r, g, b, a);
 #ifdef USE_GLES
@@ -1393,6 +1474,7 @@ void DrawRectangle(Uint32 color, int x, int y, int w, int h)
 	GLubyte r, g, b, a;
 
 	Video.GetRGBA(color, NULL, &r, &g, &b, &a);
+	FlushTextureBatch();
 	glDisable(GL_TEXTURE_2D);
 	glColor4ub(r, g, b, a);
 #ifdef USE_GLES
@@ -1569,6 +1651,7 @@ void FillRectangle(Uint32 color, int x, int y,
 	GLubyte r, g, b, a;
 
 	Video.GetRGBA(color, NULL, &r, &g, &b, &a);
+	FlushTextureBatch();
 	glDisable(GL_TEXTURE_2D);
 	glColor4ub(r, g, b, a);
 #ifdef USE_GLES
@@ -253,6 +253,8 @@ void Mng::Draw(int x, int y)
 
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
+		FlushTextureBatch();
+		glBindTexture(GL_TEXTURE_2D, texture_name);
 		GLint sx = x;
 		GLint ex = sx + surface->w;
 		GLint sy = y;
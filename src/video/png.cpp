@@ -41,10 +41,37 @@
 #include "iolib.h"
 #include "iocompat.h"
 
+#include <thread>
+
 /*----------------------------------------------------------------------------
 --  Variables
 ----------------------------------------------------------------------------*/
 
+/// State of a png file decoded ahead
+enum PNGPreloadState {
+	PNGPreloadQueued,    /// Waiting for a thread
+	PNGPreloadDecoding,  /// Being decoded by a thread
+	PNGPreloadDone,      /// Decoded, not yet used
+	PNGPreloadTaken      /// Used, or left to LoadGraphicPNG
+};
+
+/**
+**  A png file decoded ahead by the preload threads.
+*/
+struct PNGPreload {
+	std::string Name;          /// Resolved file name
+	SDL_Surface *Surface;      /// Decoded surface, NULL on error
+	PNGPreloadState State;     /// State of the decoding
+};
+
+static std::vector<PNGPreload> PNGPreloads;              /// Files decoded ahead
+static std::map<std::string, size_t> PNGPreloadIndex;    /// Index in PNGPreloads of a file
+static size_t PNGPreloadNext;                            /// Next file for the threads
+static bool PNGPreloadStop;                              /// Stop the threads
+static SDL_mutex *PNGPreloadLock;                        /// Protects the preload state
+static SDL_cond *PNGPreloadCond;                         /// Signaled when a file is decoded
+static std::vector<SDL_Thread *> PNGPreloadThreads;      /// The preload threads
+
 /*----------------------------------------------------------------------------
 --  Functions
 ----------------------------------------------------------------------------*/
@@ -78,34 +105,30 @@ private:
 };
 
 /**
-**  Load a png graphic file.
+**  Decode a png file into a new surface.
 **  Modified function from SDL_Image
 **
-**  @param g  graphic to load.
+**  Only touches its own objects, so it is called by the preload threads
+**  too.
 **
-**  @return   0 for success, -1 for error.
+**  @param name  file name, already resolved.
+**
+**  @return      the surface, NULL for error.
 */
-int LoadGraphicPNG(CGraphic *g)
+static SDL_Surface *DecodePNG(const std::string &name)
 {
-	if (g->File.empty()) {
-		return -1;
-	}
-	const std::string name = LibraryFileName(g->File.c_str());
-	if (name.empty()) {
-		return -1;
-	}
 	CFile fp;
 
 	if (fp.open(name.c_str(), CL_OPEN_READ) == -1) {
 		perror("Can't open file");
-		return -1;
+		return NULL;
 	}
 
 	// Create the PNG loading context structure
 	png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 	if (png_ptr == NULL) {
 		fprintf(stderr, "Couldn't allocate memory for PNG file");
-		return -1;
+		return NULL;
 	}
 	// Clean png_ptr on exit
 	AutoPng_read_structp pngRaii(png_ptr);
@@ -114,7 +137,7 @@ int LoadGraphicPNG(CGraphic *g)
 	png_infop info_ptr = png_create_info_struct(png_ptr);
 	if (info_ptr == NULL) {
 		fprintf(stderr, "Couldn't create image information for PNG file");
-		return -1;
+		return NULL;
 	}
 	pngRaii.setInfo(info_ptr);
 
@@ -124,7 +147,7 @@ int LoadGraphicPNG(CGraphic *g)
 	 */
 	if (setjmp(png_jmpbuf(png_ptr))) {
 		fprintf(stderr, "Error reading the PNG file.\n");
-		return -1;
+		return NULL;
 	}
 
 	/* Set up the input control */
@@ -225,7 +248,7 @@ int LoadGraphicPNG(CGraphic *g)
 						 bit_depth * png_get_channels(png_ptr, info_ptr), Rmask, Gmask, Bmask, Amask);
 	if (surface == NULL) {
 		fprintf(stderr, "Out of memory");
-		return -1;
+		return NULL;
 	}
 
 	if (ckey != -1) {
@@ -275,11 +298,169 @@ int LoadGraphicPNG(CGraphic *g)
 		}
 	}
 
+	fp.close();
+	return surface;
+}
+
+/**
+**  Decode the queued png files until there are none left.
+**
+**  @param data  unused.
+*/
+static int PNGPreloadThread(void *)
+{
+	SDL_LockMutex(PNGPreloadLock);
+	while (!PNGPreloadStop) {
+		while (PNGPreloadNext < PNGPreloads.size() && PNGPreloads[PNGPreloadNext].State != PNGPreloadQueued) {
+			++PNGPreloadNext;
+		}
+		if (PNGPreloadNext == PNGPreloads.size()) {
+			break;
+		}
+		PNGPreload &preload = PNGPreloads[PNGPreloadNext++];
+		preload.State = PNGPreloadDecoding;
+		SDL_UnlockMutex(PNGPreloadLock);
+
+		SDL_Surface *surface = DecodePNG(preload.Name);
+
+		SDL_LockMutex(PNGPreloadLock);
+		preload.Surface = surface;
+		preload.State = PNGPreloadDone;
+		SDL_CondBroadcast(PNGPreloadCond);
+	}
+	SDL_UnlockMutex(PNGPreloadLock);
+	return 0;
+}
+
+/**
+**  Take the surface of a png file decoded ahead.
+**
+**  If the file is queued but not started it is left to the caller, if
+**  it is being decoded this waits for it.
+**
+**  @param name     file name, already resolved.
+**  @param surface  set to the decoded surface, NULL for error.
+**
+**  @return         true if the file was decoded ahead.
+*/
+static bool TakePreloadedPNG(const std::string &name, SDL_Surface *&surface)
+{
+	if (!PNGPreloadLock) {
+		return false;
+	}
+	SDL_LockMutex(PNGPreloadLock);
+	std::map<std::string, size_t>::const_iterator it = PNGPreloadIndex.find(name);
+	if (it == PNGPreloadIndex.end()) {
+		SDL_UnlockMutex(PNGPreloadLock);
+		return false;
+	}
+	PNGPreload &preload = PNGPreloads[it->second];
+	while (preload.State == PNGPreloadDecoding) {
+		SDL_CondWait(PNGPreloadCond, PNGPreloadLock);
+	}
+	const bool done = preload.State == PNGPreloadDone;
+	surface = preload.Surface;
+	preload.Surface = NULL;
+	preload.State = PNGPreloadTaken;
+	SDL_UnlockMutex(PNGPreloadLock);
+	return done;
+}
+
+/**
+**  Start decoding png files ahead on threads.
+**
+**  LoadGraphicPNG takes the decoded surfaces, the conversion of the
+**  surfaces and the textures stay on the main thread.
+**
+**  @param files  file names, already resolved.
+*/
+void PreloadPNG(const std::vector<std::string> &files)
+{
+	if (PNGPreloadLock || files.empty()) {
+		return;
+	}
+	static const int MaxPreloadThreads = 8;
+	const int threads = std::max(1, std::min<int>(std::thread::hardware_concurrency(), MaxPreloadThreads));
+
+	for (size_t i = 0; i < files.size(); ++i) {
+		if (PNGPreloadIndex.insert(std::make_pair(files[i], PNGPreloads.size())).second) {
+			PNGPreload preload;
+			preload.Name = files[i];
+			preload.Surface = NULL;
+			preload.State = PNGPreloadQueued;
+			PNGPreloads.push_back(preload);
+		}
+	}
+	PNGPreloadNext = 0;
+	PNGPreloadStop = false;
+	PNGPreloadLock = SDL_CreateMutex();
+	PNGPreloadCond = SDL_CreateCond();
+	for (int i = 0; i < threads; ++i) {
+		SDL_Thread *thread = SDL_CreateThread(PNGPreloadThread, NULL);
+		if (thread) {
+			PNGPreloadThreads.push_back(thread);
+		}
+	}
+}
+
+/**
+**  Stop decoding png files ahead and free the surfaces not used.
+*/
+void FinishPreloadGraphics()
+{
+	if (!PNGPreloadLock) {
+		return;
+	}
+	SDL_LockMutex(PNGPreloadLock);
+	PNGPreloadStop = true;
+	SDL_UnlockMutex(PNGPreloadLock);
+	for (size_t i = 0; i < PNGPreloadThreads.size(); ++i) {
+		SDL_WaitThread(PNGPreloadThreads[i], NULL);
+	}
+	PNGPreloadThreads.clear();
+
+	for (size_t i = 0; i < PNGPreloads.size(); ++i) {
+		if (PNGPreloads[i].Surface) {
+			SDL_FreeSurface(PNGPreloads[i].Surface);
+		}
+	}
+	PNGPreloads.clear();
+	PNGPreloadIndex.clear();
+	SDL_DestroyCond(PNGPreloadCond);
+	PNGPreloadCond = NULL;
+	SDL_DestroyMutex(PNGPreloadLock);
+	PNGPreloadLock = NULL;
+}
+
+/**
+**  Load a png graphic file.
+**
+**  Uses the surface decoded ahead by PreloadPNG if there is one.
+**
+**  @param g  graphic to load.
+**
+**  @return   0 for success, -1 for error.
+*/
+int LoadGraphicPNG(CGraphic *g)
+{
+	if (g->File.empty()) {
+		return -1;
+	}
+	const std::string name = LibraryFileName(g->File.c_str());
+	if (name.empty()) {
+		return -1;
+	}
+	SDL_Surface *surface;
+
+	if (!TakePreloadedPNG(name, surface)) {
+		surface = DecodePNG(name);
+	}
+	if (surface == NULL) {
+		return -1;
+	}
 	g->Surface = surface;
 	g->GraphicWidth = surface->w;
 	g->GraphicHeight = surface->h;
-
-	fp.close();
 	return 0;
 }
 
@@ -341,6 +522,8 @@ void SaveScreenshotPNG(const char *name)
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
 		unsigned char* pixels = new unsigned char[Video.ViewportWidth * Video.ViewportHeight * 3];
+		// draw the batched sprites before switching the framebuffer
+		FlushTextureBatch();
 		if (GLShaderPipelineSupported) {
 			// switch to real display
 			glBindFramebuffer(GL_FRAMEBUFFER_EXT, 0);
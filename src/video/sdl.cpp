@@ -110,6 +110,37 @@ SDL_Surface *TheScreen; /// Internal screen
 static SDL_Rect Rects[100];
 static int NumRects;
 
+static const int DamageBlockWidth = 32;  /// Width of a damage tracking block
+static const int DamageBlockHeight = 32; /// Height of a damage tracking block
+static const int DamageMergeGap = 4;     /// Merge damaged blocks closer than this
+
+static std::vector<bool> DamagedBlocks; /// Blocks of the screen invalidated for this frame
+static int DamageColumns;               /// Number of damage blocks in a row
+static int DamageRows;                  /// Number of rows of damage blocks
+static bool DamageAll;                  /// The whole screen is invalidated for this frame
+
+/**
+**  Area where something was drawn in the last frame.
+**
+**  @see InvalidateDrawnArea
+*/
+struct DrawnArea {
+	uint64_t Key;        /// What was drawn
+	int X;               /// Screen X position
+	int Y;               /// Screen Y position
+	int W;               /// Width
+	int H;               /// Height
+	unsigned long Frame; /// DrawnAreaFrame when last drawn
+};
+
+/// Areas drawn in the last frame, by object and part of the object
+static std::map<std::pair<const void *, int>, DrawnArea> DrawnAreas;
+static unsigned long DrawnAreaFrame; /// Number of the frame being drawn
+
+#ifdef DEBUG
+static std::vector<Uint8> PresentedScreen; /// Copy of the screen as last presented
+#endif
+
 #if defined(USE_OPENGL) || defined(USE_GLES)
 GLint GLMaxTextureSize = 256;   /// Max texture size supported on the video card
 GLint GLMaxTextureSizeOverride;     /// User-specified limit for ::GLMaxTextureSize
@@ -765,9 +796,28 @@ int VideoValidResolution(int w, int h)
 	return SDL_VideoModeOK(w, h, TheScreen->format->BitsPerPixel, TheScreen->flags);
 }
 
+/**
+**  Resize the damage blocks to the screen size.
+*/
+static void PrepareDamageBlocks()
+{
+	const int columns = (Video.Width + DamageBlockWidth - 1) / DamageBlockWidth;
+	const int rows = (Video.Height + DamageBlockHeight - 1) / DamageBlockHeight;
+
+	if (columns != DamageColumns || rows != DamageRows) {
+		DamageColumns = columns;
+		DamageRows = rows;
+		DamagedBlocks.assign(columns * rows, false);
+		DamageAll = true;
+	}
+}
+
 /**
 **  Invalidate some area
 **
+**  The area is clipped to the screen. It is updated with the next
+**  RealizeVideoMemory, rounded to blocks of 32x32 pixels.
+**
 **  @param x  screen pixel X position.
 **  @param y  screen pixel Y position.
 **  @param w  width of rectangle in pixels.
@@ -779,13 +829,22 @@ void InvalidateArea(int x, int y, int w, int h)
 	if (!UseOpenGL)
 #endif
 	{
-		Assert(NumRects != sizeof(Rects) / sizeof(*Rects));
-		Assert(x >= 0 && y >= 0 && x + w <= Video.Width && y + h <= Video.Height);
-		Rects[NumRects].x = x;
-		Rects[NumRects].y = y;
-		Rects[NumRects].w = w;
-		Rects[NumRects].h = h;
-		++NumRects;
+		PrepareDamageBlocks();
+		if (DamageAll) {
+			return;
+		}
+		const int x0 = std::max(x, 0);
+		const int y0 = std::max(y, 0);
+		const int x1 = std::min(x + w, (int)Video.Width);
+		const int y1 = std::min(y + h, (int)Video.Height);
+		if (x0 >= x1 || y0 >= y1) {
+			return;
+		}
+		for (int row = y0 / DamageBlockHeight; row <= (y1 - 1) / DamageBlockHeight; ++row) {
+			for (int c = x0 / DamageBlockWidth; c <= (x1 - 1) / DamageBlockWidth; ++c) {
+				DamagedBlocks[row * DamageColumns + c] = true;
+			}
+		}
 	}
 }
 
@@ -798,12 +857,194 @@ void Invalidate()
 	if (!UseOpenGL)
 #endif
 	{
+		DamageAll = true;
+	}
+}
+
+/**
+**  Invalidate the area where something is drawn, if it changed since the
+**  last frame.
+**
+**  Called each frame for each thing drawn. Invalidates the old and the new
+**  area when the key or the area changed. Things which are no longer drawn
+**  have their old area invalidated by RealizeVideoMemory.
+**
+**  @param object  Object drawn, only used to identify the area.
+**  @param part    Part of the object (viewport of a unit, line of a panel...).
+**  @param key     Hash of all that changes what is drawn, see DrawnAreaKey.
+**  @param x       Screen pixel X position.
+**  @param y       Screen pixel Y position.
+**  @param w       Width of the area in pixels.
+**  @param h       Height of the area in pixels.
+*/
+void InvalidateDrawnArea(const void *object, int part, uint64_t key, int x, int y, int w, int h)
+{
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (UseOpenGL) {
+		return;
+	}
+#endif
+	const DrawnArea drawn = {key, x, y, w, h, DrawnAreaFrame};
+	std::pair<std::map<std::pair<const void *, int>, DrawnArea>::iterator, bool> res =
+		DrawnAreas.insert(std::make_pair(std::make_pair(object, part), drawn));
+	DrawnArea &area = res.first->second;
+
+	if (!res.second) {
+		if (area.Key == key && area.X == x && area.Y == y && area.W == w && area.H == h) {
+			area.Frame = DrawnAreaFrame;
+			return;
+		}
+		InvalidateArea(area.X, area.Y, area.W, area.H);
+		area = drawn;
+	}
+	InvalidateArea(x, y, w, h);
+}
+
+/**
+**  Mix a text into the key of an area given to InvalidateDrawnArea.
+*/
+uint64_t DrawnAreaKey(uint64_t key, const std::string &text)
+{
+	for (size_t i = 0; i != text.size(); ++i) {
+		key = DrawnAreaKey(key, uint64_t((unsigned char)text[i]));
+	}
+	return DrawnAreaKey(key, uint64_t(text.size()));
+}
+
+/**
+**  Invalidate the areas which were drawn in the last frame but not in this
+**  one, and start a new frame.
+*/
+static void InvalidateUndrawnAreas()
+{
+	std::map<std::pair<const void *, int>, DrawnArea>::iterator it = DrawnAreas.begin();
+	while (it != DrawnAreas.end()) {
+		const DrawnArea &area = it->second;
+		if (area.Frame != DrawnAreaFrame) {
+			InvalidateArea(area.X, area.Y, area.W, area.H);
+			DrawnAreas.erase(it++);
+		} else {
+			++it;
+		}
+	}
+	++DrawnAreaFrame;
+}
+
+#ifdef DEBUG
+/**
+**  Check that the screen didn't change outside the invalidated blocks.
+**
+**  Compares the screen with a copy of the last presented frame. A block
+**  which changed without being invalidated is a bug of the damage tracking,
+**  it is reported and invalidated.
+*/
+static void CheckUndamagedBlocks()
+{
+	const int bpp = TheScreen->format->BytesPerPixel;
+	const size_t size = TheScreen->pitch * Video.Height;
+
+	Video.LockScreen();
+	const Uint8 *screen = static_cast<const Uint8 *>(TheScreen->pixels);
+	if (!DamageAll && PresentedScreen.size() == size) {
+		for (int row = 0; row < DamageRows; ++row) {
+			const int y = row * DamageBlockHeight;
+			const int h = std::min(DamageBlockHeight, Video.Height - y);
+			for (int c = 0; c < DamageColumns; ++c) {
+				if (DamagedBlocks[row * DamageColumns + c]) {
+					continue;
+				}
+				const int x = c * DamageBlockWidth;
+				const int w = std::min(DamageBlockWidth, Video.Width - x);
+				for (int line = y; line < y + h; ++line) {
+					const size_t offset = line * TheScreen->pitch + x * bpp;
+					if (memcmp(screen + offset, &PresentedScreen[offset], w * bpp)) {
+						DebugPrint("Screen block %d,%d changed but was not invalidated\n" _C_ x _C_ y);
+						DamagedBlocks[row * DamageColumns + c] = true;
+						break;
+					}
+				}
+			}
+		}
+	}
+	PresentedScreen.assign(screen, screen + size);
+	Video.UnlockScreen();
+}
+#endif
+
+/**
+**  Add a damaged span of a block row to the rectangles to update.
+**
+**  Joins the span with a rectangle of the previous block row if both
+**  have the same horizontal extent.
+**
+**  @return false if there is no room left for a new rectangle.
+*/
+static bool AddDamageRect(int x, int y, int w, int h)
+{
+	for (int i = 0; i < NumRects; ++i) {
+		if (Rects[i].x == x && Rects[i].w == w && Rects[i].y + Rects[i].h == y) {
+			Rects[i].h += h;
+			return true;
+		}
+	}
+	if (NumRects == sizeof(Rects) / sizeof(*Rects)) {
+		return false;
+	}
+	Rects[NumRects].x = x;
+	Rects[NumRects].y = y;
+	Rects[NumRects].w = w;
+	Rects[NumRects].h = h;
+	++NumRects;
+	return true;
+}
+
+/**
+**  Turn the damaged blocks into the rectangles to update.
+**
+**  Damaged blocks of a row are merged into spans, with gaps of less than
+**  DamageMergeGap blocks. Falls back to the whole screen when there are
+**  too many rectangles.
+*/
+static void CollectDamageRects()
+{
+	NumRects = 0;
+	for (int row = 0; row < DamageRows && !DamageAll; ++row) {
+		const int y = row * DamageBlockHeight;
+		const int h = std::min(DamageBlockHeight, Video.Height - y);
+		int runStart = -1;
+		int runEnd = -1;
+
+		for (int c = 0; c <= DamageColumns; ++c) {
+			if (c < DamageColumns) {
+				if (!DamagedBlocks[row * DamageColumns + c]) {
+					continue;
+				}
+				if (runStart != -1 && c - runEnd < DamageMergeGap) {
+					runEnd = c + 1;
+					continue;
+				}
+			}
+			if (runStart != -1) {
+				const int x = runStart * DamageBlockWidth;
+				const int w = std::min(runEnd * DamageBlockWidth, (int)Video.Width) - x;
+				if (!AddDamageRect(x, y, w, h)) {
+					DamageAll = true;
+					break;
+				}
+			}
+			runStart = c;
+			runEnd = c + 1;
+		}
+	}
+	if (DamageAll) {
 		Rects[0].x = 0;
 		Rects[0].y = 0;
 		Rects[0].w = Video.Width;
 		Rects[0].h = Video.Height;
 		NumRects = 1;
 	}
+	DamagedBlocks.assign(DamagedBlocks.size(), false);
+	DamageAll = false;
 }
 
 // Switch to the shader currently stored in Video.ShaderIndex without changing it
@@ -966,7 +1207,12 @@ void WaitEventsOneFrame()
 		// Time of frame over? This makes the CPU happy. :(
 		ticks = SDL_GetTicks();
 		if (!interrupts && ticks < NextFrameTicks) {
-			SDL_Delay(NextFrameTicks - ticks);
+			if (IsNetworkGame()) {
+				// Wake up as soon as a packet arrives.
+				NetworkWaitData(NextFrameTicks - ticks);
+			} else {
+				SDL_Delay(NextFrameTicks - ticks);
+			}
 			ticks = SDL_GetTicks();
 		}
 		while (ticks >= (unsigned long)(NextFrameTicks)) {
@@ -983,7 +1229,7 @@ void WaitEventsOneFrame()
 		// Network
 		int s = 0;
 		if (IsNetworkGame()) {
-			s = NetworkFildes.HasDataToRead(0);
+			s = NetworkHasDataToRead();
 			if (s > 0) {
 				GetCallbacks()->NetworkEvent();
 			}
@@ -1007,6 +1253,7 @@ void RealizeVideoMemory()
 {
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
+		FlushTextureBatch();
 #ifdef USE_GLES_EGL
 		eglSwapBuffers(eglDisplay, eglSurface);
 #endif
@@ -1021,9 +1268,14 @@ void RealizeVideoMemory()
 	} else
 #endif
 	{
+		InvalidateUndrawnAreas();
+		PrepareDamageBlocks();
+#ifdef DEBUG
+		CheckUndamagedBlocks();
+#endif
+		CollectDamageRects();
 		if (NumRects) {
 			SDL_UpdateRects(TheScreen, NumRects, Rects);
-			NumRects = 0;
 		}
 	}
 	HideCursor();
@@ -39,10 +39,94 @@
 #include "stratagus.h"
 #include "video.h"
 
+#include <vector>
+
+/*----------------------------------------------------------------------------
+--  Variables
+----------------------------------------------------------------------------*/
+
+/**
+**  Vertex of a textured quad waiting to be drawn.
+*/
+struct TextureBatchVertex {
+	GLfloat X, Y;      /// Screen position
+	GLfloat TX, TY;    /// Texture coordinate
+	GLubyte Color[4];  /// Color modulating the texture
+};
+
+static std::vector<TextureBatchVertex> TextureBatch; /// Quads waiting to be drawn
+static GLuint TextureBatchTexture;                   /// Texture of the waiting quads
+
+GLubyte TextureBatchAlpha = 0xff; /// Alpha of the textures drawn by DrawTexture
+
 /*----------------------------------------------------------------------------
 --  Functions
 ----------------------------------------------------------------------------*/
 
+/**
+**  Draw the textured quads collected by DrawTexture.
+**
+**  All quads share one texture, they are submitted with a single
+**  vertex array draw call. Must be called before anything else is drawn
+**  with OpenGL and before the frame is shown.
+*/
+void FlushTextureBatch()
+{
+	if (TextureBatch.empty()) {
+		return;
+	}
+	const TextureBatchVertex *v = &TextureBatch[0];
+
+	glBindTexture(GL_TEXTURE_2D, TextureBatchTexture);
+	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+
+	glVertexPointer(2, GL_FLOAT, sizeof(*v), &v->X);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(*v), &v->TX);
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(*v), v->Color);
+	glDrawArrays(GL_TRIANGLES, 0, TextureBatch.size());
+
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	glColor4ub(255, 255, 255, 255);
+
+	TextureBatch.clear();
+}
+
+/**
+**  Queue a textured quad, flushing the batch if the texture changes.
+*/
+static void AddTextureQuad(GLuint texture, GLfloat sx_beg, GLfloat sy_beg, GLfloat sx_end, GLfloat sy_end,
+						   GLfloat tx_beg, GLfloat ty_beg, GLfloat tx_end, GLfloat ty_end)
+{
+	if (texture != TextureBatchTexture) {
+		FlushTextureBatch();
+		TextureBatchTexture = texture;
+	}
+#ifdef USE_GLES
+	sx_beg = 2.0f / (GLfloat)Video.Width * sx_beg - 1.0f;
+	sx_end = 2.0f / (GLfloat)Video.Width * sx_end - 1.0f;
+	sy_beg = -2.0f / (GLfloat)Video.Height * sy_beg + 1.0f;
+	sy_end = -2.0f / (GLfloat)Video.Height * sy_end + 1.0f;
+#endif
+	const TextureBatchVertex corners[4] = {
+		{sx_beg, sy_beg, tx_beg, ty_beg, {255, 255, 255, TextureBatchAlpha}},
+		{sx_end, sy_beg, tx_end, ty_beg, {255, 255, 255, TextureBatchAlpha}},
+		{sx_beg, sy_end, tx_beg, ty_end, {255, 255, 255, TextureBatchAlpha}},
+		{sx_end, sy_end, tx_end, ty_end, {255, 255, 255, TextureBatchAlpha}}
+	};
+	TextureBatch.push_back(corners[0]);
+	TextureBatch.push_back(corners[1]);
+	TextureBatch.push_back(corners[2]);
+	TextureBatch.push_back(corners[1]);
+	TextureBatch.push_back(corners[3]);
+	TextureBatch.push_back(corners[2]);
+}
+
 /** Draw a rectangular part of a CGraphic to the screen.
 **
 **  This function does not attempt to clip the CGraphic based on the
@@ -95,6 +179,18 @@ void DrawTexture(const CGraphic *g, GLuint *textures,
 	Assert(gx_end <= g->GraphicWidth);
 	Assert(gy_end <= g->GraphicHeight);
 
+	if (g->TextureAtlased) {
+		// textures holds the atlas page and the position in it
+		const GLfloat scale = 1.0f / TextureAtlasSize;
+		const int sx_end = sx_beg + gx_end - gx_beg;
+		const int sy_end = sy_beg + gy_end - gy_beg;
+
+		AddTextureQuad(textures[0], flip ? sx_end : sx_beg, sy_beg, flip ? sx_beg : sx_end, sy_end,
+					   (textures[1] + gx_beg) * scale, (textures[2] + gy_beg) * scale,
+					   (textures[1] + gx_end) * scale, (textures[2] + gy_end) * scale);
+		return;
+	}
+
 	for (int tex_gy_beg = gy_beg / GLMaxTextureSize * GLMaxTextureSize;;
 		 tex_gy_beg += GLMaxTextureSize) {
 		int tex_gy_end = tex_gy_beg + GLMaxTextureSize;
@@ -179,47 +275,8 @@ void DrawTexture(const CGraphic *g, GLuint *textures,
 						  + tex_gx_beg / GLMaxTextureSize;
 			Assert(texture >= 0 && texture < g->NumTextures);
 
-			glBindTexture(GL_TEXTURE_2D, textures[texture]);
-
-#ifdef USE_GLES
-			float texCoord[] = {
-				clip_tx_beg, clip_ty_beg,
-				clip_tx_end, clip_ty_beg,
-				clip_tx_beg, clip_ty_end,
-				clip_tx_end, clip_ty_end
-			};
-
-			float vertex[] = {
-				2.0f / (GLfloat)Video.Width *clip_sx_beg - 1.0f, -2.0f / (GLfloat)Video.Height *clip_sy_beg + 1.0f,
-				2.0f / (GLfloat)Video.Width *clip_sx_end - 1.0f, -2.0f / (GLfloat)Video.Height *clip_sy_beg + 1.0f,
-				2.0f / (GLfloat)Video.Width *clip_sx_beg - 1.0f, -2.0f / (GLfloat)Video.Height *clip_sy_end + 1.0f,
-				2.0f / (GLfloat)Video.Width *clip_sx_end - 1.0f, -2.0f / (GLfloat)Video.Height *clip_sy_end + 1.0f
-			};
-
-			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-			glEnableClientState(GL_VERTEX_ARRAY);
-
-			glTexCoordPointer(2, GL_FLOAT, 0, texCoord);
-			glVertexPointer(2, GL_FLOAT, 0, vertex);
-			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-			glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-			glDisableClientState(GL_VERTEX_ARRAY);
-#endif
-
-#ifdef USE_OPENGL
-			glBegin(GL_QUADS);
-			glTexCoord2f(clip_tx_beg, clip_ty_beg);
-			glVertex2i(clip_sx_beg, clip_sy_beg);
-			glTexCoord2f(clip_tx_beg, clip_ty_end);
-			glVertex2i(clip_sx_beg, clip_sy_end);
-			glTexCoord2f(clip_tx_end, clip_ty_end);
-			glVertex2i(clip_sx_end, clip_sy_end);
-			glTexCoord2f(clip_tx_end, clip_ty_beg);
-			glVertex2i(clip_sx_end, clip_sy_beg);
-			glEnd();
-#endif
-
+			AddTextureQuad(textures[texture], clip_sx_beg, clip_sy_beg, clip_sx_end, clip_sy_end,
+						   clip_tx_beg, clip_ty_beg, clip_tx_end, clip_ty_end);
 		}
 	}
 }
@@ -300,6 +300,7 @@ bool CVideo::ResizeScreen(int w, int h)
 		Height = h;
 		SetClipping(0, 0, Video.Width - 1, Video.Height - 1);
 #endif
+		InvalidateMapBackgrounds();
 		return true;
 	}
 	return false;
@@ -454,12 +455,18 @@ void ColorCycle()
 		return;
 	}
 	CColorCycling &colorCycling = CColorCycling::GetInstance();
+	if (colorCycling.ColorIndexRanges.empty()) {
+		return;
+	}
 	if (colorCycling.ColorCycleAll) {
 		++colorCycling.cycleCount;
 		for (std::vector<SDL_Surface *>::iterator it = colorCycling.PaletteList.begin(); it != colorCycling.PaletteList.end(); ++it) {
 			SDL_Surface *surface = (*it);
 			ColorCycleSurface(*surface);
 		}
+		// Any graphic on the screen may have changed.
+		InvalidateMapBackgrounds();
+		Invalidate();
 	} else if (Map.TileGraphic->Surface->format->BytesPerPixel == 1) {
 		++colorCycling.cycleCount;
 #if defined(USE_OPENGL) || defined(USE_GLES)
@@ -470,6 +477,7 @@ void ColorCycle()
 #endif
 		{
 			ColorCycleSurface(*Map.TileGraphic->Surface);
+			InvalidateMapBackgrounds();
 		}
 	}
 }
@@ -0,0 +1,162 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name test_ai_threat.cpp - The test file for ai_threat.cpp. */
+//
+//      (c) Copyright 2026 by the Stratagus Team
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+
+#include <UnitTest++.h>
+
+#include "stratagus.h"
+
+#include "../../src/ai/ai_local.h"
+
+#include "map.h"
+#include "unittype.h"
+
+/// An enemy added to the threat map
+struct ThreatEnemy {
+	Vec2i Pos;
+	int Width;
+	int Height;
+	int CanTarget;
+};
+
+/// Threat map of enemies at pseudo random places on a small map
+class AutoThreatMap
+{
+public:
+	AutoThreatMap() : savedWidth(Map.Info.MapWidth), savedHeight(Map.Info.MapHeight), seed(42)
+	{
+		Map.Info.MapWidth = 24;
+		Map.Info.MapHeight = 16;
+		threat.Clear(Map.Info.MapWidth, Map.Info.MapHeight);
+		for (int i = 0; i != 20; ++i) {
+			ThreatEnemy enemy;
+			enemy.Width = 1 + Random(3);
+			enemy.Height = 1 + Random(3);
+			// enemies may be cut by the bottom right borders
+			enemy.Pos.x = Random(Map.Info.MapWidth);
+			enemy.Pos.y = Random(Map.Info.MapHeight);
+			enemy.CanTarget = Random(8);
+			threat.Add(enemy.Pos, enemy.Width, enemy.Height, enemy.CanTarget);
+			enemies.push_back(enemy);
+		}
+		threat.Sum();
+	}
+	~AutoThreatMap()
+	{
+		Map.Info.MapWidth = savedWidth;
+		Map.Info.MapHeight = savedHeight;
+	}
+
+	int Random(int n)
+	{
+		seed = seed * 1103515245 + 12345;
+		return (seed >> 16) % n;
+	}
+
+	/**
+	**  Count the enemies in a rectangle like Select: the tiles they
+	**  cover and the enemies found.
+	*/
+	int Select(Vec2i pos0, Vec2i pos1, int canTarget, int *found) const
+	{
+		Map.FixSelectionArea(pos0, pos1);
+		int tiles = 0;
+		*found = 0;
+		for (size_t i = 0; i != enemies.size(); ++i) {
+			const ThreatEnemy &enemy = enemies[i];
+			if (canTarget && !(enemy.CanTarget & canTarget)) {
+				continue;
+			}
+			const int x0 = std::max<int>(pos0.x, enemy.Pos.x);
+			const int y0 = std::max<int>(pos0.y, enemy.Pos.y);
+			const int x1 = std::min<int>(pos1.x, std::min<int>(enemy.Pos.x + enemy.Width, Map.Info.MapWidth) - 1);
+			const int y1 = std::min<int>(pos1.y, std::min<int>(enemy.Pos.y + enemy.Height, Map.Info.MapHeight) - 1);
+			if (x0 <= x1 && y0 <= y1) {
+				tiles += (x1 - x0 + 1) * (y1 - y0 + 1);
+				++*found;
+			}
+		}
+		return tiles;
+	}
+
+	/// Check the threat map against Select for pseudo random rectangles
+	void CheckRectangles(const CUnitType *type, int canTarget)
+	{
+		for (int i = 0; i != 200; ++i) {
+			// rectangles may go out of the map, as in AiEnemyUnitsInDistance
+			const Vec2i pos0(Random(Map.Info.MapWidth + 8) - 4, Random(Map.Info.MapHeight + 8) - 4);
+			const Vec2i pos1(pos0.x + Random(10), pos0.y + Random(10));
+			int found;
+			const int tiles = Select(pos0, pos1, canTarget, &found);
+			const int count = threat.Count(pos0, pos1, type);
+
+			CHECK_EQUAL(tiles, count);
+			CHECK_EQUAL(found != 0, count != 0);
+		}
+	}
+
+public:
+	const int savedWidth;
+	const int savedHeight;
+	unsigned seed;
+	std::vector<ThreatEnemy> enemies;
+	AiThreatMap threat;
+};
+
+TEST_FIXTURE(AutoThreatMap, AiThreatMap_All)
+{
+	CHECK(threat.IsValid(NULL));
+	CheckRectangles(NULL, 0);
+}
+
+TEST_FIXTURE(AutoThreatMap, AiThreatMap_Air)
+{
+	CUnitType type;
+	type.UnitType = UnitTypeFly;
+
+	CHECK(threat.IsValid(&type));
+	CheckRectangles(&type, CanTargetAir);
+}
+
+TEST_FIXTURE(AutoThreatMap, AiThreatMap_Sea)
+{
+	CUnitType type;
+	type.UnitType = UnitTypeNaval;
+
+	CHECK(threat.IsValid(&type));
+	CheckRectangles(&type, CanTargetSea);
+}
+
+TEST_FIXTURE(AutoThreatMap, AiThreatMap_Clear)
+{
+	threat.Clear(Map.Info.MapWidth, Map.Info.MapHeight);
+	CHECK(!threat.IsValid(NULL));
+	threat.Sum();
+	CHECK_EQUAL(0, threat.Count(Vec2i(0, 0), Vec2i(Map.Info.MapWidth - 1, Map.Info.MapHeight - 1), NULL));
+}
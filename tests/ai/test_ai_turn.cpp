@@ -0,0 +1,175 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name test_ai_turn.cpp - The test file for the turn of ai.cpp. */
+//
+//      (c) Copyright 2026 by the Stratagus Team
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+
+#include <UnitTest++.h>
+
+#include "stratagus.h"
+
+#include "../../src/ai/ai_local.h"
+
+#include <string.h>
+
+/// Units of the tasks of the fake turn, the tasks with 0 units run whole
+static const int TaskUnits[AiTaskDone] = { 0, 0, 150, 40, 90, 70, 0 };
+/// Units each task of the fake turn looks at when run whole
+static const int WholeTaskUnits = 20;
+
+/**
+**  A turn of tasks which count the units they look at, like the tasks
+**  of AiRunTask. The resumable tasks look at a unit for each unit of
+**  the budget, from the cursor.
+*/
+class AutoTurn
+{
+public:
+	AutoTurn() : Task(AiTaskScript), TaskCursor(0), Cycle(0)
+	{
+		memset(Looked, 0, sizeof(Looked));
+		memset(Runs, 0, sizeof(Runs));
+	}
+
+	/// Continue the turn like AiEachCycle, return the units looked at
+	int EachCycle()
+	{
+		Cycle = 0;
+		Current = this;
+		AiRunTasks(&Task, &TaskCursor, AiUnitsPerCycle, RunTask);
+		return Cycle;
+	}
+
+	/// Run EachCycle until the turn is finished, return the cycles
+	int Finish()
+	{
+		int cycles = 0;
+		while (Task < AiTaskDone) {
+			const int units = EachCycle();
+			CHECK(units <= AiUnitsPerCycle + WholeTaskUnits);
+			++cycles;
+		}
+		return cycles;
+	}
+
+	/// Check that each task ran once and looked once at each unit
+	void CheckDone() const
+	{
+		CHECK_EQUAL((int)AiTaskDone, Task);
+		for (int task = 0; task != AiTaskDone; ++task) {
+			if (TaskUnits[task] == 0) {
+				CHECK_EQUAL(1, Runs[task]);
+			}
+			for (int i = 0; i != TaskUnits[task]; ++i) {
+				CHECK_EQUAL(1, Looked[task][i]);
+			}
+		}
+	}
+
+	static bool RunTask(int task, int *cursor, int *budget)
+	{
+		AutoTurn &turn = *Current;
+
+		if (TaskUnits[task] == 0) {
+			turn.Runs[task]++;
+			*budget -= WholeTaskUnits;
+			turn.Cycle += WholeTaskUnits;
+			return true;
+		}
+		for (; *cursor < TaskUnits[task]; ++*cursor) {
+			if (*budget <= 0) {
+				return false;
+			}
+			--*budget;
+			turn.Looked[task][*cursor]++;
+			turn.Cycle++;
+		}
+		return true;
+	}
+
+public:
+	int Task;
+	int TaskCursor;
+	int Looked[AiTaskDone][150];
+	int Runs[AiTaskDone];
+	int Cycle;
+	static AutoTurn *Current;
+};
+
+AutoTurn *AutoTurn::Current = NULL;
+
+TEST_FIXTURE(AutoTurn, AiTurn_SeveralCycles)
+{
+	const int cycles = Finish();
+
+	CHECK(cycles > 1);
+	CheckDone();
+	// Nothing more to do
+	CHECK_EQUAL(0, EachCycle());
+}
+
+TEST_FIXTURE(AutoTurn, AiTurn_SaveLoad)
+{
+	const int cycles = AutoTurn().Finish();
+
+	for (int saved = 1; saved < cycles; ++saved) {
+		AutoTurn before;
+		for (int i = 0; i != saved; ++i) {
+			before.EachCycle();
+		}
+		CHECK(before.Task < AiTaskDone);
+
+		// Only "task" and "task-cursor" are saved with the AI player
+		AutoTurn after;
+		after.Task = before.Task;
+		after.TaskCursor = before.TaskCursor;
+		CHECK_EQUAL(cycles - saved, after.Finish());
+
+		for (int task = 0; task != AiTaskDone; ++task) {
+			after.Runs[task] += before.Runs[task];
+			for (int i = 0; i != TaskUnits[task]; ++i) {
+				after.Looked[task][i] += before.Looked[task][i];
+			}
+		}
+		after.CheckDone();
+	}
+}
+
+TEST_FIXTURE(AutoTurn, AiTurn_Late)
+{
+	Current = this;
+	// The late turn goes on, the new one waits
+	CHECK(!AiStartTurn(&Task, &TaskCursor, RunTask));
+	CHECK(Task != AiTaskScript || TaskCursor != 0);
+	Finish();
+	CheckDone();
+
+	// The finished turn is replaced by a new one
+	CHECK(AiStartTurn(&Task, &TaskCursor, RunTask));
+	CHECK(Task < AiTaskDone);
+	CHECK_EQUAL(2, Runs[AiTaskScript]);
+}
@@ -0,0 +1,124 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name test_netreceiver.cpp - The test file for netreceiver.cpp. */
+//
+//      (c) Copyright 2026 by the Stratagus Team
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+#include <UnitTest++.h>
+
+#include "stratagus.h"
+
+#include "network/netreceiver.h"
+
+#include "net_lowlevel.h"
+
+class AutoReceiver
+{
+public:
+	AutoReceiver() :
+		senderHost("127.0.0.1", 6511), receiverHost("127.0.0.1", 6512)
+	{
+		NetInit();
+		sender.Open(senderHost);
+		socket.Open(receiverHost);
+	}
+	~AutoReceiver()
+	{
+		receiver.Stop();
+		socket.Close();
+		sender.Close();
+		NetExit();
+	}
+
+	/// Wait until count packets are queued, at most 1 second
+	bool WaitPackets(int count)
+	{
+		unsigned char buf[4];
+		int len;
+		CHost from;
+
+		for (int i = 0; i != 100 && (int)popped.size() < count; ++i) {
+			receiver.Wait(10);
+			while (receiver.Pop(buf, sizeof(buf), &len, &from)) {
+				popped.push_back(len == 1 ? buf[0] : -1);
+				CHECK(from == senderHost);
+			}
+		}
+		return (int)popped.size() == count;
+	}
+
+public:
+	const CHost senderHost;
+	const CHost receiverHost;
+	CUDPSocket sender;
+	CUDPSocket socket;
+	CNetworkReceiver receiver;
+	std::vector<int> popped;
+};
+
+TEST_FIXTURE(AutoReceiver, CNetworkReceiver_Order)
+{
+	CHECK(receiver.Start(socket, 4));
+	for (unsigned char i = 0; i != 10; ++i) {
+		sender.Send(receiverHost, &i, 1);
+	}
+	CHECK(WaitPackets(10));
+	for (int i = 0; i != (int)popped.size(); ++i) {
+		CHECK_EQUAL(i, popped[i]);
+	}
+	CHECK(!receiver.HasPacket());
+}
+
+TEST_FIXTURE(AutoReceiver, CNetworkReceiver_WaitAfterPop)
+{
+	CHECK(receiver.Start(socket, 4));
+	for (unsigned char i = 0; i != 3; ++i) {
+		sender.Send(receiverHost, &i, 1);
+	}
+	CHECK(WaitPackets(3));
+
+	// The queue is empty: Wait must not return early for the packets
+	// already popped.
+	const Uint32 start = SDL_GetTicks();
+	receiver.Wait(200);
+	CHECK(SDL_GetTicks() - start >= 150);
+}
+
+TEST_FIXTURE(AutoReceiver, CNetworkReceiver_WaitWakesUp)
+{
+	CHECK(receiver.Start(socket, 4));
+	const unsigned char data = 42;
+	sender.Send(receiverHost, &data, 1);
+
+	const Uint32 start = SDL_GetTicks();
+	while (!receiver.HasPacket() && SDL_GetTicks() - start < 1000) {
+		receiver.Wait(1000);
+	}
+	CHECK(receiver.HasPacket());
+	CHECK(SDL_GetTicks() - start < 1000);
+	CHECK(WaitPackets(1));
+	CHECK_EQUAL(42, popped[0]);
+}
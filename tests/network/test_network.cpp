@@ -50,6 +50,17 @@ void FillCustomValue(CNetworkExtendedCommand *obj)
 	obj->Arg4 = 0x9ABC;
 }
 
+void FillCustomValue(CNetworkGroupCommand *obj)
+{
+	obj->Type = 0x8C;
+	obj->X = 0x1234;
+	obj->Y = 0x0012;
+	obj->Dest = 0xFFFF;
+	for (int i = 0; i != 10; ++i) {
+		obj->Units.push_back(0x0123 + (i % 3) * 0x1000 - i);
+	}
+}
+
 void FillCustomValue(CNetworkChat *obj)
 {
 	obj->Text = "abcdefghijklmnopqrstuvwxyz";
@@ -58,6 +69,20 @@ void FillCustomValue(CNetworkCommandSync *obj)
 {
 	obj->syncSeed = 0x01234567;
 	obj->syncHash = 0x89ABCDEF;
+	obj->pingTime = 0x0123;
+	obj->pongTime = 0x4567;
+	obj->pongPlayer = 0x08;
+}
+void FillCustomValue(CNetworkCommandLag *obj)
+{
+	obj->networkLag = 0x0123;
+}
+void FillCustomValue(CNetworkCommandSyncHashes *obj)
+{
+	obj->player = 0x03;
+	for (int i = 0; i != SyncHashTypeCount; ++i) {
+		obj->hashes.Hash[i] = 0x01234567 * (i + 1);
+	}
 }
 void FillCustomValue(CNetworkCommandQuit *obj)
 {
@@ -84,6 +109,24 @@ bool Comp(const T &lhs, const T &rhs)
 	return memcmp(&lhs, &rhs, sizeof(T)) == 0;
 }
 
+bool Comp(const CNetworkGroupCommand &lhs, const CNetworkGroupCommand &rhs)
+{
+	return lhs.Type == rhs.Type && lhs.X == rhs.X && lhs.Y == rhs.Y
+		   && lhs.Dest == rhs.Dest && lhs.Units == rhs.Units;
+}
+
+bool Comp(const CNetworkCommandSync &lhs, const CNetworkCommandSync &rhs)
+{
+	return lhs.syncSeed == rhs.syncSeed && lhs.syncHash == rhs.syncHash
+		   && lhs.pingTime == rhs.pingTime && lhs.pongTime == rhs.pongTime
+		   && lhs.pongPlayer == rhs.pongPlayer;
+}
+
+bool Comp(const CNetworkCommandSyncHashes &lhs, const CNetworkCommandSyncHashes &rhs)
+{
+	return lhs.player == rhs.player && lhs.hashes == rhs.hashes;
+}
+
 bool Comp(const CNetworkChat &lhs, const CNetworkChat &rhs)
 {
 	return lhs.Text == rhs.Text;
@@ -111,6 +154,22 @@ bool CheckSerialization()
 	return res;
 }
 
+template <>
+bool CheckSerialization<CNetworkGroupCommand>()
+{
+	CNetworkGroupCommand obj1;
+
+	FillCustomValue(&obj1);
+	const size_t size = obj1.Size();
+	unsigned char *buffer = new unsigned char [size];
+	obj1.Serialize(buffer);
+
+	CNetworkGroupCommand obj2;
+	bool res = obj2.Deserialize(buffer, size) == size && Comp(obj1, obj2);
+	delete [] buffer;
+	return res;
+}
+
 TEST(CNetworkCommand)
 {
 	CHECK(CheckSerialization<CNetworkCommand>());
@@ -119,6 +178,60 @@ TEST(CNetworkExtendedCommand)
 {
 	CHECK(CheckSerialization<CNetworkExtendedCommand>());
 }
+TEST(CNetworkGroupCommand)
+{
+	CHECK(CheckSerialization<CNetworkGroupCommand>());
+}
+TEST(CNetworkGroupCommand_Bounds)
+{
+	CNetworkGroupCommand ngc;
+	FillCustomValue(&ngc);
+	std::vector<unsigned char> buffer(ngc.Size());
+	ngc.Serialize(&buffer[0]);
+
+	// Every truncation is rejected.
+	for (size_t len = 0; len != buffer.size(); ++len) {
+		CNetworkGroupCommand obj;
+		CHECK_EQUAL(0u, obj.Deserialize(&buffer[0], len));
+	}
+}
+TEST(CNetworkGroupCommand_LongVarint)
+{
+	// A varint whose fifth byte keeps the continuation bit.
+	const unsigned char buffer[] = {0x01, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00};
+	CNetworkGroupCommand obj;
+	CHECK_EQUAL(0u, obj.Deserialize(buffer, sizeof(buffer)));
+}
+TEST(CNetworkGroupCommand_UnitCount)
+{
+	// 3 units announced, only 2 bytes left.
+	const unsigned char tooMany[] = {0x01, 0x00, 0x00, 0x00, 0x03, 0x02, 0x02};
+	CNetworkGroupCommand obj;
+	CHECK_EQUAL(0u, obj.Deserialize(tooMany, sizeof(tooMany)));
+
+	// More units than a group command may hold.
+	std::vector<unsigned char> buffer(5 + MaxNetworkGroupUnits + 1, 0x02);
+	buffer[0] = 0x01;
+	buffer[1] = buffer[2] = buffer[3] = 0x00;
+	buffer[4] = MaxNetworkGroupUnits + 1;
+	CHECK_EQUAL(0u, obj.Deserialize(&buffer[0], buffer.size()));
+}
+TEST(CNetworkGroupCommand_Deltas)
+{
+	CNetworkGroupCommand obj1;
+	obj1.Type = 0x0C;
+	obj1.Dest = 0;
+	obj1.Units.push_back(0xFFFF);
+	obj1.Units.push_back(0);
+	obj1.Units.push_back(0xFFFF);
+	obj1.Units.push_back(0x7FFF);
+	std::vector<unsigned char> buffer(obj1.Size());
+	CHECK_EQUAL(buffer.size(), obj1.Serialize(&buffer[0]));
+
+	CNetworkGroupCommand obj2;
+	CHECK_EQUAL(buffer.size(), obj2.Deserialize(&buffer[0], buffer.size()));
+	CHECK(Comp(obj1, obj2));
+}
 TEST(CNetworkChat)
 {
 	CHECK(CheckSerialization<CNetworkChat>());
@@ -127,6 +240,14 @@ TEST(CNetworkCommandSync)
 {
 	CHECK(CheckSerialization<CNetworkCommandSync>());
 }
+TEST(CNetworkCommandLag)
+{
+	CHECK(CheckSerialization<CNetworkCommandLag>());
+}
+TEST(CNetworkCommandSyncHashes)
+{
+	CHECK(CheckSerialization<CNetworkCommandSyncHashes>());
+}
 TEST(CNetworkCommandQuit)
 {
 	CHECK(CheckSerialization<CNetworkCommandQuit>());
@@ -0,0 +1,204 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name test_iolib.cpp - The test file for the asset pack of iolib.cpp. */
+//
+//      (c) Copyright 2026 by the Stratagus Team
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+#include <UnitTest++.h>
+
+#include "stratagus.h"
+#include "iolib.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+static const char *PackName = "test_iolib.pak";
+
+/// A file of a pack written by the tests
+struct PackFile {
+	PackFile(const std::string &name, const std::string &data) :
+		Name(name), Data(data), Size(data.size()), Method(0) {}
+
+	std::string Name;
+	std::string Data;  /// Stored data
+	uint64_t Size;     /// Size written in the index
+	unsigned Method;   /// Method written in the index
+};
+
+static void Write32(std::string &s, unsigned v)
+{
+	for (int i = 0; i != 4; ++i) {
+		s += char((v >> (8 * i)) & 0xFF);
+	}
+}
+
+static void Write64(std::string &s, uint64_t v)
+{
+	Write32(s, unsigned(v));
+	Write32(s, unsigned(v >> 32));
+}
+
+/// Write a pack with the layout described in iolib.cpp
+static void WritePack(const std::vector<PackFile> &files, size_t truncate = 0)
+{
+	std::string names;
+	for (size_t i = 0; i != files.size(); ++i) {
+		names += files[i].Name;
+	}
+	std::string pack("STRAPAK1");
+	Write32(pack, files.size());
+	Write32(pack, names.size());
+
+	uint64_t offset = 16 + 40 * files.size() + names.size();
+	size_t nameOffset = 0;
+	for (size_t i = 0; i != files.size(); ++i) {
+		Write64(pack, offset);
+		Write64(pack, files[i].Data.size());
+		Write64(pack, files[i].Size);
+		Write32(pack, nameOffset);
+		Write32(pack, files[i].Name.size());
+		Write32(pack, files[i].Method);
+		Write32(pack, 0);
+		offset += files[i].Data.size();
+		nameOffset += files[i].Name.size();
+	}
+	pack += names;
+	for (size_t i = 0; i != files.size(); ++i) {
+		pack += files[i].Data;
+	}
+	pack.resize(pack.size() - truncate);
+
+	FILE *f = fopen(PackName, "wb");
+	fwrite(pack.data(), 1, pack.size(), f);
+	fclose(f);
+}
+
+static bool OpenTestPack()
+{
+	const bool res = OpenAssetPack(PackName);
+	CloseAssetPack();
+	remove(PackName);
+	return res;
+}
+
+TEST(ASSET_PACK_VALID)
+{
+	std::vector<PackFile> files;
+	files.push_back(PackFile("a.lua", "return 1"));
+	files.push_back(PackFile("b/c.png", "0123456789"));
+	WritePack(files);
+	CHECK(OpenAssetPack(PackName));
+
+	CFile file;
+	char buf[16] = {0};
+	CHECK_EQUAL(0, file.open("b/c.png", CL_OPEN_READ));
+	CHECK_EQUAL(10, file.read(buf, sizeof(buf)));
+	CHECK_EQUAL(0, memcmp(buf, "0123456789", 10));
+	file.close();
+
+	CloseAssetPack();
+	remove(PackName);
+}
+
+#ifdef USE_ZLIB
+TEST(ASSET_PACK_ZLIB)
+{
+	std::string data;
+	for (int i = 0; i != 100; ++i) {
+		data += "return 1\n";
+	}
+	std::vector<Bytef> deflated(compressBound(data.size()));
+	uLongf deflatedSize = deflated.size();
+	CHECK_EQUAL(Z_OK, compress2(&deflated[0], &deflatedSize,
+								reinterpret_cast<const Bytef *>(data.data()), data.size(), Z_BEST_COMPRESSION));
+
+	std::vector<PackFile> files;
+	files.push_back(PackFile("a.lua", std::string(reinterpret_cast<const char *>(&deflated[0]), deflatedSize)));
+	files[0].Method = 1;
+	files[0].Size = data.size();
+	WritePack(files);
+	CHECK(OpenAssetPack(PackName));
+
+	CFile file;
+	std::vector<char> buf(data.size() + 16);
+	CHECK_EQUAL(0, file.open("a.lua", CL_OPEN_READ));
+	CHECK_EQUAL((int)data.size(), file.read(&buf[0], buf.size()));
+	CHECK_EQUAL(0, memcmp(&buf[0], data.data(), data.size()));
+	file.close();
+
+	CloseAssetPack();
+	remove(PackName);
+}
+#endif
+
+TEST(ASSET_PACK_TRUNCATED)
+{
+	std::vector<PackFile> files;
+	files.push_back(PackFile("a.lua", "return 1"));
+	WritePack(files, 1);
+	CHECK(!OpenTestPack());
+}
+
+TEST(ASSET_PACK_UNSORTED)
+{
+	std::vector<PackFile> files;
+	files.push_back(PackFile("b.lua", "return 1"));
+	files.push_back(PackFile("a.lua", "return 2"));
+	WritePack(files);
+	CHECK(!OpenTestPack());
+}
+
+TEST(ASSET_PACK_STORED_SIZE)
+{
+	std::vector<PackFile> files;
+	files.push_back(PackFile("a.lua", "return 1"));
+	files[0].Size = 100;
+	WritePack(files);
+	CHECK(!OpenTestPack());
+}
+
+TEST(ASSET_PACK_METHOD)
+{
+	std::vector<PackFile> files;
+	files.push_back(PackFile("a.lua", "return 1"));
+	files[0].Method = 2;
+	WritePack(files);
+	CHECK(!OpenTestPack());
+}
+
+TEST(ASSET_PACK_INFLATED_SIZE)
+{
+	std::vector<PackFile> files;
+	files.push_back(PackFile("a.lua", "x"));
+	files[0].Method = 1;
+	files[0].Size = uint64_t(1) << 40;
+	WritePack(files);
+	CHECK(!OpenTestPack());
+}
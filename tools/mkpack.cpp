@@ -0,0 +1,220 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//			  T H E   W A R   B E G I N S
+//   Utility for Stratagus - A free fantasy real time strategy game engine
+//
+//  (c) Copyright 2026 by the Stratagus Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/* To compile this programm:
+
+    % g++ -o mkpack mkpack.cpp -lz
+ */
+
+/* This programm writes the asset pack of a data directory:
+
+   % mkpack [-z] datadir datadir/data.pak
+
+   Stratagus opens data.pak of its data directory and finds the files
+   of the pack before the files on the disk. With -z the files which
+   get smaller are compressed with zlib, use it for scripts and
+   uncompressed sounds, png and ogg files are compressed already.
+
+   Files ending with .gz or .bz2 are skipped, pack them uncompressed.
+
+   The layout is described in src/stratagus/iolib.cpp.
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <zlib.h>
+
+struct Entry
+{
+  std::string name;
+  std::vector<unsigned char> data;
+  uint64_t size;
+  int method;
+};
+
+static bool compressFiles = false;
+
+static bool endsWith(const std::string &s, const char *suffix)
+{
+  const size_t n = strlen(suffix);
+  return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+static bool readFile(const std::string &path, std::vector<unsigned char> &data)
+{
+  FILE *fd = fopen(path.c_str(), "rb");
+  if (!fd) {
+    return false;
+  }
+  unsigned char buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), fd)) > 0) {
+    data.insert(data.end(), buf, buf + n);
+  }
+  fclose(fd);
+  return true;
+}
+
+static void addDirectory(const std::string &root, const std::string &dir,
+                         const std::string &output, std::vector<Entry> &entries)
+{
+  const std::string path = dir.empty() ? root : root + "/" + dir;
+  DIR *d = opendir(path.c_str());
+  if (!d) {
+    fprintf(stderr, "Can't read directory '%s'\n", path.c_str());
+    return;
+  }
+  while (dirent *de = readdir(d)) {
+    if (de->d_name[0] == '.') {
+      continue;
+    }
+    const std::string name = dir.empty() ? std::string(de->d_name) : dir + "/" + de->d_name;
+    const std::string file = root + "/" + name;
+    struct stat st;
+
+    if (stat(file.c_str(), &st)) {
+      continue;
+    }
+    if (S_ISDIR(st.st_mode)) {
+      addDirectory(root, name, output, entries);
+      continue;
+    }
+    if (file == output) {
+      continue;
+    }
+    if (endsWith(name, ".gz") || endsWith(name, ".bz2")) {
+      fprintf(stderr, "Skipping compressed file '%s'\n", name.c_str());
+      continue;
+    }
+    Entry entry;
+    entry.name = name;
+    entry.method = 0;
+    if (!readFile(file, entry.data)) {
+      fprintf(stderr, "Can't read '%s'\n", file.c_str());
+      continue;
+    }
+    entry.size = entry.data.size();
+    if (compressFiles && !entry.data.empty()) {
+      uLongf size = compressBound(entry.data.size());
+      std::vector<unsigned char> packed(size);
+
+      if (compress2(&packed[0], &size, &entry.data[0], entry.data.size(), 9) == Z_OK
+          && size < entry.data.size()) {
+        packed.resize(size);
+        entry.data.swap(packed);
+        entry.method = 1;
+      }
+    }
+    entries.push_back(entry);
+  }
+  closedir(d);
+}
+
+static bool byName(const Entry &a, const Entry &b)
+{
+  return a.name < b.name;
+}
+
+static void write32(std::vector<unsigned char> &out, uint32_t v)
+{
+  for (int i = 0; i < 4; ++i) {
+    out.push_back((v >> (i * 8)) & 0xff);
+  }
+}
+
+static void write64(std::vector<unsigned char> &out, uint64_t v)
+{
+  write32(out, v & 0xffffffff);
+  write32(out, v >> 32);
+}
+
+int main(int argc, char *argv[])
+{
+  int arg = 1;
+  if (arg < argc && strcmp(argv[arg], "-z") == 0) {
+    compressFiles = true;
+    ++arg;
+  }
+  if (argc - arg != 2) {
+    fprintf(stderr, "Usage: %s [-z] datadir pack\n", argv[0]);
+    return 1;
+  }
+  const std::string root = argv[arg];
+  const std::string output = argv[arg + 1];
+
+  std::vector<Entry> entries;
+  addDirectory(root, "", output, entries);
+  std::sort(entries.begin(), entries.end(), byName);
+
+  std::string names;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    names += entries[i].name;
+  }
+
+  std::vector<unsigned char> header;
+  header.insert(header.end(), "STRAPAK1", "STRAPAK1" + 8);
+  write32(header, entries.size());
+  write32(header, names.size());
+
+  uint64_t offset = 16 + 40 * (uint64_t)entries.size() + names.size();
+  uint32_t nameOffset = 0;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    write64(header, offset);
+    write64(header, entries[i].data.size());
+    write64(header, entries[i].size);
+    write32(header, nameOffset);
+    write32(header, entries[i].name.size());
+    write32(header, entries[i].method);
+    write32(header, 0);
+    offset += entries[i].data.size();
+    nameOffset += entries[i].name.size();
+  }
+
+  FILE *fd = fopen(output.c_str(), "wb");
+  if (!fd) {
+    fprintf(stderr, "Can't write '%s'\n", output.c_str());
+    return 1;
+  }
+  fwrite(&header[0], 1, header.size(), fd);
+  fwrite(names.data(), 1, names.size(), fd);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (!entries[i].data.empty()) {
+      fwrite(&entries[i].data[0], 1, entries[i].data.size(), fd);
+    }
+  }
+  if (fclose(fd)) {
+    fprintf(stderr, "Can't write '%s'\n", output.c_str());
+    return 1;
+  }
+  printf("%u files written to '%s'\n", (unsigned)entries.size(), output.c_str());
+  return 0;
+}